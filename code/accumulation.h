@@ -0,0 +1,79 @@
+#pragma once
+
+// Progressive accumulation for a still image. While the camera, the render settings
+// and the simulation stay as they were, every base pass frame is another set of
+// samples of the same image (sampleIndex moves on with the frame), so the running
+// mean of the frames converges to the reference instead of being reprojected and
+// filtered. fp2025.cpp feeds AccumulateCS with it, CpuRenderer::accumulate the CPU
+// version.
+
+#include "shaderport.h"
+
+#include <string.h>
+
+namespace ni {
+
+	struct FrameAccumulation
+	{
+		uint32_t maxFrameNum = ACCUMULATION_MAX_FRAME_NUM;
+
+		// Frames the running mean already holds, 0 when something that changes the
+		// image changed since the last call and the mean starts over with this frame.
+		// scene is anything else the image depends on, the particles on the CPU.
+		uint32_t update(const ConstantBufferData& constantBufferData, const SimulationData& simulationData, const void* scene = nullptr, size_t sceneSize = 0)
+		{
+			Key key = {};
+			key.viewProjMtx = constantBufferData.viewProjMtx;
+			key.cameraPos = constantBufferData.cameraPos;
+			key.resolution = constantBufferData.resolution;
+			key.sampleCount = constantBufferData.sampleCount;
+			key.samplerType = constantBufferData.samplerType;
+			key.bounceNum = constantBufferData.bounceNum;
+			key.rouletteBounce = constantBufferData.rouletteBounce;
+			key.simulationData = simulationData;
+
+			bool same = frameNum > 0 && memcmp(&key, &lastKey, sizeof(key)) == 0 && sceneSize == lastScene.getNum() &&
+				(sceneSize == 0 || memcmp(scene, lastScene.getData(), sceneSize) == 0);
+			if (!same)
+			{
+				lastKey = key;
+				lastScene.reset();
+				for (size_t index = 0; index < sceneSize; ++index) lastScene.add(((const uint8_t*)scene)[index]);
+				frameNum = 0;
+			}
+			uint32_t heldFrameNum = frameNum;
+			if (frameNum < maxFrameNum) frameNum++;
+			return heldFrameNum;
+		}
+
+		void reset() { frameNum = 0; }
+
+		// The mean holds maxFrameNum frames, there is nothing left to render.
+		bool isConverged(uint32_t heldFrameNum) const { return heldFrameNum >= maxFrameNum; }
+		// The mean is still too noisy to show as is and goes through the denoiser. From
+		// ACCUMULATION_DENOISE_FRAME_NUM frames on it is shown directly.
+		static bool needsDenoise(uint32_t heldFrameNum) { return heldFrameNum + 1 < ACCUMULATION_DENOISE_FRAME_NUM; }
+
+	private:
+		struct Key
+		{
+			Float4x4 viewProjMtx;
+			Float3 cameraPos;
+			Float3 resolution;
+			uint32_t sampleCount;
+			uint32_t samplerType;
+			uint32_t bounceNum;
+			uint32_t rouletteBounce;
+			SimulationData simulationData;
+		};
+		// Compared with memcmp, so there must be no padding bytes to hold garbage. Every
+		// member is 4 byte aligned and the sizes add up; add explicit padding members
+		// here if that ever changes.
+		static_assert(sizeof(Key) == sizeof(Float4x4) + 2 * sizeof(Float3) + 4 * sizeof(uint32_t) + sizeof(SimulationData), "FrameAccumulation::Key has padding");
+
+		Key lastKey = {};
+		Array<uint8_t> lastScene;
+		uint32_t frameNum = 0;
+	};
+
+}
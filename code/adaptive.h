@@ -0,0 +1,170 @@
+#pragma once
+
+// Adaptive sampling for the base pass. The luminance moments the temporal pass keeps
+// (HistoryM1/HistoryM2) are reduced to the noise of one sample per
+// ADAPTIVE_TILE_SIZE tile, and the ray budget of the global sampleCount is spent
+// where that noise is. Counts go in proportion to the per sample standard
+// deviation, which gives the lowest summed variance for the budget, clamped to
+// [minSampleCount, maxSampleCount] so no tile stops converging. The map is for the
+// next frame, shaders/AdaptiveSampling.hlsli reads it in shadeBasePass().
+
+#include "shaderport.h"
+#include "cputexture.h"
+
+#include <algorithm>
+#include <float.h>
+
+namespace ni {
+
+	// HistoryM1/HistoryM2 the way TemporalReprojectionCS keeps them where its history
+	// is valid, which is everywhere for a still camera. For CPU renders.
+	struct LuminanceMoments
+	{
+		void update(const CpuTexture2D<Float4>& color)
+		{
+			uint32_t width = color.getWidth();
+			uint32_t height = color.getHeight();
+			bool restart = m1.getWidth() != width || m1.getHeight() != height || frameNum == 0;
+			m1.resize(width, height);
+			m2.resize(width, height);
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					UInt2 pixel(x, y);
+					float luma = dot(color[pixel].xyz, Float3(0.299f, 0.587f, 0.114f));
+					m1[pixel] = restart ? luma : lerp(luma, m1[pixel], 1.0f - blend);
+					m2[pixel] = restart ? luma * luma : lerp(luma * luma, m2[pixel], 1.0f - blend);
+				}
+			}
+			frameNum++;
+		}
+
+		static constexpr float blend = 0.15f;
+		uint32_t frameNum = 0;
+		CpuTexture2D<float> m1;
+		CpuTexture2D<float> m2;
+	};
+
+	struct AdaptiveSampling
+	{
+		uint32_t minSampleCount = 1;
+		uint32_t maxSampleCount = ADAPTIVE_MAX_SAMPLE_COUNT;
+
+		// m1/m2 come from frames rendered with the current map, or with
+		// averageSampleCount everywhere before the first update.
+		void update(const CpuTexture2D<float>& m1, const CpuTexture2D<float>& m2, uint32_t averageSampleCount)
+		{
+			uint32_t width = m1.getWidth();
+			uint32_t height = m1.getHeight();
+			uint32_t newColumnNum = (width + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE;
+			uint32_t tileNum = newColumnNum * ((height + ADAPTIVE_TILE_SIZE - 1) / ADAPTIVE_TILE_SIZE);
+			if (newColumnNum != columnNum || sampleCounts.getNum() != tileNum)
+			{
+				columnNum = newColumnNum;
+				sampleCounts.reset();
+				sampleCounts.fill(tileNum, averageSampleCount);
+			}
+
+			deviations.reset();
+			deviations.fill(tileNum, 0.0);
+			pixelNums.reset();
+			pixelNums.fill(tileNum, 0);
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					uint32_t tile = (y / ADAPTIVE_TILE_SIZE) * columnNum + x / ADAPTIVE_TILE_SIZE;
+					deviations[tile] += shader::getSampleVariance(m1[UInt2(x, y)], m2[UInt2(x, y)], sampleCounts[tile]);
+					pixelNums[tile]++;
+				}
+			}
+			for (uint32_t tile = 0; tile < tileNum; ++tile) deviations[tile] = sqrt(deviations[tile] / pixelNums[tile]);
+
+			allocate((uint64_t)averageSampleCount * width * height);
+		}
+
+		const uint32_t* getSampleCounts() const { return sampleCounts.getData(); }
+		uint32_t getTileNum() const { return sampleCounts.getNum(); }
+		uint32_t getColumnNum() const { return columnNum; }
+		// Standard deviation of one sample, averaged over the tile in the last update.
+		double getDeviation(uint32_t tile) const { return deviations[tile]; }
+
+	private:
+		// Finds the scale that spends budget on clamp(scale * deviation) by bisection,
+		// then hands out what rounding down left over to the largest remainders.
+		void allocate(uint64_t budget)
+		{
+			uint32_t tileNum = sampleCounts.getNum();
+			double minDeviation = DBL_MAX;
+			for (uint32_t tile = 0; tile < tileNum; ++tile)
+			{
+				if (deviations[tile] > 0.0) minDeviation = min(minDeviation, deviations[tile]);
+			}
+			if (minDeviation == DBL_MAX)
+			{
+				uint64_t pixelNum = 0;
+				for (uint32_t tile = 0; tile < tileNum; ++tile) pixelNum += pixelNums[tile];
+				for (uint32_t tile = 0; tile < tileNum; ++tile) sampleCounts[tile] = clamp((uint32_t)(budget / max(pixelNum, (uint64_t)1)), minSampleCount, maxSampleCount);
+				return;
+			}
+
+			double low = 0.0;
+			double high = (double)maxSampleCount / minDeviation;
+			for (uint32_t step = 0; step < 64; ++step)
+			{
+				double scale = (low + high) * 0.5;
+				if (getCost(scale) > (double)budget) high = scale;
+				else low = scale;
+			}
+
+			uint64_t used = 0;
+			remainders.reset();
+			for (uint32_t tile = 0; tile < tileNum; ++tile)
+			{
+				double count = getCount(low, tile);
+				sampleCounts[tile] = (uint32_t)count;
+				used += (uint64_t)sampleCounts[tile] * pixelNums[tile];
+				remainders.add({ count - sampleCounts[tile], tile });
+			}
+			std::sort(remainders.getData(), remainders.getData() + remainders.getNum(), [](const Remainder& a, const Remainder& b)
+			{
+				return a.fraction > b.fraction || (a.fraction == b.fraction && a.tile < b.tile);
+			});
+			for (uint32_t index = 0; index < remainders.getNum(); ++index)
+			{
+				uint32_t tile = remainders[index].tile;
+				if (sampleCounts[tile] < maxSampleCount && used + pixelNums[tile] <= budget)
+				{
+					sampleCounts[tile]++;
+					used += pixelNums[tile];
+				}
+			}
+		}
+
+		double getCount(double scale, uint32_t tile) const
+		{
+			return std::clamp(scale * deviations[tile], (double)minSampleCount, (double)maxSampleCount);
+		}
+
+		double getCost(double scale) const
+		{
+			double cost = 0.0;
+			for (uint32_t tile = 0; tile < sampleCounts.getNum(); ++tile) cost += getCount(scale, tile) * pixelNums[tile];
+			return cost;
+		}
+
+		struct Remainder
+		{
+			double fraction;
+			uint32_t tile;
+		};
+
+		uint32_t columnNum = 0;
+		Array<uint32_t> sampleCounts;
+		Array<double> deviations;
+		Array<uint32_t> pixelNums;
+		Array<Remainder> remainders;
+	};
+
+}
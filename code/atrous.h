@@ -0,0 +1,284 @@
+#pragma once
+
+// CPU version of ATrousFilterCS, one iteration of the 5x5 edge-aware filter per
+// call. filterScalar() is AtrousIter() line by line, the reference. filter() works
+// on tileWidth x tileHeight tiles spread over the worker pool: a tile and its halo of
+// 2 * step pixels are first copied into one plane per channel (color, luma,
+// normal, depth), clamped at the image border the way the taps clamp, so every tap
+// of 8 neighbouring pixels is one unaligned load per channel and the tile's working
+// set stays in L1. pow(x, 48) becomes four squarings and two multiplies, and the depth
+// and luma weights share one exp2 from a polynomial, so results differ from the
+// reference by float rounding only (`-bench atrous` checks it against
+// maxRelativeError). Without SSE filter() runs the reference.
+
+#include "shaderport.h"
+#include "cputexture.h"
+#include "raysimd.h"
+
+namespace ni {
+
+	struct ATrousStats
+	{
+		double seconds = 0.0;
+		uint64_t pixelNum = 0;
+
+		double getMegapixelsPerSecond() const { return seconds > 0.0 ? pixelNum / seconds / 1e6 : 0.0; }
+	};
+
+	namespace simd {
+
+#if NI_SIMD_SSE
+		// 2^x for x <= 0, 0 below 2^-126. Rounds to the nearest integer and evaluates
+		// the rest, in [-0.5, 0.5], with its degree 5 Taylor polynomial: 2e-6 relative error.
+		inline Float8 exp2Fast(const Float8& x)
+		{
+			Float8 clamped = max(x, set8(-126.0f));
+#if NI_SIMD_AVX2
+			__m256i rounded = _mm256_cvtps_epi32(clamped.v);
+			Float8 n = Float8{ _mm256_cvtepi32_ps(rounded) };
+			Float8 scale = Float8{ _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(rounded, _mm256_set1_epi32(127)), 23)) };
+#else
+			__m128i roundedLo = _mm_cvtps_epi32(clamped.lo);
+			__m128i roundedHi = _mm_cvtps_epi32(clamped.hi);
+			Float8 n = Float8{ _mm_cvtepi32_ps(roundedLo), _mm_cvtepi32_ps(roundedHi) };
+			Float8 scale = Float8{ _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(roundedLo, _mm_set1_epi32(127)), 23)),
+				_mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(roundedHi, _mm_set1_epi32(127)), 23)) };
+#endif
+			Float8 f = clamped - n;
+			Float8 p = set8(0.0013333558f);
+			p = p * f + set8(0.0096181291f);
+			p = p * f + set8(0.0555041087f);
+			p = p * f + set8(0.2402265070f);
+			p = p * f + set8(0.6931471806f);
+			p = p * f + set8(1.0f);
+			return andNot(less(x, set8(-126.0f)), p * scale);
+		}
+#endif
+
+	}
+
+	struct ATrousFilter
+	{
+		static constexpr uint32_t tileWidth = 32;
+		static constexpr uint32_t tileHeight = 16;
+		static constexpr uint32_t channelNum = 8;
+		// What filter() may differ from filterScalar() by, relative to the larger channel.
+		static constexpr float maxRelativeError = 1e-4f;
+
+		// AtrousIter() for every pixel of output, which must be as large as color.
+		// m1/m2 are HistoryM1/HistoryM2 of the temporal pass.
+		static ATrousStats filterScalar(WorkerPool& pool, const CpuTexture2D<Float4>& color, const CpuTexture2D<Float4>& normal, const CpuTexture2D<float>& m1,
+			const CpuTexture2D<float>& m2, const CpuTexture2D<float>& depth, int32_t step, CpuTexture2D<Float4>& output)
+		{
+			double start = getSeconds();
+			int32_t width = (int32_t)color.getWidth();
+			int32_t height = (int32_t)color.getHeight();
+			pool.parallelFor(height, [&](uint64_t y, uint32_t)
+			{
+				for (int32_t x = 0; x < width; ++x)
+				{
+					UInt2 px((uint32_t)x, (uint32_t)y);
+					Float3 Cc = color[px].xyz;
+					Float3 Nc = normal[px].xyz;
+					float Zc = depth[px];
+					float Lc = dot(Cc, Float3(0.299f, 0.587f, 0.114f));
+					float sigma = sqrtf(max(m2[px] - m1[px] * m1[px], 0.0f));
+
+					Float3 sum = 0.0f;
+					float wsum = 0.0f;
+					for (int32_t ty = -2; ty <= 2; ++ty)
+					{
+						for (int32_t tx = -2; tx <= 2; ++tx)
+						{
+							UInt2 q((uint32_t)clamp(x + tx * step, 0, width - 1), (uint32_t)clamp((int32_t)y + ty * step, 0, height - 1));
+							Float3 Cq = color[q].xyz;
+							Float3 Nq = normal[q].xyz;
+							float Zq = depth[q];
+							float Lq = dot(Cq, Float3(0.299f, 0.587f, 0.114f));
+
+							float wn = powf(saturate(dot(Nc, Nq)), 48.0f);
+							float wz = expf(-fabsf(Zc - Zq) / 0.002f);
+							float wl = expf(-fabsf(Lc - Lq) / max(1e-3f, 1.25f * sigma));
+
+							float w = wn * wz * wl;
+							sum += w * Cq;
+							wsum += w;
+						}
+					}
+					output[px] = Float4(sum / max(wsum, 1e-6f), 1.0f);
+				}
+			});
+			ATrousStats stats = {};
+			stats.seconds = getSeconds() - start;
+			stats.pixelNum = (uint64_t)width * height;
+			return stats;
+		}
+
+		// Same arguments as filterScalar().
+		ATrousStats filter(WorkerPool& pool, const CpuTexture2D<Float4>& color, const CpuTexture2D<Float4>& normal, const CpuTexture2D<float>& m1,
+			const CpuTexture2D<float>& m2, const CpuTexture2D<float>& depth, int32_t step, CpuTexture2D<Float4>& output)
+		{
+#if NI_SIMD_SSE
+			double start = getSeconds();
+			int32_t width = (int32_t)color.getWidth();
+			int32_t height = (int32_t)color.getHeight();
+			int32_t halo = 2 * step;
+			uint32_t columnNum = (width + tileWidth - 1) / tileWidth;
+			uint32_t tileNum = columnNum * ((height + tileHeight - 1) / tileHeight);
+			uint32_t planeWidth = tileWidth + 2 * halo;
+			uint32_t planeSize = planeWidth * (tileHeight + 2 * halo);
+			reserve(pool, planeSize);
+
+			pool.parallelFor(tileNum, [&](uint64_t tile, uint32_t workerIndex)
+			{
+				int32_t tileX = (int32_t)(tile % columnNum) * tileWidth;
+				int32_t tileY = (int32_t)(tile / columnNum) * tileHeight;
+				float* planes = getPlanes(workerIndex, planeSize);
+				for (uint32_t by = 0; by < tileHeight + 2 * halo; ++by)
+				{
+					int32_t y = clamp(tileY - halo + (int32_t)by, 0, height - 1);
+					for (uint32_t bx = 0; bx < planeWidth; ++bx)
+					{
+						UInt2 q((uint32_t)clamp(tileX - halo + (int32_t)bx, 0, width - 1), (uint32_t)y);
+						uint32_t index = by * planeWidth + bx;
+						const Float4& Cq = color[q];
+						planes[redPlane * planeSize + index] = Cq.x;
+						planes[greenPlane * planeSize + index] = Cq.y;
+						planes[bluePlane * planeSize + index] = Cq.z;
+						planes[lumaPlane * planeSize + index] = dot(Cq.xyz, Float3(0.299f, 0.587f, 0.114f));
+						setGeometry(planes, planeSize, index, normal[q], depth[q]);
+					}
+				}
+
+				alignas(32) float lumaScales[tileHeight][tileWidth];
+				for (uint32_t y = 0; y < tileHeight; ++y)
+				{
+					for (uint32_t x = 0; x < tileWidth; ++x)
+					{
+						UInt2 px((uint32_t)min(tileX + (int32_t)x, width - 1), (uint32_t)min(tileY + (int32_t)y, height - 1));
+						lumaScales[y][x] = getLumaScale(m1[px], m2[px]);
+					}
+				}
+				filterTile(planes, planeWidth, planeSize, step, lumaScales[0], tileWidth, tileX, tileY, tileHeight, output);
+			});
+			ATrousStats stats = {};
+			stats.seconds = getSeconds() - start;
+			stats.pixelNum = (uint64_t)width * height;
+			return stats;
+#else
+			return filterScalar(pool, color, normal, m1, m2, depth, step, output);
+#endif
+		}
+
+		// Pieces of filter() for passes that fill the planes themselves.
+		static constexpr uint32_t redPlane = 0;
+		static constexpr uint32_t greenPlane = 1;
+		static constexpr uint32_t bluePlane = 2;
+		static constexpr uint32_t lumaPlane = 3;
+		static constexpr uint32_t normalXPlane = 4;
+		static constexpr uint32_t normalYPlane = 5;
+		static constexpr uint32_t normalZPlane = 6;
+		static constexpr uint32_t depthPlane = 7;
+
+		// Scratch planes of planeSize floats for every worker of pool.
+		void reserve(WorkerPool& pool, uint32_t planeSize)
+		{
+			uint64_t num = (uint64_t)planeSize * channelNum * pool.getWorkerNum();
+			if (scratch.getNum() >= num) return;
+			scratch.reset();
+			scratch.fill(num, 0.0f);
+		}
+
+		float* getPlanes(uint32_t workerIndex, uint32_t planeSize) { return &scratch[(uint64_t)planeSize * channelNum * workerIndex]; }
+
+		static void setGeometry(float* planes, uint32_t planeSize, uint32_t index, const Float4& normal, float depth)
+		{
+			planes[normalXPlane * planeSize + index] = normal.x;
+			planes[normalYPlane * planeSize + index] = normal.y;
+			planes[normalZPlane * planeSize + index] = normal.z;
+			planes[depthPlane * planeSize + index] = depth;
+		}
+
+		// -log2(e) / max(1e-3, 1.25 * sigma): the luma weight is exp2 of it times the difference.
+		static float getLumaScale(float m1, float m2)
+		{
+			float sigma = sqrtf(max(m2 - m1 * m1, 0.0f));
+			return -1.4426950409f / max(1e-3f, 1.25f * sigma);
+		}
+
+#if NI_SIMD_SSE
+		// The taps for the pixels of the rowNum rows at tileX, tileY that are inside
+		// output. The planes hold them with a 2 * step halo on every side, planeWidth
+		// wide, lumaScales holds them lumaStride apart.
+		static void filterTile(const float* planes, uint32_t planeWidth, uint32_t planeSize, int32_t step, const float* lumaScales, uint32_t lumaStride,
+			int32_t tileX, int32_t tileY, int32_t rowNum, CpuTexture2D<Float4>& output)
+		{
+			int32_t halo = 2 * step;
+			const float* red = planes + redPlane * planeSize;
+			const float* green = planes + greenPlane * planeSize;
+			const float* blue = planes + bluePlane * planeSize;
+			const float* luma = planes + lumaPlane * planeSize;
+			const float* normalX = planes + normalXPlane * planeSize;
+			const float* normalY = planes + normalYPlane * planeSize;
+			const float* normalZ = planes + normalZPlane * planeSize;
+			const float* depths = planes + depthPlane * planeSize;
+			rowNum = min(rowNum, (int32_t)output.getHeight() - tileY);
+			int32_t pixelNum = min((int32_t)planeWidth - 2 * halo, (int32_t)output.getWidth() - tileX);
+			simd::Float8 depthScale = simd::set8(-1.4426950409f / 0.002f);
+			simd::Float8 zero = simd::set8(0.0f);
+			simd::Float8 one = simd::set8(1.0f);
+			simd::Float8 signBit = simd::set8(-0.0f);
+			for (int32_t y = 0; y < rowNum; ++y)
+			{
+				for (int32_t x = 0; x < pixelNum; x += 8)
+				{
+					uint32_t center = (uint32_t)(y + halo) * planeWidth + (uint32_t)(x + halo);
+					simd::Float8 Lc = simd::load8(luma + center);
+					simd::Float8 NcX = simd::load8(normalX + center);
+					simd::Float8 NcY = simd::load8(normalY + center);
+					simd::Float8 NcZ = simd::load8(normalZ + center);
+					simd::Float8 Zc = simd::load8(depths + center);
+					simd::Float8 lumaScale = simd::load8(lumaScales + y * lumaStride + x);
+					simd::Float8 sumR = zero, sumG = zero, sumB = zero, wsum = zero;
+					for (int32_t ty = -2; ty <= 2; ++ty)
+					{
+						for (int32_t tx = -2; tx <= 2; ++tx)
+						{
+							uint32_t tap = (uint32_t)((int32_t)center + ty * step * (int32_t)planeWidth + tx * step);
+							simd::Float8 NqX = simd::load8(normalX + tap);
+							simd::Float8 NqY = simd::load8(normalY + tap);
+							simd::Float8 NqZ = simd::load8(normalZ + tap);
+							simd::Float8 cosine = simd::min(simd::max(NcX * NqX + NcY * NqY + NcZ * NqZ, zero), one);
+							simd::Float8 cosine2 = cosine * cosine;
+							simd::Float8 cosine4 = cosine2 * cosine2;
+							simd::Float8 cosine8 = cosine4 * cosine4;
+							simd::Float8 cosine16 = cosine8 * cosine8;
+							simd::Float8 wn = cosine16 * cosine16 * cosine16;
+							simd::Float8 dz = simd::andNot(signBit, Zc - simd::load8(depths + tap));
+							simd::Float8 dl = simd::andNot(signBit, Lc - simd::load8(luma + tap));
+							simd::Float8 w = wn * simd::exp2Fast(dz * depthScale + dl * lumaScale);
+							sumR = sumR + w * simd::load8(red + tap);
+							sumG = sumG + w * simd::load8(green + tap);
+							sumB = sumB + w * simd::load8(blue + tap);
+							wsum = wsum + w;
+						}
+					}
+					simd::Float8 invWsum = one / simd::max(wsum, simd::set8(1e-6f));
+					alignas(32) float results[3][8];
+					simd::store8(results[0], sumR * invWsum);
+					simd::store8(results[1], sumG * invWsum);
+					simd::store8(results[2], sumB * invWsum);
+					for (int32_t lane = 0; lane < min(8, pixelNum - x); ++lane)
+					{
+						output[UInt2((uint32_t)(tileX + x + lane), (uint32_t)(tileY + y))] = Float4(results[0][lane], results[1][lane], results[2][lane], 1.0f);
+					}
+				}
+			}
+		}
+#endif
+
+	private:
+		Array<float> scratch;
+	};
+
+}
@@ -0,0 +1,2073 @@
+#pragma once
+
+// Headless benchmarks for the CPU ports. `fp2025.exe -bench [name ...]` runs them
+// instead of the renderer and code/headless.cpp builds them without D3D12. Without
+// names every benchmark runs.
+
+#include "cpusim.h"
+#include "particlestore.h"
+#include "cpurender.h"
+#include "raysimd.h"
+#include "bluenoise.h"
+#include "temporal.h"
+#include "history.h"
+#include "taa.h"
+
+#include <string.h>
+
+namespace ni {
+	namespace bench {
+
+		// Checks that failed during this run. runBenchmarks() returns nonzero if any did.
+		inline uint32_t& getFailedCheckNum()
+		{
+			static uint32_t failedCheckNum = 0;
+			return failedCheckNum;
+		}
+
+		// Counts a failed check and logs what it was. Benchmarks that compare against a
+		// reference pass their mismatch test here, so a mismatch fails the run.
+		inline bool check(bool passed, const char* name)
+		{
+			if (!passed)
+			{
+				NI_LOG("FAILED: %s", name);
+				getFailedCheckNum()++;
+			}
+			return passed;
+		}
+
+		inline float hashFloat(uint32_t value)
+		{
+			// PCG hash
+			uint32_t state = value * 747796405u + 2891336453u;
+			uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+			return (float)((word >> 22u) ^ word) / 4294967296.0f;
+		}
+
+		// Scene 0 with particleNum particles, with the walls pushed out by
+		// cbrt(particleNum / 64) so the density stays that of the 64 particle scene
+		// fp2025.cpp renders. initScene0's rand() starts repeating itself after a few
+		// thousand particles and stacks them on top of each other, so the dynamic
+		// particles are spread inside the walls with a proper hash instead.
+		inline void initScene(Array<ParticleData>& particles, uint32_t particleNum, SimulationData& simulationData, ParticleSceneData& sceneData)
+		{
+			particles.reset();
+			particles.fill(particleNum, ParticleData{});
+			simulationData = {};
+			simulationData.cameraPos = float3(0, 0, 0);
+			sceneData.numParticles = particleNum;
+			shader::simulateSerial(particles.getData(), simulationData, sceneData);
+
+			const float wallOffset = 25.0f;
+			float scale = cbrtf((float)particleNum / 64.0f);
+			for (uint32_t pid = 0; pid < particleNum; ++pid)
+			{
+				ParticleData& particle = particles[pid];
+				if (pid < 6)
+				{
+					particle.position *= (particle.radius + wallOffset * scale) / (particle.radius + wallOffset);
+				}
+				else if (particle.dynamic)
+				{
+					float3 random = float3(hashFloat(pid * 3), hashFloat(pid * 3 + 1), hashFloat(pid * 3 + 2));
+					particle.position = (random * 2.0f - 1.0f) * (wallOffset * scale - particle.radius);
+					particle.velocity = particle.position * -0.005f;
+				}
+			}
+			simulationData.frame = 1;
+
+			// Let overlapping spawns push apart first so the timings are for a scene
+			// that is actually running.
+			const uint32_t settleStepNum = 8;
+			SpatialHash grid;
+			Array<uint32_t> candidates;
+			for (uint32_t step = 0; step < settleStepNum; ++step)
+			{
+				shader::simulateBroadphase(grid, candidates, particles.getData(), simulationData, sceneData);
+			}
+		}
+
+		// FNV-1a
+		inline uint64_t hashBytes(const void* data, uint64_t size)
+		{
+			const uint8_t* bytes = (const uint8_t*)data;
+			uint64_t hash = 14695981039346656037ull;
+			for (uint64_t index = 0; index < size; ++index)
+			{
+				hash = (hash ^ bytes[index]) * 1099511628211ull;
+			}
+			return hash;
+		}
+
+		inline uint64_t hashParticles(const ParticleData* particles, uint32_t particleNum)
+		{
+			return hashBytes(particles, (uint64_t)particleNum * sizeof(ParticleData));
+		}
+
+		inline uint32_t countMismatches(const Array<ParticleData>& a, const Array<ParticleData>& b)
+		{
+			uint32_t mismatchNum = 0;
+			for (uint64_t index = 0; index < a.getNum(); ++index)
+			{
+				if (memcmp(&a[index], &b[index], sizeof(ParticleData)) != 0) mismatchNum++;
+			}
+			return mismatchNum;
+		}
+
+		// Brute force pair loop (simScene0) against the spatial hash, on the same start state.
+		inline void broadphase()
+		{
+			const uint32_t particleNums[] = { 64, 1024, 10240, 102400 };
+			const uint32_t bruteForceMaxNum = 10240;
+			const uint32_t stepNum = 4;
+
+			for (uint32_t particleNum : particleNums)
+			{
+				Array<ParticleData> start;
+				SimulationData simulationData;
+				ParticleSceneData sceneData;
+				initScene(start, particleNum, simulationData, sceneData);
+
+				Array<ParticleData> gridParticles = start;
+				SpatialHash grid;
+				Array<uint32_t> candidates;
+				BroadphaseStats total = {};
+				for (uint32_t step = 0; step < stepNum; ++step)
+				{
+					simulationData.time = step / 60.0f;
+					BroadphaseStats stats = shader::simulateBroadphase(grid, candidates, gridParticles.getData(), simulationData, sceneData);
+					total.buildSeconds += stats.buildSeconds;
+					total.stepSeconds += stats.stepSeconds;
+					total.pairTestNum += stats.pairTestNum;
+				}
+				double gridMs = total.stepSeconds * 1000.0 / stepNum;
+				NI_LOG("broadphase %6u particles: grid %8.3f ms/step (build %.3f ms), %.1f pair tests/particle, %.1f ns/particle, %u large",
+					particleNum, gridMs, total.buildSeconds * 1000.0 / stepNum, (double)total.pairTestNum / ((double)particleNum * stepNum),
+					total.stepSeconds * 1e9 / ((double)particleNum * stepNum), grid.getLargeNum());
+
+				if (particleNum > bruteForceMaxNum) continue;
+
+				Array<ParticleData> bruteParticles = start;
+				double bruteSeconds = 0.0;
+				for (uint32_t step = 0; step < stepNum; ++step)
+				{
+					simulationData.time = step / 60.0f;
+					double begin = getSeconds();
+					shader::simulateSerial(bruteParticles.getData(), simulationData, sceneData);
+					bruteSeconds += getSeconds() - begin;
+				}
+				double bruteMs = bruteSeconds * 1000.0 / stepNum;
+				uint32_t mismatchNum = countMismatches(gridParticles, bruteParticles);
+				NI_LOG("broadphase %6u particles: brute %7.3f ms/step, %.1fx speedup, %u mismatching particles%s",
+					particleNum, bruteMs, bruteMs / gridMs, mismatchNum, mismatchNum == 0 ? "" : " (FAILED)");
+				check(mismatchNum == 0, "broadphase: spatial hash step differs from the brute force one");
+			}
+		}
+
+
+		// CpuSimulator over 1, 2, 4... workers. Every worker count has to produce the
+		// same bytes as the single threaded run.
+		inline void simulator()
+		{
+			const uint32_t particleNum = 102400;
+			const uint32_t stepNum = 8;
+
+			Array<ParticleData> start;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(start, particleNum, simulationData, sceneData);
+
+			uint32_t hardwareThreadNum = max(std::thread::hardware_concurrency(), 1u);
+			uint32_t workerNums[32];
+			uint32_t workerNumCount = 0;
+			for (uint32_t workerNum = 1; workerNum < hardwareThreadNum; workerNum *= 2) workerNums[workerNumCount++] = workerNum;
+			workerNums[workerNumCount++] = hardwareThreadNum;
+			// Oversubscribed, still has to match.
+			workerNums[workerNumCount++] = hardwareThreadNum * 2;
+
+			double singleSeconds = 0.0;
+			uint64_t singleHash = 0;
+			bool deterministic = true;
+			for (uint32_t index = 0; index < workerNumCount; ++index)
+			{
+				WorkerPool pool(workerNums[index]);
+				CpuSimulator simulator(pool);
+				simulator.load(start.getData(), particleNum);
+				double begin = getSeconds();
+				for (uint32_t step = 0; step < stepNum; ++step)
+				{
+					simulationData.time = step / 60.0f;
+					simulationData.frame = step + 1;
+					simulator.step(simulationData);
+				}
+				double seconds = getSeconds() - begin;
+				uint64_t hash = hashParticles(simulator.getParticles(), particleNum);
+				if (index == 0)
+				{
+					singleSeconds = seconds;
+					singleHash = hash;
+				}
+				deterministic &= hash == singleHash;
+				double speedup = singleSeconds / seconds;
+				NI_LOG("simulator %3u workers: %8.3f ms/step, %7.2f M particles/s, %5.2fx speedup, %5.1f%% efficiency, hash %016llx%s",
+					workerNums[index], seconds * 1000.0 / stepNum, (double)particleNum * stepNum / seconds / 1e6, speedup,
+					100.0 * speedup / min(workerNums[index], hardwareThreadNum), (unsigned long long)hash, hash == singleHash ? "" : " (MISMATCH)");
+			}
+			NI_LOG("simulator %u particles: %s", particleNum, deterministic ? "bit-identical for every worker count" : "FAILED, results depend on the worker count");
+			check(deterministic, "simulator: results depend on the worker count");
+		}
+
+
+		// Pair test throughput of the AoS ParticleData buffer against the SoA
+		// ParticleStore, once streaming through every pair and once through the
+		// spatial hash candidates (random access). Only the 4 wide test is
+		// faster, scalar SoA is about even with AoS.
+		inline void layout()
+		{
+			const uint32_t streamParticleNum = 10240;
+			const uint32_t gatherParticleNum = 102400;
+			const uint32_t repeatNum = 4;
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			ParticleStore store;
+
+			initScene(particles, streamParticleNum, simulationData, sceneData);
+			store.fromParticles(particles.getData(), streamParticleNum);
+			uint64_t pairNum = (uint64_t)streamParticleNum * streamParticleNum * repeatNum;
+
+			uint64_t aosCount = 0;
+			double begin = getSeconds();
+			for (uint32_t repeat = 0; repeat < repeatNum; ++repeat)
+			{
+				for (uint32_t a = 0; a < streamParticleNum; ++a)
+				{
+					for (uint32_t b = 0; b < streamParticleNum; ++b) aosCount += mayCollide(particles[a], particles[b]) ? 1 : 0;
+				}
+			}
+			double aosSeconds = getSeconds() - begin;
+
+			uint64_t soaCount = 0;
+			begin = getSeconds();
+			for (uint32_t repeat = 0; repeat < repeatNum; ++repeat)
+			{
+				for (uint32_t a = 0; a < streamParticleNum; ++a)
+				{
+					for (uint32_t b = 0; b < streamParticleNum; ++b) soaCount += store.mayCollide(particles[a], b) ? 1 : 0;
+				}
+			}
+			double soaSeconds = getSeconds() - begin;
+
+			uint64_t simdCount = 0;
+			begin = getSeconds();
+			for (uint32_t repeat = 0; repeat < repeatNum; ++repeat)
+			{
+				for (uint32_t a = 0; a < streamParticleNum; ++a) simdCount += store.countOverlaps(particles[a], 0, streamParticleNum);
+			}
+			double simdSeconds = getSeconds() - begin;
+
+			NI_LOG("layout stream %u particles: AoS %.0f M pairs/s, SoA %.0f M pairs/s, SoA 4 wide %.0f M pairs/s%s",
+				streamParticleNum, pairNum / aosSeconds / 1e6, pairNum / soaSeconds / 1e6, pairNum / simdSeconds / 1e6,
+				aosCount == soaCount && aosCount == simdCount ? "" : " (MISMATCH)");
+			check(aosCount == soaCount && aosCount == simdCount, "layout: stream pair counts differ between layouts");
+
+			initScene(particles, gatherParticleNum, simulationData, sceneData);
+			store.fromParticles(particles.getData(), gatherParticleNum);
+			SpatialHash grid;
+			grid.build(particles.getData(), gatherParticleNum);
+			Array<uint32_t> candidateStart;
+			Array<uint32_t> candidateList;
+			Array<uint32_t> candidates;
+			for (uint32_t index = 0; index < gatherParticleNum; ++index)
+			{
+				candidateStart.add((uint32_t)candidateList.getNum());
+				grid.gatherCandidates(particles[index].position, particles[index].radius, candidates);
+				for (uint32_t candidate = 0; candidate < candidates.getNum(); ++candidate) candidateList.add(candidates[candidate]);
+			}
+			candidateStart.add((uint32_t)candidateList.getNum());
+			pairNum = candidateList.getNum() * (uint64_t)repeatNum;
+
+			aosCount = 0;
+			begin = getSeconds();
+			for (uint32_t repeat = 0; repeat < repeatNum; ++repeat)
+			{
+				for (uint32_t a = 0; a < gatherParticleNum; ++a)
+				{
+					for (uint32_t index = candidateStart[a]; index < candidateStart[a + 1]; ++index) aosCount += mayCollide(particles[a], particles[candidateList[index]]) ? 1 : 0;
+				}
+			}
+			aosSeconds = getSeconds() - begin;
+
+			soaCount = 0;
+			begin = getSeconds();
+			for (uint32_t repeat = 0; repeat < repeatNum; ++repeat)
+			{
+				for (uint32_t a = 0; a < gatherParticleNum; ++a)
+				{
+					for (uint32_t index = candidateStart[a]; index < candidateStart[a + 1]; ++index) soaCount += store.mayCollide(particles[a], candidateList[index]) ? 1 : 0;
+				}
+			}
+			soaSeconds = getSeconds() - begin;
+
+			NI_LOG("layout gather %u particles: AoS %.0f M pairs/s, SoA %.0f M pairs/s, %.1f candidates/particle%s",
+				gatherParticleNum, pairNum / aosSeconds / 1e6, pairNum / soaSeconds / 1e6, (double)candidateList.getNum() / gatherParticleNum,
+				aosCount == soaCount ? "" : " (MISMATCH)");
+			check(aosCount == soaCount, "layout: gather pair counts differ between layouts");
+
+			Array<ParticleData> roundTrip(gatherParticleNum, ParticleData{});
+			store.toParticles(roundTrip.getData());
+			bool isRoundTripIdentical = memcmp(roundTrip.getData(), particles.getData(), sizeof(ParticleData) * gatherParticleNum) == 0;
+			NI_LOG("layout round trip: %s", isRoundTripIdentical ? "identical" : "FAILED");
+			check(isRoundTripIdentical, "layout: ParticleStore round trip changes the particles");
+		}
+
+
+		// Radix sort throughput on random keys, then the effect of a Morton reorder on
+		// the CPU simulator. The trace() side is measured by the "render" benchmark.
+		inline void morton()
+		{
+			const uint32_t keyNum = 4 * 1024 * 1024;
+			const uint32_t particleNum = 102400;
+			const uint32_t stepNum = 8;
+
+			uint32_t hardwareThreadNum = max(std::thread::hardware_concurrency(), 1u);
+			uint32_t workerNums[] = { 1, hardwareThreadNum };
+			Array<uint64_t> sourceKeys;
+			for (uint32_t index = 0; index < keyNum; ++index)
+			{
+				sourceKeys.add(((uint64_t)(hashFloat(index * 2) * 4294967296.0f) << 32) | (uint64_t)(hashFloat(index * 2 + 1) * 4294967296.0f));
+			}
+			Array<uint64_t> keys;
+			Array<uint32_t> values;
+			RadixSorter sorter;
+			for (uint32_t keyBits : { 32u, 64u })
+			{
+				for (uint32_t workerIndex = 0; workerIndex < (hardwareThreadNum > 1 ? 2u : 1u); ++workerIndex)
+				{
+					WorkerPool pool(workerNums[workerIndex]);
+					uint64_t mask = keyBits == 64 ? ~0ull : (1ull << keyBits) - 1;
+					keys.reset();
+					values.reset();
+					// Only a few distinct keys in the top bits so stability is exercised.
+					for (uint32_t index = 0; index < keyNum; ++index) keys.add(sourceKeys[index] & mask & ~0xffull);
+					for (uint32_t index = 0; index < keyNum; ++index) values.add(index);
+					double begin = getSeconds();
+					sorter.sort(pool, keys.getData(), values.getData(), keyNum, keyBits);
+					double seconds = getSeconds() - begin;
+					bool isStable = true;
+					for (uint32_t index = 1; index < keyNum; ++index)
+					{
+						isStable &= keys[index - 1] < keys[index] || (keys[index - 1] == keys[index] && values[index - 1] < values[index]);
+					}
+					NI_LOG("morton radix sort %u bit keys, %u workers: %.0f M keys/s%s", keyBits, workerNums[workerIndex],
+						keyNum / seconds / 1e6, isStable ? "" : " (NOT SORTED OR NOT STABLE)");
+				}
+			}
+
+			Array<ParticleData> start;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(start, particleNum, simulationData, sceneData);
+
+			for (bool use63BitCodes : { false, true })
+			{
+				Array<ParticleData> sorted = start;
+				MortonReorder reorder;
+				reorder.use63BitCodes = use63BitCodes;
+				ReorderStats stats = reorder.reorder(getWorkerPool(), sorted.getData(), particleNum);
+				bool isRemapValid = true;
+				for (uint32_t index = 0; index < particleNum; ++index)
+				{
+					isRemapValid &= reorder.getIndexOfId(sorted[index].id) == index;
+					isRemapValid &= memcmp(&sorted[index], &start[reorder.getOrder()[index]], sizeof(ParticleData)) == 0;
+				}
+				NI_LOG("morton reorder %u particles, %u bit codes: %.3f ms (codes %.3f, sort %.3f, move %.3f), id remap %s", particleNum,
+					use63BitCodes ? 63 : 30, (stats.codeSeconds + stats.sortSeconds + stats.moveSeconds) * 1000.0, stats.codeSeconds * 1000.0,
+					stats.sortSeconds * 1000.0, stats.moveSeconds * 1000.0, isRemapValid ? "valid" : "BROKEN");
+			}
+
+			for (uint32_t reorderInterval : { 0u, 16u })
+			{
+				CpuSimulator simulator;
+				simulator.reorderInterval = reorderInterval;
+				simulator.load(start.getData(), particleNum);
+				double begin = getSeconds();
+				for (uint32_t step = 0; step < stepNum; ++step)
+				{
+					simulationData.time = step / 60.0f;
+					simulator.step(simulationData);
+				}
+				double seconds = getSeconds() - begin;
+				NI_LOG("morton simulator %u particles, %s: %.3f ms/step", particleNum,
+					reorderInterval == 0 ? "creation order" : "reordered every 16 steps", seconds * 1000.0 / stepNum);
+			}
+		}
+
+		inline uint64_t hashTexture(const CpuTexture2D<Float4>& texture)
+		{
+			return hashBytes(texture.getData(), texture.getSizeInBytes());
+		}
+
+		// The base pass at RENDER_WIDTH x RENDER_HEIGHT on the scene fp2025.cpp renders,
+		// then a denser scene in creation order against Morton order. Pixels don't
+		// depend on each other, so every worker count has to give the same image.
+		inline void render()
+		{
+			const uint32_t particleNum = 64;
+			const uint32_t denseParticleNum = 1024;
+			const uint32_t denseWidth = RENDER_WIDTH / 8;
+			const uint32_t denseHeight = RENDER_HEIGHT / 8;
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData = {};
+			setupCamera(constantBufferData, Float3(0, 0, -20), Float3(0, 0, 0), RENDER_WIDTH, RENDER_HEIGHT);
+			constantBufferData.sampleCount = 1;
+
+			uint32_t hardwareThreadNum = max(std::thread::hardware_concurrency(), 1u);
+			uint32_t workerNums[] = { 1, hardwareThreadNum };
+			uint64_t singleHash = 0;
+			for (uint32_t workerIndex = 0; workerIndex < (hardwareThreadNum > 1 ? 2u : 1u); ++workerIndex)
+			{
+				WorkerPool pool(workerNums[workerIndex]);
+				CpuRenderer renderer(pool);
+				RenderStats stats = renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+				uint64_t hash = hashTexture(renderer.getColor()) ^ hashTexture(renderer.getPosition());
+				if (workerIndex == 0) singleHash = hash;
+				char name[128];
+				snprintf(name, sizeof(name), "render %ux%u, %u particles, %u workers%s", RENDER_WIDTH, RENDER_HEIGHT, particleNum,
+					workerNums[workerIndex], hash == singleHash ? "" : " (IMAGE DIFFERS)");
+				stats.log(name);
+			}
+
+			initScene(particles, denseParticleNum, simulationData, sceneData);
+			float scale = cbrtf((float)denseParticleNum / 64.0f);
+			setupCamera(constantBufferData, Float3(0, 0, -20 * scale), Float3(0, 0, 0), denseWidth, denseHeight);
+			uint64_t linearHash = 0;
+			for (uint32_t mode = 0; mode < 3; ++mode)
+			{
+				// Linear loop, BVH, BVH after a Morton reorder.
+				if (mode == 2)
+				{
+					MortonReorder reorder;
+					reorder.reorder(getWorkerPool(), particles.getData(), denseParticleNum);
+				}
+				CpuRenderer renderer;
+				renderer.useBvh = mode > 0;
+				RenderStats stats = renderer.render(particles.getData(), denseParticleNum, constantBufferData, simulationData);
+				uint64_t hash = hashTexture(renderer.getColor()) ^ hashTexture(renderer.getNormal());
+				if (mode == 0) linearHash = hash;
+				const char* modeNames[] = { "linear", "bvh", "bvh, Morton order" };
+				char name[128];
+				snprintf(name, sizeof(name), "render %ux%u, %u particles, %s%s", denseWidth, denseHeight, denseParticleNum, modeNames[mode],
+					mode == 1 && hash != linearHash ? " (IMAGE DIFFERS FROM LINEAR)" : "");
+				stats.log(name);
+			}
+		}
+
+		// Random rays from inside the walls of a scene made by initScene().
+		inline void makeRays(Array<Float3>& origins, Array<Float3>& directions, uint32_t rayNum, uint32_t particleNum)
+		{
+			float scale = cbrtf((float)particleNum / 64.0f);
+			origins.reset();
+			directions.reset();
+			for (uint32_t ray = 0; ray < rayNum; ++ray)
+			{
+				origins.add((Float3(hashFloat(ray * 6), hashFloat(ray * 6 + 1), hashFloat(ray * 6 + 2)) * 2.0f - 1.0f) * 20.0f * scale);
+				directions.add(normalize(Float3(hashFloat(ray * 6 + 3), hashFloat(ray * 6 + 4), hashFloat(ray * 6 + 5)) * 2.0f - 1.0f));
+			}
+		}
+
+		inline bool isSameBits(const Float3& a, const Float3& b) { return memcmp(&a, &b, sizeof(Float3)) == 0; }
+
+		// intersectsParticle() against the 8 wide kernels of raysimd.h on every ray and
+		// sphere pair of the 1024 particle scene, and trace()'s linear loop against
+		// traceClosest()/traceClosest8(). Every result has to match bit for bit.
+		inline void intersect()
+		{
+			const uint32_t particleNum = 1024;
+			const uint32_t rayNum = 4096;
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			Array<Float3> origins;
+			Array<Float3> directions;
+			makeRays(origins, directions, rayNum, particleNum);
+			SphereStream spheres;
+			spheres.fromParticles(particles.getData(), particleNum);
+			NI_LOG("intersect: %s kernels, %u rays x %u spheres", NI_SIMD_AVX2 ? "AVX2" : NI_SIMD_SSE ? "SSE" : "scalar", rayNum, particleNum);
+
+			uint32_t mismatchNum = 0;
+			for (uint32_t ray = 0; ray < rayNum; ++ray)
+			{
+				alignas(32) float dist[8];
+				alignas(32) float exitDist[8];
+				for (uint32_t first = 0; first < particleNum; first += 8)
+				{
+					uint32_t mask = intersectSpheres8(origins[ray], directions[ray], spheres, first, dist, exitDist);
+					for (uint32_t lane = 0; lane < 8 && first + lane < particleNum; ++lane)
+					{
+						const ParticleData& particle = particles[first + lane];
+						Float3 position, normal, exit;
+						float scalarDist = 0.0f;
+						bool isSphere = particle.visible && particle.primitive == PARTICLE_PRIMITIVE_SPHERE;
+						bool isHit = isSphere && shader::intersectsParticle(origins[ray], directions[ray], particle, position, normal, scalarDist, exit);
+						bool isLaneHit = (mask >> lane) & 1;
+						mismatchNum += isHit != isLaneHit;
+						if (!isHit || !isLaneHit) continue;
+						Float3 lanePosition, laneNormal, laneExit;
+						simd::getHitGeometry(origins[ray], directions[ray], particle.position, dist[lane], exitDist[lane], lanePosition, laneNormal, laneExit);
+						mismatchNum += memcmp(&scalarDist, &dist[lane], sizeof(float)) != 0 || !isSameBits(position, lanePosition) || !isSameBits(normal, laneNormal) || !isSameBits(exit, laneExit);
+					}
+				}
+			}
+			for (uint32_t ray = 0; ray + 8 <= rayNum; ray += 8)
+			{
+				RayPacket8 packet;
+				for (uint32_t lane = 0; lane < 8; ++lane) packet.set(lane, origins[ray + lane], directions[ray + lane]);
+				for (uint32_t index = 0; index < particleNum; ++index)
+				{
+					if (particles[index].primitive != PARTICLE_PRIMITIVE_SPHERE) continue;
+					PacketHit8 hit;
+					uint32_t mask = intersectSphere8(packet, particles[index].position, particles[index].radius, hit);
+					for (uint32_t lane = 0; lane < 8; ++lane)
+					{
+						Float3 position, normal, exit;
+						float scalarDist = 0.0f;
+						bool isHit = shader::intersectsParticle(origins[ray + lane], directions[ray + lane], particles[index], position, normal, scalarDist, exit);
+						bool isLaneHit = (mask >> lane) & 1;
+						mismatchNum += isHit != isLaneHit;
+						if (!isHit || !isLaneHit) continue;
+						mismatchNum += memcmp(&scalarDist, &hit.dist[lane], sizeof(float)) != 0 || !isSameBits(position, hit.getPosition(lane)) ||
+							!isSameBits(normal, hit.getNormal(lane)) || !isSameBits(exit, hit.getExit(lane));
+					}
+				}
+			}
+
+			shader::bindSimulation(particles.getData(), simulationData, sceneData);
+			shader::bindBvh(nullptr, nullptr, 0, 0);
+			uint32_t closestMismatchNum = 0;
+			for (uint32_t ray = 0; ray + 8 <= rayNum; ray += 8)
+			{
+				RayPacket8 packet;
+				for (uint32_t lane = 0; lane < 8; ++lane) packet.set(lane, origins[ray + lane], directions[ray + lane]);
+				PacketHit8 packetHit;
+				uint32_t mask = traceClosest8(packet, spheres, packetHit);
+				for (uint32_t lane = 0; lane < 8; ++lane)
+				{
+					ParticleData particle = {};
+					Float3 position, normal, exit;
+					bool isHit = shader::trace(origins[ray + lane], directions[ray + lane], particle, position, normal, exit);
+					SphereHit hit;
+					bool isStreamHit = traceClosest(origins[ray + lane], directions[ray + lane], spheres, hit);
+					bool isPacketHit = (mask >> lane) & 1;
+					closestMismatchNum += isHit != isStreamHit || isHit != isPacketHit;
+					if (!isHit || !isStreamHit || !isPacketHit) continue;
+					closestMismatchNum += particle.id != particles[hit.index].id || !isSameBits(position, hit.position) || !isSameBits(normal, hit.normal) || !isSameBits(exit, hit.exit);
+					closestMismatchNum += hit.index != packetHit.index[lane] || !isSameBits(position, packetHit.getPosition(lane)) ||
+						!isSameBits(normal, packetHit.getNormal(lane)) || !isSameBits(exit, packetHit.getExit(lane));
+				}
+			}
+
+			// Timed passes only count hits, the pass above did the checking.
+			double pairNum = (double)rayNum * particleNum;
+			uint32_t scalarHitNum = 0;
+			double begin = getSeconds();
+			for (uint32_t ray = 0; ray < rayNum; ++ray)
+			{
+				for (uint32_t index = 0; index < particleNum; ++index)
+				{
+					Float3 position, normal, exit;
+					float dist = 0.0f;
+					scalarHitNum += particles[index].visible && particles[index].primitive == PARTICLE_PRIMITIVE_SPHERE && shader::intersectsParticle(origins[ray], directions[ray], particles[index], position, normal, dist, exit);
+				}
+			}
+			double scalarSeconds = getSeconds() - begin;
+
+			uint32_t streamHitNum = 0;
+			begin = getSeconds();
+			for (uint32_t ray = 0; ray < rayNum; ++ray)
+			{
+				alignas(32) float dist[8];
+				alignas(32) float exitDist[8];
+				for (uint32_t first = 0; first < particleNum; first += 8)
+				{
+					uint32_t mask = intersectSpheres8(origins[ray], directions[ray], spheres, first, dist, exitDist);
+					for (; mask != 0; mask &= mask - 1) streamHitNum++;
+				}
+			}
+			double streamSeconds = getSeconds() - begin;
+
+			uint32_t packetHitNum = 0;
+			begin = getSeconds();
+			for (uint32_t ray = 0; ray + 8 <= rayNum; ray += 8)
+			{
+				RayPacket8 packet;
+				for (uint32_t lane = 0; lane < 8; ++lane) packet.set(lane, origins[ray + lane], directions[ray + lane]);
+				for (uint32_t index = 0; index < particleNum; ++index)
+				{
+					if (!particles[index].visible || particles[index].primitive != PARTICLE_PRIMITIVE_SPHERE) continue;
+					PacketHit8 hit;
+					uint32_t mask = intersectSphere8(packet, particles[index].position, particles[index].radius, hit);
+					for (; mask != 0; mask &= mask - 1) packetHitNum++;
+				}
+			}
+			double packetSeconds = getSeconds() - begin;
+
+			begin = getSeconds();
+			for (uint32_t ray = 0; ray < rayNum; ++ray)
+			{
+				ParticleData particle;
+				Float3 position, normal, exit;
+				shader::trace(origins[ray], directions[ray], particle, position, normal, exit);
+			}
+			double traceSeconds = getSeconds() - begin;
+
+			begin = getSeconds();
+			for (uint32_t ray = 0; ray < rayNum; ++ray)
+			{
+				SphereHit hit;
+				traceClosest(origins[ray], directions[ray], spheres, hit);
+			}
+			double closestSeconds = getSeconds() - begin;
+
+			begin = getSeconds();
+			for (uint32_t ray = 0; ray + 8 <= rayNum; ray += 8)
+			{
+				RayPacket8 packet;
+				for (uint32_t lane = 0; lane < 8; ++lane) packet.set(lane, origins[ray + lane], directions[ray + lane]);
+				PacketHit8 hit;
+				traceClosest8(packet, spheres, hit);
+			}
+			double closest8Seconds = getSeconds() - begin;
+
+			NI_LOG("intersect: scalar %.1f M pairs/s, 1 ray x 8 spheres %.1f M pairs/s (%.1fx), 8 rays x 1 sphere %.1f M pairs/s (%.1fx), hits %u/%u/%u, %u mismatches",
+				pairNum / scalarSeconds / 1e6, pairNum / streamSeconds / 1e6, scalarSeconds / streamSeconds, pairNum / packetSeconds / 1e6, scalarSeconds / packetSeconds,
+				scalarHitNum, streamHitNum, packetHitNum, mismatchNum);
+			NI_LOG("intersect: closest hit trace() %.3f M rays/s, traceClosest %.3f M rays/s (%.1fx), traceClosest8 %.3f M rays/s (%.1fx), %u mismatches",
+				rayNum / traceSeconds / 1e6, rayNum / closestSeconds / 1e6, traceSeconds / closestSeconds, rayNum / closest8Seconds / 1e6, traceSeconds / closest8Seconds,
+				closestMismatchNum);
+			check(mismatchNum == 0, "intersect: ray/sphere kernels differ from intersectsParticle()");
+			check(closestMismatchNum == 0, "intersect: traceClosest/traceClosest8 differ from trace()");
+		}
+
+		// Random rays from inside the walls against the BVH and the linear loop in
+		// trace(). Hits have to be the same particle at the same distance.
+		inline void bvh()
+		{
+			const uint32_t particleNums[] = { 64, 1024, 10240, 102400 };
+			const uint32_t rayNum = 65536;
+			const uint32_t linearTestNum = 1u << 24;
+
+			for (uint32_t particleNum : particleNums)
+			{
+				Array<ParticleData> particles;
+				SimulationData simulationData;
+				ParticleSceneData sceneData;
+				initScene(particles, particleNum, simulationData, sceneData);
+
+				ParticleBvh bvh;
+				double begin = getSeconds();
+				bvh.build(particles.getData(), particleNum);
+				double buildSeconds = getSeconds() - begin;
+				float buildCost = bvh.getCost();
+
+				SpatialHash grid;
+				Array<uint32_t> candidates;
+				shader::simulateBroadphase(grid, candidates, particles.getData(), simulationData, sceneData);
+				BvhStats refitStats = bvh.update(particles.getData(), particleNum);
+
+				Array<Float3> origins;
+				Array<Float3> directions;
+				makeRays(origins, directions, rayNum, particleNum);
+
+				// The linear loop gets fewer rays at high counts to keep the run short.
+				uint32_t linearRayNum = min(rayNum, max(linearTestNum / particleNum, 256u));
+				shader::bindSimulation(particles.getData(), simulationData, sceneData);
+				shader::bindBvh(nullptr, nullptr, 0, 0);
+				Array<ParticleData> linearHits;
+				Array<float> linearDists;
+				begin = getSeconds();
+				for (uint32_t ray = 0; ray < linearRayNum; ++ray)
+				{
+					ParticleData hit = {};
+					Float3 position, normal, exit;
+					bool isHit = shader::trace(origins[ray], directions[ray], hit, position, normal, exit);
+					linearHits.add(isHit ? hit : ParticleData{});
+					linearDists.add(isHit ? length(position - origins[ray]) : -1.0f);
+				}
+				double linearSeconds = getSeconds() - begin;
+
+				shader::bindBvh(bvh.getNodes(), bvh.getPrimitives(), bvh.getNodeNum(), bvh.getPlaneNum());
+				uint32_t mismatchNum = 0;
+				uint32_t anyMismatchNum = 0;
+				begin = getSeconds();
+				for (uint32_t ray = 0; ray < rayNum; ++ray)
+				{
+					ParticleData hit = {};
+					Float3 position, normal, exit;
+					bool isHit = shader::trace(origins[ray], directions[ray], hit, position, normal, exit);
+					if (ray < linearRayNum)
+					{
+						float dist = isHit ? length(position - origins[ray]) : -1.0f;
+						mismatchNum += (isHit ? hit.id : 0) != linearHits[ray].id || dist != linearDists[ray];
+					}
+				}
+				double bvhSeconds = getSeconds() - begin;
+
+				// Any hit: always hits without a limit, never before the closest hit.
+				for (uint32_t ray = 0; ray < linearRayNum; ++ray)
+				{
+					bool isHit = linearDists[ray] >= 0.0f;
+					anyMismatchNum += shader::traceAnyBvh(origins[ray], directions[ray], 3.402823466e+38F) != isHit;
+					if (isHit)
+					{
+						anyMismatchNum += shader::traceAnyBvh(origins[ray], directions[ray], linearDists[ray] * 0.999f);
+					}
+				}
+
+				shader::bindBvh(nullptr, nullptr, 0, 0);
+
+				NI_LOG("bvh %u particles: build %.3f ms, %u nodes, depth %u, SAH cost %.1f, after one step %s %.3f ms cost %.1f",
+					particleNum, buildSeconds * 1000.0, bvh.getNodeNum(), bvh.getDepth(), buildCost, refitStats.rebuilt ? "rebuild" : "refit",
+					refitStats.seconds * 1000.0, bvh.getCost());
+				NI_LOG("bvh %u particles: linear %.3f M rays/s, bvh %.3f M rays/s, %u closest / %u any hit mismatches in %u rays", particleNum,
+					linearRayNum / linearSeconds / 1e6, rayNum / bvhSeconds / 1e6, mismatchNum, anyMismatchNum, linearRayNum);
+				check(mismatchNum == 0 && anyMismatchNum == 0, "bvh: traversal differs from the linear trace");
+			}
+		}
+
+		// Scene 0's walls as the radius 999 spheres they used to be against the planes
+		// they are now, per ray through trace(), linear and with a BVH. The variants
+		// take turns and the best of repeatNum runs counts.
+		inline void walls()
+		{
+			const uint32_t particleNums[] = { 64, 1024, 10240 };
+			const uint32_t rayNum = 16384;
+			const uint32_t linearTestNum = 1u << 24;
+			const uint32_t repeatNum = 5;
+			for (uint32_t particleNum : particleNums)
+			{
+				Array<ParticleData> scenes[2];
+				SimulationData simulationData;
+				ParticleSceneData sceneData;
+				initScene(scenes[1], particleNum, simulationData, sceneData);
+				scenes[0] = scenes[1];
+				for (uint32_t pid = 0; pid < 6; ++pid) scenes[0][pid].primitive = PARTICLE_PRIMITIVE_SPHERE;
+				ParticleBvh bvhs[2];
+				for (uint32_t asPlanes = 0; asPlanes < 2; ++asPlanes) bvhs[asPlanes].build(scenes[asPlanes].getData(), particleNum);
+
+				Array<Float3> origins;
+				Array<Float3> directions;
+				makeRays(origins, directions, rayNum, particleNum);
+				uint32_t linearRayNum = min(rayNum, max(linearTestNum / particleNum, 256u));
+				double nsPerRay[2][2] = { { DBL_MAX, DBL_MAX }, { DBL_MAX, DBL_MAX } };
+				for (uint32_t repeat = 0; repeat < repeatNum; ++repeat)
+				{
+					for (uint32_t variant = 0; variant < 4; ++variant)
+					{
+						uint32_t asPlanes = variant & 1;
+						uint32_t useBvh = variant >> 1;
+						const ParticleBvh& bvh = bvhs[asPlanes];
+						shader::bindSimulation(scenes[asPlanes].getData(), simulationData, sceneData);
+						if (useBvh) shader::bindBvh(bvh.getNodes(), bvh.getPrimitives(), bvh.getNodeNum(), bvh.getPlaneNum());
+						else shader::bindBvh(nullptr, nullptr, 0, 0);
+						uint32_t testNum = useBvh ? rayNum : linearRayNum;
+						double begin = getSeconds();
+						for (uint32_t ray = 0; ray < testNum; ++ray)
+						{
+							ParticleData hit;
+							Float3 position, normal, exit;
+							shader::trace(origins[ray], directions[ray], hit, position, normal, exit);
+						}
+						nsPerRay[asPlanes][useBvh] = min(nsPerRay[asPlanes][useBvh], (getSeconds() - begin) * 1e9 / testNum);
+					}
+				}
+				shader::bindBvh(nullptr, nullptr, 0, 0);
+				NI_LOG("walls %u particles: linear %.0f -> %.0f ns/ray (%.2fx), bvh %.0f -> %.0f ns/ray (%.2fx), %u -> %u bvh nodes", particleNum,
+					nsPerRay[0][0], nsPerRay[1][0], nsPerRay[0][0] / nsPerRay[1][0], nsPerRay[0][1], nsPerRay[1][1], nsPerRay[0][1] / nsPerRay[1][1],
+					bvhs[0].getNodeNum(), bvhs[1].getNodeNum());
+			}
+		}
+
+		// Per channel RMSE of color against reference, and of the error after a 3x3
+		// box blur, which is what is left of blue noise error once neighbours average.
+		inline void getRenderError(const CpuTexture2D<Float4>& color, const Array<Float3>& reference, double& rmse, double& blurredRmse)
+		{
+			uint32_t width = color.getWidth();
+			uint32_t height = color.getHeight();
+			double sum = 0.0;
+			double blurredSum = 0.0;
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					Float3 error = color[UInt2(x, y)].xyz - reference[y * width + x];
+					sum += error.x * error.x + error.y * error.y + error.z * error.z;
+					Float3 blurred = 0.0f;
+					float weight = 0.0f;
+					for (uint32_t ny = (y > 0 ? y - 1 : 0); ny <= min(y + 1, height - 1); ++ny)
+					{
+						for (uint32_t nx = (x > 0 ? x - 1 : 0); nx <= min(x + 1, width - 1); ++nx)
+						{
+							blurred += color[UInt2(nx, ny)].xyz - reference[ny * width + nx];
+							weight += 1.0f;
+						}
+					}
+					blurred /= weight;
+					blurredSum += blurred.x * blurred.x + blurred.y * blurred.y + blurred.z * blurred.z;
+				}
+			}
+			double valueNum = (double)width * height * 3.0;
+			rmse = sqrt(sum / valueNum);
+			blurredRmse = sqrt(blurredSum / valueNum);
+		}
+
+		// Convergence of the base pass, both samplers against one high spp Sobol render
+		// (a different part of the sequence than the runs measured), and the blue noise
+		// table against its generator.
+		inline void sampler()
+		{
+			Array<uint32_t> ranks;
+			BlueNoiseGenerator generator;
+			generator.generate(BLUE_NOISE_TILE, ranks);
+			uint32_t rankMismatchNum = 0;
+			for (uint32_t index = 0; index < ranks.getNum(); ++index) rankMismatchNum += ranks[index] != shader::blueNoiseRanks[index] ? 1 : 0;
+			NI_LOG("sampler: %u of %u blue noise ranks differ from BlueNoiseGenerator", rankMismatchNum, ranks.getNum());
+
+			const uint32_t particleNum = 64;
+			const uint32_t width = 96;
+			const uint32_t height = 54;
+			const uint32_t referenceSampleCount = 256;
+			const uint32_t sampleCounts[] = { 1, 2, 4, 8, 16, 32 };
+			const uint32_t sampleCountNum = sizeof(sampleCounts) / sizeof(sampleCounts[0]);
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData = {};
+			setupCamera(constantBufferData, Float3(0, 0, -20), Float3(0, 0, 0), width, height);
+			CpuRenderer renderer;
+
+			constantBufferData.samplerType = SAMPLER_SOBOL;
+			constantBufferData.sampleCount = referenceSampleCount;
+			constantBufferData.frame = 1000.0f;
+			renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+			Array<Float3> reference;
+			for (uint32_t pixel = 0; pixel < width * height; ++pixel) reference.add(renderer.getColor().getData()[pixel].xyz);
+
+			const uint32_t samplerTypes[] = { SAMPLER_HASH, SAMPLER_SOBOL };
+			const char* samplerNames[] = { "hash", "sobol" };
+			double rmses[2][sampleCountNum] = {};
+			constantBufferData.frame = 0.0f;
+			for (uint32_t type = 0; type < 2; ++type)
+			{
+				constantBufferData.samplerType = samplerTypes[type];
+				for (uint32_t count = 0; count < sampleCountNum; ++count)
+				{
+					constantBufferData.sampleCount = sampleCounts[count];
+					RenderStats stats = renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+					double blurredRmse = 0.0;
+					getRenderError(renderer.getColor(), reference, rmses[type][count], blurredRmse);
+					NI_LOG("sampler %s %ux%u, %2u spp: rmse %.5f, blurred rmse %.5f, %.3f ms", samplerNames[type], width, height, sampleCounts[count],
+						rmses[type][count], blurredRmse, stats.seconds * 1000.0);
+				}
+			}
+			// Fewest Sobol samples that are as good as the 4 fp2025.cpp used to take with the hash.
+			uint32_t matchCount = 0;
+			for (uint32_t count = sampleCountNum; count-- > 0;)
+			{
+				if (rmses[1][count] <= rmses[0][2]) matchCount = sampleCounts[count];
+			}
+			if (matchCount > 0) NI_LOG("sampler: sobol reaches the hash's 4 spp rmse at %u spp", matchCount);
+			else NI_LOG("sampler: sobol does not reach the hash's 4 spp rmse within %u spp", sampleCounts[sampleCountNum - 1]);
+		}
+
+		inline double getMeanColor(const CpuTexture2D<Float4>& color)
+		{
+			double sum = 0.0;
+			uint64_t pixelNum = (uint64_t)color.getWidth() * color.getHeight();
+			for (uint64_t pixel = 0; pixel < pixelNum; ++pixel)
+			{
+				const Float4& value = color.getData()[pixel];
+				sum += value.x + value.y + value.z;
+			}
+			return sum / (double)(pixelNum * 3);
+		}
+
+		// Next event estimation against the bounces alone at the same samples per pixel,
+		// as error against a high spp render with light sampling. The high spp renders
+		// with and without it have to agree on the mean, or one of them is biased.
+		inline void lights()
+		{
+			const uint32_t particleNum = 64;
+			const uint32_t width = 96;
+			const uint32_t height = 54;
+			const uint32_t referenceSampleCount = 256;
+			const uint32_t sampleCounts[] = { 1, 4, 16 };
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData = {};
+			setupCamera(constantBufferData, Float3(0, 0, -20), Float3(0, 0, 0), width, height);
+			CpuRenderer renderer;
+
+			constantBufferData.sampleCount = referenceSampleCount;
+			constantBufferData.frame = 1000.0f;
+			double referenceMeans[2] = {};
+			Array<Float3> reference;
+			for (uint32_t useLights = 0; useLights < 2; ++useLights)
+			{
+				renderer.useLights = useLights != 0;
+				RenderStats stats = renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+				referenceMeans[useLights] = getMeanColor(renderer.getColor());
+				if (useLights)
+				{
+					for (uint32_t pixel = 0; pixel < width * height; ++pixel) reference.add(renderer.getColor().getData()[pixel].xyz);
+					NI_LOG("lights: %u of %u particles emissive, list built in %.3f ms", stats.lights.lightNum, particleNum, stats.lights.seconds * 1000.0);
+				}
+			}
+			NI_LOG("lights %ux%u, %u spp mean: bounces only %.5f, light sampling %.5f (%+.2f%%)", width, height, referenceSampleCount, referenceMeans[0],
+				referenceMeans[1], (referenceMeans[1] / referenceMeans[0] - 1.0) * 100.0);
+
+			constantBufferData.frame = 0.0f;
+			for (uint32_t sampleCount : sampleCounts)
+			{
+				constantBufferData.sampleCount = sampleCount;
+				double mses[2] = {};
+				double seconds[2] = {};
+				for (uint32_t useLights = 0; useLights < 2; ++useLights)
+				{
+					renderer.useLights = useLights != 0;
+					RenderStats stats = renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+					double rmse = 0.0;
+					double blurredRmse = 0.0;
+					getRenderError(renderer.getColor(), reference, rmse, blurredRmse);
+					mses[useLights] = rmse * rmse;
+					seconds[useLights] = stats.seconds;
+				}
+				NI_LOG("lights %ux%u, %2u spp: rmse %.5f -> %.5f, %.2fx less variance, %.3f -> %.3f ms, %.2fx less variance per time", width, height,
+					sampleCount, sqrt(mses[0]), sqrt(mses[1]), mses[0] / mses[1], seconds[0] * 1000.0, seconds[1] * 1000.0,
+					(mses[0] * seconds[0]) / (mses[1] * seconds[1]));
+			}
+		}
+
+		// Russian roulette from different bounces against full length paths. Expected
+		// color has to stay where it was, with fewer rays per path for some extra noise.
+		inline void roulette()
+		{
+			const uint32_t particleNum = 64;
+			const uint32_t width = 96;
+			const uint32_t height = 54;
+			const uint32_t referenceSampleCount = 256;
+			const uint32_t sampleCount = 64;
+			const uint32_t rouletteBounces[] = { 0, 1, 2, 3 };
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData = {};
+			setupCamera(constantBufferData, Float3(0, 0, -20), Float3(0, 0, 0), width, height);
+			constantBufferData.bounceNum = PATH_DEFAULT_BOUNCE_NUM;
+			CpuRenderer renderer;
+
+			constantBufferData.sampleCount = referenceSampleCount;
+			constantBufferData.frame = 1000.0f;
+			renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+			Array<Float3> reference;
+			for (uint32_t pixel = 0; pixel < width * height; ++pixel) reference.add(renderer.getColor().getData()[pixel].xyz);
+
+			constantBufferData.sampleCount = sampleCount;
+			constantBufferData.frame = 0.0f;
+			double baseMean = 0.0;
+			double baseCost = 0.0;
+			for (uint32_t rouletteBounce : rouletteBounces)
+			{
+				constantBufferData.rouletteBounce = rouletteBounce;
+				RenderStats stats = renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+				double mean = getMeanColor(renderer.getColor());
+				double rmse = 0.0;
+				double blurredRmse = 0.0;
+				getRenderError(renderer.getColor(), reference, rmse, blurredRmse);
+				// Time to the same error, relative to no roulette.
+				double cost = rmse * rmse * stats.seconds;
+				if (rouletteBounce == 0)
+				{
+					baseMean = mean;
+					baseCost = cost;
+				}
+				char name[128];
+				if (rouletteBounce == 0) snprintf(name, sizeof(name), "roulette off");
+				else snprintf(name, sizeof(name), "roulette from hit %u", rouletteBounce);
+				char histogram[256] = {};
+				for (uint32_t length = 0; length <= PATH_DEFAULT_BOUNCE_NUM; ++length)
+				{
+					size_t used = strlen(histogram);
+					snprintf(histogram + used, sizeof(histogram) - used, "%s%.1f%%", length > 0 ? " " : "", stats.pathLengthNums[length] * 100.0 / stats.getPathNum());
+				}
+				NI_LOG("%s, %ux%u %u spp: %.3f ms, %.2f M rays/s, %.2f rays/path, %.2f hits/path [%s], mean %+.2f%%, rmse %.5f, %.2fx efficiency", name,
+					width, height, sampleCount, stats.seconds * 1000.0, stats.getRaysPerSecond() / 1e6, (double)stats.rayNum / stats.getPathNum(),
+					stats.getMeanPathLength(), histogram, (mean / baseMean - 1.0) * 100.0, rmse, baseCost / cost);
+			}
+		}
+
+		// The adaptive sample count map against the same ray budget spread evenly, at a
+		// still camera so the moments build up like in the temporal pass. Each measured
+		// frame uses the map the frames before it produced.
+		inline void adaptive()
+		{
+			const uint32_t particleNum = 64;
+			const uint32_t width = 256;
+			const uint32_t height = 128;
+			const uint32_t referenceSampleCount = 128;
+			const uint32_t averageSampleCount = 4;
+			const uint32_t warmupFrameNum = 8;
+			const uint32_t measureFrameNum = 4;
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData = {};
+			setupCamera(constantBufferData, Float3(0, 0, -20), Float3(0, 0, 0), width, height);
+			CpuRenderer renderer;
+
+			constantBufferData.sampleCount = referenceSampleCount;
+			constantBufferData.frame = 1000.0f;
+			renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+			Array<Float3> reference;
+			Array<uint32_t> hitIds;
+			for (uint32_t pixel = 0; pixel < width * height; ++pixel)
+			{
+				reference.add(renderer.getColor().getData()[pixel].xyz);
+				hitIds.add((uint32_t)renderer.getPosition().getData()[pixel].w);
+			}
+
+			LuminanceMoments moments;
+			AdaptiveSampling sampling;
+			constantBufferData.sampleCount = averageSampleCount;
+			double mses[2] = {};
+			uint64_t rayNums[2] = {};
+			for (uint32_t frame = 0; frame < warmupFrameNum + measureFrameNum; ++frame)
+			{
+				constantBufferData.frame = (float)frame;
+				for (uint32_t mode = (frame < warmupFrameNum ? 1u : 0u); mode < 2; ++mode)
+				{
+					renderer.sampleCounts = mode == 1 ? &sampling : nullptr;
+					RenderStats stats = renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+					if (frame < warmupFrameNum) continue;
+					double rmse = 0.0;
+					double blurredRmse = 0.0;
+					getRenderError(renderer.getColor(), reference, rmse, blurredRmse);
+					mses[mode] += rmse * rmse / measureFrameNum;
+					rayNums[mode] += stats.rayNum / measureFrameNum;
+				}
+				moments.update(renderer.getColor());
+				sampling.update(moments.m1, moments.m2, averageSampleCount);
+			}
+			NI_LOG("adaptive %ux%u, %u spp budget: uniform rmse %.5f, %.2f M rays, adaptive rmse %.5f, %.2f M rays, %.2fx less error per ray", width, height,
+				averageSampleCount, sqrt(mses[0]), rayNums[0] / 1e6, sqrt(mses[1]), rayNums[1] / 1e6, (mses[0] * rayNums[0]) / (mses[1] * rayNums[1]));
+
+			// Where the samples went: the map and the average count of wall and sphere pixels.
+			const uint32_t* sampleCounts = sampling.getSampleCounts();
+			uint32_t columnNum = sampling.getColumnNum();
+			for (uint32_t row = 0; row < sampling.getTileNum() / columnNum; ++row)
+			{
+				char line[256] = {};
+				for (uint32_t column = 0; column < columnNum; ++column)
+				{
+					size_t used = strlen(line);
+					snprintf(line + used, sizeof(line) - used, "%3u", sampleCounts[row * columnNum + column]);
+				}
+				NI_LOG("adaptive map:%s", line);
+			}
+			double wallSampleSum = 0.0;
+			double sphereSampleSum = 0.0;
+			uint32_t wallPixelNum = 0;
+			uint32_t spherePixelNum = 0;
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					uint32_t id = hitIds[y * width + x];
+					uint32_t sampleCount = sampleCounts[(y / ADAPTIVE_TILE_SIZE) * columnNum + x / ADAPTIVE_TILE_SIZE];
+					if (id >= 1 && id <= 6)
+					{
+						wallSampleSum += sampleCount;
+						wallPixelNum++;
+					}
+					else if (id > 6)
+					{
+						sphereSampleSum += sampleCount;
+						spherePixelNum++;
+					}
+				}
+			}
+			NI_LOG("adaptive: wall pixels %.2f spp, sphere pixels %.2f spp", wallSampleSum / max(wallPixelNum, 1u), sphereSampleSum / max(spherePixelNum, 1u));
+		}
+
+		// A still camera accumulating 4 spp frames, as error against a high spp render.
+		// The error has to fall like 1 / sqrt(frames), the mean must not drift, a camera
+		// move has to start over and a converged image has to cost nothing.
+		inline void accumulate()
+		{
+			const uint32_t particleNum = 64;
+			const uint32_t width = 256;
+			const uint32_t height = 128;
+			const uint32_t referenceSampleCount = 256;
+			const uint32_t frameSampleCount = 4;
+			const uint32_t frameNum = 32;
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData = {};
+			setupCamera(constantBufferData, Float3(0, 0, -20), Float3(0, 0, 0), width, height);
+			CpuRenderer renderer;
+
+			constantBufferData.sampleCount = referenceSampleCount;
+			constantBufferData.frame = 1000.0f;
+			renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+			Array<Float3> reference;
+			for (uint32_t pixel = 0; pixel < width * height; ++pixel) reference.add(renderer.getColor().getData()[pixel].xyz);
+			double referenceMean = getMeanColor(renderer.getColor());
+
+			renderer.accumulate = true;
+			renderer.accumulation.maxFrameNum = frameNum;
+			constantBufferData.sampleCount = frameSampleCount;
+			double firstRmse = 0.0;
+			double frameSeconds = 0.0;
+			for (uint32_t frame = 0; frame < frameNum; ++frame)
+			{
+				constantBufferData.frame = (float)frame;
+				RenderStats stats = renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+				frameSeconds += stats.seconds / frameNum;
+				if (stats.accumulatedFrameNum != frame + 1) NI_LOG("accumulate: frame %u holds %u frames, FAILED", frame, stats.accumulatedFrameNum);
+				check(stats.accumulatedFrameNum == frame + 1, "accumulate: a still frame does not add to the running mean");
+				if ((stats.accumulatedFrameNum & (stats.accumulatedFrameNum - 1)) != 0) continue;
+				double rmse = 0.0;
+				double blurredRmse = 0.0;
+				getRenderError(renderer.getAccumulation(), reference, rmse, blurredRmse);
+				if (frame == 0) firstRmse = rmse;
+				NI_LOG("accumulate %ux%u, %2u frames of %u spp: rmse %.5f (%.2fx below one frame, 1/sqrt gives %.2fx), mean %+.2f%%", width, height,
+					stats.accumulatedFrameNum, frameSampleCount, rmse, firstRmse / rmse, sqrt((double)stats.accumulatedFrameNum),
+					(getMeanColor(renderer.getAccumulation()) / referenceMean - 1.0) * 100.0);
+			}
+
+			RenderStats convergedStats = renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+			setupCamera(constantBufferData, Float3(0, 0.5f, -20), Float3(0, 0, 0), width, height);
+			RenderStats movedStats = renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+			NI_LOG("accumulate: %.3f ms/frame while accumulating, %.3f ms once converged (%u frames), camera move restarts at %u frame%s", frameSeconds * 1000.0,
+				convergedStats.seconds * 1000.0, convergedStats.accumulatedFrameNum, movedStats.accumulatedFrameNum, movedStats.accumulatedFrameNum == 1 ? "" : "s, FAILED");
+			check(movedStats.accumulatedFrameNum == 1, "accumulate: a camera move does not restart the running mean");
+		}
+
+		// Camera rays of every pixel through tracePrimary(), as shadeBasePass() makes them.
+		// Returns the seconds, the hits go to ids and positions.
+		inline double traceCameraRays(uint32_t width, uint32_t height, Array<uint32_t>& ids, Array<Float3>& positions)
+		{
+			ids.reset();
+			positions.reset();
+			double begin = getSeconds();
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					Float3 rayOrigin;
+					shader::PrimaryHit primary = shader::tracePrimary(Float2((float)x, (float)y) / Float2((float)width, (float)height), UInt2(x, y), rayOrigin);
+					ids.add(primary.hit ? primary.particle.id : ~0u);
+					positions.add(primary.position);
+				}
+			}
+			return getSeconds() - begin;
+		}
+
+		inline void tilebins()
+		{
+			const uint32_t particleNums[] = { 64, 256, 1024, 4096, 16384 };
+			const uint32_t width = 320;
+			const uint32_t height = 180;
+			const uint32_t buildNum = 16;
+			const uint32_t maxLinearParticleNum = 4096;
+
+			for (uint32_t particleNum : particleNums)
+			{
+				Array<ParticleData> particles;
+				SimulationData simulationData;
+				ParticleSceneData sceneData;
+				initScene(particles, particleNum, simulationData, sceneData);
+				ConstantBufferData constantBufferData = {};
+				float scale = cbrtf((float)particleNum / 64.0f);
+				setupCamera(constantBufferData, Float3(0, 0, -20 * scale), Float3(0, 0, 0), width, height);
+				shader::bindBasePass(particles.getData(), constantBufferData, simulationData, sceneData);
+
+				ParticleTileBins bins;
+				TileBinStats binStats = {};
+				double buildSeconds = 0.0;
+				for (uint32_t build = 0; build < buildNum; ++build)
+				{
+					binStats = bins.build(getWorkerPool(), particles.getData(), particleNum, constantBufferData);
+					buildSeconds += binStats.seconds / buildNum;
+				}
+				ParticleBvh bvh;
+				bvh.build(particles.getData(), particleNum);
+
+				// Linear loop (the reference) up to maxLinearParticleNum, BVH, bins.
+				Array<uint32_t> ids[3];
+				Array<Float3> positions[3];
+				double seconds[3] = {};
+				if (particleNum <= maxLinearParticleNum) seconds[0] = traceCameraRays(width, height, ids[0], positions[0]);
+				shader::bindBvh(bvh.getNodes(), bvh.getPrimitives(), bvh.getNodeNum(), bvh.getPlaneNum());
+				seconds[1] = traceCameraRays(width, height, ids[1], positions[1]);
+				shader::bindTileBins(bins.getOffsets(), bins.getParticles(), bins.getGlobalParticles(), bins.getGlobalNum(), bins.getColumnNum());
+				seconds[2] = traceCameraRays(width, height, ids[2], positions[2]);
+				shader::bindTileBins(nullptr, nullptr, nullptr, 0, 0);
+				shader::bindBvh(nullptr, nullptr, 0, 0);
+
+				uint32_t reference = particleNum <= maxLinearParticleNum ? 0 : 1;
+				uint32_t mismatchNum[3] = {};
+				for (uint32_t mode = 1; mode < 3; ++mode)
+				{
+					for (uint32_t pixel = 0; pixel < width * height; ++pixel)
+					{
+						mismatchNum[mode] += ids[mode][pixel] != ids[reference][pixel] || (ids[mode][pixel] != ~0u && positions[mode][pixel] != positions[reference][pixel]);
+					}
+				}
+
+				double rayNum = (double)width * height;
+				char linear[32] = "-";
+				if (reference == 0) snprintf(linear, sizeof(linear), "%.0f", seconds[0] / rayNum * 1e9);
+				NI_LOG("tilebins %u particles: build %.3f ms, %u tiles, %.2f spheres/tile, %u global", particleNum, buildSeconds * 1000.0,
+					binStats.tileNum, (double)binStats.pairNum / binStats.tileNum, binStats.globalNum);
+				NI_LOG("tilebins %u particles, %ux%u camera rays: linear %s ns/ray, bvh %.0f ns/ray, bins %.0f ns/ray, saves %.3f ms on the bvh for %.3f ms build, %u mismatches against %s",
+					particleNum, width, height, linear, seconds[1] / rayNum * 1e9,
+					seconds[2] / rayNum * 1e9, (seconds[1] - seconds[2]) * 1000.0, buildSeconds * 1000.0, mismatchNum[2] + (reference == 0 ? mismatchNum[1] : 0),
+					reference == 0 ? "linear" : "bvh");
+				check(mismatchNum[1] == 0 && mismatchNum[2] == 0, "tilebins: binned camera rays differ from the reference trace");
+			}
+		}
+
+		inline void splats()
+		{
+			const uint32_t particleNums[] = { 64, 256, 1024, 4096, 16384 };
+			const uint32_t width = 320;
+			const uint32_t height = 180;
+			const uint32_t repeatNum = 8;
+
+			for (uint32_t particleNum : particleNums)
+			{
+				Array<ParticleData> particles;
+				SimulationData simulationData;
+				ParticleSceneData sceneData;
+				initScene(particles, particleNum, simulationData, sceneData);
+				ConstantBufferData constantBufferData = {};
+				float scale = cbrtf((float)particleNum / 64.0f);
+				setupCamera(constantBufferData, Float3(0, 0, -20 * scale), Float3(0, 0, 0), width, height);
+				shader::bindBasePass(particles.getData(), constantBufferData, simulationData, sceneData);
+
+				ParticleTileBins bins;
+				TileBinStats binStats = bins.build(getWorkerPool(), particles.getData(), particleNum, constantBufferData);
+				ParticleSplats splats;
+				SplatStats splatStats = {};
+				double rasterSeconds = 0.0;
+				for (uint32_t repeat = 0; repeat < repeatNum; ++repeat)
+				{
+					splatStats = splats.rasterize(getWorkerPool(), particles.getData(), constantBufferData, bins);
+					rasterSeconds += splatStats.seconds / repeatNum;
+				}
+
+				// Camera rays traced through the bins, then read from the splats.
+				Array<uint32_t> ids[2];
+				Array<Float3> positions[2];
+				shader::bindTileBins(bins.getOffsets(), bins.getParticles(), bins.getGlobalParticles(), bins.getGlobalNum(), bins.getColumnNum());
+				double traceSeconds = traceCameraRays(width, height, ids[0], positions[0]);
+				shader::bindSplats(splats.getParticleIndices(), splats.getWidth());
+				double resolveSeconds = traceCameraRays(width, height, ids[1], positions[1]);
+				shader::bindSplats(nullptr, 0);
+				shader::bindTileBins(nullptr, nullptr, nullptr, 0, 0);
+
+				uint32_t mismatchNum = 0;
+				for (uint32_t pixel = 0; pixel < width * height; ++pixel)
+				{
+					mismatchNum += ids[1][pixel] != ids[0][pixel] || (ids[0][pixel] != ~0u && positions[1][pixel] != positions[0][pixel]);
+				}
+
+				double pixelNum = (double)width * height;
+				NI_LOG("splats %u particles, %ux%u: bins build %.3f ms, raster %.3f ms (%.2f tests/pixel, %.2f of them binned spheres) + resolve %.3f ms, bins trace %.3f ms, %u mismatches",
+					particleNum, width, height, binStats.seconds * 1000.0, rasterSeconds * 1000.0, splatStats.testNum / pixelNum, splatStats.testNum / pixelNum - binStats.globalNum,
+					resolveSeconds * 1000.0, traceSeconds * 1000.0, mismatchNum);
+				check(mismatchNum == 0, "splats: visibility buffer resolve differs from the binned trace");
+			}
+		}
+
+		inline void noise()
+		{
+			const uint32_t callNum = 1u << 20;
+			const uint32_t particleNum = 1024;
+			const uint32_t width = 240;
+			const uint32_t height = 135;
+
+			NoiseVolume volume;
+			NoiseVolumeStats bakeStats = volume.bake(getWorkerPool());
+			NI_LOG("noise: baked %llu lattice hashes (%.1f MB) in %.3f ms on %u workers", (unsigned long long)bakeStats.entryNum,
+				bakeStats.entryNum * sizeof(float) / (1024.0 * 1024.0), bakeStats.seconds * 1000.0, getWorkerPool().getWorkerNum());
+
+			// The inputs getMaterialScene0() makes: sphere offsets * 2 for pid > 6, wall
+			// positions * 0.08 for pids 2 and 3.
+			Array<Float3> inputs[2];
+			for (uint32_t call = 0; call < callNum; ++call)
+			{
+				Float3 direction = normalize(Float3(hashFloat(call * 4), hashFloat(call * 4 + 1), hashFloat(call * 4 + 2)) * 2.0f - 1.0f);
+				inputs[0].add(direction * (0.5f + hashFloat(call * 4 + 3) * 4.0f) * 2.0f);
+				inputs[1].add((Float3(hashFloat(call * 4), hashFloat(call * 4 + 1), 1.0f) * 2.0f - 1.0f) * 25.0f * 0.08f);
+			}
+			const char* domainNames[] = { "sphere", "wall" };
+			for (uint32_t domain = 0; domain < 2; ++domain)
+			{
+				Array<Float4> results[2];
+				double seconds[2] = {};
+				for (uint32_t cached = 0; cached < 2; ++cached)
+				{
+					shader::bindNoiseVolume(cached ? volume.getLattice() : nullptr, cached ? volume.getExtent() : 0);
+					double begin = getSeconds();
+					for (uint32_t call = 0; call < callNum; ++call) results[cached].add(shader::fbmd(inputs[domain][call]));
+					seconds[cached] = getSeconds() - begin;
+				}
+				shader::bindNoiseVolume(nullptr, 0);
+				float maxError = 0.0f;
+				for (uint32_t call = 0; call < callNum; ++call) maxError = max(maxError, length(results[1][call] - results[0][call]));
+				NI_LOG("noise fbmd, %s inputs: evaluated %.1f ns/call, lattice %.1f ns/call (%.2fx), max difference %g", domainNames[domain],
+					seconds[0] / callNum * 1e9, seconds[1] / callNum * 1e9, seconds[0] / seconds[1], maxError);
+			}
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData = {};
+			float scale = cbrtf((float)particleNum / 64.0f);
+			setupCamera(constantBufferData, Float3(0, 0, -20 * scale), Float3(0, 0, 0), width, height);
+			constantBufferData.sampleCount = 4;
+			uint64_t hashes[2] = {};
+			RenderStats stats[2];
+			for (uint32_t cached = 0; cached < 2; ++cached)
+			{
+				CpuRenderer renderer;
+				renderer.useNoiseVolume = cached != 0;
+				renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+				stats[cached] = renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+				hashes[cached] = hashTexture(renderer.getColor());
+			}
+			NI_LOG("noise render %ux%u, %u particles, %u spp: evaluated %.3f ms, lattice %.3f ms (%.2fx)%s", width, height, particleNum,
+				constantBufferData.sampleCount, stats[0].seconds * 1000.0, stats[1].seconds * 1000.0, stats[0].seconds / stats[1].seconds,
+				hashes[0] == hashes[1] ? "" : " (IMAGE DIFFERS)");
+		}
+
+		// Error at rayNum on the line through the two runs around it, in log space,
+		// where error falls with a power of the ray count. Runs are sorted by rays.
+		inline double getErrorAtRayNum(const double* rayNums, const double* errors, uint32_t runNum, double rayNum)
+		{
+			uint32_t run = 0;
+			while (run + 2 < runNum && rayNums[run + 1] < rayNum) ++run;
+			double exponent = log(errors[run + 1] / errors[run]) / log(rayNums[run + 1] / rayNums[run]);
+			return errors[run] * pow(rayNum / rayNums[run], exponent);
+		}
+
+		// Reservoir resampled direct light against one light sample per path, as error
+		// against a high spp render without it over the last frames of a still camera,
+		// once the temporal reuse has its history. The error is also taken over the
+		// diffuse camera hits alone, the pixels the reservoirs shade, and compared with
+		// the error without reservoirs at the same rays per pixel, interpolated between
+		// the runs without them. The reservoirs are resampled once per pixel, so more
+		// samples only buy the indirect light. They have to pay off where the direct
+		// light is the error, at 2 bounces and below the default 4 spp they are meant
+		// to replace; with 5 bounces the indirect light's error swamps them.
+		inline void restir()
+		{
+			const uint32_t particleNum = 64;
+			const uint32_t width = 96;
+			const uint32_t height = 54;
+			const uint32_t referenceSampleCount = 256;
+			const uint32_t warmUpFrameNum = 8;
+			const uint32_t frameNum = 16;
+			const uint32_t sampleCounts[] = { 1, 2, 4, 8 };
+			const uint32_t sampleCountNum = sizeof(sampleCounts) / sizeof(sampleCounts[0]);
+			// With reservoirs, 8 spp would only check the interpolation's end point.
+			const uint32_t restirSampleCountNum = 3;
+			const uint32_t checkedSampleCount = 2;
+			// 2 leaves the camera hits' direct light, the part the reservoirs sample.
+			const uint32_t bounceNums[] = { 2, 0 };
+			const uint32_t checkedBounceNum = 2;
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData = {};
+			setupCamera(constantBufferData, Float3(0, 0, -20), Float3(0, 0, 0), width, height);
+			CpuRenderer renderer;
+
+			for (uint32_t bounceNum : bounceNums)
+			{
+				constantBufferData.bounceNum = bounceNum;
+				constantBufferData.sampleCount = referenceSampleCount;
+				constantBufferData.frame = 1000.0f;
+				renderer.useRestir = false;
+				renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+				double referenceMean = getMeanColor(renderer.getColor());
+				Array<Float3> reference;
+				for (uint32_t pixel = 0; pixel < width * height; ++pixel) reference.add(renderer.getColor().getData()[pixel].xyz);
+				Array<uint32_t> diffusePixels;
+				for (uint32_t pixel = 0; pixel < width * height; ++pixel)
+				{
+					uint32_t id = (uint32_t)renderer.getPosition().getData()[pixel].w;
+					if (id > 0 && particles[id - 1].material.reflection == 0.0f && particles[id - 1].material.transparency == 0.0f) diffusePixels.add(pixel);
+				}
+				uint32_t bounces = bounceNum == 0 ? PATH_DEFAULT_BOUNCE_NUM : bounceNum;
+
+				double rayNums[2][sampleCountNum] = {};
+				double diffuseRmses[2][sampleCountNum] = {};
+				for (uint32_t useRestir = 0; useRestir < 2; ++useRestir)
+				{
+					renderer.useRestir = useRestir != 0;
+					for (uint32_t run = 0; run < (useRestir ? restirSampleCountNum : sampleCountNum); ++run)
+					{
+						constantBufferData.sampleCount = sampleCounts[run];
+						renderer.resetRestirHistory();
+						uint64_t rayNum = 0;
+						uint64_t pixelNum = 0;
+						double seconds = 0.0;
+						double meanSum = 0.0;
+						double squaredRmseSum = 0.0;
+						double squaredBlurredRmseSum = 0.0;
+						double diffuseSum = 0.0;
+						for (uint32_t frame = 0; frame < frameNum; ++frame)
+						{
+							constantBufferData.frame = (float)frame;
+							RenderStats stats = renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+							if (frame < warmUpFrameNum) continue;
+							rayNum += stats.rayNum;
+							pixelNum += stats.pixelNum;
+							seconds += stats.seconds;
+							meanSum += getMeanColor(renderer.getColor());
+							double rmse = 0.0;
+							double blurredRmse = 0.0;
+							getRenderError(renderer.getColor(), reference, rmse, blurredRmse);
+							squaredRmseSum += rmse * rmse;
+							squaredBlurredRmseSum += blurredRmse * blurredRmse;
+							for (uint32_t entry = 0; entry < diffusePixels.getNum(); ++entry)
+							{
+								uint32_t pixel = diffusePixels[entry];
+								Float3 error = renderer.getColor().getData()[pixel].xyz - reference[pixel];
+								diffuseSum += error.x * error.x + error.y * error.y + error.z * error.z;
+							}
+						}
+						uint32_t measuredFrameNum = frameNum - warmUpFrameNum;
+						rayNums[useRestir][run] = (double)rayNum / pixelNum;
+						diffuseRmses[useRestir][run] = sqrt(diffuseSum / max(diffusePixels.getNum() * 3.0 * measuredFrameNum, 1.0));
+						NI_LOG("restir %ux%u %u bounces %s, %u spp: %.2f rays/pixel, rmse %.5f (diffuse hits %.5f), blurred rmse %.5f, mean %+.2f%% off, %.3f ms/frame",
+							width, height, bounces, useRestir ? "on " : "off", sampleCounts[run], rayNums[useRestir][run], sqrt(squaredRmseSum / measuredFrameNum),
+							diffuseRmses[useRestir][run], sqrt(squaredBlurredRmseSum / measuredFrameNum), (meanSum / measuredFrameNum / referenceMean - 1.0) * 100.0,
+							seconds * 1000.0 / measuredFrameNum);
+					}
+				}
+
+				for (uint32_t run = 0; run < restirSampleCountNum; ++run)
+				{
+					double offRmse = getErrorAtRayNum(rayNums[0], diffuseRmses[0], sampleCountNum, rayNums[1][run]);
+					NI_LOG("restir %u bounces, %u spp at %.2f rays/pixel: diffuse hits rmse %.5f, %.5f without (%.2fx)", bounces, sampleCounts[run],
+						rayNums[1][run], diffuseRmses[1][run], offRmse, offRmse / diffuseRmses[1][run]);
+					if (bounceNum == checkedBounceNum && sampleCounts[run] <= checkedSampleCount)
+					{
+						check(diffuseRmses[1][run] < offRmse, "restir: reservoirs don't lower the diffuse hits' error at the same ray count");
+					}
+				}
+			}
+		}
+
+		// Both ATrousFilter versions over the iterations fp2025.cpp runs, at 1080p, on
+		// a 480x270 render with its luminance moments scaled up 4x. The SIMD result has
+		// to stay within ATrousFilter::maxRelativeError of the scalar one.
+		inline void atrous()
+		{
+			const uint32_t particleNum = 64;
+			const uint32_t renderWidth = 480;
+			const uint32_t renderHeight = 270;
+			const uint32_t scale = 4;
+			const uint32_t frameNum = 4;
+			const uint32_t repeatNum = 3;
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData = {};
+			setupCamera(constantBufferData, Float3(0, 0, -20), Float3(0, 0, 0), renderWidth, renderHeight);
+			constantBufferData.sampleCount = 1;
+			CpuRenderer renderer;
+			LuminanceMoments moments;
+			for (uint32_t frame = 0; frame < frameNum; ++frame)
+			{
+				constantBufferData.frame = (float)frame;
+				renderer.render(particles.getData(), particleNum, constantBufferData, simulationData);
+				moments.update(renderer.getColor());
+			}
+
+			uint32_t width = renderWidth * scale;
+			uint32_t height = renderHeight * scale;
+			CpuTexture2D<Float4> color(width, height);
+			CpuTexture2D<Float4> normal(width, height);
+			CpuTexture2D<float> depth(width, height);
+			CpuTexture2D<float> m1(width, height);
+			CpuTexture2D<float> m2(width, height);
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					UInt2 source(x / scale, y / scale);
+					UInt2 pixel(x, y);
+					color[pixel] = renderer.getColor()[source];
+					normal[pixel] = renderer.getNormal()[source];
+					depth[pixel] = renderer.getDepth()[source];
+					m1[pixel] = moments.m1[source];
+					m2[pixel] = moments.m2[source];
+				}
+			}
+
+			ATrousFilter filter;
+			CpuTexture2D<Float4> inputs[2] = { color, color };
+			CpuTexture2D<Float4> outputs[2] = { color, color };
+			for (int32_t step = 1; step <= 2; ++step)
+			{
+				double seconds[2] = { DBL_MAX, DBL_MAX };
+				for (uint32_t repeat = 0; repeat < repeatNum; ++repeat)
+				{
+					seconds[0] = min(seconds[0], ATrousFilter::filterScalar(getWorkerPool(), inputs[0], normal, m1, m2, depth, step, outputs[0]).seconds);
+					seconds[1] = min(seconds[1], filter.filter(getWorkerPool(), inputs[1], normal, m1, m2, depth, step, outputs[1]).seconds);
+				}
+				float maxError = 0.0f;
+				uint32_t failNum = 0;
+				for (uint64_t pixel = 0; pixel < outputs[0].getTexelNum(); ++pixel)
+				{
+					Float3 reference = outputs[0].getData()[pixel].xyz;
+					Float3 result = outputs[1].getData()[pixel].xyz;
+					float magnitude = max(max(fabsf(reference.x), fabsf(reference.y)), max(fabsf(reference.z), 1e-3f));
+					float error = max(max(fabsf(result.x - reference.x), fabsf(result.y - reference.y)), fabsf(result.z - reference.z)) / magnitude;
+					maxError = max(maxError, error);
+					failNum += error > ATrousFilter::maxRelativeError ? 1 : 0;
+				}
+				double megapixels = (double)width * height / 1e6;
+				NI_LOG("atrous %ux%u step %d, %s: scalar %.2f ms (%.1f MP/s), simd %.2f ms (%.1f MP/s), %.2fx, max relative error %.2e, %u pixels over %.0e",
+					width, height, step, NI_SIMD_AVX2 ? "AVX2" : NI_SIMD_SSE ? "SSE" : "scalar", seconds[0] * 1000.0, megapixels / seconds[0], seconds[1] * 1000.0,
+					megapixels / seconds[1], seconds[0] / seconds[1], maxError, failNum, ATrousFilter::maxRelativeError);
+				check(failNum == 0, "atrous: SIMD filter outside the relative error bound of the scalar one");
+				// Each version filters its own last output, as the iterations chain.
+				inputs[0] = outputs[0];
+				inputs[1] = outputs[1];
+			}
+		}
+
+		template<typename T>
+		void upscaleTexture(const CpuTexture2D<T>& source, uint32_t scale, CpuTexture2D<T>& target)
+		{
+			target.resize(source.getWidth() * scale, source.getHeight() * scale);
+			for (uint32_t y = 0; y < target.getHeight(); ++y)
+			{
+				for (uint32_t x = 0; x < target.getWidth(); ++x) target[UInt2(x, y)] = source[UInt2(x / scale, y / scale)];
+			}
+		}
+
+		// TemporalReprojection::reproject() and ATrousFilter::filter() one after the other
+		// against reprojectAndFilter(), at 1080p from two 480x270 frames of a moving
+		// camera scaled up 4x. Traffic is the full resolution texture bytes each pass
+		// reads and writes, every texel once; the fused pass reads the halos it
+		// reprojects twice from cache.
+		inline void temporal()
+		{
+			const uint32_t particleNum = 64;
+			const uint32_t renderWidth = 480;
+			const uint32_t renderHeight = 270;
+			const uint32_t scale = 4;
+			const uint32_t repeatNum = 3;
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData[2] = {};
+			setupCamera(constantBufferData[0], Float3(0, 0, -20), Float3(0, 0, 0), renderWidth, renderHeight);
+			setupCamera(constantBufferData[1], Float3(0.3f, 0.1f, -19.8f), Float3(0, 0, 0), renderWidth, renderHeight);
+			constantBufferData[1].prevCameraPos = constantBufferData[0].cameraPos;
+			constantBufferData[1].prevViewProjMtx = constantBufferData[0].viewProjMtx;
+			constantBufferData[1].prevInvViewProjMtx = constantBufferData[0].invViewProjMtx;
+			constantBufferData[1].frame = 1.0f;
+			CpuRenderer renderers[2];
+			LuminanceMoments moments;
+			for (uint32_t frame = 0; frame < 2; ++frame)
+			{
+				constantBufferData[frame].sampleCount = 1;
+				renderers[frame].render(particles.getData(), particleNum, constantBufferData[frame], simulationData);
+			}
+			moments.update(renderers[0].getColor());
+
+			CpuTexture2D<Float4> color, velocity, history, position, normal, prevPosition, prevNormal;
+			CpuTexture2D<float> prevM1, prevM2, depth, prevDepth;
+			upscaleTexture(renderers[1].getColor(), scale, color);
+			upscaleTexture(renderers[1].getVelocity(), scale, velocity);
+			upscaleTexture(renderers[0].getColor(), scale, history);
+			upscaleTexture(renderers[1].getPosition(), scale, position);
+			upscaleTexture(renderers[1].getNormal(), scale, normal);
+			upscaleTexture(renderers[0].getPosition(), scale, prevPosition);
+			upscaleTexture(renderers[0].getNormal(), scale, prevNormal);
+			upscaleTexture(moments.m1, scale, prevM1);
+			upscaleTexture(moments.m2, scale, prevM2);
+			upscaleTexture(renderers[1].getDepth(), scale, depth);
+			upscaleTexture(renderers[0].getDepth(), scale, prevDepth);
+			TemporalInputs inputs;
+			inputs.color = &color;
+			inputs.velocity = &velocity;
+			inputs.history = &history;
+			inputs.position = &position;
+			inputs.normal = &normal;
+			inputs.prevPosition = &prevPosition;
+			inputs.prevNormal = &prevNormal;
+			inputs.prevM1 = &prevM1;
+			inputs.prevM2 = &prevM2;
+			inputs.depth = &depth;
+			inputs.prevDepth = &prevDepth;
+
+			uint32_t width = color.getWidth();
+			uint32_t height = color.getHeight();
+			CpuTexture2D<Float4> reprojected(width, height);
+			CpuTexture2D<Float4> outputs[2] = { CpuTexture2D<Float4>(width, height), CpuTexture2D<Float4>(width, height) };
+			CpuTexture2D<float> m1s[2] = { CpuTexture2D<float>(width, height), CpuTexture2D<float>(width, height) };
+			CpuTexture2D<float> m2s[2] = { CpuTexture2D<float>(width, height), CpuTexture2D<float>(width, height) };
+			ATrousFilter filter;
+			TemporalReprojection temporalReprojection;
+			double reprojectSeconds = DBL_MAX;
+			double filterSeconds = DBL_MAX;
+			double fusedSeconds = DBL_MAX;
+			TemporalStats fusedStats = {};
+			for (uint32_t repeat = 0; repeat < repeatNum; ++repeat)
+			{
+				reprojectSeconds = min(reprojectSeconds, TemporalReprojection::reproject(getWorkerPool(), inputs, reprojected, m1s[0], m2s[0]).seconds);
+				filterSeconds = min(filterSeconds, filter.filter(getWorkerPool(), reprojected, normal, m1s[0], m2s[0], depth, 1, outputs[0]).seconds);
+				fusedStats = temporalReprojection.reprojectAndFilter(getWorkerPool(), inputs, filter, outputs[1], m1s[1], m2s[1]);
+				fusedSeconds = min(fusedSeconds, fusedStats.seconds);
+			}
+
+			uint32_t mismatchNum = 0;
+			for (uint64_t pixel = 0; pixel < outputs[0].getTexelNum(); ++pixel)
+			{
+				mismatchNum += memcmp(&outputs[0].getData()[pixel], &outputs[1].getData()[pixel], sizeof(Float4)) != 0 || m1s[0].getData()[pixel] != m1s[1].getData()[pixel] ||
+					m2s[0].getData()[pixel] != m2s[1].getData()[pixel];
+			}
+
+			// Seven Float4 and four float inputs to the temporal pass. The two pass version
+			// writes the reprojected color and reads it back with normal, depth and the
+			// moments; the fused one has all of them at hand.
+			uint32_t reprojectBytes = 7 * sizeof(Float4) + 4 * sizeof(float) + sizeof(Float4) + 2 * sizeof(float);
+			uint32_t filterBytes = 2 * sizeof(Float4) + 3 * sizeof(float) + sizeof(Float4);
+			uint32_t fusedBytes = 7 * sizeof(Float4) + 4 * sizeof(float) + 2 * sizeof(float) + sizeof(Float4);
+			double megapixels = (double)width * height / 1e6;
+			NI_LOG("temporal %ux%u, %s: two passes %.2f + %.2f = %.2f ms (%u B/pixel), fused %.2f ms (%u B/pixel, %.2f reprojections/pixel), %.2fx, %u mismatches",
+				width, height, NI_SIMD_AVX2 ? "AVX2" : NI_SIMD_SSE ? "SSE" : "scalar", reprojectSeconds * 1000.0, filterSeconds * 1000.0,
+				(reprojectSeconds + filterSeconds) * 1000.0, reprojectBytes + filterBytes, fusedSeconds * 1000.0, fusedBytes,
+				(double)fusedStats.reprojectedNum / fusedStats.pixelNum, (reprojectSeconds + filterSeconds) / fusedSeconds, mismatchNum);
+			check(mismatchNum == 0, "temporal: fused pass differs from the two pass one");
+			NI_LOG("temporal %ux%u: two passes %.1f MP/s, fused %.1f MP/s", width, height, megapixels / (reprojectSeconds + filterSeconds), megapixels / fusedSeconds);
+		}
+
+		// The end of frame history of fp2025.cpp on the CPU: copying this frame's
+		// position, normal, depth, moments and color over last frame's, against
+		// HistoryChain::rotate(). Every frame writes a 1080p G-buffer, alternating two
+		// rendered ones, and TemporalReprojection::reproject() reads it with the
+		// history, which both have to give the same. Also checks the order a three
+		// frame chain hands out its textures in.
+		inline void history()
+		{
+			const uint32_t particleNum = 64;
+			const uint32_t renderWidth = 480;
+			const uint32_t renderHeight = 270;
+			const uint32_t scale = 4;
+			const uint32_t frameNum = 8;
+
+			// get(age) has to be the slot written age frames ago.
+			uint32_t slots[3] = { 0, 1, 2 };
+			HistoryChain<uint32_t, 3> chain;
+			for (uint32_t index = 0; index < chain.getFrameNum(); ++index) chain.set(index, &slots[index]);
+			uint32_t rotationErrorNum = 0;
+			for (uint32_t frame = 0; frame < 3 * chain.getFrameNum(); ++frame)
+			{
+				for (uint32_t age = 0; age < chain.getFrameNum(); ++age)
+				{
+					rotationErrorNum += *chain.get(age) != (frame + chain.getFrameNum() - age) % chain.getFrameNum();
+				}
+				rotationErrorNum += chain.getPrevious() != chain.get(1);
+				chain.rotate();
+			}
+			check(rotationErrorNum == 0, "history: HistoryChain hands out the wrong slot for an age");
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData[2] = {};
+			setupCamera(constantBufferData[0], Float3(0, 0, -20), Float3(0, 0, 0), renderWidth, renderHeight);
+			setupCamera(constantBufferData[1], Float3(0.3f, 0.1f, -19.8f), Float3(0, 0, 0), renderWidth, renderHeight);
+			CpuRenderer renderers[2];
+			CpuTexture2D<Float4> colors[2], velocities[2], positions[2], normals[2];
+			CpuTexture2D<float> depths[2];
+			for (uint32_t frame = 0; frame < 2; ++frame)
+			{
+				constantBufferData[frame].prevCameraPos = constantBufferData[1 - frame].cameraPos;
+				constantBufferData[frame].prevViewProjMtx = constantBufferData[1 - frame].viewProjMtx;
+				constantBufferData[frame].prevInvViewProjMtx = constantBufferData[1 - frame].invViewProjMtx;
+				constantBufferData[frame].sampleCount = 1;
+				renderers[frame].render(particles.getData(), particleNum, constantBufferData[frame], simulationData);
+				upscaleTexture(renderers[frame].getColor(), scale, colors[frame]);
+				upscaleTexture(renderers[frame].getVelocity(), scale, velocities[frame]);
+				upscaleTexture(renderers[frame].getPosition(), scale, positions[frame]);
+				upscaleTexture(renderers[frame].getNormal(), scale, normals[frame]);
+				upscaleTexture(renderers[frame].getDepth(), scale, depths[frame]);
+			}
+			uint32_t width = colors[0].getWidth();
+			uint32_t height = colors[0].getHeight();
+
+			// Copied, as fp2025.cpp did.
+			CpuTexture2D<Float4> position(width, height), normal(width, height), color(width, height);
+			CpuTexture2D<Float4> prevPosition(width, height), prevNormal(width, height), prevColor(width, height);
+			CpuTexture2D<float> depth(width, height), m1(width, height), m2(width, height);
+			CpuTexture2D<float> prevDepth(width, height), prevM1(width, height), prevM2(width, height);
+
+			// Rotated.
+			CpuTexture2D<Float4> positionSlots[2] = { CpuTexture2D<Float4>(width, height), CpuTexture2D<Float4>(width, height) };
+			CpuTexture2D<Float4> normalSlots[2] = { CpuTexture2D<Float4>(width, height), CpuTexture2D<Float4>(width, height) };
+			CpuTexture2D<Float4> colorSlots[2] = { CpuTexture2D<Float4>(width, height), CpuTexture2D<Float4>(width, height) };
+			CpuTexture2D<float> depthSlots[2] = { CpuTexture2D<float>(width, height), CpuTexture2D<float>(width, height) };
+			CpuTexture2D<float> m1Slots[2] = { CpuTexture2D<float>(width, height), CpuTexture2D<float>(width, height) };
+			CpuTexture2D<float> m2Slots[2] = { CpuTexture2D<float>(width, height), CpuTexture2D<float>(width, height) };
+			HistoryChain<CpuTexture2D<Float4>> positionHistory, normalHistory, colorHistory;
+			HistoryChain<CpuTexture2D<float>> depthHistory, historyM1, historyM2;
+			for (uint32_t index = 0; index < 2; ++index)
+			{
+				positionHistory.set(index, &positionSlots[index]);
+				normalHistory.set(index, &normalSlots[index]);
+				colorHistory.set(index, &colorSlots[index]);
+				depthHistory.set(index, &depthSlots[index]);
+				historyM1.set(index, &m1Slots[index]);
+				historyM2.set(index, &m2Slots[index]);
+			}
+
+			double frameSeconds[2] = {};
+			double historySeconds[2] = {};
+			uint32_t mismatchNum = 0;
+			for (uint32_t frame = 0; frame < frameNum; ++frame)
+			{
+				uint32_t source = frame % 2;
+
+				// The base pass writes the G-buffer, the temporal pass reads it and last
+				// frame's and writes color and moments, then the history moves on.
+				double start = getSeconds();
+				position = positions[source];
+				normal = normals[source];
+				depth = depths[source];
+				TemporalInputs inputs;
+				inputs.color = &colors[source];
+				inputs.velocity = &velocities[source];
+				inputs.history = &prevColor;
+				inputs.position = &position;
+				inputs.normal = &normal;
+				inputs.prevPosition = &prevPosition;
+				inputs.prevNormal = &prevNormal;
+				inputs.prevM1 = &prevM1;
+				inputs.prevM2 = &prevM2;
+				inputs.depth = &depth;
+				inputs.prevDepth = &prevDepth;
+				TemporalReprojection::reproject(getWorkerPool(), inputs, color, m1, m2);
+				double historyStart = getSeconds();
+				prevPosition = position;
+				prevNormal = normal;
+				prevDepth = depth;
+				prevM1 = m1;
+				prevM2 = m2;
+				prevColor = color;
+				historySeconds[0] += getSeconds() - historyStart;
+				frameSeconds[0] += getSeconds() - start;
+
+				start = getSeconds();
+				*positionHistory.getCurrent() = positions[source];
+				*normalHistory.getCurrent() = normals[source];
+				*depthHistory.getCurrent() = depths[source];
+				inputs.history = colorHistory.getPrevious();
+				inputs.position = positionHistory.getCurrent();
+				inputs.normal = normalHistory.getCurrent();
+				inputs.prevPosition = positionHistory.getPrevious();
+				inputs.prevNormal = normalHistory.getPrevious();
+				inputs.prevM1 = historyM1.getPrevious();
+				inputs.prevM2 = historyM2.getPrevious();
+				inputs.depth = depthHistory.getCurrent();
+				inputs.prevDepth = depthHistory.getPrevious();
+				TemporalReprojection::reproject(getWorkerPool(), inputs, *colorHistory.getCurrent(), *historyM1.getCurrent(), *historyM2.getCurrent());
+				historyStart = getSeconds();
+				const CpuTexture2D<Float4>& rotatedColor = *colorHistory.getCurrent();
+				const CpuTexture2D<float>& rotatedM1 = *historyM1.getCurrent();
+				const CpuTexture2D<float>& rotatedM2 = *historyM2.getCurrent();
+				positionHistory.rotate();
+				normalHistory.rotate();
+				depthHistory.rotate();
+				historyM1.rotate();
+				historyM2.rotate();
+				colorHistory.rotate();
+				historySeconds[1] += getSeconds() - historyStart;
+				frameSeconds[1] += getSeconds() - start;
+
+				for (uint64_t pixel = 0; pixel < color.getTexelNum(); ++pixel)
+				{
+					mismatchNum += memcmp(&color.getData()[pixel], &rotatedColor.getData()[pixel], sizeof(Float4)) != 0 || m1.getData()[pixel] != rotatedM1.getData()[pixel] ||
+						m2.getData()[pixel] != rotatedM2.getData()[pixel];
+				}
+			}
+
+			// In fp2025.cpp's formats: two R32G32B32A32, three R32 and an R16G16B16A16,
+			// read and written.
+			double gpuMegabytes = (double)width * height * 2 * (2 * 16 + 3 * 4 + 8) / 1e6;
+			double cpuMegabytes = (double)width * height * 2 * (3 * sizeof(Float4) + 3 * sizeof(float)) / 1e6;
+			NI_LOG("history %ux%u, %u frames: copies %.2f ms/frame (%.0f MB), rotation %.4f ms/frame; frames %.2f ms and %.2f ms, %.2fx, %u mismatches, %u rotation errors",
+				width, height, frameNum, historySeconds[0] * 1000.0 / frameNum, cpuMegabytes, historySeconds[1] * 1000.0 / frameNum, frameSeconds[0] * 1000.0 / frameNum,
+				frameSeconds[1] * 1000.0 / frameNum, frameSeconds[0] / frameSeconds[1], mismatchNum, rotationErrorNum);
+			NI_LOG("history %ux%u: the GPU copies moved %.0f MB a frame", width, height, gpuMegabytes);
+			check(mismatchNum == 0, "history: reprojection over the rotated history differs from the copied one");
+		}
+
+		// shaders/GBuffer.hlsli on a rendered frame of a moving camera: every normal,
+		// velocity and hit position through the packed texel fp2025.cpp keeps and back,
+		// the position from depth alone. The byte counts are fp2025.cpp's textures at
+		// RENDER_WIDTH x RENDER_HEIGHT: velocity, ids (were positions) and normals
+		// with their history, and the passes that write and read them, each texel once.
+		inline void gbuffer()
+		{
+			const uint32_t particleNum = 64;
+			const uint32_t width = 480;
+			const uint32_t height = 270;
+			// Past what 16 bit octahedral normals and the float depth the positions
+			// come back from lose. Halves round to 11 significant bits.
+			const float normalToleranceDegrees = 0.005f;
+			const float velocityTolerance = 1.0f / 2048.0f;
+			const float positionTolerance = 1e-3f;
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData[2] = {};
+			setupCamera(constantBufferData[0], Float3(0, 0, -20), Float3(0, 0, 0), width, height);
+			setupCamera(constantBufferData[1], Float3(0.3f, 0.1f, -19.8f), Float3(0, 0, 0), width, height);
+			constantBufferData[1].prevCameraPos = constantBufferData[0].cameraPos;
+			constantBufferData[1].prevViewProjMtx = constantBufferData[0].viewProjMtx;
+			constantBufferData[1].prevInvViewProjMtx = constantBufferData[0].invViewProjMtx;
+			constantBufferData[1].sampleCount = 1;
+			CpuRenderer renderer;
+			renderer.render(particles.getData(), particleNum, constantBufferData[1], simulationData);
+			Float4x4 invViewProj = columnMajor(constantBufferData[1].invViewProjMtx);
+
+			double normalErrorSum = 0.0, positionErrorSum = 0.0;
+			float normalErrorMax = 0.0f, velocityErrorMax = 0.0f, positionErrorMax = 0.0f;
+			uint32_t overToleranceNum = 0, hitNum = 0;
+			double start = getSeconds();
+			for (uint32_t y = 0; y < height; ++y)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					UInt2 pixel(x, y);
+					Float3 normal = normalize(renderer.getNormal()[pixel].xyz);
+					Float3 decodedNormal = shader::decodeOctahedral(shader::unpackSnorm2x16(shader::packSnorm2x16(shader::encodeOctahedral(normal))));
+					// From the chord, acos() of a float dot product can't resolve this.
+					float normalError = toDeg(2.0f * asinf(min(length(normal - decodedNormal) * 0.5f, 1.0f)));
+					Float2 velocity = renderer.getVelocity()[pixel].xy;
+					Float2 decodedVelocity = shader::unpackHalf2x16(shader::packHalf2x16(velocity));
+					Float2 velocityError = abs(velocity - decodedVelocity);
+					normalErrorSum += normalError;
+					normalErrorMax = max(normalErrorMax, normalError);
+					velocityErrorMax = max(velocityErrorMax, max(velocityError.x * width, velocityError.y * height));
+					bool over = normalError > normalToleranceDegrees || velocityError.x > fabsf(velocity.x) * velocityTolerance + 1e-7f ||
+						velocityError.y > fabsf(velocity.y) * velocityTolerance + 1e-7f;
+
+					// Misses have no position to get back, their depth is the far plane.
+					float depth = renderer.getDepth()[pixel];
+					if (depth < 1.0f)
+					{
+						Float3 position = renderer.getPosition()[pixel].xyz;
+						Float2 uv((float)x / width, (float)y / height);
+						Float3 decodedPosition = shader::reconstructPosition(uv, depth, invViewProj);
+						// Relative to the distance, depth precision goes with it.
+						float positionError = length(decodedPosition - position) / length(position - constantBufferData[1].cameraPos);
+						positionErrorSum += positionError;
+						positionErrorMax = max(positionErrorMax, positionError);
+						over = over || positionError > positionTolerance;
+						hitNum++;
+					}
+					overToleranceNum += over;
+				}
+			}
+			double seconds = getSeconds() - start;
+
+			// Bytes per pixel: velocity, ids or positions and normals, the last two
+			// twice for the history. The base pass writes the three, the temporal pass
+			// reads all five and both a-trous iterations the normals.
+			const uint32_t oldSizes[3] = { 16, 16, 16 };
+			const uint32_t newSizes[3] = { 4, 4, 4 };
+			const uint32_t* sizes[2] = { oldSizes, newSizes };
+			double megabytes[2] = {}, trafficMegabytes[2] = {};
+			double pixelNum = (double)RENDER_WIDTH * RENDER_HEIGHT;
+			for (uint32_t layout = 0; layout < 2; ++layout)
+			{
+				const uint32_t* size = sizes[layout];
+				megabytes[layout] = pixelNum * (size[0] + 2 * size[1] + 2 * size[2]) / 1e6;
+				uint32_t basePassBytes = size[0] + size[1] + size[2];
+				uint32_t temporalBytes = size[0] + 2 * size[1] + 2 * size[2];
+				uint32_t atrousBytes = 2 * size[2];
+				trafficMegabytes[layout] = pixelNum * (basePassBytes + temporalBytes + atrousBytes) / 1e6;
+			}
+
+			NI_LOG("gbuffer %ux%u, %u hits: normal error mean %.5f max %.5f degrees, velocity error max %.2e pixels, position error mean %.2e max %.2e relative, %u pixels over tolerance (%.2f ms)",
+				width, height, hitNum, normalErrorSum / ((double)width * height), normalErrorMax, velocityErrorMax, hitNum ? positionErrorSum / hitNum : 0.0, positionErrorMax,
+				overToleranceNum, seconds * 1000.0);
+			check(overToleranceNum == 0, "gbuffer: packed normal, velocity or reconstructed position out of tolerance");
+			NI_LOG("gbuffer %ux%u per frame: %.1f MB of textures instead of %.1f MB, %.1f MB of traffic instead of %.1f MB, %.1f MB less",
+				RENDER_WIDTH, RENDER_HEIGHT, megabytes[1], megabytes[0], trafficMegabytes[1], trafficMegabytes[0], trafficMegabytes[0] - trafficMegabytes[1]);
+		}
+
+		// TemporalAA::resolve() against resolveScalar() on the second of two rendered
+		// frames upscaled to 1080p, with the first as the history, for the clamp the
+		// shader uses and for the clip. The two have to agree bit for bit.
+		inline void taa()
+		{
+			const uint32_t particleNum = 64;
+			const uint32_t renderWidth = 480;
+			const uint32_t renderHeight = 270;
+			const uint32_t scale = 4;
+			const uint32_t repeatNum = 3;
+
+			Array<ParticleData> particles;
+			SimulationData simulationData;
+			ParticleSceneData sceneData;
+			initScene(particles, particleNum, simulationData, sceneData);
+			ConstantBufferData constantBufferData[2] = {};
+			setupCamera(constantBufferData[0], Float3(0, 0, -20), Float3(0, 0, 0), renderWidth, renderHeight);
+			setupCamera(constantBufferData[1], Float3(0.3f, 0.1f, -19.8f), Float3(0, 0, 0), renderWidth, renderHeight);
+			constantBufferData[1].prevCameraPos = constantBufferData[0].cameraPos;
+			constantBufferData[1].prevViewProjMtx = constantBufferData[0].viewProjMtx;
+			constantBufferData[1].prevInvViewProjMtx = constantBufferData[0].invViewProjMtx;
+			constantBufferData[1].frame = 1.0f;
+			CpuRenderer renderers[2];
+			for (uint32_t frame = 0; frame < 2; ++frame)
+			{
+				constantBufferData[frame].sampleCount = 1;
+				renderers[frame].render(particles.getData(), particleNum, constantBufferData[frame], simulationData);
+			}
+
+			CpuTexture2D<Float4> color, velocity, history;
+			upscaleTexture(renderers[1].getColor(), scale, color);
+			upscaleTexture(renderers[1].getVelocity(), scale, velocity);
+			upscaleTexture(renderers[0].getColor(), scale, history);
+			uint32_t width = color.getWidth();
+			uint32_t height = color.getHeight();
+			double megapixels = (double)width * height / 1e6;
+			CpuTexture2D<Float4> outputs[2] = { CpuTexture2D<Float4>(width, height), CpuTexture2D<Float4>(width, height) };
+			for (uint32_t clip = 0; clip < 2; ++clip)
+			{
+				double scalarSeconds = DBL_MAX;
+				double simdSeconds = DBL_MAX;
+				for (uint32_t repeat = 0; repeat < repeatNum; ++repeat)
+				{
+					scalarSeconds = min(scalarSeconds, TemporalAA::resolveScalar(getWorkerPool(), color, velocity, history, clip != 0, outputs[0]).seconds);
+					simdSeconds = min(simdSeconds, TemporalAA::resolve(getWorkerPool(), color, velocity, history, clip != 0, outputs[1]).seconds);
+				}
+
+				uint32_t mismatchNum = 0;
+				for (uint64_t pixel = 0; pixel < outputs[0].getTexelNum(); ++pixel)
+				{
+					mismatchNum += memcmp(&outputs[0].getData()[pixel], &outputs[1].getData()[pixel], sizeof(Float4)) != 0;
+				}
+				NI_LOG("taa %ux%u, %s, %s: scalar %.2f ms (%.1f MP/s), tiled %.2f ms (%.1f MP/s), %.2fx, %u mismatches", width, height,
+					clip ? "clip" : "clamp", NI_SIMD_AVX2 ? "AVX2" : NI_SIMD_SSE ? "SSE" : "scalar", scalarSeconds * 1000.0, megapixels / scalarSeconds,
+					simdSeconds * 1000.0, megapixels / simdSeconds, scalarSeconds / simdSeconds, mismatchNum);
+				check(mismatchNum == 0, clip ? "taa: tiled clip resolve differs from the scalar one" : "taa: tiled clamp resolve differs from the scalar one");
+			}
+		}
+	}
+
+	struct Benchmark
+	{
+		const char* name;
+		void (*run)();
+	};
+
+	inline int runBenchmarks(int argc, char** argv)
+	{
+		static const Benchmark benchmarks[] = {
+			{ "broadphase", bench::broadphase },
+			{ "simulator", bench::simulator },
+			{ "layout", bench::layout },
+			{ "morton", bench::morton },
+			{ "render", bench::render },
+			{ "bvh", bench::bvh },
+			{ "intersect", bench::intersect },
+			{ "walls", bench::walls },
+			{ "sampler", bench::sampler },
+			{ "lights", bench::lights },
+			{ "roulette", bench::roulette },
+			{ "adaptive", bench::adaptive },
+			{ "accumulate", bench::accumulate },
+			{ "tilebins", bench::tilebins },
+			{ "splats", bench::splats },
+			{ "noise", bench::noise },
+			{ "restir", bench::restir },
+			{ "atrous", bench::atrous },
+			{ "temporal", bench::temporal },
+			{ "history", bench::history },
+			{ "gbuffer", bench::gbuffer },
+			{ "taa", bench::taa },
+		};
+		const uint32_t benchmarkNum = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+		for (int arg = 0; arg < argc; ++arg)
+		{
+			bool found = false;
+			for (uint32_t index = 0; index < benchmarkNum; ++index) found |= strcmp(argv[arg], benchmarks[index].name) == 0;
+			if (!found)
+			{
+				NI_LOG("Unknown benchmark '%s'. Available:", argv[arg]);
+				for (uint32_t index = 0; index < benchmarkNum; ++index) NI_LOG("  %s", benchmarks[index].name);
+				return 1;
+			}
+		}
+
+		for (uint32_t index = 0; index < benchmarkNum; ++index)
+		{
+			bool selected = argc == 0;
+			for (int arg = 0; arg < argc; ++arg) selected |= strcmp(argv[arg], benchmarks[index].name) == 0;
+			if (!selected) continue;
+			NI_LOG("== %s ==", benchmarks[index].name);
+			benchmarks[index].run();
+		}
+		if (bench::getFailedCheckNum() > 0)
+		{
+			NI_LOG("%u checks FAILED", bench::getFailedCheckNum());
+			return 1;
+		}
+		return 0;
+	}
+
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+// Void and cluster (Ulichney 1993) generator for the tiled blue noise rank table in
+// shaders/BlueNoise.hlsli. Every prefix of the ranking, the pixels with rank below
+// n, is a blue noise point set, so giving each pixel of a tile the rank as its
+// offset into a shared sample sequence spreads the error as blue noise. The table
+// is checked in as shader data, `-bench sampler` checks that it still matches.
+
+#include "nicore.h"
+
+#include <math.h>
+
+namespace ni {
+
+	struct BlueNoiseGenerator
+	{
+		// Ranks 0 .. size * size - 1 for a size x size tile that wraps around.
+		void generate(uint32_t tileSize, Array<uint32_t>& ranks, float sigma = 1.5f)
+		{
+			size = tileSize;
+			uint32_t pixelNum = size * size;
+			kernel.reset();
+			for (uint32_t y = 0; y < size; ++y)
+			{
+				for (uint32_t x = 0; x < size; ++x)
+				{
+					float dx = (float)min(x, size - x);
+					float dy = (float)min(y, size - y);
+					kernel.add(exp(-(double)(dx * dx + dy * dy) / (2.0 * sigma * sigma)));
+				}
+			}
+
+			// Initial pattern: a tenth of the pixels from a hash, then moved from the
+			// tightest cluster to the largest void until that stops changing anything.
+			uint32_t initialNum = max(pixelNum / 10, 1u);
+			resetPattern();
+			uint32_t state = 0x2545f491u;
+			while (oneNum < initialNum)
+			{
+				state = state * 747796405u + 2891336453u;
+				uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+				uint32_t pixel = ((word >> 22u) ^ word) % pixelNum;
+				if (!pattern[pixel]) set(pixel, true);
+			}
+			for (uint32_t iteration = 0; iteration < pixelNum; ++iteration)
+			{
+				uint32_t cluster = findTightestCluster();
+				set(cluster, false);
+				uint32_t largestVoid = findLargestVoid();
+				set(largestVoid, true);
+				if (largestVoid == cluster) break;
+			}
+			Array<uint32_t> initialOnes;
+			for (uint32_t pixel = 0; pixel < pixelNum; ++pixel)
+			{
+				if (pattern[pixel]) initialOnes.add(pixel);
+			}
+			uint32_t initialOneNum = oneNum;
+
+			ranks.reset();
+			ranks.fill(pixelNum, 0);
+			// Phase 1, rank the initial points from the tightest cluster down.
+			for (uint32_t rank = initialOneNum; rank-- > 0;)
+			{
+				uint32_t cluster = findTightestCluster();
+				set(cluster, false);
+				ranks[cluster] = rank;
+			}
+			// Phases 2 and 3, fill the largest void. With a Gaussian that sums to the
+			// same value everywhere on the torus, the tightest cluster of zeros that
+			// phase 3 looks for is the largest void as well.
+			resetPattern();
+			for (uint32_t index = 0; index < initialOnes.getNum(); ++index) set(initialOnes[index], true);
+			for (uint32_t rank = initialOneNum; rank < pixelNum; ++rank)
+			{
+				uint32_t largestVoid = findLargestVoid();
+				set(largestVoid, true);
+				ranks[largestVoid] = rank;
+			}
+		}
+
+	private:
+		void resetPattern()
+		{
+			pattern.reset();
+			pattern.fill(size * size, 0);
+			energy.reset();
+			energy.fill(size * size, 0.0);
+			oneNum = 0;
+		}
+
+		void set(uint32_t pixel, bool isOne)
+		{
+			pattern[pixel] = isOne ? 1 : 0;
+			oneNum = isOne ? oneNum + 1 : oneNum - 1;
+			uint32_t pixelX = pixel % size;
+			uint32_t pixelY = pixel / size;
+			double sign = isOne ? 1.0 : -1.0;
+			for (uint32_t y = 0; y < size; ++y)
+			{
+				const double* kernelRow = &kernel[((y + size - pixelY) % size) * size];
+				for (uint32_t x = 0; x < size; ++x)
+				{
+					energy[y * size + x] += sign * kernelRow[(x + size - pixelX) % size];
+				}
+			}
+		}
+
+		// Lowest index on a tie, so the table does not depend on anything but the code.
+		uint32_t findTightestCluster() const
+		{
+			uint32_t best = 0;
+			double bestEnergy = -1.0;
+			for (uint32_t pixel = 0; pixel < pattern.getNum(); ++pixel)
+			{
+				if (pattern[pixel] && energy[pixel] > bestEnergy)
+				{
+					bestEnergy = energy[pixel];
+					best = pixel;
+				}
+			}
+			return best;
+		}
+
+		uint32_t findLargestVoid() const
+		{
+			uint32_t best = 0;
+			double bestEnergy = 1e300;
+			for (uint32_t pixel = 0; pixel < pattern.getNum(); ++pixel)
+			{
+				if (!pattern[pixel] && energy[pixel] < bestEnergy)
+				{
+					bestEnergy = energy[pixel];
+					best = pixel;
+				}
+			}
+			return best;
+		}
+
+		uint32_t size = 0;
+		uint32_t oneNum = 0;
+		Array<double> kernel;
+		Array<uint8_t> pattern;
+		Array<double> energy;
+	};
+
+}
@@ -0,0 +1,318 @@
+#pragma once
+
+// Bounding volume hierarchy over the particle spheres for ray queries. Built top
+// down with a binned surface area heuristic into the flat BvhNode layout from
+// ParticleConfig.h, which is what shaders/Bvh.hlsli traverses on the CPU and what
+// gets uploaded as a StructuredBuffer on the GPU.
+//
+// Planes (PARTICLE_PRIMITIVE_PLANE) have no bounds. They stay out of the tree and
+// come first in the primitive buffer, where the traversal tests them up front.
+//
+// Every frame the simulation moves the particles from prevPosition to position
+// without changing much of the neighbourhood, so update() only refits the bounds of
+// the existing tree and rebuilds once the refitted tree got noticeably worse.
+
+#include "shaderport.h"
+
+#include <algorithm>
+#include <float.h>
+
+namespace ni {
+
+	struct BvhStats
+	{
+		double seconds = 0.0;
+		bool rebuilt = false;
+	};
+
+	struct ParticleBvh
+	{
+		static constexpr uint32_t binNum = 16;
+		static constexpr uint32_t maxLeafSize = 4;
+		// Below BVH_STACK_SIZE so the traversal stacks can't overflow. Splits past
+		// medianDepth are by median, which keeps degenerate input logarithmic.
+		static constexpr uint32_t maxDepth = BVH_STACK_SIZE - 2;
+		static constexpr uint32_t medianDepth = 40;
+
+		// Rebuild when the SAH cost of the refitted tree is this much above the cost
+		// it had right after the last build.
+		float rebuildCostRatio = 1.5f;
+
+		void build(const ParticleData* particles, uint32_t particleNum)
+		{
+			num = particleNum;
+			nodes.reset();
+			primitives.reset();
+			depth = 0;
+			planeNum = 0;
+			for (uint32_t index = 0; index < num; ++index)
+			{
+				if (particles[index].primitive == PARTICLE_PRIMITIVE_PLANE) primitives.add(index);
+			}
+			planeNum = (uint32_t)primitives.getNum();
+			if (planeNum == num) return;
+			primitiveMin.reset();
+			primitiveMax.reset();
+			centroids.reset();
+			for (uint32_t index = 0; index < num; ++index)
+			{
+				Float3 boundsMin, boundsMax;
+				getParticleBounds(particles[index], boundsMin, boundsMax);
+				primitiveMin.add(boundsMin);
+				primitiveMax.add(boundsMax);
+				centroids.add((boundsMin + boundsMax) * 0.5f);
+				if (particles[index].primitive != PARTICLE_PRIMITIVE_PLANE) primitives.add(index);
+			}
+
+			struct Task { uint32_t node, depth; };
+			Array<Task> tasks;
+			nodes.add(makeNode(planeNum, num - planeNum));
+			tasks.add({ 0, 0 });
+			while (tasks.getNum() > 0)
+			{
+				Task task = tasks[tasks.getNum() - 1];
+				tasks.pop();
+				depth = max(depth, task.depth);
+				uint32_t first = nodes[task.node].leftFirst;
+				uint32_t count = nodes[task.node].primitiveNum;
+				uint32_t split = 0;
+				if (count <= 1 || task.depth >= maxDepth || !findSplit(nodes[task.node], first, count, task.depth, split)) continue;
+
+				uint32_t left = nodes.getNum();
+				nodes.add(makeNode(first, split - first));
+				nodes.add(makeNode(split, first + count - split));
+				nodes[task.node].leftFirst = left;
+				nodes[task.node].primitiveNum = 0;
+				tasks.add({ left, task.depth + 1 });
+				tasks.add({ left + 1, task.depth + 1 });
+			}
+			builtCost = getCost();
+		}
+
+		// Recomputes every node's bounds from the current positions, the tree stays the same.
+		void refit(const ParticleData* particles)
+		{
+			// Children are always stored after their parent.
+			for (uint32_t nodeIndex = nodes.getNum(); nodeIndex-- > 0;)
+			{
+				BvhNode& node = nodes[nodeIndex];
+				Float3 boundsMin = Float3(FLT_MAX, FLT_MAX, FLT_MAX);
+				Float3 boundsMax = Float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				if (node.primitiveNum > 0)
+				{
+					for (uint32_t index = node.leftFirst; index < node.leftFirst + node.primitiveNum; ++index)
+					{
+						Float3 particleMin, particleMax;
+						getParticleBounds(particles[primitives[index]], particleMin, particleMax);
+						boundsMin = min(boundsMin, particleMin);
+						boundsMax = max(boundsMax, particleMax);
+					}
+				}
+				else
+				{
+					boundsMin = min(nodes[node.leftFirst].boundsMin, nodes[node.leftFirst + 1].boundsMin);
+					boundsMax = max(nodes[node.leftFirst].boundsMax, nodes[node.leftFirst + 1].boundsMax);
+				}
+				node.boundsMin = boundsMin;
+				node.boundsMax = boundsMax;
+			}
+		}
+
+		// Per frame entry point: refit, or build when the particle count changed or
+		// the refit degraded the tree past rebuildCostRatio.
+		BvhStats update(const ParticleData* particles, uint32_t particleNum)
+		{
+			BvhStats stats = {};
+			double start = getSeconds();
+			if (particleNum != num || nodes.getNum() == 0)
+			{
+				build(particles, particleNum);
+				stats.rebuilt = true;
+			}
+			else
+			{
+				refit(particles);
+				if (getCost() > builtCost * rebuildCostRatio)
+				{
+					build(particles, particleNum);
+					stats.rebuilt = true;
+				}
+			}
+			stats.seconds = getSeconds() - start;
+			return stats;
+		}
+
+		// Expected node visits plus sphere tests of a random ray through the root, by
+		// surface area.
+		float getCost() const
+		{
+			if (nodes.getNum() == 0) return 0.0f;
+			float rootArea = getArea(nodes[0].boundsMin, nodes[0].boundsMax);
+			if (rootArea <= 0.0f) return 0.0f;
+			float cost = 0.0f;
+			for (uint32_t nodeIndex = 0; nodeIndex < nodes.getNum(); ++nodeIndex)
+			{
+				const BvhNode& node = nodes[nodeIndex];
+				cost += getArea(node.boundsMin, node.boundsMax) * (node.primitiveNum > 0 ? (float)node.primitiveNum : 1.0f);
+			}
+			return cost / rootArea;
+		}
+
+		const BvhNode* getNodes() const { return nodes.getData(); }
+		uint32_t getNodeNum() const { return nodes.getNum(); }
+		const uint32_t* getPrimitives() const { return primitives.getData(); }
+		uint32_t getPrimitiveNum() const { return primitives.getNum(); }
+		uint32_t getPlaneNum() const { return planeNum; }
+		uint32_t getDepth() const { return depth; }
+
+	private:
+		// Sphere bounds, padded so rounding in the slab test can't lose a grazing hit
+		// that intersectsParticle() still reports.
+		static void getParticleBounds(const ParticleData& particle, Float3& boundsMin, Float3& boundsMax)
+		{
+			float extent = particle.radius * 1.001f + 1e-3f;
+			boundsMin = particle.position - extent;
+			boundsMax = particle.position + extent;
+		}
+
+		static float getArea(const Float3& boundsMin, const Float3& boundsMax)
+		{
+			Float3 size = max(boundsMax - boundsMin, Float3(0.0f));
+			return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+		}
+
+		BvhNode makeNode(uint32_t first, uint32_t count) const
+		{
+			BvhNode node;
+			node.boundsMin = Float3(FLT_MAX, FLT_MAX, FLT_MAX);
+			node.boundsMax = Float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			for (uint32_t index = first; index < first + count; ++index)
+			{
+				node.boundsMin = min(node.boundsMin, primitiveMin[primitives[index]]);
+				node.boundsMax = max(node.boundsMax, primitiveMax[primitives[index]]);
+			}
+			node.leftFirst = first;
+			node.primitiveNum = count;
+			return node;
+		}
+
+		uint32_t splitAtMedian(uint32_t* range, uint32_t first, uint32_t count, uint32_t axis)
+		{
+			std::nth_element(range, range + count / 2, range + count, [&](uint32_t a, uint32_t b)
+			{
+				return centroids[a][axis] < centroids[b][axis];
+			});
+			return first + count / 2;
+		}
+
+		// Picks the cheapest of the binNum - 1 planes per axis and partitions the
+		// primitives around it. Returns false when a leaf is cheaper.
+		bool findSplit(const BvhNode& node, uint32_t first, uint32_t count, uint32_t nodeDepth, uint32_t& split)
+		{
+			uint32_t* range = primitives.getData() + first;
+			Float3 centroidMin = Float3(FLT_MAX, FLT_MAX, FLT_MAX);
+			Float3 centroidMax = Float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			for (uint32_t index = 0; index < count; ++index)
+			{
+				centroidMin = min(centroidMin, centroids[range[index]]);
+				centroidMax = max(centroidMax, centroids[range[index]]);
+			}
+			Float3 centroidExtent = centroidMax - centroidMin;
+			uint32_t longestAxis = centroidExtent.x >= centroidExtent.y && centroidExtent.x >= centroidExtent.z ? 0 : centroidExtent.y >= centroidExtent.z ? 1 : 2;
+
+			if (nodeDepth >= medianDepth || centroidExtent[longestAxis] <= 0.0f)
+			{
+				if (count <= maxLeafSize) return false;
+				split = splitAtMedian(range, first, count, longestAxis);
+				return true;
+			}
+
+			float bestCost = FLT_MAX;
+			uint32_t bestAxis = 0;
+			uint32_t bestBin = 0;
+			for (uint32_t axis = 0; axis < 3; ++axis)
+			{
+				if (centroidExtent[axis] <= 0.0f) continue;
+				float binScale = binNum / centroidExtent[axis];
+				uint32_t binCounts[binNum] = {};
+				Float3 binMin[binNum];
+				Float3 binMax[binNum];
+				for (uint32_t bin = 0; bin < binNum; ++bin)
+				{
+					binMin[bin] = Float3(FLT_MAX, FLT_MAX, FLT_MAX);
+					binMax[bin] = Float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				}
+				for (uint32_t index = 0; index < count; ++index)
+				{
+					uint32_t primitive = range[index];
+					uint32_t bin = min((uint32_t)((centroids[primitive][axis] - centroidMin[axis]) * binScale), binNum - 1);
+					binCounts[bin]++;
+					binMin[bin] = min(binMin[bin], primitiveMin[primitive]);
+					binMax[bin] = max(binMax[bin], primitiveMax[primitive]);
+				}
+
+				// Sweep from the right for the right hand areas, then from the left.
+				float rightAreas[binNum];
+				uint32_t rightCounts[binNum];
+				Float3 sweepMin = Float3(FLT_MAX, FLT_MAX, FLT_MAX);
+				Float3 sweepMax = Float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				uint32_t sweepCount = 0;
+				for (uint32_t bin = binNum - 1; bin > 0; --bin)
+				{
+					sweepMin = min(sweepMin, binMin[bin]);
+					sweepMax = max(sweepMax, binMax[bin]);
+					sweepCount += binCounts[bin];
+					rightAreas[bin] = sweepCount > 0 ? getArea(sweepMin, sweepMax) : 0.0f;
+					rightCounts[bin] = sweepCount;
+				}
+				sweepMin = Float3(FLT_MAX, FLT_MAX, FLT_MAX);
+				sweepMax = Float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+				sweepCount = 0;
+				for (uint32_t bin = 0; bin < binNum - 1; ++bin)
+				{
+					sweepMin = min(sweepMin, binMin[bin]);
+					sweepMax = max(sweepMax, binMax[bin]);
+					sweepCount += binCounts[bin];
+					if (sweepCount == 0 || rightCounts[bin + 1] == 0) continue;
+					float cost = getArea(sweepMin, sweepMax) * sweepCount + rightAreas[bin + 1] * rightCounts[bin + 1];
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestAxis = axis;
+						bestBin = bin;
+					}
+				}
+			}
+
+			// One node visit plus the tests of both children against testing all of
+			// this node's primitives.
+			float nodeArea = getArea(node.boundsMin, node.boundsMax);
+			float leafCost = nodeArea * count;
+			if (count <= maxLeafSize && nodeArea + bestCost >= leafCost) return false;
+			if (bestCost == FLT_MAX)
+			{
+				split = splitAtMedian(range, first, count, longestAxis);
+				return true;
+			}
+
+			float binScale = binNum / centroidExtent[bestAxis];
+			uint32_t* middle = std::partition(range, range + count, [&](uint32_t primitive)
+			{
+				return min((uint32_t)((centroids[primitive][bestAxis] - centroidMin[bestAxis]) * binScale), binNum - 1) <= bestBin;
+			});
+			split = first + (uint32_t)(middle - range);
+			return true;
+		}
+
+		Array<BvhNode> nodes;
+		Array<uint32_t> primitives;
+		Array<Float3> primitiveMin;
+		Array<Float3> primitiveMax;
+		Array<Float3> centroids;
+		uint32_t num = 0;
+		uint32_t planeNum = 0;
+		uint32_t depth = 0;
+		float builtCost = 0.0f;
+	};
+
+}
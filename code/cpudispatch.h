@@ -0,0 +1,315 @@
+#pragma once
+
+// CPU emulation of compute dispatches. Thread groups are spread over a pool of OS
+// threads with per worker work stealing, and each kernel invocation gets the same
+// SV_DispatchThreadID / SV_GroupThreadID / SV_GroupID / SV_GroupIndex values the
+// GPU would give it.
+//
+// Kernels are written as one or more stages. Every thread of a group runs stage N
+// before any thread of that group starts stage N + 1, which is what a
+// GroupMemoryBarrierWithGroupSync() between the stages does on the GPU. Groupshared
+// memory is a TGroupShared instance per group, zeroed when the group starts.
+//
+// Uses std::thread rather than CreateThread since this also runs on the Linux
+// render nodes.
+
+#include "hlsl.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <type_traits>
+
+namespace ni {
+
+	struct NoGroupShared {};
+
+	struct ThreadContext
+	{
+		UInt3 dispatchThreadID;
+		UInt3 groupThreadID;
+		UInt3 groupID;
+		uint32_t groupIndex;
+		uint32_t workerIndex;
+	};
+
+	struct DispatchStats
+	{
+		double seconds = 0.0;
+		uint64_t groupNum = 0;
+		uint64_t threadNum = 0;
+		uint64_t stealNum = 0;
+		uint32_t workerNum = 0;
+
+		void log(const char* name) const
+		{
+			NI_LOG("%s: %.3f ms, %llu groups, %llu threads, %u workers, %llu steals", name, seconds * 1000.0,
+				(unsigned long long)groupNum, (unsigned long long)threadNum, workerNum, (unsigned long long)stealNum);
+		}
+	};
+
+	// Fixed set of workers that executes parallelFor jobs. The calling thread takes
+	// part as worker 0, so a pool of N workers owns N - 1 threads. Every worker
+	// starts with an even slice of the index range and steals half of another
+	// worker's remaining slice when its own runs out.
+	struct WorkerPool
+	{
+		WorkerPool(uint32_t requestedWorkerNum = 0)
+		{
+			workerNum = requestedWorkerNum > 0 ? requestedWorkerNum : (uint32_t)std::thread::hardware_concurrency();
+			if (workerNum == 0) workerNum = 1;
+			queues = new WorkQueue[workerNum];
+			threads = new std::thread[workerNum];
+			for (uint32_t index = 1; index < workerNum; ++index)
+			{
+				threads[index] = std::thread([this, index]() { workerMain(index); });
+			}
+		}
+
+		~WorkerPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				shouldQuit = true;
+			}
+			wakeCondition.notify_all();
+			for (uint32_t index = 1; index < workerNum; ++index)
+			{
+				threads[index].join();
+			}
+			delete[] threads;
+			delete[] queues;
+		}
+
+		WorkerPool(const WorkerPool&) = delete;
+		WorkerPool& operator=(const WorkerPool&) = delete;
+
+		uint32_t getWorkerNum() const { return workerNum; }
+
+		// Calls func(index, workerIndex) for every index in [0, count). Blocks until
+		// all calls returned and gives back how many times work was stolen.
+		template<typename TFunc>
+		uint64_t parallelFor(uint64_t count, const TFunc& func)
+		{
+			NI_ASSERT(count <= UINT32_MAX, "parallelFor supports up to 2^32 items, got %llu", (unsigned long long)count);
+			if (count == 0) return 0;
+			std::lock_guard<std::mutex> jobLock(jobMutex);
+
+			job.func = &func;
+			job.invoke = [](const void* funcPtr, uint64_t index, uint32_t workerIndex)
+			{
+				(*(const TFunc*)funcPtr)(index, workerIndex);
+			};
+			stealNum.store(0, std::memory_order_relaxed);
+			for (uint32_t index = 0; index < workerNum; ++index)
+			{
+				uint64_t begin = count * index / workerNum;
+				uint64_t end = count * (index + 1) / workerNum;
+				queues[index].range.store(packRange((uint32_t)begin, (uint32_t)end), std::memory_order_relaxed);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				activeWorkerNum = workerNum - 1;
+				generation++;
+			}
+			wakeCondition.notify_all();
+
+			execute(0);
+
+			std::unique_lock<std::mutex> lock(mutex);
+			doneCondition.wait(lock, [this]() { return activeWorkerNum == 0; });
+			return stealNum.load(std::memory_order_relaxed);
+		}
+
+	private:
+		struct alignas(64) WorkQueue
+		{
+			// Remaining [begin, end) of this worker, begin in the low 32 bits.
+			std::atomic<uint64_t> range{ 0 };
+		};
+
+		struct Job
+		{
+			const void* func = nullptr;
+			void (*invoke)(const void*, uint64_t, uint32_t) = nullptr;
+		};
+
+		static uint64_t packRange(uint32_t begin, uint32_t end) { return (uint64_t)begin | ((uint64_t)end << 32); }
+		static uint32_t rangeBegin(uint64_t range) { return (uint32_t)range; }
+		static uint32_t rangeEnd(uint64_t range) { return (uint32_t)(range >> 32); }
+
+		bool popLocal(uint32_t workerIndex, uint32_t& outIndex)
+		{
+			std::atomic<uint64_t>& range = queues[workerIndex].range;
+			uint64_t current = range.load(std::memory_order_acquire);
+			while (rangeBegin(current) < rangeEnd(current))
+			{
+				uint64_t next = packRange(rangeBegin(current) + 1, rangeEnd(current));
+				if (range.compare_exchange_weak(current, next, std::memory_order_acq_rel))
+				{
+					outIndex = rangeBegin(current);
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool steal(uint32_t workerIndex)
+		{
+			for (uint32_t offset = 1; offset < workerNum; ++offset)
+			{
+				std::atomic<uint64_t>& victim = queues[(workerIndex + offset) % workerNum].range;
+				uint64_t current = victim.load(std::memory_order_acquire);
+				while (rangeBegin(current) < rangeEnd(current))
+				{
+					uint32_t begin = rangeBegin(current);
+					uint32_t end = rangeEnd(current);
+					uint32_t middle = begin + (end - begin) / 2;
+					if (victim.compare_exchange_weak(current, packRange(begin, middle), std::memory_order_acq_rel))
+					{
+						// Our own queue is empty here, so nobody else is touching it.
+						queues[workerIndex].range.store(packRange(middle, end), std::memory_order_release);
+						stealNum.fetch_add(1, std::memory_order_relaxed);
+						return true;
+					}
+				}
+			}
+			return false;
+		}
+
+		void execute(uint32_t workerIndex)
+		{
+			uint32_t index = 0;
+			for (;;)
+			{
+				while (popLocal(workerIndex, index))
+				{
+					job.invoke(job.func, index, workerIndex);
+				}
+				if (!steal(workerIndex)) break;
+			}
+		}
+
+		void workerMain(uint32_t workerIndex)
+		{
+			uint64_t lastGeneration = 0;
+			for (;;)
+			{
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					wakeCondition.wait(lock, [&]() { return shouldQuit || generation != lastGeneration; });
+					if (shouldQuit) return;
+					lastGeneration = generation;
+				}
+				execute(workerIndex);
+				bool isLast = false;
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					isLast = --activeWorkerNum == 0;
+				}
+				if (isLast) doneCondition.notify_one();
+			}
+		}
+
+		WorkQueue* queues = nullptr;
+		std::thread* threads = nullptr;
+		uint32_t workerNum = 0;
+		Job job;
+		std::atomic<uint64_t> stealNum{ 0 };
+		std::mutex jobMutex;
+		std::mutex mutex;
+		std::condition_variable wakeCondition;
+		std::condition_variable doneCondition;
+		uint64_t generation = 0;
+		uint32_t activeWorkerNum = 0;
+		bool shouldQuit = false;
+	};
+
+	// Process wide pool using every hardware thread.
+	inline WorkerPool& getWorkerPool()
+	{
+		static WorkerPool pool;
+		return pool;
+	}
+
+	template<typename TFunc>
+	uint64_t parallelFor(uint64_t count, const TFunc& func)
+	{
+		return getWorkerPool().parallelFor(count, func);
+	}
+
+	template<typename TGroupShared, typename TStage>
+	void runDispatchStage(const TStage& stage, const ThreadContext& context, TGroupShared& shared)
+	{
+		if constexpr (std::is_invocable_v<const TStage&, const ThreadContext&, TGroupShared&>)
+		{
+			stage(context, shared);
+		}
+		else
+		{
+			stage(context);
+		}
+	}
+
+	// Runs a [numthreads(TX, TY, TZ)] kernel over groupsX * groupsY * groupsZ groups.
+	// Each stage is callable as stage(const ThreadContext&) or, for kernels that
+	// use groupshared memory, stage(const ThreadContext&, TGroupShared&).
+	template<uint32_t TX, uint32_t TY, uint32_t TZ, typename TGroupShared = NoGroupShared, typename... TStages>
+	DispatchStats cpuDispatch(WorkerPool& pool, uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ, const TStages&... stages)
+	{
+		static_assert(sizeof...(TStages) > 0, "cpuDispatch needs at least one kernel stage");
+		static_assert(TX * TY * TZ <= 1024, "numthreads is limited to 1024 threads per group");
+
+		DispatchStats stats = {};
+		stats.groupNum = (uint64_t)groupsX * groupsY * groupsZ;
+		stats.threadNum = stats.groupNum * TX * TY * TZ;
+		stats.workerNum = pool.getWorkerNum();
+
+		size_t sharedStride = alignSize(sizeof(TGroupShared), 64);
+		uint8_t* sharedMemory = (uint8_t*)malloc(sharedStride * pool.getWorkerNum() + 64);
+		uint8_t* sharedBase = (uint8_t*)alignPtr(sharedMemory, 64);
+
+		double start = getSeconds();
+		stats.stealNum = pool.parallelFor(stats.groupNum, [&](uint64_t group, uint32_t workerIndex)
+		{
+			TGroupShared* shared = new (sharedBase + sharedStride * workerIndex) TGroupShared();
+
+			ThreadContext context = {};
+			context.workerIndex = workerIndex;
+			context.groupID = UInt3((uint32_t)(group % groupsX), (uint32_t)((group / groupsX) % groupsY), (uint32_t)(group / ((uint64_t)groupsX * groupsY)));
+
+			auto runStage = [&](const auto& stage)
+			{
+				for (uint32_t z = 0; z < TZ; ++z)
+				{
+					for (uint32_t y = 0; y < TY; ++y)
+					{
+						for (uint32_t x = 0; x < TX; ++x)
+						{
+							context.groupThreadID = UInt3(x, y, z);
+							context.groupIndex = (z * TY + y) * TX + x;
+							context.dispatchThreadID = UInt3(context.groupID.x * TX + x, context.groupID.y * TY + y, context.groupID.z * TZ + z);
+							runDispatchStage<TGroupShared>(stage, context, *shared);
+						}
+					}
+				}
+			};
+			(runStage(stages), ...);
+
+			shared->~TGroupShared();
+		});
+		stats.seconds = getSeconds() - start;
+
+		free(sharedMemory);
+		return stats;
+	}
+
+	template<uint32_t TX, uint32_t TY, uint32_t TZ, typename TGroupShared = NoGroupShared, typename... TStages>
+	DispatchStats cpuDispatch(uint32_t groupsX, uint32_t groupsY, uint32_t groupsZ, const TStages&... stages)
+	{
+		return cpuDispatch<TX, TY, TZ, TGroupShared>(getWorkerPool(), groupsX, groupsY, groupsZ, stages...);
+	}
+
+}
@@ -0,0 +1,309 @@
+#pragma once
+
+// CPU version of ParticleBasePassCS. Runs the pathtrace()/trace() code from
+// shaders/PathTrace.hlsli over the same [numthreads(32, 32, 1)] groups, one 32x32
+// tile per group spread over every core, into the same five outputs. Gives
+// reference frames and regression/perf runs on machines without a D3D12 GPU.
+
+#include "shaderport.h"
+#include "cputexture.h"
+#include "bvh.h"
+#include "lights.h"
+#include "adaptive.h"
+#include "accumulation.h"
+#include "tilebins.h"
+#include "splat.h"
+#include "noisevolume.h"
+#include "restir.h"
+
+namespace ni {
+
+	struct RenderStats
+	{
+		double seconds = 0.0;
+		uint64_t rayNum = 0;
+		uint64_t cameraRayNum = 0;
+		uint64_t pixelNum = 0;
+		// Frames in getAccumulation() after this render, 0 without CpuRenderer::accumulate.
+		uint32_t accumulatedFrameNum = 0;
+		// Paths by the number of surfaces they hit before they missed, ran into the
+		// bounce limit or lost the Russian roulette.
+		uint64_t pathLengthNums[PATH_MAX_BOUNCE_NUM + 1] = {};
+		DispatchStats dispatch;
+		BvhStats bvh;
+		LightStats lights;
+		TileBinStats tileBins;
+		SplatStats splats;
+		NoiseVolumeStats noise;
+		// The restirSpatial() pass, zero without CpuRenderer::useRestir.
+		DispatchStats restir;
+
+		double getRaysPerSecond() const { return seconds > 0.0 ? rayNum / seconds : 0.0; }
+
+		uint64_t getPathNum() const
+		{
+			uint64_t pathNum = 0;
+			for (uint64_t pathLengthNum : pathLengthNums) pathNum += pathLengthNum;
+			return pathNum;
+		}
+
+		double getMeanPathLength() const
+		{
+			uint64_t hitNum = 0;
+			for (uint32_t length = 0; length <= PATH_MAX_BOUNCE_NUM; ++length) hitNum += pathLengthNums[length] * length;
+			uint64_t pathNum = getPathNum();
+			return pathNum > 0 ? (double)hitNum / pathNum : 0.0;
+		}
+
+		void log(const char* name) const
+		{
+			NI_LOG("%s: %.3f ms, %.2f M rays/s (%llu rays, %.2f camera rays/pixel, %u workers, %llu steals, bvh %s %.3f ms, %u lights)", name, seconds * 1000.0,
+				getRaysPerSecond() / 1e6, (unsigned long long)rayNum, pixelNum > 0 ? (double)cameraRayNum / pixelNum : 0.0, dispatch.workerNum,
+				(unsigned long long)dispatch.stealNum, bvh.rebuilt ? "build" : bvh.seconds > 0.0 ? "refit" : "off", bvh.seconds * 1000.0, lights.lightNum);
+		}
+	};
+
+	// Fills the camera part of constantBufferData the way fp2025.cpp does for its
+	// FlyCamera, previous frame matrices included, with no camera motion.
+	inline void setupCamera(ConstantBufferData& constantBufferData, const Float3& position, const Float3& target, uint32_t width, uint32_t height)
+	{
+		Float4x4 projMtx;
+		projMtx.perspective(toRad(60.0f), (float)width / (float)height, 0.1f, 1000.0f);
+		Float4x4 viewMtx;
+		viewMtx.loadIdentity();
+		viewMtx.lookAt(position, target, Float3(0, 1, 0));
+		constantBufferData.resolution = Float3((float)width, (float)height, 1.0f);
+		constantBufferData.cameraPos = position;
+		constantBufferData.viewMtx = viewMtx;
+		constantBufferData.viewProjMtx = projMtx * viewMtx;
+		constantBufferData.invViewProjMtx = constantBufferData.viewProjMtx;
+		constantBufferData.invViewProjMtx.transpose().invert();
+		constantBufferData.prevCameraPos = constantBufferData.cameraPos;
+		constantBufferData.prevInvViewProjMtx = constantBufferData.invViewProjMtx;
+		constantBufferData.prevViewProjMtx = constantBufferData.viewProjMtx;
+	}
+
+	struct CpuRenderer
+	{
+		static constexpr uint32_t tileSize = 32;
+
+		explicit CpuRenderer(WorkerPool& workerPool = getWorkerPool()) : pool(&workerPool)
+		{
+			counters = new WorkerCounters[pool->getWorkerNum()];
+		}
+
+		~CpuRenderer()
+		{
+			delete[] counters;
+		}
+
+		CpuRenderer(const CpuRenderer&) = delete;
+		CpuRenderer& operator=(const CpuRenderer&) = delete;
+
+		// Renders at constantBufferData.resolution. The constant buffer is taken as
+		// fp2025.cpp fills it, matrices included. The BVH is refitted (or rebuilt)
+		// and the light list rebuilt from particleData first.
+		RenderStats render(const ParticleData* particleData, uint32_t particleNum, const ConstantBufferData& constantBufferData, const SimulationData& simulationData)
+		{
+			uint32_t width = (uint32_t)constantBufferData.resolution.x;
+			uint32_t height = (uint32_t)constantBufferData.resolution.y;
+			resize(width, height);
+			for (uint32_t index = 0; index < pool->getWorkerNum(); ++index) counters[index] = {};
+
+			RenderStats stats = {};
+			uint32_t heldFrameNum = 0;
+			if (accumulate)
+			{
+				heldFrameNum = accumulation.update(constantBufferData, simulationData, particleData, sizeof(ParticleData) * particleNum);
+				stats.accumulatedFrameNum = heldFrameNum;
+				if (accumulation.isConverged(heldFrameNum)) return stats;
+				stats.accumulatedFrameNum++;
+			}
+
+			ParticleSceneData sceneData = {};
+			sceneData.numParticles = particleNum;
+			if (useTileBins) stats.tileBins = tileBins.build(*pool, particleData, particleNum, constantBufferData);
+			const uint32_t* binOffsets = useTileBins ? tileBins.getOffsets() : nullptr;
+			const uint32_t* binParticles = useTileBins ? tileBins.getParticles() : nullptr;
+			const uint32_t* binGlobalParticles = useTileBins ? tileBins.getGlobalParticles() : nullptr;
+			uint32_t binGlobalNum = useTileBins ? tileBins.getGlobalNum() : 0;
+			uint32_t binColumnNum = useTileBins ? tileBins.getColumnNum() : 0;
+			bool splatting = useTileBins && useSplats;
+			if (splatting) stats.splats = splats.rasterize(*pool, particleData, constantBufferData, tileBins);
+			const uint32_t* splatParticles = splatting ? splats.getParticleIndices() : nullptr;
+			uint32_t splatWidth = splatting ? splats.getWidth() : 0;
+			if (useNoiseVolume) stats.noise = noiseVolume.bake(*pool);
+			const float* noiseLattice = useNoiseVolume ? noiseVolume.getLattice() : nullptr;
+			uint32_t noiseExtent = useNoiseVolume ? noiseVolume.getExtent() : 0;
+			if (useBvh) stats.bvh = bvh.update(particleData, particleNum);
+			const BvhNode* bvhNodes = useBvh ? bvh.getNodes() : nullptr;
+			const uint32_t* bvhPrimitives = useBvh ? bvh.getPrimitives() : nullptr;
+			uint32_t bvhNodeNum = useBvh ? bvh.getNodeNum() : 0;
+			uint32_t bvhPlaneNum = useBvh ? bvh.getPlaneNum() : 0;
+			if (useLights) stats.lights = lightList.build(particleData, particleNum);
+			const LightData* lights = useLights ? lightList.getLights() : nullptr;
+			uint32_t lightNum = useLights ? lightList.getLightNum() : 0;
+			float lightPowerSum = useLights ? lightList.getPowerSum() : 0.0f;
+			if (useRestir) lightResampler.resize(width, height);
+			// The base pass only reads the particles, the binding is shared with SimulateCS.
+			ParticleData* particles = const_cast<ParticleData*>(particleData);
+			// With restir the frame is only complete after the spatial pass.
+			bool accumulateBasePass = accumulate && !useRestir;
+			stats.dispatch = cpuDispatch<tileSize, tileSize, 1>(*pool, (width + tileSize - 1) / tileSize, (height + tileSize - 1) / tileSize, 1, [&](const ThreadContext& context)
+			{
+				if (context.groupIndex == 0)
+				{
+					shader::bindBasePass(particles, constantBufferData, simulationData, sceneData);
+					shader::bindBvh(bvhNodes, bvhPrimitives, bvhNodeNum, bvhPlaneNum);
+					shader::bindLights(lights, lightNum, lightPowerSum);
+					shader::bindTileBins(binOffsets, binParticles, binGlobalParticles, binGlobalNum, binColumnNum);
+					shader::bindSplats(splatParticles, splatWidth);
+					shader::bindNoiseVolume(noiseLattice, noiseExtent);
+					shader::bindSampleCounts(sampleCounts ? sampleCounts->getSampleCounts() : nullptr, sampleCounts ? sampleCounts->getColumnNum() : 0);
+					if (useRestir) lightResampler.bind();
+					else shader::bindRestir(nullptr, nullptr, nullptr, nullptr, nullptr, 0);
+					shader::rayNum = 0;
+					shader::cameraRayNum = 0;
+					for (uint64_t& pathLengthNum : shader::pathLengthNums) pathLengthNum = 0;
+				}
+				UInt2 pixel = context.dispatchThreadID.xy();
+				if (pixel.x < width && pixel.y < height)
+				{
+					shader::BasePassOutput output = shader::shadeBasePass(pixel);
+					color[pixel] = output.color;
+					velocity[pixel] = output.velocity;
+					position[pixel] = output.position;
+					normal[pixel] = output.normal;
+					depth[pixel] = output.depth;
+					if (accumulateBasePass) accumulatePixel(pixel, output.color, heldFrameNum);
+				}
+				if (context.groupIndex == tileSize * tileSize - 1)
+				{
+					WorkerCounters& workerCounters = counters[context.workerIndex];
+					workerCounters.rayNum += shader::rayNum;
+					workerCounters.cameraRayNum += shader::cameraRayNum;
+					for (uint32_t length = 0; length <= PATH_MAX_BOUNCE_NUM; ++length) workerCounters.pathLengthNums[length] += shader::pathLengthNums[length];
+					shader::unbind();
+				}
+			});
+			if (useRestir)
+			{
+				// Neighbours come from other groups, so the reservoirs of the whole frame
+				// have to be written before this pass starts.
+				stats.restir = cpuDispatch<tileSize, tileSize, 1>(*pool, (width + tileSize - 1) / tileSize, (height + tileSize - 1) / tileSize, 1, [&](const ThreadContext& context)
+				{
+					if (context.groupIndex == 0)
+					{
+						shader::bindBasePass(particles, constantBufferData, simulationData, sceneData);
+						shader::bindBvh(bvhNodes, bvhPrimitives, bvhNodeNum, bvhPlaneNum);
+						shader::bindLights(lights, lightNum, lightPowerSum);
+						lightResampler.bind();
+						shader::rayNum = 0;
+					}
+					UInt2 pixel = context.dispatchThreadID.xy();
+					if (pixel.x < width && pixel.y < height)
+					{
+						Float4& pixelColor = color[pixel];
+						pixelColor += Float4(shader::restirSpatial(pixel), 0.0f);
+						if (accumulate) accumulatePixel(pixel, pixelColor, heldFrameNum);
+					}
+					if (context.groupIndex == tileSize * tileSize - 1)
+					{
+						counters[context.workerIndex].rayNum += shader::rayNum;
+						shader::unbind();
+					}
+				});
+				lightResampler.endFrame();
+			}
+			stats.pixelNum = (uint64_t)width * height;
+			stats.seconds = stats.dispatch.seconds + stats.bvh.seconds + stats.lights.seconds + stats.tileBins.seconds + stats.splats.seconds + stats.noise.seconds +
+				stats.restir.seconds;
+			for (uint32_t index = 0; index < pool->getWorkerNum(); ++index)
+			{
+				stats.rayNum += counters[index].rayNum;
+				stats.cameraRayNum += counters[index].cameraRayNum;
+				for (uint32_t length = 0; length <= PATH_MAX_BOUNCE_NUM; ++length) stats.pathLengthNums[length] += counters[index].pathLengthNums[length];
+			}
+			return stats;
+		}
+
+		// Off traces with the linear loop over every particle, as the GPU still does.
+		bool useBvh = true;
+		// Off traces camera rays like every other ray, as the GPU still does.
+		bool useTileBins = true;
+		// Off traces camera rays through the tile bins rather than splatting them, has
+		// no effect without useTileBins.
+		bool useSplats = true;
+		// Off evaluates every noise hash, as the GPU still does. The lattice is baked by
+		// the first render that uses it.
+		bool useNoiseVolume = true;
+		// Off leaves emissive particles to the bounces that happen to hit them, as the
+		// GPU still does.
+		bool useLights = true;
+		// Resamples the camera hits' direct light through reservoirs reused over
+		// pixels and frames (shaders/Restir.hlsli) instead of one light sample per
+		// path. Needs useLights. Converges to the same still image, but the reuse
+		// correlates neighbouring pixels and frames, and it only pays off where the
+		// direct light is most of the noise, below 4 spp with few bounces (see
+		// bench::restir). Off by default, as the GPU doesn't run it.
+		bool useRestir = false;
+		// Per tile sample counts, constantBufferData.sampleCount everywhere when null.
+		const AdaptiveSampling* sampleCounts = nullptr;
+		// Keeps the running mean of the frames in getAccumulation() while nothing moves,
+		// and stops rendering once it holds accumulation.maxFrameNum frames.
+		bool accumulate = false;
+		FrameAccumulation accumulation;
+
+		const CpuTexture2D<Float4>& getColor() const { return color; }
+		const CpuTexture2D<Float4>& getVelocity() const { return velocity; }
+		const CpuTexture2D<Float4>& getPosition() const { return position; }
+		const CpuTexture2D<Float4>& getNormal() const { return normal; }
+		const CpuTexture2D<float>& getDepth() const { return depth; }
+		const CpuTexture2D<Float4>& getAccumulation() const { return accumulated; }
+		const ParticleBvh& getBvh() const { return bvh; }
+		uint32_t getWorkerNum() const { return pool->getWorkerNum(); }
+
+		// Forgets the last frame's reservoirs, for a camera cut.
+		void resetRestirHistory() { lightResampler.resetHistory(); }
+
+	private:
+		void accumulatePixel(const UInt2& pixel, const Float4& pixelColor, uint32_t heldFrameNum)
+		{
+			Float4 mean = accumulated[pixel];
+			accumulated[pixel] = heldFrameNum > 0 ? mean + (pixelColor - mean) / (float)(heldFrameNum + 1) : pixelColor;
+		}
+
+		void resize(uint32_t width, uint32_t height)
+		{
+			color.resize(width, height);
+			velocity.resize(width, height);
+			position.resize(width, height);
+			normal.resize(width, height);
+			depth.resize(width, height);
+			if (accumulate) accumulated.resize(width, height);
+		}
+
+		struct alignas(64) WorkerCounters
+		{
+			uint64_t rayNum;
+			uint64_t cameraRayNum;
+			uint64_t pathLengthNums[PATH_MAX_BOUNCE_NUM + 1];
+		};
+
+		WorkerPool* pool = nullptr;
+		WorkerCounters* counters = nullptr;
+		ParticleBvh bvh;
+		ParticleLightList lightList;
+		ParticleTileBins tileBins;
+		ParticleSplats splats;
+		NoiseVolume noiseVolume;
+		LightResampler lightResampler;
+		CpuTexture2D<Float4> color;
+		CpuTexture2D<Float4> velocity;
+		CpuTexture2D<Float4> position;
+		CpuTexture2D<Float4> normal;
+		CpuTexture2D<float> depth;
+		CpuTexture2D<Float4> accumulated;
+	};
+
+}
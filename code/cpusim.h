@@ -0,0 +1,167 @@
+#pragma once
+
+// Deterministic multithreaded CPU particle simulator. State is double buffered: a
+// step only reads the previous state and every particle only writes its own slot
+// of the next one, with collision candidates visited in index order. The result is
+// bit-identical for any number of worker threads, which SimulateCS (in place,
+// scheduling dependent) can't give us.
+//
+// This is a Jacobi style update where SimulateCS is closer to Gauss-Seidel, so the
+// two drift apart over time. simulateSerial in shaderport.h reproduces the GPU.
+
+#include "spatialhash.h"
+#include "mortonsort.h"
+
+namespace ni {
+
+	namespace shader {
+		namespace {
+
+		// One particle of a double buffered step. Expects bindSimulation() on this thread.
+		inline ParticleData stepParticle(const SpatialHash& grid, Array<uint32_t>& candidates, const ParticleData* previous, uint32_t pid)
+		{
+			seed = float3(1, 1, 1);
+			ParticleData particle = previous[pid];
+			uint sceneId = beginParticle(pid, particle);
+			integrateScene(sceneId, particle, simData.scene, simData.time);
+			if (particle.dynamic)
+			{
+				grid.gatherCandidates(particle.position, particle.radius, candidates);
+				for (uint32_t index = 0; index < candidates.getNum(); ++index)
+				{
+					uint32_t other = candidates[index];
+					if (other != pid && mayCollide(particle, previous[other]))
+					{
+						collideScene(particle, previous[other], simData.scene);
+					}
+				}
+			}
+			return particle;
+		}
+
+		inline ParticleData initParticle(const ParticleData& previous, uint32_t pid)
+		{
+			seed = float3(1, 1, 1);
+			ParticleData particle = previous;
+			beginParticle(pid, particle);
+			initScene(pid, particle, simData.scene);
+			return particle;
+		}
+
+		}
+	}
+
+	struct CpuSimulator
+	{
+		// Particles per parallelFor item. Big enough to hide the scheduling cost and
+		// small enough for stealing to even out dense regions.
+		static constexpr uint32_t blockSize = 64;
+
+		explicit CpuSimulator(WorkerPool& workerPool = getWorkerPool()) : pool(&workerPool)
+		{
+			candidates = new Array<uint32_t>[pool->getWorkerNum()];
+		}
+
+		~CpuSimulator()
+		{
+			delete[] candidates;
+		}
+
+		CpuSimulator(const CpuSimulator&) = delete;
+		CpuSimulator& operator=(const CpuSimulator&) = delete;
+
+		// Runs the scene init (what SimulateCS does on frame 0) for particleNum particles.
+		void init(uint32_t particleNum, const SimulationData& simulationData)
+		{
+			resize(particleNum);
+			SimulationData initData = simulationData;
+			initData.frame = 0;
+			run(initData, [&](uint32_t pid, uint32_t)
+			{
+				return shader::initParticle(buffers[current][pid], pid);
+			});
+		}
+
+		// Continues from an existing state, e.g. a GPU readback or a baked frame.
+		void load(const ParticleData* particleData, uint32_t particleNum)
+		{
+			resize(particleNum);
+			for (uint32_t index = 0; index < particleNum; ++index)
+			{
+				buffers[current][index] = particleData[index];
+			}
+		}
+
+		void step(const SimulationData& simulationData)
+		{
+			if (simulationData.frame == 0)
+			{
+				init(sceneData.numParticles, simulationData);
+				return;
+			}
+			if (reorderInterval > 0 && stepIndex++ % reorderInterval == 0)
+			{
+				reorder.reorder(*pool, buffers[current].getData(), sceneData.numParticles);
+			}
+			const ParticleData* previous = buffers[current].getData();
+			grid.build(previous, sceneData.numParticles);
+			run(simulationData, [&](uint32_t pid, uint32_t workerIndex)
+			{
+				return shader::stepParticle(grid, candidates[workerIndex], previous, pid);
+			});
+		}
+
+		// Sort the particles into Morton order every this many steps, 0 turns it off.
+		// The order changes which candidate is visited first, so results differ
+		// from an unsorted run but are still the same for every worker count.
+		uint32_t reorderInterval = 0;
+
+		const ParticleData* getParticles() const { return buffers[current].getData(); }
+		const MortonReorder& getReorder() const { return reorder; }
+		uint32_t getParticleNum() const { return sceneData.numParticles; }
+		uint32_t getWorkerNum() const { return pool->getWorkerNum(); }
+
+	private:
+		void resize(uint32_t particleNum)
+		{
+			sceneData.numParticles = particleNum;
+			for (Array<ParticleData>& buffer : buffers)
+			{
+				if (buffer.getNum() == particleNum) continue;
+				buffer.reset();
+				buffer.fill(particleNum, ParticleData{});
+			}
+		}
+
+		// Calls func(pid, workerIndex) for every particle, writes the returned
+		// particles to the other buffer and flips.
+		template<typename TFunc>
+		void run(const SimulationData& simulationData, const TFunc& func)
+		{
+			ParticleData* previous = buffers[current].getData();
+			ParticleData* next = buffers[current ^ 1].getData();
+			uint32_t particleNum = sceneData.numParticles;
+			uint32_t blockNum = (particleNum + blockSize - 1) / blockSize;
+			pool->parallelFor(blockNum, [&](uint64_t block, uint32_t workerIndex)
+			{
+				shader::bindSimulation(previous, simulationData, sceneData);
+				uint32_t end = min((uint32_t)block * blockSize + blockSize, particleNum);
+				for (uint32_t pid = (uint32_t)block * blockSize; pid < end; ++pid)
+				{
+					next[pid] = func(pid, workerIndex);
+				}
+			});
+			current ^= 1;
+		}
+
+		WorkerPool* pool = nullptr;
+		Array<ParticleData> buffers[2];
+		uint32_t current = 0;
+		SpatialHash grid;
+		MortonReorder reorder;
+		uint32_t stepIndex = 0;
+		Array<uint32_t>* candidates = nullptr;
+		ParticleSceneData sceneData = {};
+	};
+
+}
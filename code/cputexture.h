@@ -0,0 +1,98 @@
+#pragma once
+
+// CPU stand-ins for the shader resources the compute passes use, so the CPU ports
+// can keep the same access patterns (tex[px], Load, SampleLevel) as the HLSL code.
+
+#include "hlsl.h"
+
+namespace ni {
+
+	template<typename T>
+	struct CpuTexture2D
+	{
+		CpuTexture2D() {}
+		CpuTexture2D(uint32_t width, uint32_t height) { resize(width, height); }
+		CpuTexture2D(const CpuTexture2D& other) { *this = other; }
+		~CpuTexture2D() { delete[] texels; }
+
+		CpuTexture2D& operator=(const CpuTexture2D& other)
+		{
+			if (this == &other) return *this;
+			resize(other.width, other.height);
+			for (uint64_t index = 0; index < getTexelNum(); ++index)
+			{
+				texels[index] = other.texels[index];
+			}
+			return *this;
+		}
+
+		void resize(uint32_t newWidth, uint32_t newHeight)
+		{
+			if (newWidth == width && newHeight == height) return;
+			delete[] texels;
+			width = newWidth;
+			height = newHeight;
+			texels = new T[(uint64_t)width * height]();
+		}
+
+		void clear(const T& value)
+		{
+			for (uint64_t index = 0; index < getTexelNum(); ++index)
+			{
+				texels[index] = value;
+			}
+		}
+
+		T& operator[](const UInt2& px) { return texels[(uint64_t)px.y * width + px.x]; }
+		const T& operator[](const UInt2& px) const { return texels[(uint64_t)px.y * width + px.x]; }
+
+		// Out of range loads return zero like Texture2D.Load does.
+		T Load(const Int2& px) const
+		{
+			if (px.x < 0 || px.y < 0 || px.x >= (int32_t)width || px.y >= (int32_t)height) return T(0);
+			return texels[(uint64_t)px.y * width + px.x];
+		}
+
+		// Clamp addressing, point filtered.
+		T SamplePoint(const Float2& uv) const
+		{
+			int32_t x = clamp((int32_t)floorf(uv.x * width), 0, (int32_t)width - 1);
+			int32_t y = clamp((int32_t)floorf(uv.y * height), 0, (int32_t)height - 1);
+			return texels[(uint64_t)y * width + x];
+		}
+
+		// Clamp addressing, bilinear filtered. Matches SampleLevel(linearClamp, uv, 0).
+		T SampleLevel(const Float2& uv, float mipLevel = 0.0f) const
+		{
+			(void)mipLevel;
+			float fx = uv.x * width - 0.5f;
+			float fy = uv.y * height - 0.5f;
+			float x0 = floorf(fx);
+			float y0 = floorf(fy);
+			float tx = fx - x0;
+			float ty = fy - y0;
+			int32_t ix0 = clamp((int32_t)x0, 0, (int32_t)width - 1);
+			int32_t iy0 = clamp((int32_t)y0, 0, (int32_t)height - 1);
+			int32_t ix1 = clamp((int32_t)x0 + 1, 0, (int32_t)width - 1);
+			int32_t iy1 = clamp((int32_t)y0 + 1, 0, (int32_t)height - 1);
+			const T& a = texels[(uint64_t)iy0 * width + ix0];
+			const T& b = texels[(uint64_t)iy0 * width + ix1];
+			const T& c = texels[(uint64_t)iy1 * width + ix0];
+			const T& d = texels[(uint64_t)iy1 * width + ix1];
+			return (a * (1.0f - tx) + b * tx) * (1.0f - ty) + (c * (1.0f - tx) + d * tx) * ty;
+		}
+
+		T* getData() { return texels; }
+		const T* getData() const { return texels; }
+		uint32_t getWidth() const { return width; }
+		uint32_t getHeight() const { return height; }
+		uint64_t getTexelNum() const { return (uint64_t)width * height; }
+		size_t getSizeInBytes() const { return sizeof(T) * getTexelNum(); }
+
+	private:
+		T* texels = nullptr;
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+}
@@ -6,22 +6,22 @@
 #include "../tmp/shaders/TemporalAACS.h"
 #include "../tmp/shaders/TemporalReprojectionCS.h"
 #include "../tmp/shaders/ATrousFilterCS.h"
+#include "../tmp/shaders/AccumulateCS.h"
 #include "../tmp/shaders/DepthOfFieldPS.h"
 #include "../tmp/shaders/TransferToBackbufferPS.h"
 #include "../tmp/shaders/AudioProcessCS.h"
 
 #define IS_CPU 1
 #include "../shaders/ParticleConfig.h"
+#include "benchmarks.h"
 
 #include "render.h"
+#include "history.h"
 #include "audio.h"
 #include "editor.h"
 
 inline UINT PIX_COLOR_INDEX(BYTE i) { return 0x00000000 | i; }
 
-#define RENDER_WIDTH 1920
-#define RENDER_HEIGHT 1080
-
 #define MAX_PARTICLE_NUM (32*10)
 
 #if NI_DEBUG
@@ -30,8 +30,14 @@ inline UINT PIX_COLOR_INDEX(BYTE i) { return 0x00000000 | i; }
 #define ENABLE_PIX 0
 #endif
 
-int main()
+int main(int argc, char** argv)
 {
+	// fp2025.exe -bench [name ...] runs the CPU benchmarks without opening a window.
+	if (argc > 1 && strcmp(argv[1], "-bench") == 0)
+	{
+		return ni::runBenchmarks(argc - 2, argv + 2);
+	}
+
 	ni::init(0, 0, 1920, 1080, "FP2025", !NI_DEBUG, ENABLE_PIX);
 
 #if NI_DEBUG
@@ -83,9 +89,7 @@ int main()
 	basePassParticleDesc.shader = { ParticleBasePassCS, sizeof(ParticleBasePassCS) };
 	ni::PipelineState* basePassParticle = ni::buildComputePipelineState(basePassParticleDesc);
 	ni::Texture* outputTexture = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R16G16B16A16_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-	ni::Texture* velocityBuffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32G32B32A32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-	ni::Texture* positionBuffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32G32B32A32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-	ni::Texture* normalBuffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32G32B32A32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	ni::Texture* velocityBuffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R16G16_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
 
 	ConstantBufferUploader<ConstantBufferData>* sceneRenderCB = new ConstantBufferUploader<ConstantBufferData>();
 
@@ -105,20 +109,39 @@ int main()
 	sceneRenderCB->data.prevViewProjMtx = sceneRenderCB->data.viewProjMtx;
 	sceneRenderCB->data.frame = 0.0f;
 	sceneRenderCB->data.sampleCount = 4;
+	sceneRenderCB->data.samplerType = SAMPLER_SOBOL;
+	sceneRenderCB->data.bounceNum = PATH_DEFAULT_BOUNCE_NUM;
+	sceneRenderCB->data.rouletteBounce = 2;
 
 	ni::DescriptorAllocator* rtvDescriptorAllocator = ni::createDescriptorAllocator(D3D12_DESCRIPTOR_HEAP_TYPE_RTV, 2, D3D12_DESCRIPTOR_HEAP_FLAG_NONE);
 
-	// Temporal Reprojection
-	ni::Texture* prevPositionBuffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32G32B32A32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-	ni::Texture* prevNormalBuffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32G32B32A32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-	ni::Texture* historyM1Buffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-	ni::Texture* historyM2Buffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-	ni::Texture* prevHistoryM1Buffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-	ni::Texture* prevHistoryM2Buffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-	ni::Texture* depthBuffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-	ni::Texture* prevDepthBuffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
-	ni::Texture* historyBuffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE, DXGI_FORMAT_R16G16B16A16_FLOAT);
-	ni::Texture* resultTemporalReprojection = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R16G16B16A16_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	// Temporal Reprojection. Everything the next frame reads back is a HistoryChain
+	// (code/history.h) that is rotated at the end of the frame instead of copied.
+	// The G-buffer is packed as shaders/GBuffer.hlsli describes: particle ids,
+	// octahedral normals and no position, which depth gives back.
+	ni::HistoryChain<ni::Texture> idHistory;
+	ni::HistoryChain<ni::Texture> normalHistory;
+	ni::HistoryChain<ni::Texture> depthHistory;
+	ni::HistoryChain<ni::Texture> historyM1;
+	ni::HistoryChain<ni::Texture> historyM2;
+	ni::HistoryChain<ni::Texture> colorHistory;
+	for (uint32_t index = 0; index < idHistory.getFrameNum(); ++index)
+	{
+		idHistory.set(index, ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32_UINT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+		normalHistory.set(index, ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R16G16_SNORM, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+		depthHistory.set(index, ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+		historyM1.set(index, ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+		historyM2.set(index, ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+		colorHistory.set(index, ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R16G16B16A16_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS));
+	}
+	// The base pass stores the packed formats through typed UAVs, which not every
+	// format guarantees; the passes after it only Load them.
+	for (DXGI_FORMAT format : { DXGI_FORMAT_R16G16_FLOAT, DXGI_FORMAT_R16G16_SNORM, DXGI_FORMAT_R32_UINT })
+	{
+		D3D12_FEATURE_DATA_FORMAT_SUPPORT formatSupport = { format };
+		NI_D3D_ASSERT(ni::getDevice()->CheckFeatureSupport(D3D12_FEATURE_FORMAT_SUPPORT, &formatSupport, sizeof(formatSupport)), "Failed to query format support");
+		NI_ASSERT((formatSupport.Support2 & D3D12_FORMAT_SUPPORT2_UAV_TYPED_STORE) != 0, "G-buffer format %u has no typed UAV store", (uint32_t)format);
+	}
 
 	ni::ComputePipelineDesc temporalReprojectionDesc = {};
 	temporalReprojectionDesc.layout.addDescriptorTable(ni::DescriptorRange(
@@ -141,6 +164,29 @@ int main()
 	AtrousFilterDesc.shader = { ATrousFilterCS, sizeof(ATrousFilterCS) };
 	ni::PipelineState* atrousFilter = ni::buildComputePipelineState(AtrousFilterDesc);
 
+	// Progressive accumulation, P pauses the simulation and a still camera then
+	// accumulates into an HDR running mean (code/accumulation.h).
+	ni::Texture* accumulationBuffer = ni::createTexture(RENDER_WIDTH, RENDER_HEIGHT, 1, nullptr, D3D12_RESOURCE_STATE_UNORDERED_ACCESS, DXGI_FORMAT_R32G32B32A32_FLOAT, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+	// AccumulateCS reads the mean back through the same typed UAV it writes, and a
+	// typed UAV load of RGBA32F needs TypedUAVLoadAdditionalFormats.
+	{
+		D3D12_FEATURE_DATA_FORMAT_SUPPORT formatSupport = { DXGI_FORMAT_R32G32B32A32_FLOAT };
+		NI_D3D_ASSERT(ni::getDevice()->CheckFeatureSupport(D3D12_FEATURE_FORMAT_SUPPORT, &formatSupport, sizeof(formatSupport)), "Failed to query format support");
+		NI_ASSERT((formatSupport.Support2 & D3D12_FORMAT_SUPPORT2_UAV_TYPED_LOAD) != 0 && (formatSupport.Support2 & D3D12_FORMAT_SUPPORT2_UAV_TYPED_STORE) != 0,
+			"Accumulation format %u has no typed UAV load and store", (uint32_t)DXGI_FORMAT_R32G32B32A32_FLOAT);
+	}
+	ni::ComputePipelineDesc accumulateDesc = {};
+	accumulateDesc.layout.addDescriptorTable(ni::DescriptorRange(
+		ni::DescriptorRangeEntry(D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 1, 0, 0),
+		ni::DescriptorRangeEntry(D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 1, 0, 0)
+	), D3D12_SHADER_VISIBILITY_ALL);
+	accumulateDesc.layout.add32BitConstant(0, 0, 4, D3D12_SHADER_VISIBILITY_ALL);
+	accumulateDesc.shader = { AccumulateCS, sizeof(AccumulateCS) };
+	ni::PipelineState* accumulate = ni::buildComputePipelineState(accumulateDesc);
+	ni::FrameAccumulation accumulation;
+	bool simulationPaused = false;
+	bool pauseKeyDown = false;
+
 	// Depth of Field
 	FullscreenRasterPass* depthOfFieldPass = new FullscreenRasterPass();
 	depthOfFieldPass->pixel.shader = { DepthOfFieldPS, sizeof(DepthOfFieldPS) };
@@ -232,6 +278,13 @@ int main()
 				simulationCB->data.frame = 0;
 			}
 
+			if (ni::keyDown(ni::P) && !pauseKeyDown)
+			{
+				simulationPaused = !simulationPaused;
+				NI_LOG("simulation %s", simulationPaused ? "paused, accumulating" : "running");
+			}
+			pauseKeyDown = ni::keyDown(ni::P);
+
 		}
 
 		if (ni::mouseClick(ni::MOUSE_BUTTON_MIDDLE))
@@ -273,6 +326,28 @@ int main()
 				transferToBackBufferCB->data.time = sceneRenderCB->data.time;
 				simulationCB->data.cameraPos = camera.position;
 
+				// While paused a frame with the same camera and settings as the last one adds
+				// to the running mean. It takes over from the denoiser after
+				// ACCUMULATION_DENOISE_FRAME_NUM frames and the base pass stops once converged.
+				uint32_t accumulatedFrameNum = 0;
+				if (simulationPaused) accumulatedFrameNum = accumulation.update(sceneRenderCB->data, simulationCB->data);
+				else accumulation.reset();
+				bool renderFrame = !accumulation.isConverged(accumulatedFrameNum);
+				bool denoise = !simulationPaused || ni::FrameAccumulation::needsDenoise(accumulatedFrameNum);
+
+				ni::Texture* idBuffer = idHistory.getCurrent();
+				ni::Texture* normalBuffer = normalHistory.getCurrent();
+				ni::Texture* depthBuffer = depthHistory.getCurrent();
+				ni::Texture* historyM1Buffer = historyM1.getCurrent();
+				ni::Texture* historyM2Buffer = historyM2.getCurrent();
+				ni::Texture* resultTemporalReprojection = colorHistory.getCurrent();
+				ni::Texture* prevIdBuffer = idHistory.getPrevious();
+				ni::Texture* prevNormalBuffer = normalHistory.getPrevious();
+				ni::Texture* prevDepthBuffer = depthHistory.getPrevious();
+				ni::Texture* prevHistoryM1Buffer = historyM1.getPrevious();
+				ni::Texture* prevHistoryM2Buffer = historyM2.getPrevious();
+				ni::Texture* historyBuffer = colorHistory.getPrevious();
+
 				pixBeginEventOnCommandList(commandList, PIX_COLOR_INDEX(pixColorIndex++), "Update CBs");
 				depthOfFieldCB->update(commandList);
 				simulationCB->update(commandList);
@@ -283,165 +358,193 @@ int main()
 
 				// Run Simulation
 				pixBeginEventOnCommandList(commandList, PIX_COLOR_INDEX(pixColorIndex++), "Particle Simulation");
-				commandList->SetPipelineState(simulateParticles->pso);
-				commandList->SetComputeRootSignature(simulateParticles->rootSignature);
-				ni::DescriptorTable simulateParticlesDescriptorTable = descriptorAllocator->allocateDescriptorTable(3);
-				simulateParticlesDescriptorTable.allocUAVBuffer(particleBuffer->resource, nullptr, DXGI_FORMAT_UNKNOWN, 0, MAX_PARTICLE_NUM, sizeof(ParticleData), 0);
-				simulateParticlesDescriptorTable.allocCBVBuffer(simulationCB->buffer->resource, simulationCB->buffer->resource.apiResource->GetDesc().Width);
-				simulateParticlesDescriptorTable.allocCBVBuffer(particleSceneCB->buffer->resource, particleSceneCB->buffer->resource.apiResource->GetDesc().Width);
-				commandList->SetComputeRootDescriptorTable(0, simulateParticlesDescriptorTable.gpuBaseHandle);
-				commandList->Dispatch(particleSceneCB->data.numParticles / 32, 1, 1);
+				if (!simulationPaused)
+				{
+					commandList->SetPipelineState(simulateParticles->pso);
+					commandList->SetComputeRootSignature(simulateParticles->rootSignature);
+					ni::DescriptorTable simulateParticlesDescriptorTable = descriptorAllocator->allocateDescriptorTable(3);
+					simulateParticlesDescriptorTable.allocUAVBuffer(particleBuffer->resource, nullptr, DXGI_FORMAT_UNKNOWN, 0, MAX_PARTICLE_NUM, sizeof(ParticleData), 0);
+					simulateParticlesDescriptorTable.allocCBVBuffer(simulationCB->buffer->resource, simulationCB->buffer->resource.apiResource->GetDesc().Width);
+					simulateParticlesDescriptorTable.allocCBVBuffer(particleSceneCB->buffer->resource, particleSceneCB->buffer->resource.apiResource->GetDesc().Width);
+					commandList->SetComputeRootDescriptorTable(0, simulateParticlesDescriptorTable.gpuBaseHandle);
+					commandList->Dispatch(particleSceneCB->data.numParticles / 32, 1, 1);
+				}
 
 				resourceBarrier.transition(particleBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
 				resourceBarrier.transition(outputTexture->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 				resourceBarrier.transition(velocityBuffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+				resourceBarrier.transition(idBuffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+				resourceBarrier.transition(normalBuffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+				resourceBarrier.transition(depthBuffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 				resourceBarrier.flush(commandList);
 				pixEndEventOnCommandList(commandList);
 
 				// Render Scene
 				pixBeginEventOnCommandList(commandList, PIX_COLOR_INDEX(pixColorIndex++), "Render Base Scene");
-				commandList->SetPipelineState(basePassParticle->pso);
-				commandList->SetComputeRootSignature(basePassParticle->rootSignature);
-				ni::DescriptorTable basePassDescriptorTable = descriptorAllocator->allocateDescriptorTable(9);
-				basePassDescriptorTable.allocSRVBuffer(particleBuffer->resource, DXGI_FORMAT_UNKNOWN, 0, MAX_PARTICLE_NUM, sizeof(ParticleData));
-				basePassDescriptorTable.allocUAVTex2D(outputTexture->resource, nullptr, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 0);
-				basePassDescriptorTable.allocUAVTex2D(velocityBuffer->resource, nullptr, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0);
-				basePassDescriptorTable.allocUAVTex2D(positionBuffer->resource, nullptr, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0);
-				basePassDescriptorTable.allocUAVTex2D(normalBuffer->resource, nullptr, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0);
-				basePassDescriptorTable.allocUAVTex2D(depthBuffer->resource, nullptr, DXGI_FORMAT_R32_FLOAT, 0, 0);
-				basePassDescriptorTable.allocCBVBuffer(sceneRenderCB->buffer->resource, sceneRenderCB->buffer->resource.apiResource->GetDesc().Width);
-				basePassDescriptorTable.allocCBVBuffer(particleSceneCB->buffer->resource, particleSceneCB->buffer->resource.apiResource->GetDesc().Width);
-				basePassDescriptorTable.allocCBVBuffer(simulationCB->buffer->resource, simulationCB->buffer->resource.apiResource->GetDesc().Width);
-				commandList->SetComputeRootDescriptorTable(0, basePassDescriptorTable.gpuBaseHandle);
-				commandList->Dispatch((uint32_t)(sceneRenderCB->data.resolution.x / 32.0f), (uint32_t)(sceneRenderCB->data.resolution.y / 32.0f) + 1, 1);
-				pixEndEventOnCommandList(commandList);
-
-				// Temporal Reprojection
-				pixBeginEventOnCommandList(commandList, PIX_COLOR_INDEX(pixColorIndex++), "Temporal Reprojection");
-				resourceBarrier.transition(outputTexture->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.transition(velocityBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.transition(historyBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.transition(positionBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.transition(normalBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.transition(prevPositionBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.transition(prevNormalBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.transition(prevHistoryM1Buffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.transition(prevHistoryM2Buffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.transition(depthBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.transition(prevDepthBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.transition(resultTemporalReprojection->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-				resourceBarrier.transition(historyM1Buffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-				resourceBarrier.transition(historyM2Buffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-				resourceBarrier.flush(commandList);
-
-				commandList->SetPipelineState(temporalReprojection->pso);
-				commandList->SetComputeRootSignature(temporalReprojection->rootSignature);
-				ni::DescriptorTable temporalReprojectionDescriptorTable = descriptorAllocator->allocateDescriptorTable(15);
-				temporalReprojectionDescriptorTable.allocSRVTex2D(outputTexture->resource, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 1, 0, 0.0f);
-				temporalReprojectionDescriptorTable.allocSRVTex2D(velocityBuffer->resource, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 1, 0, 0.0f);
-				temporalReprojectionDescriptorTable.allocSRVTex2D(historyBuffer->resource, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 1, 0, 0.0f);
-				temporalReprojectionDescriptorTable.allocSRVTex2D(positionBuffer->resource, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 1, 0, 0.0f);
-				temporalReprojectionDescriptorTable.allocSRVTex2D(normalBuffer->resource, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 1, 0, 0.0f);
-				temporalReprojectionDescriptorTable.allocSRVTex2D(prevPositionBuffer->resource, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 1, 0, 0.0f);
-				temporalReprojectionDescriptorTable.allocSRVTex2D(prevNormalBuffer->resource, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 1, 0, 0.0f);
-				temporalReprojectionDescriptorTable.allocSRVTex2D(prevHistoryM1Buffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
-				temporalReprojectionDescriptorTable.allocSRVTex2D(prevHistoryM2Buffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
-				temporalReprojectionDescriptorTable.allocSRVTex2D(depthBuffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
-				temporalReprojectionDescriptorTable.allocSRVTex2D(prevDepthBuffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
-				temporalReprojectionDescriptorTable.allocUAVTex2D(resultTemporalReprojection->resource, nullptr, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 0);
-				temporalReprojectionDescriptorTable.allocUAVTex2D(historyM1Buffer->resource, nullptr, DXGI_FORMAT_R32_FLOAT, 0, 0);
-				temporalReprojectionDescriptorTable.allocUAVTex2D(historyM2Buffer->resource, nullptr, DXGI_FORMAT_R32_FLOAT, 0, 0);
-				temporalReprojectionDescriptorTable.allocCBVBuffer(sceneRenderCB->buffer->resource, sceneRenderCB->buffer->resource.apiResource->GetDesc().Width);
-				commandList->SetComputeRootDescriptorTable(0, temporalReprojectionDescriptorTable.gpuBaseHandle);
-				commandList->Dispatch((uint32_t)(sceneRenderCB->data.resolution.x / 32.0f), (uint32_t)(sceneRenderCB->data.resolution.y / 32.0f) + 1, 1);
-
-				resourceBarrier.transition(historyM1Buffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.transition(historyM2Buffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-				resourceBarrier.flush(commandList);
+				if (renderFrame)
+				{
+					commandList->SetPipelineState(basePassParticle->pso);
+					commandList->SetComputeRootSignature(basePassParticle->rootSignature);
+					ni::DescriptorTable basePassDescriptorTable = descriptorAllocator->allocateDescriptorTable(9);
+					basePassDescriptorTable.allocSRVBuffer(particleBuffer->resource, DXGI_FORMAT_UNKNOWN, 0, MAX_PARTICLE_NUM, sizeof(ParticleData));
+					basePassDescriptorTable.allocUAVTex2D(outputTexture->resource, nullptr, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 0);
+					basePassDescriptorTable.allocUAVTex2D(velocityBuffer->resource, nullptr, DXGI_FORMAT_R16G16_FLOAT, 0, 0);
+					basePassDescriptorTable.allocUAVTex2D(idBuffer->resource, nullptr, DXGI_FORMAT_R32_UINT, 0, 0);
+					basePassDescriptorTable.allocUAVTex2D(normalBuffer->resource, nullptr, DXGI_FORMAT_R16G16_SNORM, 0, 0);
+					basePassDescriptorTable.allocUAVTex2D(depthBuffer->resource, nullptr, DXGI_FORMAT_R32_FLOAT, 0, 0);
+					basePassDescriptorTable.allocCBVBuffer(sceneRenderCB->buffer->resource, sceneRenderCB->buffer->resource.apiResource->GetDesc().Width);
+					basePassDescriptorTable.allocCBVBuffer(particleSceneCB->buffer->resource, particleSceneCB->buffer->resource.apiResource->GetDesc().Width);
+					basePassDescriptorTable.allocCBVBuffer(simulationCB->buffer->resource, simulationCB->buffer->resource.apiResource->GetDesc().Width);
+					commandList->SetComputeRootDescriptorTable(0, basePassDescriptorTable.gpuBaseHandle);
+					commandList->Dispatch((uint32_t)(sceneRenderCB->data.resolution.x / 32.0f), (uint32_t)(sceneRenderCB->data.resolution.y / 32.0f) + 1, 1);
+				}
 				pixEndEventOnCommandList(commandList);
 
-				// A-trous filter passes
-				pixBeginEventOnCommandList(commandList, PIX_COLOR_INDEX(pixColorIndex++), "A-Trous Filter Passes");
-				ni::Texture* atrousInputOutput[2] = { resultTemporalReprojection, outputTexture };
-
-				commandList->SetPipelineState(atrousFilter->pso);
-				commandList->SetComputeRootSignature(atrousFilter->rootSignature);
-
-				ni::Texture* input = atrousInputOutput[0];
-				ni::Texture* output = atrousInputOutput[1];
-
-# if 1
-				for (uint32_t index = 0; index < 2; ++index)
+				if (simulationPaused && renderFrame)
 				{
-					input = atrousInputOutput[index % 2];
-					output = atrousInputOutput[(index + 1) % 2];
-
-					resourceBarrier.transition(input->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
-					resourceBarrier.transition(output->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+					pixBeginEventOnCommandList(commandList, PIX_COLOR_INDEX(pixColorIndex++), "Accumulate");
+					resourceBarrier.transition(outputTexture->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(accumulationBuffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 					resourceBarrier.flush(commandList);
-
-					ni::DescriptorTable atrousFilterDescriptorTable = descriptorAllocator->allocateDescriptorTable(7);
-					atrousFilterDescriptorTable.allocSRVTex2D(input->resource, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 1, 0, 0.0f);
-					atrousFilterDescriptorTable.allocSRVTex2D(normalBuffer->resource, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 1, 0, 0.0f);
-					atrousFilterDescriptorTable.allocSRVTex2D(historyM1Buffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
-					atrousFilterDescriptorTable.allocSRVTex2D(historyM2Buffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
-					atrousFilterDescriptorTable.allocSRVTex2D(depthBuffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
-					atrousFilterDescriptorTable.allocUAVTex2D(output->resource, nullptr, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 0);
+					commandList->SetPipelineState(accumulate->pso);
+					commandList->SetComputeRootSignature(accumulate->rootSignature);
+					ni::DescriptorTable accumulateDescriptorTable = descriptorAllocator->allocateDescriptorTable(2);
+					accumulateDescriptorTable.allocSRVTex2D(outputTexture->resource, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 1, 0, 0.0f);
+					accumulateDescriptorTable.allocUAVTex2D(accumulationBuffer->resource, nullptr, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 0);
 
 					struct Constant
 					{
-						uint32_t step;
+						uint32_t frameNum;
 						ni::Float3 resolution;
-					} constantData = { index + 1, sceneRenderCB->data.resolution };
+					} constantData = { accumulatedFrameNum, sceneRenderCB->data.resolution };
 
-					commandList->SetComputeRootDescriptorTable(0, atrousFilterDescriptorTable.gpuBaseHandle);
+					commandList->SetComputeRootDescriptorTable(0, accumulateDescriptorTable.gpuBaseHandle);
 					commandList->SetComputeRoot32BitConstants(1, ni::calcNumUint32FromSize(sizeof(Constant)), &constantData, 0);
 					commandList->Dispatch((uint32_t)(sceneRenderCB->data.resolution.x / 32.0f), (uint32_t)(sceneRenderCB->data.resolution.y / 32.0f) + 1, 1);
+					pixEndEventOnCommandList(commandList);
 				}
+
+				// Shows the running mean instead once it holds enough frames.
+				ni::Texture* output = accumulationBuffer;
+				if (denoise)
+				{
+					// Temporal Reprojection
+					pixBeginEventOnCommandList(commandList, PIX_COLOR_INDEX(pixColorIndex++), "Temporal Reprojection");
+					resourceBarrier.transition(outputTexture->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(velocityBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(historyBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(idBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(normalBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(prevIdBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(prevNormalBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(prevHistoryM1Buffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(prevHistoryM2Buffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(depthBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(prevDepthBuffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(resultTemporalReprojection->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+					resourceBarrier.transition(historyM1Buffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+					resourceBarrier.transition(historyM2Buffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+					resourceBarrier.flush(commandList);
+
+					commandList->SetPipelineState(temporalReprojection->pso);
+					commandList->SetComputeRootSignature(temporalReprojection->rootSignature);
+					ni::DescriptorTable temporalReprojectionDescriptorTable = descriptorAllocator->allocateDescriptorTable(15);
+					temporalReprojectionDescriptorTable.allocSRVTex2D(outputTexture->resource, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 1, 0, 0.0f);
+					temporalReprojectionDescriptorTable.allocSRVTex2D(velocityBuffer->resource, DXGI_FORMAT_R16G16_FLOAT, 0, 1, 0, 0.0f);
+					temporalReprojectionDescriptorTable.allocSRVTex2D(historyBuffer->resource, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 1, 0, 0.0f);
+					temporalReprojectionDescriptorTable.allocSRVTex2D(idBuffer->resource, DXGI_FORMAT_R32_UINT, 0, 1, 0, 0.0f);
+					temporalReprojectionDescriptorTable.allocSRVTex2D(normalBuffer->resource, DXGI_FORMAT_R16G16_SNORM, 0, 1, 0, 0.0f);
+					temporalReprojectionDescriptorTable.allocSRVTex2D(prevIdBuffer->resource, DXGI_FORMAT_R32_UINT, 0, 1, 0, 0.0f);
+					temporalReprojectionDescriptorTable.allocSRVTex2D(prevNormalBuffer->resource, DXGI_FORMAT_R16G16_SNORM, 0, 1, 0, 0.0f);
+					temporalReprojectionDescriptorTable.allocSRVTex2D(prevHistoryM1Buffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
+					temporalReprojectionDescriptorTable.allocSRVTex2D(prevHistoryM2Buffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
+					temporalReprojectionDescriptorTable.allocSRVTex2D(depthBuffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
+					temporalReprojectionDescriptorTable.allocSRVTex2D(prevDepthBuffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
+					temporalReprojectionDescriptorTable.allocUAVTex2D(resultTemporalReprojection->resource, nullptr, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 0);
+					temporalReprojectionDescriptorTable.allocUAVTex2D(historyM1Buffer->resource, nullptr, DXGI_FORMAT_R32_FLOAT, 0, 0);
+					temporalReprojectionDescriptorTable.allocUAVTex2D(historyM2Buffer->resource, nullptr, DXGI_FORMAT_R32_FLOAT, 0, 0);
+					temporalReprojectionDescriptorTable.allocCBVBuffer(sceneRenderCB->buffer->resource, sceneRenderCB->buffer->resource.apiResource->GetDesc().Width);
+					commandList->SetComputeRootDescriptorTable(0, temporalReprojectionDescriptorTable.gpuBaseHandle);
+					commandList->Dispatch((uint32_t)(sceneRenderCB->data.resolution.x / 32.0f), (uint32_t)(sceneRenderCB->data.resolution.y / 32.0f) + 1, 1);
+
+					resourceBarrier.transition(historyM1Buffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.transition(historyM2Buffer->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+					resourceBarrier.flush(commandList);
+					pixEndEventOnCommandList(commandList);
+
+					// A-trous filter passes
+					pixBeginEventOnCommandList(commandList, PIX_COLOR_INDEX(pixColorIndex++), "A-Trous Filter Passes");
+					ni::Texture* atrousInputOutput[2] = { resultTemporalReprojection, outputTexture };
+
+					commandList->SetPipelineState(atrousFilter->pso);
+					commandList->SetComputeRootSignature(atrousFilter->rootSignature);
+
+					ni::Texture* input = atrousInputOutput[0];
+					output = atrousInputOutput[1];
+
+# if 1
+					for (uint32_t index = 0; index < 2; ++index)
+					{
+						input = atrousInputOutput[index % 2];
+						output = atrousInputOutput[(index + 1) % 2];
+
+						resourceBarrier.transition(input->resource, D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+						resourceBarrier.transition(output->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+						resourceBarrier.flush(commandList);
+
+						ni::DescriptorTable atrousFilterDescriptorTable = descriptorAllocator->allocateDescriptorTable(7);
+						atrousFilterDescriptorTable.allocSRVTex2D(input->resource, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 1, 0, 0.0f);
+						atrousFilterDescriptorTable.allocSRVTex2D(normalBuffer->resource, DXGI_FORMAT_R16G16_SNORM, 0, 1, 0, 0.0f);
+						atrousFilterDescriptorTable.allocSRVTex2D(historyM1Buffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
+						atrousFilterDescriptorTable.allocSRVTex2D(historyM2Buffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
+						atrousFilterDescriptorTable.allocSRVTex2D(depthBuffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f);
+						atrousFilterDescriptorTable.allocUAVTex2D(output->resource, nullptr, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 0);
+
+						struct Constant
+						{
+							uint32_t step;
+							ni::Float3 resolution;
+						} constantData = { index + 1, sceneRenderCB->data.resolution };
+
+						commandList->SetComputeRootDescriptorTable(0, atrousFilterDescriptorTable.gpuBaseHandle);
+						commandList->SetComputeRoot32BitConstants(1, ni::calcNumUint32FromSize(sizeof(Constant)), &constantData, 0);
+						commandList->Dispatch((uint32_t)(sceneRenderCB->data.resolution.x / 32.0f), (uint32_t)(sceneRenderCB->data.resolution.y / 32.0f) + 1, 1);
+					}
 #else
-				output = resultTemporalReprojection;
+					output = resultTemporalReprojection;
 #endif
 
-				pixEndEventOnCommandList(commandList);
+					pixEndEventOnCommandList(commandList);
+				}
 
-				pixBeginEventOnCommandList(commandList, PIX_COLOR_INDEX(pixColorIndex++), "Copy Next Frame Resources");
-				resourceBarrier.transition(historyBuffer->resource, D3D12_RESOURCE_STATE_COPY_DEST);
-				resourceBarrier.transition(resultTemporalReprojection->resource, D3D12_RESOURCE_STATE_COPY_SOURCE);
-				resourceBarrier.flush(commandList);
-				commandList->CopyResource(historyBuffer->resource.apiResource, resultTemporalReprojection->resource.apiResource);
+				// What this frame wrote is the next one's history. A chain only rotates on
+				// the frames that write it, so its previous texture stays the last one written.
+				if (renderFrame)
+				{
+					idHistory.rotate();
+					normalHistory.rotate();
+					depthHistory.rotate();
+				}
+				if (denoise)
+				{
+					historyM1.rotate();
+					historyM2.rotate();
+					colorHistory.rotate();
+				}
 
+				// The depth the base pass wrote last, this frame's or, once converged, the
+				// one from the last frame it ran.
+				ni::Texture* lastDepthBuffer = depthHistory.getPrevious();
+				pixBeginEventOnCommandList(commandList, PIX_COLOR_INDEX(pixColorIndex++), "Depth of Field");
 				resourceBarrier.transition(particleBuffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-				resourceBarrier.transition(output->resource, D3D12_RESOURCE_STATE_COPY_SOURCE);
-				resourceBarrier.transition(positionBuffer->resource, D3D12_RESOURCE_STATE_COPY_SOURCE);
-				resourceBarrier.transition(normalBuffer->resource, D3D12_RESOURCE_STATE_COPY_SOURCE);
-				resourceBarrier.transition(historyM1Buffer->resource, D3D12_RESOURCE_STATE_COPY_SOURCE);
-				resourceBarrier.transition(historyM2Buffer->resource, D3D12_RESOURCE_STATE_COPY_SOURCE);
-				resourceBarrier.transition(prevPositionBuffer->resource, D3D12_RESOURCE_STATE_COPY_DEST);
-				resourceBarrier.transition(prevNormalBuffer->resource, D3D12_RESOURCE_STATE_COPY_DEST);
-				resourceBarrier.transition(prevHistoryM1Buffer->resource, D3D12_RESOURCE_STATE_COPY_DEST);
-				resourceBarrier.transition(prevHistoryM2Buffer->resource, D3D12_RESOURCE_STATE_COPY_DEST);
-				resourceBarrier.transition(depthBuffer->resource, D3D12_RESOURCE_STATE_COPY_SOURCE);
-				resourceBarrier.transition(prevDepthBuffer->resource, D3D12_RESOURCE_STATE_COPY_DEST);
+				resourceBarrier.transition(output->resource, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+				resourceBarrier.transition(lastDepthBuffer->resource, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 				resourceBarrier.flush(commandList);
-
-				commandList->CopyResource(prevPositionBuffer->resource.apiResource, positionBuffer->resource.apiResource);
-				commandList->CopyResource(prevNormalBuffer->resource.apiResource, normalBuffer->resource.apiResource);
-				commandList->CopyResource(prevHistoryM1Buffer->resource.apiResource, historyM1Buffer->resource.apiResource);
-				commandList->CopyResource(prevHistoryM2Buffer->resource.apiResource, historyM2Buffer->resource.apiResource);
-				commandList->CopyResource(prevDepthBuffer->resource.apiResource, depthBuffer->resource.apiResource);
-				pixEndEventOnCommandList(commandList);
-
-				pixBeginEventOnCommandList(commandList, PIX_COLOR_INDEX(pixColorIndex++), "Depth of Field");
 				ni::Array<ResourceDesc> depthOfFieldPassParams;
-				depthOfFieldPassParams.add(ResourceDesc::srvTex2D(depthBuffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f));
-				depthOfFieldPassParams.add(ResourceDesc::srvTex2D(output->resource, DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 1, 0, 0.0f));
+				depthOfFieldPassParams.add(ResourceDesc::srvTex2D(lastDepthBuffer->resource, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, 0.0f));
+				depthOfFieldPassParams.add(ResourceDesc::srvTex2D(output->resource, output == accumulationBuffer ? DXGI_FORMAT_R32G32B32A32_FLOAT : DXGI_FORMAT_R16G16B16A16_FLOAT, 0, 1, 0, 0.0f));
 				depthOfFieldPassParams.add(ResourceDesc::cbvBuffer(depthOfFieldCB->buffer->resource, depthOfFieldCB->buffer->resource.apiResource->GetDesc().Width));
 				depthOfFieldPass->draw(RENDER_WIDTH, RENDER_HEIGHT, commandList, rtvDescriptorTable.cpuBaseHandle, descriptorAllocator, depthOfFieldPassParams);
-				resourceBarrier.transition(positionBuffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-				resourceBarrier.transition(normalBuffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-				resourceBarrier.transition(prevPositionBuffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-				resourceBarrier.transition(prevNormalBuffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-				resourceBarrier.transition(depthBuffer->resource, D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
 				resourceBarrier.transition(finalBuffer->resource, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
 				resourceBarrier.transition(ni::getCurrentBackbuffer()->resource, D3D12_RESOURCE_STATE_RENDER_TARGET);
 				resourceBarrier.flush(commandList);
@@ -460,8 +563,11 @@ int main()
 				sceneRenderCB->data.prevCameraPos = sceneRenderCB->data.cameraPos;
 				sceneRenderCB->data.prevInvViewProjMtx = sceneRenderCB->data.invViewProjMtx;
 				sceneRenderCB->data.prevViewProjMtx = sceneRenderCB->data.viewProjMtx;
-				simulationCB->data.time += 0.016f;
-				simulationCB->data.frame++;
+				if (!simulationPaused)
+				{
+					simulationCB->data.time += 0.016f;
+					simulationCB->data.frame++;
+				}
 			}
 
 			editor->render(commandList, descriptorAllocator, resourceBarrier);
@@ -496,20 +602,19 @@ int main()
 	delete audioRenderer;
 	delete editor;
 
+	ni::destroyPipelineState(accumulate);
+	ni::destroyTexture(accumulationBuffer);
 	ni::destroyPipelineState(atrousFilter);
 	ni::destroyPipelineState(temporalReprojection);
-	ni::destroyTexture(depthBuffer);
-	ni::destroyTexture(prevDepthBuffer);
-	ni::destroyTexture(historyM1Buffer);
-	ni::destroyTexture(historyM2Buffer);
-	ni::destroyTexture(prevHistoryM1Buffer);
-	ni::destroyTexture(prevHistoryM2Buffer);
-	ni::destroyTexture(prevPositionBuffer);
-	ni::destroyTexture(prevNormalBuffer);
-	ni::destroyTexture(positionBuffer);
-	ni::destroyTexture(normalBuffer);
-	ni::destroyTexture(resultTemporalReprojection);
-	ni::destroyTexture(historyBuffer);
+	for (uint32_t index = 0; index < idHistory.getFrameNum(); ++index)
+	{
+		ni::destroyTexture(idHistory.getTexture(index));
+		ni::destroyTexture(normalHistory.getTexture(index));
+		ni::destroyTexture(depthHistory.getTexture(index));
+		ni::destroyTexture(historyM1.getTexture(index));
+		ni::destroyTexture(historyM2.getTexture(index));
+		ni::destroyTexture(colorHistory.getTexture(index));
+	}
 	ni::destroyDescriptorAllocator(rtvDescriptorAllocator);
 	ni::destroyTexture(outputTexture);
 	ni::destroyTexture(velocityBuffer);
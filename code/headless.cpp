@@ -0,0 +1,13 @@
+// Benchmark-only entry point without D3D12 or Windows, for machines without a GPU:
+//   g++ -std=c++20 -O2 -march=native -ffp-contract=off -pthread code/headless.cpp code/nicore.cpp -o fp2025-bench
+// Same arguments as `fp2025.exe -bench`, returns nonzero when a check failed.
+// -ffp-contract=off keeps GCC and Clang from fusing a * b + c into an FMA on
+// FMA capable targets. Fused and unfused code round differently, and the SIMD
+// kernels are checked bit for bit against the scalar shader code.
+
+#include "benchmarks.h"
+
+int main(int argc, char** argv)
+{
+	return ni::runBenchmarks(argc - 1, argv + 1);
+}
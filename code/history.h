@@ -0,0 +1,49 @@
+#pragma once
+
+// Frame history without copies. The temporal passes read last frame's particle
+// ids, normals, depth, M1/M2 and color next to this frame's. Instead of copying
+// every channel into a second texture at the end of the frame, a HistoryChain
+// owns frameNum textures of one channel and rotate() makes the current one the
+// previous one by index, so only the descriptors change. T is whatever the
+// textures are, ni::Texture in fp2025.cpp and CpuTexture2D in bench::history.
+// Resource states stay with the textures, so the barriers the passes issue on
+// getCurrent() and getPrevious() are tracked as before.
+
+#include "nicore.h"
+
+namespace ni {
+
+	template<typename T, uint32_t frameNum = 2>
+	struct HistoryChain
+	{
+		static_assert(frameNum >= 2, "A history needs a previous frame");
+
+		void set(uint32_t index, T* texture)
+		{
+			NI_ASSERT(index < frameNum, "History texture out of range");
+			textures[index] = texture;
+		}
+
+		// age 0 is the frame being written, 1 the last one and so on.
+		T* get(uint32_t age) const
+		{
+			NI_ASSERT(age < frameNum, "History doesn't go back that far");
+			return textures[(current + frameNum - age) % frameNum];
+		}
+
+		T* getCurrent() const { return get(0); }
+		T* getPrevious() const { return get(1); }
+
+		// The frame was written, the next one writes over the oldest texture.
+		void rotate() { current = (current + 1) % frameNum; }
+
+		// By slot, not by age, to create and destroy them.
+		T* getTexture(uint32_t index) const { return textures[index]; }
+		static constexpr uint32_t getFrameNum() { return frameNum; }
+
+	private:
+		T* textures[frameNum] = {};
+		uint32_t current = 0;
+	};
+
+}
@@ -0,0 +1,313 @@
+#pragma once
+
+// HLSL emulation on top of the ni math types. Including this lets shader code that
+// only uses the subset below (vector types, swizzles, intrinsics, mul) compile as
+// C++, so CPU reference paths can share helpers with the GPU instead of carrying a
+// hand ported copy. See shaders/HLSLCompat.h for the keyword side (inout, out,
+// [unroll]) and code/shaderport.h for how the shader files are pulled in.
+//
+// Vectors keep the scalar ni::Float2/3/4 storage. float3 has to stay 12 bytes so
+// that structs like ParticleData keep matching the StructuredBuffer layout on the
+// GPU, so SIMD is used inside the heavier operations (mul, dot on float4) instead.
+
+#include "nicore.h"
+
+#if NI_SIMD_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace ni {
+
+	struct Int2
+	{
+		int32_t x, y;
+
+		Int2() : x(0), y(0) {}
+		Int2(int32_t x) : x(x), y(x) {}
+		Int2(int32_t x, int32_t y) : x(x), y(y) {}
+		explicit Int2(const Float2& n) : x((int32_t)n.x), y((int32_t)n.y) {}
+		explicit operator Float2() const { return Float2((float)x, (float)y); }
+		bool operator==(const Int2& n) const { return x == n.x && y == n.y; }
+		bool operator!=(const Int2& n) const { return x != n.x || y != n.y; }
+	};
+
+	struct UInt2
+	{
+		uint32_t x, y;
+
+		UInt2() : x(0), y(0) {}
+		UInt2(uint32_t x) : x(x), y(x) {}
+		UInt2(uint32_t x, uint32_t y) : x(x), y(y) {}
+		explicit UInt2(const Int2& n) : x((uint32_t)n.x), y((uint32_t)n.y) {}
+		explicit operator Int2() const { return Int2((int32_t)x, (int32_t)y); }
+		explicit operator Float2() const { return Float2((float)x, (float)y); }
+		bool operator==(const UInt2& n) const { return x == n.x && y == n.y; }
+		bool operator!=(const UInt2& n) const { return x != n.x || y != n.y; }
+	};
+
+	struct UInt3
+	{
+		uint32_t x, y, z;
+
+		UInt3() : x(0), y(0), z(0) {}
+		UInt3(uint32_t x) : x(x), y(x), z(x) {}
+		UInt3(uint32_t x, uint32_t y, uint32_t z) : x(x), y(y), z(z) {}
+		UInt2 xy() const { return UInt2(x, y); }
+		bool operator==(const UInt3& n) const { return x == n.x && y == n.y && z == n.z; }
+	};
+
+	// Scalar intrinsics that ni doesn't already have. The existing ni::sign keeps
+	// returning 1 for zero, so shader code that depends on sign(0) == 0 should not
+	// go through this layer.
+	inline float frac(float x) { return x - floorf(x); }
+	inline float rsqrt(float x) { return 1.0f / sqrtf(x); }
+	inline float rcp(float x) { return 1.0f / x; }
+	inline float trunc(float x) { return truncf(x); }
+	inline float fmod(float x, float y) { return fmodf(x, y); }
+	inline float lerp(float a, float b, float t) { return a + (b - a) * t; }
+	inline float smoothstep(float a, float b, float x) { float t = saturate((x - a) / (b - a)); return t * t * (3.0f - 2.0f * t); }
+	inline float radians(float d) { return toRad(d); }
+	inline float degrees(float r) { return toDeg(r); }
+	inline float mad(float a, float b, float c) { return a * b + c; }
+	inline float min(float a, float b) { return a < b ? a : b; }
+	inline float max(float a, float b) { return a > b ? a : b; }
+	inline float dot(float a, float b) { return a * b; }
+	inline float length(float x) { return fabsf(x); }
+	inline uint32_t asuint(float x) { uint32_t u; memcpy(&u, &x, sizeof(u)); return u; }
+	inline float asfloat(uint32_t u) { float x; memcpy(&x, &u, sizeof(x)); return x; }
+	// Half floats in the low 16 bits, rounded to nearest even; NaN stays NaN and
+	// anything past the half range becomes infinity.
+	inline uint32_t f32tof16(float x)
+	{
+		uint32_t u = asuint(x);
+		uint32_t sign = (u >> 16) & 0x8000u;
+		u &= 0x7fffffffu;
+		if (u >= 0x47800000u) return sign | (u > 0x7f800000u ? 0x7e00u : 0x7c00u);
+		// Subnormal halves: adding 0.5 lines the mantissa up with the half's.
+		if (u < 0x38800000u) return sign | (asuint(asfloat(u) + 0.5f) - 0x3f000000u);
+		u += 0xc8000fffu + ((u >> 13) & 1u);
+		return sign | (u >> 13);
+	}
+	inline float f16tof32(uint32_t h)
+	{
+		uint32_t u = (h & 0x7fffu) << 13;
+		uint32_t exponent = u & 0x0f800000u;
+		u += 0x38000000u;
+		if (exponent == 0x0f800000u) u += 0x38000000u;
+		else if (exponent == 0) u = asuint(asfloat(u + 0x00800000u) - asfloat(0x38800000u));
+		return asfloat(u | ((h & 0x8000u) << 16));
+	}
+	inline uint32_t reversebits(uint32_t x)
+	{
+		x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+		x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+		x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+		x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+		return (x >> 16) | (x << 16);
+	}
+	inline int32_t clamp(int32_t n, int32_t x, int32_t y) { return (n < x ? x : n > y ? y : n); }
+	inline uint32_t clamp(uint32_t n, uint32_t x, uint32_t y) { return (n < x ? x : n > y ? y : n); }
+
+	// Component-wise versions of the scalar intrinsics.
+#define NI_HLSL_UNARY(name) \
+	inline Float2 name(const Float2& v) { return Float2(name(v.x), name(v.y)); } \
+	inline Float3 name(const Float3& v) { return Float3(name(v.x), name(v.y), name(v.z)); } \
+	inline Float4 name(const Float4& v) { return Float4(name(v.x), name(v.y), name(v.z), name(v.w)); }
+#define NI_HLSL_BINARY(name) \
+	inline Float2 name(const Float2& a, const Float2& b) { return Float2(name(a.x, b.x), name(a.y, b.y)); } \
+	inline Float3 name(const Float3& a, const Float3& b) { return Float3(name(a.x, b.x), name(a.y, b.y), name(a.z, b.z)); } \
+	inline Float4 name(const Float4& a, const Float4& b) { return Float4(name(a.x, b.x), name(a.y, b.y), name(a.z, b.z), name(a.w, b.w)); }
+
+	NI_HLSL_UNARY(abs)
+	NI_HLSL_UNARY(floor)
+	NI_HLSL_UNARY(ceil)
+	NI_HLSL_UNARY(round)
+	NI_HLSL_UNARY(trunc)
+	NI_HLSL_UNARY(frac)
+	NI_HLSL_UNARY(sqrt)
+	NI_HLSL_UNARY(rsqrt)
+	NI_HLSL_UNARY(rcp)
+	NI_HLSL_UNARY(sin)
+	NI_HLSL_UNARY(cos)
+	NI_HLSL_UNARY(tan)
+	NI_HLSL_UNARY(asin)
+	NI_HLSL_UNARY(acos)
+	NI_HLSL_UNARY(atan)
+	NI_HLSL_UNARY(exp)
+	NI_HLSL_UNARY(exp2)
+	NI_HLSL_UNARY(log)
+	NI_HLSL_UNARY(log2)
+	NI_HLSL_UNARY(saturate)
+	NI_HLSL_BINARY(min)
+	NI_HLSL_BINARY(max)
+	NI_HLSL_BINARY(pow)
+	NI_HLSL_BINARY(fmod)
+	NI_HLSL_BINARY(step)
+	NI_HLSL_BINARY(atan2)
+
+#undef NI_HLSL_UNARY
+#undef NI_HLSL_BINARY
+
+	inline Float2 clamp(const Float2& v, const Float2& a, const Float2& b) { return min(max(v, a), b); }
+	inline Float3 clamp(const Float3& v, const Float3& a, const Float3& b) { return min(max(v, a), b); }
+	inline Float4 clamp(const Float4& v, const Float4& a, const Float4& b) { return min(max(v, a), b); }
+	inline Int2 clamp(const Int2& v, const Int2& a, const Int2& b) { return Int2(clamp(v.x, a.x, b.x), clamp(v.y, a.y, b.y)); }
+
+	inline Float2 lerp(const Float2& a, const Float2& b, float t) { return a + (b - a) * t; }
+	inline Float3 lerp(const Float3& a, const Float3& b, float t) { return a + (b - a) * t; }
+	inline Float4 lerp(const Float4& a, const Float4& b, float t) { return a + (b - a) * t; }
+	inline Float3 lerp(const Float3& a, const Float3& b, const Float3& t) { return a + (b - a) * t; }
+	inline Float4 lerp(const Float4& a, const Float4& b, const Float4& t) { return a + (b - a) * t; }
+	inline Float3 smoothstep(const Float3& a, const Float3& b, const Float3& x)
+	{
+		return Float3(smoothstep(a.x, b.x, x.x), smoothstep(a.y, b.y, x.y), smoothstep(a.z, b.z, x.z));
+	}
+
+	inline float dot(const Float2& a, const Float2& b) { return a.x * b.x + a.y * b.y; }
+	inline float dot(const Float3& a, const Float3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	inline float dot(const Float4& a, const Float4& b)
+	{
+#if NI_SIMD_SSE
+		__m128 m = _mm_mul_ps(_mm_loadu_ps(a.components), _mm_loadu_ps(b.components));
+		m = _mm_add_ps(m, _mm_movehl_ps(m, m));
+		m = _mm_add_ss(m, _mm_shuffle_ps(m, m, 1));
+		return _mm_cvtss_f32(m);
+#else
+		return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+#endif
+	}
+
+	inline float length(const Float2& v) { return sqrtf(dot(v, v)); }
+	inline float length(const Float3& v) { return sqrtf(dot(v, v)); }
+	inline float length(const Float4& v) { return sqrtf(dot(v, v)); }
+	inline float distance(const Float2& a, const Float2& b) { return length(a - b); }
+	inline float distance(const Float3& a, const Float3& b) { return length(a - b); }
+	inline float distance(const Float4& a, const Float4& b) { return length(a - b); }
+
+	// Same as HLSL, a zero length vector produces NaNs.
+	inline Float2 normalize(const Float2& v) { return v * rsqrt(dot(v, v)); }
+	inline Float3 normalize(const Float3& v) { return v * rsqrt(dot(v, v)); }
+	inline Float4 normalize(const Float4& v) { return v * rsqrt(dot(v, v)); }
+
+	inline Float3 cross(const Float3& a, const Float3& b)
+	{
+		return Float3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+	}
+
+	inline Float3 reflect(const Float3& i, const Float3& n) { return i - 2.0f * dot(n, i) * n; }
+
+	inline Float3 refract(const Float3& i, const Float3& n, float eta)
+	{
+		float cosi = dot(n, i);
+		float k = 1.0f - eta * eta * (1.0f - cosi * cosi);
+		if (k < 0.0f) return Float3(0.0f);
+		return eta * i - (eta * cosi + sqrtf(k)) * n;
+	}
+
+	inline Float3 faceforward(const Float3& n, const Float3& i, const Float3& ng) { return dot(ng, i) < 0.0f ? n : -n; }
+
+	inline bool any(const Float2& v) { return v.x != 0.0f || v.y != 0.0f; }
+	inline bool any(const Float3& v) { return v.x != 0.0f || v.y != 0.0f || v.z != 0.0f; }
+	inline bool any(const Float4& v) { return v.x != 0.0f || v.y != 0.0f || v.z != 0.0f || v.w != 0.0f; }
+	inline bool all(const Float2& v) { return v.x != 0.0f && v.y != 0.0f; }
+	inline bool all(const Float3& v) { return v.x != 0.0f && v.y != 0.0f && v.z != 0.0f; }
+	inline bool all(const Float4& v) { return v.x != 0.0f && v.y != 0.0f && v.z != 0.0f && v.w != 0.0f; }
+
+	// mul() follows HLSL: the matrix is indexed [row][column] on its logical rows,
+	// mul(m, v) treats v as a column vector and mul(v, m) as a row vector.
+	inline Float3 mul(const Float3x3& m, const Float3& v)
+	{
+		return Float3(dot(m.rows[0], v), dot(m.rows[1], v), dot(m.rows[2], v));
+	}
+
+	inline Float3 mul(const Float3& v, const Float3x3& m)
+	{
+		return v.x * m.rows[0] + v.y * m.rows[1] + v.z * m.rows[2];
+	}
+
+	inline Float4 mul(const Float4& v, const Float4x4& m)
+	{
+#if NI_SIMD_SSE
+		__m128 r = _mm_mul_ps(_mm_set1_ps(v.x), _mm_loadu_ps(&m.data[0]));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v.y), _mm_loadu_ps(&m.data[4])));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v.z), _mm_loadu_ps(&m.data[8])));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v.w), _mm_loadu_ps(&m.data[12])));
+		Float4 result;
+		_mm_storeu_ps(result.components, r);
+		return result;
+#else
+		return v.x * m.rows[0] + v.y * m.rows[1] + v.z * m.rows[2] + v.w * m.rows[3];
+#endif
+	}
+
+	inline Float4 mul(const Float4x4& m, const Float4& v)
+	{
+#if NI_SIMD_SSE
+		__m128 r0 = _mm_loadu_ps(&m.data[0]);
+		__m128 r1 = _mm_loadu_ps(&m.data[4]);
+		__m128 r2 = _mm_loadu_ps(&m.data[8]);
+		__m128 r3 = _mm_loadu_ps(&m.data[12]);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		__m128 r = _mm_mul_ps(_mm_set1_ps(v.x), r0);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v.y), r1));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v.z), r2));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v.w), r3));
+		Float4 result;
+		_mm_storeu_ps(result.components, r);
+		return result;
+#else
+		return Float4(dot(m.rows[0], v), dot(m.rows[1], v), dot(m.rows[2], v), dot(m.rows[3], v));
+#endif
+	}
+
+	inline Float4x4 mul(const Float4x4& a, const Float4x4& b)
+	{
+		Float4x4 result;
+		for (uint32_t row = 0; row < 4; ++row)
+		{
+			result.rows[row] = mul(a.rows[row], b);
+		}
+		return result;
+	}
+
+	inline Float3x3 transpose(const Float3x3& m)
+	{
+		Float3x3 result = m;
+		result.transpose();
+		return result;
+	}
+
+	inline Float4x4 transpose(const Float4x4& m)
+	{
+		Float4x4 result = m;
+		result.transpose();
+		return result;
+	}
+
+	// ni matrices are uploaded as-is into constant buffers, which HLSL reads with the
+	// default column_major packing. A shader therefore sees the transpose of the CPU
+	// matrix. Use this when binding a matrix for CPU shader code so mul() gives the
+	// same result the GPU does.
+	inline Float4x4 columnMajor(const Float4x4& m) { return transpose(m); }
+
+}
+
+// Global arithmetic for the integer vectors, the same place the Float operators live.
+inline ni::Int2 operator+(const ni::Int2& a, const ni::Int2& b) { return ni::Int2(a.x + b.x, a.y + b.y); }
+inline ni::Int2 operator-(const ni::Int2& a, const ni::Int2& b) { return ni::Int2(a.x - b.x, a.y - b.y); }
+inline ni::Int2 operator*(const ni::Int2& a, const ni::Int2& b) { return ni::Int2(a.x * b.x, a.y * b.y); }
+inline ni::Int2 operator*(const ni::Int2& a, int32_t b) { return ni::Int2(a.x * b, a.y * b); }
+inline ni::UInt2 operator+(const ni::UInt2& a, const ni::UInt2& b) { return ni::UInt2(a.x + b.x, a.y + b.y); }
+inline ni::UInt2 operator*(const ni::UInt2& a, const ni::UInt2& b) { return ni::UInt2(a.x * b.x, a.y * b.y); }
+
+// HLSL type names. ParticleConfig.h declares a few of these as well when IS_CPU is
+// set, the typedefs are identical so both can be included in any order.
+typedef ni::Float2 float2;
+typedef ni::Float3 float3;
+typedef ni::Float4 float4;
+typedef ni::Float3x3 float3x3;
+typedef ni::Float4x4 float4x4;
+typedef ni::Int2 int2;
+typedef ni::UInt2 uint2;
+typedef ni::UInt3 uint3;
+typedef uint32_t uint;
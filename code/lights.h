@@ -0,0 +1,65 @@
+#pragma once
+
+// Light list for next event estimation (shaders/Light.hlsli). Rebuilt every frame
+// from the visible emissive particles, which move and can be switched on and off by
+// the scene. Lights are picked by getLightPower(), so a sphere is picked in
+// proportion to its area times its emission, through the cdf in LightData.
+
+#include "shaderport.h"
+
+namespace ni {
+
+	struct LightStats
+	{
+		double seconds = 0.0;
+		uint32_t lightNum = 0;
+	};
+
+	struct ParticleLightList
+	{
+		LightStats build(const ParticleData* particles, uint32_t particleNum)
+		{
+			double start = getSeconds();
+			lights.reset();
+			powerSum = 0.0f;
+			for (uint32_t index = 0; index < particleNum; ++index)
+			{
+				const ParticleData& particle = particles[index];
+				if (!particle.visible || particle.primitive != PARTICLE_PRIMITIVE_SPHERE || particle.material.emissive <= 0.0f) continue;
+				float power = shader::getLightPower(particle);
+				if (!(power > 0.0f)) continue;
+				LightData light = {};
+				light.particle = index;
+				light.pdf = power;
+				lights.add(light);
+				powerSum += power;
+			}
+
+			// Same division the shader does for a light it hits, so both sides agree on
+			// the pdf bit for bit.
+			float cdf = 0.0f;
+			for (uint32_t index = 0; index < lights.getNum(); ++index)
+			{
+				LightData& light = lights[index];
+				light.pdf = light.pdf / powerSum;
+				cdf += light.pdf;
+				light.cdf = cdf;
+			}
+			if (lights.getNum() > 0) lights[lights.getNum() - 1].cdf = 1.0f;
+
+			LightStats stats = {};
+			stats.seconds = getSeconds() - start;
+			stats.lightNum = lights.getNum();
+			return stats;
+		}
+
+		const LightData* getLights() const { return lights.getData(); }
+		uint32_t getLightNum() const { return lights.getNum(); }
+		float getPowerSum() const { return powerSum; }
+
+	private:
+		Array<LightData> lights;
+		float powerSum = 0.0f;
+	};
+
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+// Morton (Z-order) reordering of the particle buffer. Particles are created in pid
+// order, which scatters spatial neighbours over the whole buffer, and every
+// collision loop and trace() then jumps all over memory. Sorting by the Morton code
+// of the position puts particles that are close in space close in memory.
+//
+// ParticleData::id moves along with the particle, so everything keyed on it (the
+// scene code, getMaterial, the id test in TemporalReprojectionCS) keeps working.
+// getIndexOfId() maps an id back to its current buffer index.
+
+#include "shaderport.h"
+
+#include <float.h>
+
+namespace ni {
+
+	// Spreads the low 10 bits of value out to every third bit.
+	inline uint32_t expandBits10(uint32_t value)
+	{
+		value &= 0x3ff;
+		value = (value | (value << 16)) & 0x030000ff;
+		value = (value | (value << 8)) & 0x0300f00f;
+		value = (value | (value << 4)) & 0x030c30c3;
+		value = (value | (value << 2)) & 0x09249249;
+		return value;
+	}
+
+	// Spreads the low 21 bits of value out to every third bit.
+	inline uint64_t expandBits21(uint64_t value)
+	{
+		value &= 0x1fffff;
+		value = (value | (value << 32)) & 0x001f00000000ffffull;
+		value = (value | (value << 16)) & 0x001f0000ff0000ffull;
+		value = (value | (value << 8)) & 0x100f00f00f00f00full;
+		value = (value | (value << 4)) & 0x10c30c30c30c30c3ull;
+		value = (value | (value << 2)) & 0x1249249249249249ull;
+		return value;
+	}
+
+	// Codes for a position normalized to [0, 1], values outside are clamped.
+	inline uint32_t mortonCode30(const Float3& normalized)
+	{
+		uint32_t x = (uint32_t)clamp(normalized.x * 1024.0f, 0.0f, 1023.0f);
+		uint32_t y = (uint32_t)clamp(normalized.y * 1024.0f, 0.0f, 1023.0f);
+		uint32_t z = (uint32_t)clamp(normalized.z * 1024.0f, 0.0f, 1023.0f);
+		return (expandBits10(x) << 2) | (expandBits10(y) << 1) | expandBits10(z);
+	}
+
+	inline uint64_t mortonCode63(const Float3& normalized)
+	{
+		uint64_t x = (uint64_t)clamp(normalized.x * 2097152.0f, 0.0f, 2097151.0f);
+		uint64_t y = (uint64_t)clamp(normalized.y * 2097152.0f, 0.0f, 2097151.0f);
+		uint64_t z = (uint64_t)clamp(normalized.z * 2097152.0f, 0.0f, 2097151.0f);
+		return (expandBits21(x) << 2) | (expandBits21(y) << 1) | expandBits21(z);
+	}
+
+	// Parallel LSD radix sort of 64 bit keys with a 32 bit payload, 8 bits per pass.
+	// Work is split into fixed size blocks, each block counts its digits and then
+	// scatters in order, so the sort is stable and the result does not depend on
+	// the number of workers.
+	struct RadixSorter
+	{
+		static constexpr uint32_t blockSize = 16384;
+
+		// Only the low keyBits of the keys are sorted on. Passes in which every key has
+		// the same digit are skipped.
+		void sort(WorkerPool& pool, uint64_t* keys, uint32_t* values, uint32_t num, uint32_t keyBits)
+		{
+			if (num < 2) return;
+			resizeScratch(num);
+			uint32_t blockNum = (num + blockSize - 1) / blockSize;
+			histograms.reset();
+			histograms.fill((uint64_t)blockNum * 256, 0);
+
+			uint64_t* sourceKeys = keys;
+			uint32_t* sourceValues = values;
+			uint64_t* targetKeys = keyScratch.getData();
+			uint32_t* targetValues = valueScratch.getData();
+			for (uint32_t shift = 0; shift < keyBits; shift += 8)
+			{
+				pool.parallelFor(blockNum, [&](uint64_t block, uint32_t)
+				{
+					uint32_t histogram[256] = {};
+					const uint64_t* blockKeys = sourceKeys;
+					uint32_t end = min((uint32_t)block * blockSize + blockSize, num);
+					for (uint32_t index = (uint32_t)block * blockSize; index < end; ++index)
+					{
+						histogram[(blockKeys[index] >> shift) & 0xff]++;
+					}
+					memcpy(&histograms[block * 256], histogram, sizeof(histogram));
+				});
+
+				// Turn the counts into write offsets, digit major so equal digits keep
+				// their block order.
+				uint32_t offset = 0;
+				bool isSorted = false;
+				for (uint32_t digit = 0; digit < 256; ++digit)
+				{
+					uint32_t digitStart = offset;
+					for (uint32_t block = 0; block < blockNum; ++block)
+					{
+						uint32_t count = histograms[block * 256 + digit];
+						histograms[block * 256 + digit] = offset;
+						offset += count;
+					}
+					isSorted |= offset - digitStart == num;
+				}
+				if (isSorted) continue;
+
+				pool.parallelFor(blockNum, [&](uint64_t block, uint32_t)
+				{
+					uint32_t cursor[256];
+					memcpy(cursor, &histograms[block * 256], sizeof(cursor));
+					const uint64_t* blockKeys = sourceKeys;
+					const uint32_t* blockValues = sourceValues;
+					uint64_t* outKeys = targetKeys;
+					uint32_t* outValues = targetValues;
+					uint32_t end = min((uint32_t)block * blockSize + blockSize, num);
+					for (uint32_t index = (uint32_t)block * blockSize; index < end; ++index)
+					{
+						uint64_t key = blockKeys[index];
+						uint32_t target = cursor[(key >> shift) & 0xff]++;
+						outKeys[target] = key;
+						outValues[target] = blockValues[index];
+					}
+				});
+				std::swap(sourceKeys, targetKeys);
+				std::swap(sourceValues, targetValues);
+			}
+
+			if (sourceKeys != keys)
+			{
+				pool.parallelFor(blockNum, [&](uint64_t block, uint32_t)
+				{
+					uint32_t end = min((uint32_t)block * blockSize + blockSize, num);
+					for (uint32_t index = (uint32_t)block * blockSize; index < end; ++index)
+					{
+						keys[index] = sourceKeys[index];
+						values[index] = sourceValues[index];
+					}
+				});
+			}
+		}
+
+	private:
+		void resizeScratch(uint32_t num)
+		{
+			if (keyScratch.getNum() >= num) return;
+			keyScratch.reset();
+			keyScratch.fill(num, 0);
+			valueScratch.reset();
+			valueScratch.fill(num, 0);
+		}
+
+		Array<uint64_t> keyScratch;
+		Array<uint32_t> valueScratch;
+		Array<uint32_t> histograms;
+	};
+
+	struct ReorderStats
+	{
+		double codeSeconds = 0.0;
+		double sortSeconds = 0.0;
+		double moveSeconds = 0.0;
+	};
+
+	struct MortonReorder
+	{
+		// 30 bit codes give 1024 cells per axis and sort in 4 passes, 63 bit codes
+		// give 2M cells per axis and take 8.
+		bool use63BitCodes = false;
+		// Spheres above this (the scene 0 walls) would squash everything else into a
+		// few cells. They get code 0 and stay in front in their current order.
+		float largeRadius = 64.0f;
+
+		ReorderStats reorder(WorkerPool& pool, ParticleData* particles, uint32_t num)
+		{
+			ReorderStats stats = {};
+			if (num == 0) return stats;
+			double start = getSeconds();
+			if (keys.getNum() != num)
+			{
+				keys.reset();
+				keys.fill(num, 0);
+				order.reset();
+				order.fill(num, 0);
+			}
+			for (uint32_t index = 0; index < num; ++index)
+			{
+				keys[index] = 0;
+				order[index] = index;
+			}
+
+			Float3 boundsMin = Float3(FLT_MAX, FLT_MAX, FLT_MAX);
+			Float3 boundsMax = Float3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			for (uint32_t index = 0; index < num; ++index)
+			{
+				if (particles[index].radius > largeRadius) continue;
+				boundsMin = min(boundsMin, particles[index].position);
+				boundsMax = max(boundsMax, particles[index].position);
+			}
+			Float3 extent = max(boundsMax - boundsMin, Float3(1e-6f, 1e-6f, 1e-6f));
+			Float3 invExtent = Float3(1.0f / extent.x, 1.0f / extent.y, 1.0f / extent.z);
+
+			uint32_t blockNum = (num + RadixSorter::blockSize - 1) / RadixSorter::blockSize;
+			pool.parallelFor(blockNum, [&](uint64_t block, uint32_t)
+			{
+				uint32_t end = min((uint32_t)block * RadixSorter::blockSize + RadixSorter::blockSize, num);
+				for (uint32_t index = (uint32_t)block * RadixSorter::blockSize; index < end; ++index)
+				{
+					const ParticleData& particle = particles[index];
+					if (particle.radius > largeRadius) continue;
+					Float3 normalized = (particle.position - boundsMin) * invExtent;
+					// + 1 keeps code 0 for the large spheres.
+					keys[index] = (use63BitCodes ? mortonCode63(normalized) : mortonCode30(normalized)) + 1;
+				}
+			});
+			stats.codeSeconds = getSeconds() - start;
+
+			start = getSeconds();
+			sorter.sort(pool, keys.getData(), order.getData(), num, use63BitCodes ? 64 : 32);
+			stats.sortSeconds = getSeconds() - start;
+
+			start = getSeconds();
+			if (scratch.getNum() != num)
+			{
+				scratch.reset();
+				scratch.fill(num, ParticleData{});
+			}
+			pool.parallelFor(blockNum, [&](uint64_t block, uint32_t)
+			{
+				uint32_t end = min((uint32_t)block * RadixSorter::blockSize + RadixSorter::blockSize, num);
+				for (uint32_t index = (uint32_t)block * RadixSorter::blockSize; index < end; ++index)
+				{
+					scratch[index] = particles[order[index]];
+				}
+			});
+			pool.parallelFor(blockNum, [&](uint64_t block, uint32_t)
+			{
+				uint32_t end = min((uint32_t)block * RadixSorter::blockSize + RadixSorter::blockSize, num);
+				for (uint32_t index = (uint32_t)block * RadixSorter::blockSize; index < end; ++index)
+				{
+					particles[index] = scratch[index];
+				}
+			});
+			uint32_t maxId = 0;
+			for (uint32_t index = 0; index < num; ++index)
+			{
+				maxId = max(maxId, particles[index].id);
+			}
+			indexOfId.reset();
+			indexOfId.fill(maxId, UINT32_MAX);
+			for (uint32_t index = 0; index < num; ++index)
+			{
+				if (particles[index].id > 0) indexOfId[particles[index].id - 1] = index;
+			}
+			stats.moveSeconds = getSeconds() - start;
+			return stats;
+		}
+
+		// Buffer index before the last reorder, per buffer index after it.
+		const uint32_t* getOrder() const { return order.getData(); }
+
+		// Current buffer index of the particle with the given ParticleData::id, or
+		// UINT32_MAX when no particle has it.
+		uint32_t getIndexOfId(uint32_t id) const
+		{
+			if (id == 0 || id > indexOfId.getNum()) return UINT32_MAX;
+			return indexOfId[id - 1];
+		}
+
+	private:
+		RadixSorter sorter;
+		Array<uint64_t> keys;
+		Array<uint32_t> order;
+		Array<uint32_t> indexOfId;
+		Array<ParticleData> scratch;
+	};
+
+}
@@ -1,5 +1,9 @@
 #pragma once
 
+// Windows.h min/max macros would hide the HLSL min/max in hlsl.h.
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include <stdint.h>
 #include <d3d12.h>
 #include <dxgi1_6.h>
@@ -7,6 +11,8 @@
 #include <utility>
 #include <new>
 
+#include "nicore.h"
+
 ///////////////////////////////////////////////////////////////
 // CONFIG 
 ///////////////////////////////////////////////////////////////
@@ -17,29 +23,11 @@
 
 ///////////////////////////////////////////////////////////////
 
-#define NI_EXIT(code) { ExitProcess(code); }
-#define NI_DEBUG_BREAK() __debugbreak()
-#define NI_LOG(fmt, ...) ni::logFmt(fmt "\n", ##__VA_ARGS__)
-#define NI_PANIC(fmt, ...) { ni::logFmt("PANIC: " fmt "\n", ##__VA_ARGS__); NI_DEBUG_BREAK(); NI_EXIT(~0); }
-#define NI_ASSERT(x, fmt, ...) if (!(x)) { ni::logFmt("ASSERT: " fmt "\n", ##__VA_ARGS__); NI_DEBUG_BREAK(); }
 #define NI_D3D_ASSERT(x, ...) if ((x) != S_OK) { NI_PANIC(__VA_ARGS__); }
 #define NI_D3D_RELEASE(obj) { if ((obj)) { (obj)->Release(); obj = nullptr; } }
-#define NI_COLOR_UINT(color) (((color) & 0xff) << 24) | ((((color) >> 8) & 0xff) << 16) | ((((color) >> 16) & 0xff) << 8) | ((color) >> 24)
-#define NI_COLOR_RGBA_UINT(r, g, b, a) ((uint32_t)(r)) | ((uint32_t)(g) << 8) | ((uint32_t)(b) << 16) | ((uint32_t)(a) << 24)
-#define NI_COLOR_RGB_UINT(r, g, b) NI_COLOR_RGBA_UINT(r, g, b, 0xff)
-#define NI_COLOR_RGBA_FLOAT(r, g, b, a) NI_COLOR_RGBA_UINT((uint8_t)((r) * 255.0f), (uint8_t)((g) * 255.0f), (uint8_t)((b) * 255.0f), (uint8_t)((a) * 255.0f))
-#define NI_COLOR_RGB_FLOAT(r, g, b) NI_COLOR_RGBA_FLOAT(r, g, b, 1.0f)
-
-#ifdef _DEBUG
-#define NI_DEBUG 1
-#else
-#define NI_DEBUG 0
-#endif
 
 namespace ni {
 
-	void logFmt(const char* fmt, ...);
-
 	enum KeyCode : uint32_t {
 		ALT = 18,
 		DOWN = 40,
@@ -164,224 +152,6 @@ namespace ni {
 		size_t size = 0;
 	};
 
-	template<typename T, typename TSize = uint64_t>
-	struct Array {
-		Array(TSize fillCount, const T& element) : data(nullptr), num(0), capacity(0)
-		{
-			resize(fillCount);
-			fill(fillCount, element);
-		}
-
-		Array() : data(nullptr), num(0), capacity(0) {}
-
-		~Array() {
-			clear();
-		}
-
-		Array(const Array<T, TSize>& copyRef) : data(nullptr), num(0), capacity(0) {
-			if (copyRef.num > 0 && copyRef.data != nullptr) {
-				resize(copyRef.num);
-				copy(data, copyRef.data, copyRef.num);
-				num = copyRef.num;
-			}
-		}
-
-		Array(Array<T, TSize>&& moveRef) noexcept : data(nullptr), num(0), capacity(0) {
-			data = moveRef.data;
-			num = moveRef.num;
-			capacity = moveRef.capacity;
-			moveRef.data = nullptr;
-			moveRef.num = 0;
-			moveRef.capacity = 0;
-		}
-
-		Array<T, TSize>& operator=(const Array<T, TSize>& copyRef) {
-			if (data != nullptr) {
-				clear();
-			}
-			if (copyRef.num > 0 && copyRef.data != nullptr) {
-				resize(copyRef.num);
-				copy(copyRef.data, copyRef.num);
-				num = copyRef.num;
-			}
-			return *this;
-		}
-
-		Array<T, TSize>& operator=(Array<T, TSize>&& moveRef) noexcept {
-			data = moveRef.data;
-			num = moveRef.num;
-			capacity = moveRef.capacity;
-			moveRef.data = nullptr;
-			moveRef.num = 0;
-			moveRef.capacity = 0;
-			return *this;
-		}
-
-		void reset() {
-			destroyRange(0, num);
-			num = 0;
-		}
-		
-		void clear() {
-			destroyRange(0, num);
-			num = 0;
-			free(data);
-			data = nullptr;
-		}
-
-		void fill(TSize count, const T& element)
-		{
-			for (TSize index = 0; index < count; ++index)
-			{
-				add(element);
-			}
-		}
-
-		template<typename... TArgs>
-		T& emplace(TArgs... args) {
-			checkResize();
-			T* ptr = new (&data[num++]) T(std::forward<TArgs...>(args...));
-			return *ptr;
-		}
-
-		void add(const T& element) {
-			checkResize();
-			new (&data[num++]) T(element);
-		}
-
-		void add(T&& element) {
-			checkResize();
-			new (&data[num++]) T(std::move(element));
-		}
-
-		void remove(TSize index)
-		{
-			if (index > 0 && index < num)
-			{
-				destroyRange(index, index + 1);
-				move(&data[index], &data[index + 1], num - index);
-				num--;
-			}
-		}
-
-		void resize(TSize newCapacity) {
-			NI_ASSERT(newCapacity > capacity, "New capacity must be larger than capacity. To clear the use the clear function.");
-			if (data != nullptr && newCapacity > capacity) {
-				T* newData = (T*)malloc((size_t)newCapacity * sizeof(T));
-				move(newData, data, num);
-				free(data);
-				data = newData;
-				capacity = newCapacity;
-			} else if (data == nullptr && newCapacity > 0) {
-				data = (T*)malloc((size_t)newCapacity * sizeof(T));
-				capacity = newCapacity;
-			} else if (data != nullptr && newCapacity == 0) {
-				clear();
-			} else {
-				NI_ASSERT(0, "");
-			}
-		}
-
-		void checkResize() {
-			if (num + 1 >= capacity) {
-				resize(capacity > 0 ? capacity * 2 : 16);
-			}
-		}
-
-		T* getData() { return data; }
-		const T* getData() const { return data; }
-
-		TSize getNum() const { return num; }
-		TSize getCapacity() const { return capacity;  }
-		size_t getNumInByteSize() const { return sizeof(T) * num; }
-		size_t getCapacityInByteSize() const { return sizeof(T) * capacity; }
-
-		const T& operator[](TSize index) const { return data[index]; }
-		T& operator[](TSize index) { return data[index]; }
-		T* operator*() const { return data; }
-		const T* operator*() { return data; }
-
-	private:
-		T* data;
-		TSize num;
-		TSize capacity;
-
-		void destroyRange(TSize from, TSize to) {
-			if (data == nullptr) return;
-			for (TSize index = from; index < to; index++) {
-				data[index].~T();
-			}
-		}
-
-		void copy(const T* src, TSize count) {
-			for (TSize index = 0; index < count; index++) {
-				new (&data[index]) T(src[index]);
-			}
-		}
-
-		void copy(T* dst, const T* src, TSize count) {
-			for (TSize index = 0; index < count; index++) {
-				new (&dst[index]) T(src[index]);
-			}
-		}
-
-		void move(T* src, TSize count) {
-			for (TSize index = 0; index < count; index++) {
-				new (&data[index]) T(std::move(src[index]));
-			}
-		}
-
-		void move(T*dst, T* src, TSize count) {
-			for (TSize index = 0; index < count; index++) {
-				new (&dst[index]) T(std::move(src[index]));
-			}
-		}
-	};
-
-	template<typename T, size_t MAX_COUNT, typename TSize = uint64_t>
-	struct FixedArray {
-
-		FixedArray() : num(0) {}
-
-		~FixedArray()
-		{
-
-		}
-		
-		void reset() {
-			num = 0;
-		}
-
-		template<typename... TArgs>
-		T& emplace(TArgs... args) {
-			NI_ASSERT(num < MAX_COUNT, "Exceeded the limit of the fixed array %u", MAX_COUNT);
-			T* ptr = new (&data[num++]) T(std::forward(args)...);
-			return *ptr;
-		}
-
-		void add(const T& element) {
-			NI_ASSERT(num < MAX_COUNT, "Exceeded the limit of the fixed array %u", MAX_COUNT);
-			data[num++] = element;
-		}
-		void remove(TSize index) {
-			NI_ASSERT(index < num, "Index out of bounds");
-			for (TSize start = index; start < num - 1; ++start) {
-				data[start] = data[start + 1];
-			}
-			num--;
-		}
-		T* getData() { return data; }
-		const T* getData() const { return data; }
-		TSize getNum() const { return num; }
-		TSize getCapacity() const { return (TSize)MAX_COUNT; }
-		const T& operator[](TSize index) const { return data[index]; }
-		T& operator[](TSize index) { return data[index]; }
-
-	private:
-		T data[MAX_COUNT];
-		TSize num;
-	};
-
 	struct RootSignatureDescriptorRange {
 		RootSignatureDescriptorRange() {}
 		~RootSignatureDescriptorRange() {}
@@ -880,16 +650,12 @@ namespace ni {
 	uint32_t randomUint();
 	template<typename T> uint32_t calcNumUint32FromSize() { return sizeof(T) / sizeof(uint32_t); }
 	uint32_t calcNumUint32FromSize(size_t size);
-	double getSeconds();
 	size_t getDXGIFormatBits(DXGI_FORMAT format);
 	size_t getDXGIFormatBytes(DXGI_FORMAT format);
 	Texture* createTexture(const wchar_t* name, uint32_t width, uint32_t height, uint32_t depth, const void* pixels, D3D12_RESOURCE_STATES initialState, DXGI_FORMAT dxgiFormat, D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
 	Texture* createTexture(uint32_t width, uint32_t height, uint32_t depth, const void* pixels, D3D12_RESOURCE_STATES initialState, DXGI_FORMAT dxgiFormat, D3D12_RESOURCE_FLAGS flags = D3D12_RESOURCE_FLAG_NONE);
 	void destroyTexture(Texture*& image);
 	uint64_t murmurHash(const void* key, uint64_t keyLength, uint64_t seed);
-	inline void* offsetPtr(void* Ptr, intptr_t Offset) { return (void*)((intptr_t)Ptr + Offset); }
-	inline void* alignPtr(void* Ptr, size_t Alignment) { return (void*)(((uintptr_t)(Ptr)+((uintptr_t)(Alignment)-1LL)) & ~((uintptr_t)(Alignment)-1LL)); }
-	inline size_t alignSize(size_t Value, size_t Alignment) { return ((Value)+((Alignment)-1LL)) & ~((Alignment)-1LL); }
 	size_t getFileSize(const char* path);
 	bool readFile(const char* path, void* outBuffer);
 	void* allocReadFile(const char* path);
@@ -1009,501 +775,6 @@ namespace ni {
 		forEachKeyCode(func, ni::keyDown);
 	}
 
-}
-
-#ifdef min
-#undef min
-#endif
-#ifdef max
-#undef max
-#endif
-
-namespace ni {
-	struct Float2;
-	struct Float3;
-	struct Float4;
-	struct Float2x2;
-	struct Float3x3;
-	struct Float4x4;
-	struct Quaternion;
-	struct Matrix2D;
-}
-
-// Global operators
-ni::Float2x2 operator*(const ni::Float2x2& a, const ni::Float2x2& b);
-ni::Float3x3 operator*(const ni::Float3x3& a, const ni::Float3x3& b);
-ni::Float4x4 operator*(const ni::Float4x4& a, const ni::Float4x4& b);
-
-ni::Float2 operator+(const ni::Float2& a, const ni::Float2& b);
-ni::Float2 operator-(const ni::Float2& a, const ni::Float2& b);
-ni::Float2 operator*(const ni::Float2& a, const ni::Float2& b);
-ni::Float2 operator/(const ni::Float2& a, const ni::Float2& b);
-ni::Float2 operator*(const ni::Float2x2& a, const ni::Float2& b);
-ni::Float2 operator*(const ni::Float2x2& a, const ni::Float2& b);
-ni::Float2 operator+(const ni::Float2& a, const float& b);
-ni::Float2 operator-(const ni::Float2& a, const float& b);
-ni::Float2 operator*(const ni::Float2& a, const float& b);
-ni::Float2 operator/(const ni::Float2& a, const float& b);
-ni::Float2 operator+(const float& a, const ni::Float2& b);
-ni::Float2 operator-(const float& a, const ni::Float2& b);
-ni::Float2 operator*(const float& a, const ni::Float2& b);
-ni::Float2 operator/(const float& a, const ni::Float2& b);
-ni::Float2 operator-(const ni::Float2& a);
-ni::Float2 operator*(const ni::Matrix2D& a, const ni::Float2& b);
-
-ni::Float3 operator+(const ni::Float3& a, const ni::Float3& b);
-ni::Float3 operator-(const ni::Float3& a, const ni::Float3& b);
-ni::Float3 operator*(const ni::Float3& a, const ni::Float3& b);
-ni::Float3 operator/(const ni::Float3& a, const ni::Float3& b);
-ni::Float3 operator*(const ni::Float3x3& a, const ni::Float3& b);
-ni::Float3 operator+(const ni::Float3& a, const float& b);
-ni::Float3 operator-(const ni::Float3& a, const float& b);
-ni::Float3 operator*(const ni::Float3& a, const float& b);
-ni::Float3 operator/(const ni::Float3& a, const float& b);
-ni::Float3 operator+(const float& a, const ni::Float3& b);
-ni::Float3 operator-(const float& a, const ni::Float3& b);
-ni::Float3 operator*(const float& a, const ni::Float3& b);
-ni::Float3 operator/(const float& a, const ni::Float3& b);
-ni::Float3 operator-(const ni::Float3& a);
-
-ni::Float4 operator+(const ni::Float4& a, const ni::Float4& b);
-ni::Float4 operator-(const ni::Float4& a, const ni::Float4& b);
-ni::Float4 operator*(const ni::Float4& a, const ni::Float4& b);
-ni::Float4 operator/(const ni::Float4& a, const ni::Float4& b);
-ni::Float4 operator*(const ni::Float4x4& a, const ni::Float4& b);
-ni::Float4 operator+(const ni::Float4& a, const float& b);
-ni::Float4 operator-(const ni::Float4& a, const float& b);
-ni::Float4 operator*(const ni::Float4& a, const float& b);
-ni::Float4 operator/(const ni::Float4& a, const float& b);
-ni::Float4 operator+(const float& a, const ni::Float4& b);
-ni::Float4 operator-(const float& a, const ni::Float4& b);
-ni::Float4 operator*(const float& a, const ni::Float4& b);
-ni::Float4 operator/(const float& a, const ni::Float4& b);
-ni::Float4 operator-(const ni::Float4& a);
-
-namespace ni {
-
-	constexpr float PI = 3.14159265359f;
-	constexpr float TAU = PI * 2.0f;
-
-	float toRad(float d);
-	float toDeg(float r);
-	float cos(float t);
-	float sin(float t);
-	float tan(float t);
-	float asin(float t);
-	float acos(float t);
-	float atan(float t);
-	float atan2(float y, float x);
-	float pow(float x, float y);
-	float exp(float x);
-	float exp2(float x);
-	float log(float x);
-	float log2(float x);
-	float sqrt(float x);
-	float invSqrt(float x);
-	float abs(float x);
-	float round(float x);
-	float sign(float x);
-	float floor(float x);
-	float ceil(float x);
-	float fract(float x);
-	float mod(float x, float y);
-	float clamp(float n, float x, float y);
-	float mix(float x, float y, float n);
-	float step(float edge, float x);
-	float smootStep(float edge0, float edge1, float x);
-	float saturate(float Value);
-	float normalize(float Value, float MinValue, float MaxValue);
-	float random();
-
-	template<typename T>
-	static T min(T Lhs, T Rhs)
-	{
-		return Lhs < Rhs ? Lhs : Rhs;
-	}
-
-	template<typename T>
-	static T max(T Lhs, T Rhs)
-	{
-		return Lhs > Rhs ? Lhs : Rhs;
-	}
-
-
-	struct Float2
-	{
-		union
-		{
-			struct { float x, y; };
-			float components[2];
-		};
-
-		Float2();
-		Float2(float x);
-		Float2(float x, float y);
-		Float2& operator=(const float& n) { x = n; y = n; return *this; }
-		Float2& operator=(const Float2& n) { x = n.x; y = n.y; return *this; }
-		bool operator==(const Float2& n) const { return x == n.x && y == n.y; }
-		Float2& operator+=(const float& n) { x += n; y += n; return *this; }
-		Float2& operator-=(const float& n) { x -= n; y -= n; return *this; }
-		Float2& operator*=(const float& n) { x *= n; y *= n; return *this; }
-		Float2& operator/=(const float& n) { x /= n; y /= n; return *this; }
-		Float2& operator+=(const Float2& n) { x += n.x; y += n.y; return *this; }
-		Float2& operator-=(const Float2& n) { x -= n.x; y -= n.y; return *this; }
-		Float2& operator*=(const Float2& n) { x *= n.x; y *= n.y; return *this; }
-		Float2& operator/=(const Float2& n) { x /= n.x; y /= n.y; return *this; }
-		float& operator[](uint64_t Index) { return components[Index]; }
-		float lengthSqr() const { return x * x + y * y; }
-		float length() const { return ni::sqrt(lengthSqr()); }
-		float dot(const Float2& n) const { return x * n.x + y * n.y; }
-		float distance(const Float2& n) const { return (*this - n).length(); }
-		Float2& normalize();
-		Float2& faceForward(const Float2& Incident, const Float2& Reference);
-		Float2& reflect(const Float2& Normal);
-		Float2& refract(const Float2& Normal, float IndexOfRefraction);
-		Float2& operator*=(const Float2x2& m);
-		Float3 toFloat3();
-		Float4 toFloat4();
-	};
-
-	struct Float3
-	{
-		union
-		{
-			struct { float x, y, z; };
-			float components[3];
-		};
-
-		Float3();
-		Float3(float x);
-		Float3(float x, float y, float z);
-		Float3& operator=(const float& n) { x = n; y = n; z = n; return *this; }
-		Float3& operator=(const Float3& n) { x = n.x; y = n.y; z = n.z; return *this; }
-		bool operator==(const Float3& n) const { return x == n.x && y == n.y && z == n.z; }
-		Float3& operator+=(const float& n) { x += n; y += n; z += n; return *this; }
-		Float3& operator-=(const float& n) { x -= n; y -= n; z -= n; return *this; }
-		Float3& operator*=(const float& n) { x *= n; y *= n; z *= n; return *this; }
-		Float3& operator/=(const float& n) { x /= n; y /= n; z /= n; return *this; }
-		Float3& operator+=(const Float3& n) { x += n.x; y += n.y; z += n.z; return *this; }
-		Float3& operator-=(const Float3& n) { x -= n.x; y -= n.y; z -= n.z; return *this; }
-		Float3& operator*=(const Float3& n) { x *= n.x; y *= n.y; z *= n.z; return *this; }
-		Float3& operator/=(const Float3& n) { x /= n.x; y /= n.y; z /= n.z; return *this; }
-		float& operator[](uint64_t Index) { return components[Index]; }
-		float lengthSqr() const;
-		float length() const;
-		float dot(const Float3& n) const;
-		float distance(const Float3& n) const;
-		Float3& normalize();
-		Float3& cross(const Float3& n);
-		Float3& faceForward(const Float3& Incident, const Float3& Reference);
-		Float3& reflect(const Float3& Normal);
-		Float3& refract(const Float3& Normal, float IndexOfRefraction);
-		Float3& operator*=(const Float3x3& m);
-		Float4 toFloat4();
-		Float2 toFloat2();
-	};
-
-	struct Float4
-	{
-		union
-		{
-			struct { float x, y, z, w; };
-			float components[4];
-		};
-
-		Float4();
-		Float4(float x);
-		Float4(float x, float y, float z, float w);
-		Float4& operator=(const float& n) { x = n; y = n; z = n; w = n; return *this; }
-		Float4& operator=(const Float2& n) { x = n.x; y = n.y; return *this; }
-		bool operator==(const Float4& n) const { return x == n.x && y == n.y && z == n.z && w == n.w; }
-		Float4& operator+=(const float& n) { x += n; y += n; z += n; w += n; return *this; }
-		Float4& operator-=(const float& n) { x -= n; y -= n; z -= n; w -= n; return *this; }
-		Float4& operator*=(const float& n) { x *= n; y *= n; z *= n; w *= n; return *this; }
-		Float4& operator/=(const float& n) { x /= n; y /= n; z /= n; w /= n; return *this; }
-		Float4& operator+=(const Float4& n) { x += n.x; y += n.y; z += n.z; w += n.w; return *this; }
-		Float4& operator-=(const Float4& n) { x -= n.x; y -= n.y; z -= n.z; w -= n.w; return *this; }
-		Float4& operator*=(const Float4& n) { x *= n.x; y *= n.y; z *= n.z; w *= n.w; return *this; }
-		Float4& operator/=(const Float4& n) { x /= n.x; y /= n.y; z /= n.z; w /= n.w; return *this; }
-		const float& operator[](uint64_t Index) const { return components[Index]; }
-		float& operator[](uint64_t Index) { return components[Index]; }
-		float lengthSqr() const;
-		float length() const;
-		float dot(const Float4& n) const;
-		float distance(const Float4& n) const;
-		Float4& normalize();
-		Float4& faceForward(const Float4& Incident, const Float4& Reference);
-		Float4& reflect(const Float4& Normal);
-		Float4& refract(const Float4& Normal, float IndexOfRefraction);
-		Float4& operator*=(const Float4x4& m);
-		Float3 toFloat3();
-		Float2 toFloat2();
-	};
-
-	struct Float2x2
-	{
-		union
-		{
-			float data[4];
-			Float2 rows[2];
-			struct
-			{
-				Float2 row0;
-				Float2 row1;
-			};
-		};
-		Float2x2();
-		Float2x2(float a, float b, float c, float d);
-		Float2x2& loadIdentity();
-		Float2x2& operator=(const Float2x2& n)
-		{
-			data[0] = n.data[0]; data[1] = n.data[1];
-			data[2] = n.data[2]; data[3] = n.data[3];
-			return *this;
-		}
-		bool operator==(const Float2x2& n) const
-		{
-			return data[0] == n.data[0] && data[1] == n.data[1] &&
-				data[2] == n.data[2] && data[3] == n.data[3];
-		}
-		Float2& operator[](uint64_t Index) { return rows[Index]; }
-		Float2x2& transpose();
-		Float2x2& operator*=(const Float2x2& m)
-		{
-			float a00 = data[0]; float a01 = data[1];;
-			float a10 = data[2]; float a11 = data[3];;
-
-			float b0 = m.data[0];
-			float b1 = m.data[1];
-
-			data[0] = b0 * a00 + b1 * a10;
-			data[1] = b0 * a01 + b1 * a11;
-
-			b0 = m.data[2];
-			b1 = m.data[3];
-
-			data[2] = b0 * a00 + b1 * a10;
-			data[3] = b0 * a01 + b1 * a11;
-
-			return *this;
-		}
-		Float2x2& rotate(float rad);
-		Float2x2& scale(const Float2& v);
-	};
-
-	struct Float3x3
-	{
-		union
-		{
-			float data[9];
-			Float3 rows[3];
-			struct
-			{
-				Float3 row0;
-				Float3 row1;
-				Float3 row2;
-			};
-		};
-		Float3x3();
-		Float3x3(float a, float b, float c,
-			float d, float e, float f,
-			float g, float h, float i);
-		Float3x3& loadIdentity();
-		Float3x3& operator=(const Float3x3& n)
-		{
-			data[0] = n.data[0]; data[1] = n.data[1]; data[2] = n.data[2];
-			data[3] = n.data[3]; data[4] = n.data[4]; data[5] = n.data[5];
-			data[6] = n.data[6]; data[7] = n.data[7]; data[8] = n.data[8];
-			return *this;
-		}
-		bool operator==(const Float3x3& n) const
-		{
-			return data[0] == n.data[0] && data[1] == n.data[1] && data[2] == n.data[2] &&
-				data[3] == n.data[3] && data[4] == n.data[4] && data[5] == n.data[5];
-			data[6] == n.data[6] && data[7] == n.data[7] && data[8] == n.data[8];
-		}
-		Float3& operator[](uint64_t Index) { return rows[Index]; }
-		Float3x3& transpose();
-		Float3x3& operator*=(const Float3x3& m)
-		{
-			float a00 = data[0]; float a01 = data[1]; float a02 = data[2];
-			float a10 = data[3]; float a11 = data[4]; float a12 = data[5];
-			float a20 = data[6]; float a21 = data[7]; float a22 = data[8];
-
-			float b0 = m.data[0];
-			float b1 = m.data[1];
-			float b2 = m.data[2];
-
-			data[0] = b0 * a00 + b1 * a10 + b2 * a20;
-			data[1] = b0 * a01 + b1 * a11 + b2 * a21;
-			data[2] = b0 * a02 + b1 * a12 + b2 * a22;
-
-			b0 = m.data[3];
-			b1 = m.data[4];
-			b2 = m.data[5];
-
-			data[3] = b0 * a00 + b1 * a10 + b2 * a20;
-			data[4] = b0 * a01 + b1 * a11 + b2 * a21;
-			data[5] = b0 * a02 + b1 * a12 + b2 * a22;
-
-			b0 = m.data[6];
-			b1 = m.data[7];
-			b2 = m.data[8];
-
-			data[6] = b0 * a00 + b1 * a10 + b2 * a20;
-			data[7] = b0 * a01 + b1 * a11 + b2 * a21;
-			data[8] = b0 * a02 + b1 * a12 + b2 * a22;
-
-			return *this;
-		}
-		Float3x3& translate(const Float3& n);
-		Float3x3& rotate(float rad);
-		Float3x3& scale(const Float2& n);
-	};
-
-	struct Float4x4
-	{
-		union
-		{
-			float data[16];
-			Float4 rows[4];
-			struct
-			{
-				Float4 row0;
-				Float4 row1;
-				Float4 row2;
-				Float4 row3;
-			};
-		};
-		Float4x4();
-		Float4x4(float a, float b, float c, float d,
-			float e, float f, float g, float h,
-			float i, float j, float k, float l,
-			float m, float n, float o, float p);
-		Float4x4& loadIdentity();
-		Float4x4& operator=(const Float4x4& n)
-		{
-			data[0] = n.data[0]; data[1] = n.data[1]; data[2] = n.data[2]; data[3] = n.data[3];
-			data[4] = n.data[4]; data[5] = n.data[5]; data[6] = n.data[6]; data[7] = n.data[7];
-			data[8] = n.data[8]; data[9] = n.data[9]; data[10] = n.data[10]; data[11] = n.data[11];
-			data[12] = n.data[12]; data[13] = n.data[13]; data[14] = n.data[14]; data[15] = n.data[15];
-			return *this;
-		}
-		bool operator==(const Float4x4& n) const
-		{
-			return data[0] == n.data[0] && data[1] == n.data[1] && data[2] == n.data[2] && data[3] == n.data[3] &&
-				data[4] == n.data[4] && data[5] == n.data[5] && data[6] == n.data[6] && data[7] == n.data[7] &&
-				data[8] == n.data[8] && data[9] == n.data[9] && data[10] == n.data[10] && data[11] == n.data[11] &&
-				data[12] == n.data[12] && data[13] == n.data[13] && data[14] == n.data[14] && data[15] == n.data[15];
-		}
-		Float4& operator[](uint64_t Index) { return rows[Index]; }
-		Float4x4& transpose();
-		Float4x4& operator*=(const Float4x4& m)
-		{
-			float a00 = data[0]; float a01 = data[1]; float a02 = data[2]; float a03 = data[3];
-			float a10 = data[4]; float a11 = data[5]; float a12 = data[6]; float a13 = data[7];
-			float a20 = data[8]; float a21 = data[9]; float a22 = data[10]; float a23 = data[11];
-			float a30 = data[12]; float a31 = data[13]; float a32 = data[14]; float a33 = data[15];
-
-			float b0 = m.data[0];
-			float b1 = m.data[1];
-			float b2 = m.data[2];
-			float b3 = m.data[3];
-
-			data[0] = b0 * a00 + b1 * a10 + b2 * a20 + b3 * a30;
-			data[1] = b0 * a01 + b1 * a11 + b2 * a21 + b3 * a31;
-			data[2] = b0 * a02 + b1 * a12 + b2 * a22 + b3 * a32;
-			data[3] = b0 * a03 + b1 * a13 + b2 * a23 + b3 * a33;
-
-			b0 = m.data[4];
-			b1 = m.data[5];
-			b2 = m.data[6];
-			b3 = m.data[7];
-
-			data[4] = b0 * a00 + b1 * a10 + b2 * a20 + b3 * a30;
-			data[5] = b0 * a01 + b1 * a11 + b2 * a21 + b3 * a31;
-			data[6] = b0 * a02 + b1 * a12 + b2 * a22 + b3 * a32;
-			data[7] = b0 * a03 + b1 * a13 + b2 * a23 + b3 * a33;
-
-			b0 = m.data[8];
-			b1 = m.data[9];
-			b2 = m.data[10];
-			b3 = m.data[11];
-
-			data[8] = b0 * a00 + b1 * a10 + b2 * a20 + b3 * a30;
-			data[9] = b0 * a01 + b1 * a11 + b2 * a21 + b3 * a31;
-			data[10] = b0 * a02 + b1 * a12 + b2 * a22 + b3 * a32;
-			data[11] = b0 * a03 + b1 * a13 + b2 * a23 + b3 * a33;
-
-			b0 = m.data[12];
-			b1 = m.data[13];
-			b2 = m.data[14];
-			b3 = m.data[15];
-
-			data[12] = b0 * a00 + b1 * a10 + b2 * a20 + b3 * a30;
-			data[13] = b0 * a01 + b1 * a11 + b2 * a21 + b3 * a31;
-			data[14] = b0 * a02 + b1 * a12 + b2 * a22 + b3 * a32;
-			data[15] = b0 * a03 + b1 * a13 + b2 * a23 + b3 * a33;
-
-			return *this;
-		}
-		Float4x4& translate(const Float3& v);
-		Float4x4& scale(const Float3& v);
-		Float4x4& rotate(const Float3& v);
-		Float4x4& rotateX(float rad);
-		Float4x4& rotateY(float rad);
-		Float4x4& rotateZ(float rad);
-		Float4x4& perspective(float fovy, float aspect, float nearBound, float farBound);
-		Float4x4& orthographic(float left, float right, float bottom, float top, float nearBound, float farBound);
-		Float4x4& lookAt(const Float3& eye, const Float3& center, const Float3& up);
-		Float4x4& invert();
-	};
-
-
-	struct Quaternion
-	{
-		union
-		{
-			struct { float x, y, z, w; };
-			float components[4];
-		};
-
-		Quaternion();
-		Quaternion(float x);
-		Quaternion(float x, float y, float z, float w);
-		Quaternion& loadIdentity();
-		Quaternion& fromEulerAngles(const Float3& eulerAngles);
-		Float3 toEulerAngles();
-		Quaternion& rotateX(float rad);
-		Quaternion& rotateY(float rad);
-		Quaternion& rotateZ(float rad);
-		Float4x4 toFloat4x4();
-		float& operator[](uint64_t Index) { return components[Index]; }
-	};
-
-	struct Matrix2D
-	{
-		Matrix2D();
-		Matrix2D(const Matrix2D& Other);
-		Matrix2D(float a, float b, float c, float d, float tx, float ty);
-		Matrix2D& loadIdentity();
-		Matrix2D& translate(float x, float y);
-		Matrix2D& translate(Float2& TranslateVector);
-		Matrix2D& scale(float x, float y);
-		Matrix2D& scale(Float2& ScaleVector);
-		Matrix2D& rotate(float Rotation);
-		float& operator[](uint64_t Index) { return components[Index]; }
-		Matrix2D& operator=(const Matrix2D& Other);
-
-
-		union
-		{
-			float components[6];
-			struct { float a, b, c, d, tx, ty; };
-			struct { Float2 ab, cd, txty; };
-		};
-	};
-
 	struct FlyCamera {
 		FlyCamera(ni::Float3 initialPosition = { 0, 0, 0 });
 		void update();
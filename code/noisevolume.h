@@ -0,0 +1,60 @@
+#pragma once
+
+// Precomputed value noise lattice for the materials' fbmd() (shaders/Noise.hlsli).
+// Every noised() call hashes the eight corners of its cell with sin(), three
+// octaves per fbmd(), at every material hit of every bounce. The hashes only depend
+// on the integer corner, so they are baked once for the corners in
+// [-extent, extent]^3 and noised() reads them back. The corners are integers well
+// inside float precision, so the lookups give exactly the hashes the evaluation
+// would and fbmd() does not change.
+
+#include "shaderport.h"
+
+namespace ni {
+
+	struct NoiseVolumeStats
+	{
+		double seconds = 0.0;
+		uint64_t entryNum = 0;
+	};
+
+	struct NoiseVolume
+	{
+		// Rebakes only when the extent changes.
+		NoiseVolumeStats bake(WorkerPool& pool, uint32_t newExtent = NOISE_VOLUME_EXTENT)
+		{
+			NoiseVolumeStats stats = {};
+			if (newExtent == extent) return stats;
+
+			double start = getSeconds();
+			extent = newExtent;
+			uint32_t size = 2 * extent + 1;
+			lattice.reset();
+			lattice.fill((uint64_t)size * size * size, 0.0f);
+			pool.parallelFor(size, [&](uint64_t z, uint32_t)
+			{
+				float* slice = &lattice[z * size * size];
+				for (uint32_t y = 0; y < size; ++y)
+				{
+					for (uint32_t x = 0; x < size; ++x)
+					{
+						// As noised() forms n for the corner.
+						Float3 p((float)x - (float)extent, (float)y - (float)extent, (float)z - (float)extent);
+						slice[y * size + x] = shader::hash(p.x + p.y * 157 + 113 * p.z);
+					}
+				}
+			});
+			stats.seconds = getSeconds() - start;
+			stats.entryNum = lattice.getNum();
+			return stats;
+		}
+
+		const float* getLattice() const { return lattice.getData(); }
+		uint32_t getExtent() const { return extent; }
+
+	private:
+		uint32_t extent = 0;
+		Array<float> lattice;
+	};
+
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+// Structure of arrays copy of the particle buffer for the CPU simulation.
+// ParticleData is a 104 byte record, but a pair test only reads position, radius and
+// the primitive type. The fields every step touches (position, prevPosition,
+// velocity, radius, primitive) are kept as separate streams, the rest goes into a
+// cold record per particle.
+// fromParticles/toParticles convert from and to the GPU layout.
+// Only the 4 wide countOverlaps() is faster than testing the records. One pair at
+// a time, mayCollide() on the streams is no faster than ni::mayCollide (-bench
+// layout), so CpuSimulator tests its candidates on the records.
+
+#include "shaderport.h"
+
+#if NI_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+namespace ni {
+
+	struct ParticleColdData
+	{
+		float3 acceleration;
+		float elasticity;
+		float friction;
+		uint id;
+		uint dynamic;
+		uint visible;
+		Material material;
+	};
+
+	struct ParticleStore
+	{
+		void resize(uint32_t particleNum)
+		{
+			num = particleNum;
+			Array<float>* streams[] = { &positionX, &positionY, &positionZ, &prevPositionX, &prevPositionY, &prevPositionZ, &velocityX, &velocityY, &velocityZ, &radius };
+			for (Array<float>* stream : streams)
+			{
+				if (stream->getNum() == particleNum) continue;
+				stream->reset();
+				stream->fill(particleNum, 0.0f);
+			}
+			if (primitive.getNum() != particleNum)
+			{
+				primitive.reset();
+				primitive.fill(particleNum, 0);
+			}
+			if (cold.getNum() != particleNum)
+			{
+				cold.reset();
+				cold.fill(particleNum, ParticleColdData{});
+			}
+		}
+
+		// Only refreshes the hot streams, for callers that keep the cold data elsewhere.
+		void fromParticlesHot(const ParticleData* particles, uint32_t particleNum)
+		{
+			resize(particleNum);
+			for (uint32_t index = 0; index < particleNum; ++index)
+			{
+				const ParticleData& particle = particles[index];
+				positionX[index] = particle.position.x;
+				positionY[index] = particle.position.y;
+				positionZ[index] = particle.position.z;
+				prevPositionX[index] = particle.prevPosition.x;
+				prevPositionY[index] = particle.prevPosition.y;
+				prevPositionZ[index] = particle.prevPosition.z;
+				velocityX[index] = particle.velocity.x;
+				velocityY[index] = particle.velocity.y;
+				velocityZ[index] = particle.velocity.z;
+				radius[index] = particle.radius;
+				primitive[index] = particle.primitive;
+			}
+		}
+
+		void fromParticles(const ParticleData* particles, uint32_t particleNum)
+		{
+			fromParticlesHot(particles, particleNum);
+			for (uint32_t index = 0; index < particleNum; ++index)
+			{
+				const ParticleData& particle = particles[index];
+				ParticleColdData& coldData = cold[index];
+				coldData.acceleration = particle.acceleration;
+				coldData.elasticity = particle.elasticity;
+				coldData.friction = particle.friction;
+				coldData.id = particle.id;
+				coldData.dynamic = particle.dynamic;
+				coldData.visible = particle.visible;
+				coldData.material = particle.material;
+			}
+		}
+
+		void toParticles(ParticleData* particles) const
+		{
+			for (uint32_t index = 0; index < num; ++index)
+			{
+				particles[index] = getParticle(index);
+			}
+		}
+
+		ParticleData getParticle(uint32_t index) const
+		{
+			const ParticleColdData& coldData = cold[index];
+			ParticleData particle;
+			particle.position = float3(positionX[index], positionY[index], positionZ[index]);
+			particle.prevPosition = float3(prevPositionX[index], prevPositionY[index], prevPositionZ[index]);
+			particle.velocity = float3(velocityX[index], velocityY[index], velocityZ[index]);
+			particle.acceleration = coldData.acceleration;
+			particle.radius = radius[index];
+			particle.primitive = primitive[index];
+			particle.elasticity = coldData.elasticity;
+			particle.friction = coldData.friction;
+			particle.id = coldData.id;
+			particle.dynamic = coldData.dynamic;
+			particle.visible = coldData.visible;
+			particle.material = coldData.material;
+			return particle;
+		}
+
+		// Same test as ni::mayCollide, reading the other particle from the hot streams.
+		bool mayCollide(const ParticleData& particle, uint32_t other) const
+		{
+			if (particle.primitive != PARTICLE_PRIMITIVE_SPHERE || primitive[other] != PARTICLE_PRIMITIVE_SPHERE) return true;
+			float dx = particle.position.x - positionX[other];
+			float dy = particle.position.y - positionY[other];
+			float dz = particle.position.z - positionZ[other];
+			float radiusSum = particle.radius + radius[other];
+			return dx * dx + dy * dy + dz * dz <= radiusSum * radiusSum * 1.0001f + 1e-6f;
+		}
+
+		// How many of the particles in [begin, end) mayCollide with particle. The
+		// streams make this a straight 4 wide loop.
+		uint32_t countOverlaps(const ParticleData& particle, uint32_t begin, uint32_t end) const
+		{
+			uint32_t count = 0;
+			uint32_t index = begin;
+			if (particle.primitive != PARTICLE_PRIMITIVE_SPHERE) return end - begin;
+#if NI_SIMD_SSE
+			__m128i sphere = _mm_set1_epi32(PARTICLE_PRIMITIVE_SPHERE);
+			__m128 allBits = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			__m128 px = _mm_set1_ps(particle.position.x);
+			__m128 py = _mm_set1_ps(particle.position.y);
+			__m128 pz = _mm_set1_ps(particle.position.z);
+			__m128 pr = _mm_set1_ps(particle.radius);
+			__m128 tolerance = _mm_set1_ps(1.0001f);
+			__m128 epsilon = _mm_set1_ps(1e-6f);
+			static const uint8_t maskBitNum[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+			for (; index + 4 <= end; index += 4)
+			{
+				__m128 dx = _mm_sub_ps(px, _mm_loadu_ps(&positionX[index]));
+				__m128 dy = _mm_sub_ps(py, _mm_loadu_ps(&positionY[index]));
+				__m128 dz = _mm_sub_ps(pz, _mm_loadu_ps(&positionZ[index]));
+				__m128 radiusSum = _mm_add_ps(pr, _mm_loadu_ps(&radius[index]));
+				__m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+				__m128 limit = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(radiusSum, radiusSum), tolerance), epsilon);
+				__m128 isSphere = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)&primitive[index]), sphere));
+				__m128 isOverlap = _mm_or_ps(_mm_cmple_ps(distanceSq, limit), _mm_andnot_ps(isSphere, allBits));
+				count += maskBitNum[_mm_movemask_ps(isOverlap)];
+			}
+#endif
+			for (; index < end; ++index)
+			{
+				count += mayCollide(particle, index) ? 1 : 0;
+			}
+			return count;
+		}
+
+		uint32_t getNum() const { return num; }
+
+		Array<float> positionX, positionY, positionZ;
+		Array<float> prevPositionX, prevPositionY, prevPositionZ;
+		Array<float> velocityX, velocityY, velocityZ;
+		Array<float> radius;
+		Array<uint32_t> primitive;
+		Array<ParticleColdData> cold;
+
+	private:
+		uint32_t num = 0;
+	};
+
+}
@@ -0,0 +1,490 @@
+#pragma once
+
+// 8 wide versions of intersectsParticle() from shaders/PathTrace.hlsli, in two
+// shapes: 8 rays against one sphere (RayPacket8) and one ray against 8 spheres of a
+// SphereStream at a time. Both give bit for bit what intersectsParticle() gives,
+// all in float with the same order of operations. That needs a build that doesn't
+// contract the scalar side into FMAs: -ffp-contract=off with GCC and Clang (see
+// code/headless.cpp), MSVC's default /fp:precise.
+//
+// With AVX2 a lane group is one __m256, with SSE two __m128. Without SSE the
+// kernels run simd::intersectScalar() per lane.
+
+#include "shaderport.h"
+
+#if NI_SIMD_AVX2
+#include <immintrin.h>
+#elif NI_SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+namespace ni {
+
+	// 8 rays in SoA form.
+	struct RayPacket8
+	{
+		alignas(32) float originX[8];
+		alignas(32) float originY[8];
+		alignas(32) float originZ[8];
+		alignas(32) float directionX[8];
+		alignas(32) float directionY[8];
+		alignas(32) float directionZ[8];
+
+		void set(uint32_t lane, const Float3& origin, const Float3& direction)
+		{
+			originX[lane] = origin.x;
+			originY[lane] = origin.y;
+			originZ[lane] = origin.z;
+			directionX[lane] = direction.x;
+			directionY[lane] = direction.y;
+			directionZ[lane] = direction.z;
+		}
+
+		Float3 getOrigin(uint32_t lane) const { return Float3(originX[lane], originY[lane], originZ[lane]); }
+		Float3 getDirection(uint32_t lane) const { return Float3(directionX[lane], directionY[lane], directionZ[lane]); }
+	};
+
+	// Per ray results of a packet query, valid for the lanes set in the returned mask.
+	struct PacketHit8
+	{
+		alignas(32) float dist[8];
+		alignas(32) float positionX[8];
+		alignas(32) float positionY[8];
+		alignas(32) float positionZ[8];
+		alignas(32) float normalX[8];
+		alignas(32) float normalY[8];
+		alignas(32) float normalZ[8];
+		alignas(32) float exitX[8];
+		alignas(32) float exitY[8];
+		alignas(32) float exitZ[8];
+		// Sphere index for the stream queries.
+		uint32_t index[8];
+
+		Float3 getPosition(uint32_t lane) const { return Float3(positionX[lane], positionY[lane], positionZ[lane]); }
+		Float3 getNormal(uint32_t lane) const { return Float3(normalX[lane], normalY[lane], normalZ[lane]); }
+		Float3 getExit(uint32_t lane) const { return Float3(exitX[lane], exitY[lane], exitZ[lane]); }
+	};
+
+	struct SphereHit
+	{
+		uint32_t index = UINT32_MAX;
+		float dist = 0.0f;
+		Float3 position;
+		Float3 normal;
+		Float3 exit;
+	};
+
+	// Particle spheres in SoA form, padded to a multiple of 8 with spheres that are
+	// never hit. Invisible particles keep their slot so indices match the particle
+	// buffer, they are masked out like trace() skips them. So are planes, the visible
+	// ones are copied to `planes` and tested one by one.
+	struct SphereStream
+	{
+		void fromParticles(const ParticleData* particles, uint32_t particleNum)
+		{
+			num = particleNum;
+			uint32_t paddedNum = (particleNum + 7) & ~7u;
+			Array<float>* streams[] = { &centerX, &centerY, &centerZ, &radius };
+			for (Array<float>* stream : streams)
+			{
+				stream->reset();
+				stream->fill(paddedNum, 0.0f);
+			}
+			visible.reset();
+			visible.fill(paddedNum, 0);
+			planes.reset();
+			planeIndices.reset();
+			for (uint32_t index = 0; index < particleNum; ++index)
+			{
+				const ParticleData& particle = particles[index];
+				centerX[index] = particle.position.x;
+				centerY[index] = particle.position.y;
+				centerZ[index] = particle.position.z;
+				radius[index] = particle.radius;
+				bool isPlane = particle.primitive == PARTICLE_PRIMITIVE_PLANE;
+				visible[index] = particle.visible && !isPlane ? UINT32_MAX : 0;
+				if (particle.visible && isPlane)
+				{
+					planes.add(particle);
+					planeIndices.add(index);
+				}
+			}
+		}
+
+		uint32_t getNum() const { return num; }
+		uint32_t getPaddedNum() const { return (uint32_t)radius.getNum(); }
+		Float3 getCenter(uint32_t index) const { return Float3(centerX[index], centerY[index], centerZ[index]); }
+
+		Array<float> centerX, centerY, centerZ;
+		Array<float> radius;
+		// All bits set for visible spheres.
+		Array<uint32_t> visible;
+		Array<ParticleData> planes;
+		Array<uint32_t> planeIndices;
+
+	private:
+		uint32_t num = 0;
+	};
+
+	namespace simd {
+
+		// intersectsParticle() for one pair, giving exitDist (the far root) instead of
+		// the exit point. The non-SIMD fallback of the kernels below.
+		inline bool intersectScalar(const Float3& origin, const Float3& direction, const Float3& center, float radius, float& dist, float& exitDist)
+		{
+			Float3 oc = origin - center;
+			float a = dot(direction, direction);
+			float b = 2.0f * dot(oc, direction);
+			float c = dot(oc, oc) - radius * radius;
+			float discriminant = b * b - 4.0f * a * c;
+			if (discriminant < 0.0f) return false;
+			float sqrtDiscriminant = sqrtf(discriminant);
+			float t1 = (-b - sqrtDiscriminant) / (2.0f * a);
+			float t2 = (-b + sqrtDiscriminant) / (2.0f * a);
+			dist = t1 > 0.0f ? t1 : t2;
+			exitDist = t1 > t2 ? t1 : t2;
+			return !(dist < 0.0f);
+		}
+
+		// Position, normal and exit of a hit at dist / exitDist, in the operation
+		// order intersectsParticle() uses.
+		inline void getHitGeometry(const Float3& origin, const Float3& direction, const Float3& center, float dist, float exitDist, Float3& position, Float3& normal, Float3& exit)
+		{
+			position = origin + dist * direction;
+			normal = normalize(position - center);
+			exit = origin + exitDist * direction;
+		}
+
+#if NI_SIMD_SSE
+		// 8 float lanes. Comparisons return all bits set per true lane.
+		struct Float8
+		{
+#if NI_SIMD_AVX2
+			__m256 v;
+#else
+			__m128 lo, hi;
+#endif
+		};
+
+#if NI_SIMD_AVX2
+#define NI_FLOAT8_BINARY(name, avx, sse) inline Float8 name(const Float8& a, const Float8& b) { return Float8{ avx(a.v, b.v) }; }
+#define NI_FLOAT8_COMPARE(name, predicate, sse) inline Float8 name(const Float8& a, const Float8& b) { return Float8{ _mm256_cmp_ps(a.v, b.v, predicate) }; }
+#else
+#define NI_FLOAT8_BINARY(name, avx, sse) inline Float8 name(const Float8& a, const Float8& b) { return Float8{ sse(a.lo, b.lo), sse(a.hi, b.hi) }; }
+#define NI_FLOAT8_COMPARE(name, predicate, sse) inline Float8 name(const Float8& a, const Float8& b) { return Float8{ sse(a.lo, b.lo), sse(a.hi, b.hi) }; }
+#endif
+
+		NI_FLOAT8_BINARY(operator+, _mm256_add_ps, _mm_add_ps)
+		NI_FLOAT8_BINARY(operator-, _mm256_sub_ps, _mm_sub_ps)
+		NI_FLOAT8_BINARY(operator*, _mm256_mul_ps, _mm_mul_ps)
+		NI_FLOAT8_BINARY(operator/, _mm256_div_ps, _mm_div_ps)
+		NI_FLOAT8_BINARY(operator&, _mm256_and_ps, _mm_and_ps)
+		NI_FLOAT8_BINARY(operator|, _mm256_or_ps, _mm_or_ps)
+		NI_FLOAT8_BINARY(operator^, _mm256_xor_ps, _mm_xor_ps)
+		// ~a & b
+		NI_FLOAT8_BINARY(andNot, _mm256_andnot_ps, _mm_andnot_ps)
+		// a > b ? a : b, like the scalar max().
+		NI_FLOAT8_BINARY(max, _mm256_max_ps, _mm_max_ps)
+		// a < b ? a : b, like the scalar min().
+		NI_FLOAT8_BINARY(min, _mm256_min_ps, _mm_min_ps)
+		NI_FLOAT8_COMPARE(less, _CMP_LT_OQ, _mm_cmplt_ps)
+		NI_FLOAT8_COMPARE(greater, _CMP_GT_OQ, _mm_cmpgt_ps)
+		// !(a < b), true for NaN like the negated scalar test.
+		NI_FLOAT8_COMPARE(notLess, _CMP_NLT_UQ, _mm_cmpnlt_ps)
+
+#undef NI_FLOAT8_BINARY
+#undef NI_FLOAT8_COMPARE
+
+#if NI_SIMD_AVX2
+		inline Float8 load8(const float* values) { return Float8{ _mm256_loadu_ps(values) }; }
+		inline Float8 load8(const uint32_t* values) { return Float8{ _mm256_castsi256_ps(_mm256_loadu_si256((const __m256i*)values)) }; }
+		inline Float8 set8(float value) { return Float8{ _mm256_set1_ps(value) }; }
+		inline Float8 set8(uint32_t value) { return Float8{ _mm256_castsi256_ps(_mm256_set1_epi32((int)value)) }; }
+		inline void store8(float* values, const Float8& a) { _mm256_storeu_ps(values, a.v); }
+		inline void store8(uint32_t* values, const Float8& a) { _mm256_storeu_si256((__m256i*)values, _mm256_castps_si256(a.v)); }
+		inline Float8 sqrt(const Float8& a) { return Float8{ _mm256_sqrt_ps(a.v) }; }
+		inline Float8 select(const Float8& mask, const Float8& a, const Float8& b) { return Float8{ _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+		inline uint32_t getMask(const Float8& a) { return (uint32_t)_mm256_movemask_ps(a.v); }
+#else
+		inline Float8 load8(const float* values) { return Float8{ _mm_loadu_ps(values), _mm_loadu_ps(values + 4) }; }
+		inline Float8 load8(const uint32_t* values) { return load8((const float*)values); }
+		inline Float8 set8(float value) { return Float8{ _mm_set1_ps(value), _mm_set1_ps(value) }; }
+		inline Float8 set8(uint32_t value) { __m128 bits = _mm_castsi128_ps(_mm_set1_epi32((int)value)); return Float8{ bits, bits }; }
+		inline void store8(float* values, const Float8& a) { _mm_storeu_ps(values, a.lo); _mm_storeu_ps(values + 4, a.hi); }
+		inline void store8(uint32_t* values, const Float8& a) { store8((float*)values, a); }
+		inline Float8 sqrt(const Float8& a) { return Float8{ _mm_sqrt_ps(a.lo), _mm_sqrt_ps(a.hi) }; }
+		inline Float8 select(const Float8& mask, const Float8& a, const Float8& b) { return (mask & a) | andNot(mask, b); }
+		inline uint32_t getMask(const Float8& a) { return (uint32_t)(_mm_movemask_ps(a.lo) | (_mm_movemask_ps(a.hi) << 4)); }
+#endif
+
+		// The quadratic of intersectsParticle() for 8 ray/sphere pairs, oc being the
+		// ray origin minus the sphere center. Returns the hit mask, dist and exitDist
+		// are only meaningful where it is set.
+		inline Float8 intersectLanes(const Float8& ocX, const Float8& ocY, const Float8& ocZ, const Float8& directionX, const Float8& directionY, const Float8& directionZ,
+			const Float8& radius, Float8& dist, Float8& exitDist)
+		{
+			Float8 a = directionX * directionX + directionY * directionY + directionZ * directionZ;
+			Float8 dotOcDirection = ocX * directionX + ocY * directionY + ocZ * directionZ;
+			Float8 b = dotOcDirection + dotOcDirection;
+			Float8 c = (ocX * ocX + ocY * ocY + ocZ * ocZ) - radius * radius;
+			Float8 discriminant = b * b - set8(4.0f) * a * c;
+			Float8 sqrtDiscriminant = sqrt(discriminant);
+			Float8 negativeB = b ^ set8(0x80000000u);
+			Float8 twoA = a + a;
+			Float8 t1 = (negativeB - sqrtDiscriminant) / twoA;
+			Float8 t2 = (negativeB + sqrtDiscriminant) / twoA;
+			Float8 zero = set8(0.0f);
+			dist = select(greater(t1, zero), t1, t2);
+			exitDist = max(t1, t2);
+			return notLess(discriminant, zero) & notLess(dist, zero);
+		}
+#endif
+
+	}
+
+	// The 8 rays of the packet against one sphere, intersectsParticle() per lane.
+	// Returns one bit per hitting ray, hit holds dist, position, normal and exit for
+	// those.
+	inline uint32_t intersectSphere8(const RayPacket8& rays, const Float3& center, float radius, PacketHit8& hit)
+	{
+#if NI_SIMD_SSE
+		using namespace simd;
+		Float8 originX = load8(rays.originX);
+		Float8 originY = load8(rays.originY);
+		Float8 originZ = load8(rays.originZ);
+		Float8 directionX = load8(rays.directionX);
+		Float8 directionY = load8(rays.directionY);
+		Float8 directionZ = load8(rays.directionZ);
+		Float8 centerX = set8(center.x);
+		Float8 centerY = set8(center.y);
+		Float8 centerZ = set8(center.z);
+		Float8 dist, exitDist;
+		uint32_t mask = getMask(intersectLanes(originX - centerX, originY - centerY, originZ - centerZ, directionX, directionY, directionZ, set8(radius), dist, exitDist));
+		if (mask == 0) return 0;
+
+		Float8 positionX = originX + dist * directionX;
+		Float8 positionY = originY + dist * directionY;
+		Float8 positionZ = originZ + dist * directionZ;
+		Float8 normalX = positionX - centerX;
+		Float8 normalY = positionY - centerY;
+		Float8 normalZ = positionZ - centerZ;
+		// normalize() is v * rsqrt(dot(v, v)) with rsqrt(x) = 1 / sqrt(x).
+		Float8 invLength = set8(1.0f) / sqrt(normalX * normalX + normalY * normalY + normalZ * normalZ);
+		store8(hit.dist, dist);
+		store8(hit.positionX, positionX);
+		store8(hit.positionY, positionY);
+		store8(hit.positionZ, positionZ);
+		store8(hit.normalX, normalX * invLength);
+		store8(hit.normalY, normalY * invLength);
+		store8(hit.normalZ, normalZ * invLength);
+		store8(hit.exitX, originX + exitDist * directionX);
+		store8(hit.exitY, originY + exitDist * directionY);
+		store8(hit.exitZ, originZ + exitDist * directionZ);
+		return mask;
+#else
+		uint32_t mask = 0;
+		for (uint32_t lane = 0; lane < 8; ++lane)
+		{
+			Float3 position, normal, exit;
+			float dist = 0.0f;
+			float exitDist = 0.0f;
+			if (!simd::intersectScalar(rays.getOrigin(lane), rays.getDirection(lane), center, radius, dist, exitDist)) continue;
+			simd::getHitGeometry(rays.getOrigin(lane), rays.getDirection(lane), center, dist, exitDist, position, normal, exit);
+			mask |= 1u << lane;
+			hit.dist[lane] = dist;
+			hit.positionX[lane] = position.x;
+			hit.positionY[lane] = position.y;
+			hit.positionZ[lane] = position.z;
+			hit.normalX[lane] = normal.x;
+			hit.normalY[lane] = normal.y;
+			hit.normalZ[lane] = normal.z;
+			hit.exitX[lane] = exit.x;
+			hit.exitY[lane] = exit.y;
+			hit.exitZ[lane] = exit.z;
+		}
+		return mask;
+#endif
+	}
+
+	// One ray against spheres [first, first + 8) of the stream. Returns one bit per
+	// hit visible sphere with its dist and exitDist.
+	inline uint32_t intersectSpheres8(const Float3& origin, const Float3& direction, const SphereStream& spheres, uint32_t first, float* dist, float* exitDist)
+	{
+#if NI_SIMD_SSE
+		using namespace simd;
+		Float8 lanesDist, lanesExitDist;
+		Float8 hit = intersectLanes(set8(origin.x) - load8(&spheres.centerX[first]), set8(origin.y) - load8(&spheres.centerY[first]), set8(origin.z) - load8(&spheres.centerZ[first]),
+			set8(direction.x), set8(direction.y), set8(direction.z), load8(&spheres.radius[first]), lanesDist, lanesExitDist);
+		store8(dist, lanesDist);
+		store8(exitDist, lanesExitDist);
+		return getMask(hit & load8(&spheres.visible[first]));
+#else
+		uint32_t mask = 0;
+		for (uint32_t lane = 0; lane < 8; ++lane)
+		{
+			if (spheres.visible[first + lane] && simd::intersectScalar(origin, direction, spheres.getCenter(first + lane), spheres.radius[first + lane], dist[lane], exitDist[lane]))
+			{
+				mask |= 1u << lane;
+			}
+		}
+		return mask;
+#endif
+	}
+
+	// The stream's planes against one ray. Returns whether any of them is hit, hit is
+	// filled when one is closer than closestIndex at closestDist, UINT32_MAX otherwise.
+	inline bool intersectPlanes(const Float3& origin, const Float3& direction, const SphereStream& spheres, float closestDist, uint32_t closestIndex, SphereHit& hit)
+	{
+		bool isHit = false;
+		hit.index = UINT32_MAX;
+		for (uint32_t plane = 0; plane < spheres.planes.getNum(); ++plane)
+		{
+			uint32_t index = spheres.planeIndices[plane];
+			Float3 position, normal, exit;
+			float dist = 0.0f;
+			if (!shader::intersectsPlane(origin, direction, spheres.planes[plane], position, normal, dist, exit)) continue;
+			isHit = true;
+			if (dist < closestDist || (dist == closestDist && index < closestIndex))
+			{
+				closestDist = dist;
+				closestIndex = index;
+				hit.index = index;
+				hit.dist = dist;
+				hit.position = position;
+				hit.normal = normal;
+				hit.exit = exit;
+			}
+		}
+		return isHit;
+	}
+
+	// Closest visible sphere or plane along the ray, the result trace()'s linear loop gives:
+	// smallest dist, lowest index on a tie. A ray that only hits at a NaN distance
+	// returns true with hit.index UINT32_MAX, where trace() returns true without
+	// writing its outputs.
+	inline bool traceClosest(const Float3& origin, const Float3& direction, const SphereStream& spheres, SphereHit& hit)
+	{
+		bool isHit = false;
+		float closestDist = 3.402823466e+38F;
+		float closestExitDist = 0.0f;
+		uint32_t closestIndex = UINT32_MAX;
+		alignas(32) float dist[8];
+		alignas(32) float exitDist[8];
+		for (uint32_t first = 0; first < spheres.getPaddedNum(); first += 8)
+		{
+			uint32_t mask = intersectSpheres8(origin, direction, spheres, first, dist, exitDist);
+			isHit |= mask != 0;
+			for (uint32_t lane = 0; mask != 0 && lane < 8; ++lane)
+			{
+				if ((mask & (1u << lane)) && dist[lane] < closestDist)
+				{
+					closestDist = dist[lane];
+					closestExitDist = exitDist[lane];
+					closestIndex = first + lane;
+				}
+			}
+		}
+		SphereHit planeHit;
+		isHit |= intersectPlanes(origin, direction, spheres, closestDist, closestIndex, planeHit);
+		if (!isHit) return false;
+		if (planeHit.index != UINT32_MAX)
+		{
+			hit = planeHit;
+			return true;
+		}
+		hit.index = closestIndex;
+		if (closestIndex == UINT32_MAX) return true;
+		hit.dist = closestDist;
+		simd::getHitGeometry(origin, direction, spheres.getCenter(closestIndex), closestDist, closestExitDist, hit.position, hit.normal, hit.exit);
+		return true;
+	}
+
+	// traceClosest() for the 8 rays of a packet, sweeping the stream once with every
+	// sphere tested against all 8 rays. Returns one bit per hitting ray.
+	inline uint32_t traceClosest8(const RayPacket8& rays, const SphereStream& spheres, PacketHit8& hit)
+	{
+		alignas(32) float closestExitDist[8];
+#if NI_SIMD_SSE
+		using namespace simd;
+		Float8 originX = load8(rays.originX);
+		Float8 originY = load8(rays.originY);
+		Float8 originZ = load8(rays.originZ);
+		Float8 directionX = load8(rays.directionX);
+		Float8 directionY = load8(rays.directionY);
+		Float8 directionZ = load8(rays.directionZ);
+		Float8 closestDist = set8(3.402823466e+38F);
+		Float8 exitDist = set8(0.0f);
+		Float8 closestIndex = set8(UINT32_MAX);
+		Float8 anyHit = set8(0.0f);
+		for (uint32_t index = 0; index < spheres.getNum(); ++index)
+		{
+			if (!spheres.visible[index]) continue;
+			Float8 dist, sphereExitDist;
+			Float8 sphereHit = intersectLanes(originX - set8(spheres.centerX[index]), originY - set8(spheres.centerY[index]), originZ - set8(spheres.centerZ[index]),
+				directionX, directionY, directionZ, set8(spheres.radius[index]), dist, sphereExitDist);
+			anyHit = anyHit | sphereHit;
+			Float8 closer = sphereHit & less(dist, closestDist);
+			closestDist = select(closer, dist, closestDist);
+			exitDist = select(closer, sphereExitDist, exitDist);
+			closestIndex = select(closer, set8(index), closestIndex);
+		}
+		uint32_t mask = getMask(anyHit);
+		store8(hit.dist, closestDist);
+		store8(closestExitDist, exitDist);
+		store8(hit.index, closestIndex);
+#else
+		uint32_t mask = 0;
+		for (uint32_t lane = 0; lane < 8; ++lane)
+		{
+			hit.dist[lane] = 3.402823466e+38F;
+			hit.index[lane] = UINT32_MAX;
+			for (uint32_t index = 0; index < spheres.getNum(); ++index)
+			{
+				float dist = 0.0f;
+				float exitDist = 0.0f;
+				if (!spheres.visible[index] || !simd::intersectScalar(rays.getOrigin(lane), rays.getDirection(lane), spheres.getCenter(index), spheres.radius[index], dist, exitDist)) continue;
+				mask |= 1u << lane;
+				if (dist < hit.dist[lane])
+				{
+					hit.dist[lane] = dist;
+					hit.index[lane] = index;
+					closestExitDist[lane] = exitDist;
+				}
+			}
+		}
+#endif
+		for (uint32_t lane = 0; lane < 8; ++lane)
+		{
+			SphereHit planeHit;
+			if (intersectPlanes(rays.getOrigin(lane), rays.getDirection(lane), spheres, hit.dist[lane], hit.index[lane], planeHit)) mask |= 1u << lane;
+			Float3 position, normal, exit;
+			if (planeHit.index != UINT32_MAX)
+			{
+				hit.index[lane] = planeHit.index;
+				hit.dist[lane] = planeHit.dist;
+				position = planeHit.position;
+				normal = planeHit.normal;
+				exit = planeHit.exit;
+			}
+			else if ((mask & (1u << lane)) && hit.index[lane] != UINT32_MAX)
+			{
+				simd::getHitGeometry(rays.getOrigin(lane), rays.getDirection(lane), spheres.getCenter(hit.index[lane]), hit.dist[lane], closestExitDist[lane], position, normal, exit);
+			}
+			else
+			{
+				continue;
+			}
+			hit.positionX[lane] = position.x;
+			hit.positionY[lane] = position.y;
+			hit.positionZ[lane] = position.z;
+			hit.normalX[lane] = normal.x;
+			hit.normalY[lane] = normal.y;
+			hit.normalZ[lane] = normal.z;
+			hit.exitX[lane] = exit.x;
+			hit.exitY[lane] = exit.y;
+			hit.exitZ[lane] = exit.z;
+		}
+		return mask;
+	}
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// Buffers for the light reservoirs of shaders/Restir.hlsli. restirInitial() writes
+// one reservoir and one surface per pixel in the base pass, restirSpatial() reads
+// them in a second pass over the same pixels and writes the reservoir that is
+// shaded. That one and its surface are next frame's history, so the surfaces and
+// outputs are kept twice and swapped every frame. A resize drops the history.
+
+#include "shaderport.h"
+
+namespace ni {
+
+	struct LightResampler
+	{
+		void resize(uint32_t newWidth, uint32_t newHeight)
+		{
+			if (newWidth == width && newHeight == height) return;
+			width = newWidth;
+			height = newHeight;
+			reservoirs.reset();
+			reservoirs.fill(width * height, LightReservoir{});
+			for (uint32_t index = 0; index < 2; ++index)
+			{
+				surfaces[index].reset();
+				surfaces[index].fill(width * height, RestirSurface{});
+				outputs[index].reset();
+				outputs[index].fill(width * height, LightReservoir{});
+			}
+			historyValid = false;
+		}
+
+		// For both passes of a frame, before the shader code runs on this thread.
+		void bind()
+		{
+			uint32_t previous = 1 - current;
+			shader::bindRestir(reservoirs.getData(), surfaces[current].getData(), historyValid ? outputs[previous].getData() : nullptr,
+				historyValid ? surfaces[previous].getData() : nullptr, outputs[current].getData(), width);
+		}
+
+		// Once restirSpatial() ran for every pixel, makes this frame the history.
+		void endFrame()
+		{
+			current = 1 - current;
+			historyValid = true;
+		}
+
+		// Drops the history, for a camera cut.
+		void resetHistory() { historyValid = false; }
+		bool hasHistory() const { return historyValid; }
+
+	private:
+		uint32_t width = 0;
+		uint32_t height = 0;
+		uint32_t current = 0;
+		bool historyValid = false;
+		Array<LightReservoir> reservoirs;
+		Array<RestirSurface> surfaces[2];
+		Array<LightReservoir> outputs[2];
+	};
+
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+// Compiles the shared shader sources as C++ so the CPU runs the exact same scene,
+// material, simulation and path tracing code as the GPU. The .hlsli files are
+// included inside ni::shader, which makes unqualified calls (dot, frac, lerp...)
+// resolve to the overloads from hlsl.h before anything in the global namespace.
+//
+// Resources are plain thread_local bindings. A CPU "dispatch" binds them on each
+// worker and then calls the same entry functions the compute shaders call.
+
+#ifndef IS_CPU
+#define IS_CPU 1
+#endif
+#define PARTICLE_BVH 1
+#define PARTICLE_LIGHTS 1
+#define PARTICLE_ADAPTIVE_SAMPLING 1
+#define PARTICLE_TILE_BINS 1
+#define PARTICLE_SPLATS 1
+#define PARTICLE_NOISE_VOLUME 1
+#define PARTICLE_RESTIR 1
+
+#include "hlsl.h"
+#include "cpudispatch.h"
+#include "../shaders/ParticleConfig.h"
+
+namespace ni {
+	namespace shader {
+
+		inline thread_local ParticleData* particles = nullptr;
+		inline thread_local SimulationData simData = {};
+		inline thread_local ParticleSceneData particleScene = {};
+		inline thread_local ConstantBufferData constantData = {};
+		// Particle BVH from code/bvh.h, trace() falls back to the linear loop while
+		// bvhNodeNum is 0. The first bvhPlaneNum primitives are the planes, which
+		// are not in the tree.
+		inline thread_local const BvhNode* bvhNodes = nullptr;
+		inline thread_local const uint* bvhPrimitives = nullptr;
+		inline thread_local uint bvhNodeNum = 0;
+		inline thread_local uint bvhPlaneNum = 0;
+		// Emissive particles from code/lights.h, no light sampling while lightNum is 0.
+		inline thread_local const LightData* lights = nullptr;
+		inline thread_local uint lightNum = 0;
+		inline thread_local float lightPowerSum = 0.0f;
+		// Sample count map from code/adaptive.h, constantData.sampleCount everywhere while
+		// tileColumnNum is 0.
+		inline thread_local const uint* tileSampleCounts = nullptr;
+		inline thread_local uint tileColumnNum = 0;
+		// Screen space tile bins from code/tilebins.h for the camera rays, trace() for
+		// them as well while binColumnNum is 0.
+		inline thread_local const uint* binOffsets = nullptr;
+		inline thread_local const uint* binParticles = nullptr;
+		inline thread_local const uint* binGlobalParticles = nullptr;
+		inline thread_local uint binGlobalNum = 0;
+		inline thread_local uint binColumnNum = 0;
+		// Splat buffer from code/splat.h, which the camera rays read rather than trace
+		// while splatWidth is not 0.
+		inline thread_local const uint* splatParticles = nullptr;
+		inline thread_local uint splatWidth = 0;
+		// Noise lattice from code/noisevolume.h, unused while noiseLatticeExtent is 0.
+		inline thread_local const float* noiseLattice = nullptr;
+		inline thread_local uint noiseLatticeExtent = 0;
+		// Light reservoirs from code/restir.h, off while restirWidth is 0.
+		inline thread_local LightReservoir* restirReservoirs = nullptr;
+		inline thread_local RestirSurface* restirSurfaces = nullptr;
+		inline thread_local const LightReservoir* restirHistory = nullptr;
+		inline thread_local const RestirSurface* restirHistorySurfaces = nullptr;
+		inline thread_local LightReservoir* restirOutput = nullptr;
+		inline thread_local uint restirWidth = 0;
+		inline thread_local uint restirHistoryValid = 0;
+		// trace() calls on this thread, for rays per second numbers.
+		inline thread_local uint64_t rayNum = 0;
+		// Of those, the ones tracePrimary() shot from the camera.
+		inline thread_local uint64_t cameraRayNum = 0;
+		// pathtrace() calls on this thread by the number of surfaces the path hit.
+		inline thread_local uint64_t pathLengthNums[PATH_MAX_BOUNCE_NUM + 1] = {};
+
+		namespace {
+#include "../shaders/Simulate.hlsli"
+#include "../shaders/Noise.hlsli"
+#include "../shaders/scenes/scene0/Material0.hlsli"
+#include "../shaders/PathTrace.hlsli"
+#include "../shaders/GBuffer.hlsli"
+
+		inline void bindSimulation(ParticleData* particleData, const SimulationData& simulationData, const ParticleSceneData& sceneData)
+		{
+			particles = particleData;
+			simData = simulationData;
+			particleScene = sceneData;
+		}
+
+		// Matrices are expected in the layout fp2025.cpp uploads, see columnMajor().
+		inline void bindBasePass(ParticleData* particleData, const ConstantBufferData& constantBufferData, const SimulationData& simulationData, const ParticleSceneData& sceneData)
+		{
+			bindSimulation(particleData, simulationData, sceneData);
+			constantData = constantBufferData;
+			constantData.invViewProjMtx = columnMajor(constantBufferData.invViewProjMtx);
+			constantData.prevInvViewProjMtx = columnMajor(constantBufferData.prevInvViewProjMtx);
+			constantData.viewMtx = columnMajor(constantBufferData.viewMtx);
+			constantData.viewProjMtx = columnMajor(constantBufferData.viewProjMtx);
+			constantData.prevViewProjMtx = columnMajor(constantBufferData.prevViewProjMtx);
+		}
+
+		// Pass nullptr/0 to trace without the BVH.
+		inline void bindBvh(const BvhNode* nodes, const uint* primitives, uint nodeNum, uint planeNum)
+		{
+			bvhNodes = nodes;
+			bvhPrimitives = primitives;
+			bvhNodeNum = nodeNum;
+			bvhPlaneNum = planeNum;
+		}
+
+		// Pass nullptr/0 to leave lights to the bounces that happen to hit them.
+		inline void bindLights(const LightData* lightData, uint num, float powerSum)
+		{
+			lights = lightData;
+			lightNum = num;
+			lightPowerSum = powerSum;
+		}
+
+		// Pass nullptr/0 to take constantData.sampleCount samples everywhere.
+		inline void bindSampleCounts(const uint* sampleCounts, uint columnNum)
+		{
+			tileSampleCounts = sampleCounts;
+			tileColumnNum = columnNum;
+		}
+
+		// Pass nullptr/0 to trace camera rays like every other ray.
+		inline void bindTileBins(const uint* offsets, const uint* particleIndices, const uint* globalParticles, uint globalNum, uint columnNum)
+		{
+			binOffsets = offsets;
+			binParticles = particleIndices;
+			binGlobalParticles = globalParticles;
+			binGlobalNum = globalNum;
+			binColumnNum = columnNum;
+		}
+
+		// Pass nullptr/0 to trace camera rays again.
+		inline void bindSplats(const uint* particleIndices, uint width)
+		{
+			splatParticles = particleIndices;
+			splatWidth = width;
+		}
+
+		// Pass nullptr/0 to evaluate every noise hash.
+		inline void bindNoiseVolume(const float* lattice, uint extent)
+		{
+			noiseLattice = lattice;
+			noiseLatticeExtent = extent;
+		}
+
+		// Pass nullptr/0 to sample the camera hit's direct light in pathtrace() again.
+		// history/historySurfaces may be null when there is no last frame.
+		inline void bindRestir(LightReservoir* reservoirs, RestirSurface* surfaces, const LightReservoir* history, const RestirSurface* historySurfaces,
+			LightReservoir* output, uint width)
+		{
+			restirReservoirs = reservoirs;
+			restirSurfaces = surfaces;
+			restirHistory = history;
+			restirHistorySurfaces = historySurfaces;
+			restirOutput = output;
+			restirWidth = width;
+			restirHistoryValid = history != nullptr && historySurfaces != nullptr ? 1 : 0;
+		}
+
+		// Drops every buffer binding on this thread. A dispatch over buffers that don't
+		// outlive it calls this when its group ends, so no later shader call on the
+		// worker reads them.
+		inline void unbind()
+		{
+			particles = nullptr;
+			bindBvh(nullptr, nullptr, 0, 0);
+			bindLights(nullptr, 0, 0.0f);
+			bindSampleCounts(nullptr, 0);
+			bindTileBins(nullptr, nullptr, nullptr, 0, 0);
+			bindSplats(nullptr, 0);
+			bindNoiseVolume(nullptr, 0);
+			bindRestir(nullptr, nullptr, nullptr, nullptr, nullptr, 0);
+		}
+
+		// CPU version of SimulateCS main(). HLSL static globals start from their
+		// initializer on every invocation, so the seed is reset before running.
+		inline void simulateCS(uint3 DTid)
+		{
+			seed = float3(1, 1, 1);
+			simulateParticle(DTid.x);
+		}
+
+		// Runs SimulateCS for every particle on the calling thread, in thread order.
+		inline void simulateSerial(ParticleData* particleData, const SimulationData& simulationData, const ParticleSceneData& sceneData)
+		{
+			bindSimulation(particleData, simulationData, sceneData);
+			for (uint32_t index = 0; index < sceneData.numParticles; ++index)
+			{
+				simulateCS(uint3(index, 0, 0));
+			}
+		}
+
+		// SimulateCS over the same [numthreads(32, 1, 1)] grid fp2025.cpp dispatches.
+		// Just like on the GPU, threads read particles that other threads are writing
+		// in place, so the result of a simulation step depends on scheduling.
+		inline DispatchStats dispatchSimulateCS(WorkerPool& pool, ParticleData* particleData, const SimulationData& simulationData, const ParticleSceneData& sceneData)
+		{
+			return cpuDispatch<32, 1, 1>(pool, sceneData.numParticles / 32, 1, 1, [&](const ThreadContext& context)
+			{
+				if (context.groupIndex == 0) bindSimulation(particleData, simulationData, sceneData);
+				simulateCS(context.dispatchThreadID);
+			});
+		}
+
+		}
+	}
+}
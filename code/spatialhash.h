@@ -0,0 +1,264 @@
+#pragma once
+
+// Uniform grid broadphase for the particle simulation. The grid is rebuilt every
+// step with a counting sort of particles into hashed cells, so only particles in
+// the cells around a sphere are handed to the narrowphase instead of all of
+// them. Spheres above largeRadius (the radius 999 walls of scene 0) would overlap
+// every cell, so they are kept in a separate list that is always tested. When
+// particles are updated in place, rebin() files a particle that crossed into
+// another cell under its new one, so the grid stays exact for the whole step.
+
+#include "shaderport.h"
+
+#include <algorithm>
+
+namespace ni {
+
+	struct SpatialHash
+	{
+		float largeRadius = 64.0f;
+		// Cells are this much bigger than the largest small sphere. The extra is the
+		// slack a particle may move while its candidates from one gather are used.
+		float cellMargin = 1.25f;
+
+		void build(const ParticleData* particles, uint32_t particleNum)
+		{
+			num = particleNum;
+			largeParticles.reset();
+			rebinned.reset();
+			maxSmallRadius = 0.0f;
+			for (uint32_t index = 0; index < particleNum; ++index)
+			{
+				if (particles[index].radius > largeRadius) largeParticles.add(index);
+				else maxSmallRadius = max(maxSmallRadius, particles[index].radius);
+			}
+			cellSize = max(maxSmallRadius * 2.0f * cellMargin, 1e-3f);
+			invCellSize = 1.0f / cellSize;
+
+			tableSize = 64;
+			while (tableSize < particleNum * 2) tableSize *= 2;
+
+			cellStart.reset();
+			for (uint32_t index = 0; index <= tableSize; ++index) cellStart.add(0);
+			rebinnedHead.reset();
+			for (uint32_t index = 0; index < tableSize; ++index) rebinnedHead.add(UINT32_MAX);
+			particleCell.reset();
+			for (uint32_t index = 0; index < particleNum; ++index)
+			{
+				const ParticleData& particle = particles[index];
+				uint32_t cell = UINT32_MAX;
+				if (particle.radius <= largeRadius)
+				{
+					cell = hashCell(cellCoord(particle.position.x), cellCoord(particle.position.y), cellCoord(particle.position.z));
+					cellStart[cell + 1]++;
+				}
+				particleCell.add(cell);
+			}
+			for (uint32_t index = 0; index < tableSize; ++index)
+			{
+				cellStart[index + 1] += cellStart[index];
+			}
+
+			// Scatter in index order so every cell lists its particles ascending.
+			cellCursor.reset();
+			for (uint32_t index = 0; index < tableSize; ++index) cellCursor.add(cellStart[index]);
+			cellEntries.reset();
+			for (uint32_t index = 0; index < cellStart[tableSize]; ++index) cellEntries.add(0);
+			for (uint32_t index = 0; index < particleNum; ++index)
+			{
+				if (particleCell[index] != UINT32_MAX)
+				{
+					cellEntries[cellCursor[particleCell[index]]++] = index;
+				}
+			}
+		}
+
+		// Fills out with every particle that can touch the sphere, ascending and without
+		// duplicates. Always includes the large list. A large sphere gets everything.
+		// slack widens the search, for a querying particle that keeps moving while it
+		// uses the candidates.
+		void gatherCandidates(const float3& position, float radius, Array<uint32_t>& out, float slack = 0.0f) const
+		{
+			out.reset();
+			float reach = radius + maxSmallRadius + slack;
+			int32_t x0 = cellCoord(position.x - reach), x1 = cellCoord(position.x + reach);
+			int32_t y0 = cellCoord(position.y - reach), y1 = cellCoord(position.y + reach);
+			int32_t z0 = cellCoord(position.z - reach), z1 = cellCoord(position.z + reach);
+			uint64_t cellNum = (uint64_t)(x1 - x0 + 1) * (y1 - y0 + 1) * (z1 - z0 + 1);
+			if (radius > largeRadius || cellNum > tableSize)
+			{
+				for (uint32_t index = 0; index < num; ++index) out.add(index);
+				return;
+			}
+
+			uint32_t visited[64];
+			uint32_t visitedNum = 0;
+			for (int32_t z = z0; z <= z1; ++z)
+			{
+				for (int32_t y = y0; y <= y1; ++y)
+				{
+					for (int32_t x = x0; x <= x1; ++x)
+					{
+						// Different cells can land in the same bucket, only walk it once.
+						uint32_t cell = hashCell(x, y, z);
+						bool seen = false;
+						for (uint32_t index = 0; index < visitedNum; ++index) seen |= visited[index] == cell;
+						if (seen) continue;
+						if (visitedNum < 64) visited[visitedNum++] = cell;
+						// Entries of particles rebinned since build() are stale.
+						for (uint32_t entry = cellStart[cell]; entry < cellStart[cell + 1]; ++entry)
+						{
+							if (particleCell[cellEntries[entry]] == cell) out.add(cellEntries[entry]);
+						}
+						for (uint32_t node = rebinnedHead[cell]; node != UINT32_MAX; node = rebinned[node].next)
+						{
+							if (particleCell[rebinned[node].index] == cell) out.add(rebinned[node].index);
+						}
+					}
+				}
+			}
+			for (uint32_t index = 0; index < largeParticles.getNum(); ++index)
+			{
+				out.add(largeParticles[index]);
+			}
+			// A particle that went back to a bucket it was in is listed there twice.
+			uint32_t* begin = out.getData();
+			uint32_t* end = begin + out.getNum();
+			std::sort(begin, end);
+			uint32_t uniqueNum = (uint32_t)(std::unique(begin, end) - begin);
+			while (out.getNum() > uniqueNum) out.pop();
+		}
+
+		// For in-place updates: files a particle under the cell of its new position, so
+		// queries after it find it there and no longer where build() put it.
+		void rebin(uint32_t index, const float3& position)
+		{
+			if (particleCell[index] == UINT32_MAX) return;
+			uint32_t cell = hashCell(cellCoord(position.x), cellCoord(position.y), cellCoord(position.z));
+			if (cell == particleCell[index]) return;
+			particleCell[index] = cell;
+			rebinned.add(RebinnedNode{ index, rebinnedHead[cell] });
+			rebinnedHead[cell] = (uint32_t)rebinned.getNum() - 1;
+		}
+
+		float getCellSize() const { return cellSize; }
+		uint32_t getTableSize() const { return tableSize; }
+		uint32_t getLargeNum() const { return (uint32_t)largeParticles.getNum(); }
+		uint32_t getRebinnedNum() const { return (uint32_t)rebinned.getNum(); }
+
+	private:
+		struct RebinnedNode
+		{
+			uint32_t index;
+			uint32_t next;
+		};
+
+		int32_t cellCoord(float value) const { return (int32_t)floorf(value * invCellSize); }
+
+		uint32_t hashCell(int32_t x, int32_t y, int32_t z) const
+		{
+			uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u) ^ ((uint32_t)z * 83492791u);
+			return hash & (tableSize - 1);
+		}
+
+		Array<uint32_t> cellStart;
+		Array<uint32_t> cellCursor;
+		Array<uint32_t> cellEntries;
+		Array<uint32_t> particleCell;
+		Array<uint32_t> largeParticles;
+		// Per bucket lists of the particles rebin() moved there.
+		Array<uint32_t> rebinnedHead;
+		Array<RebinnedNode> rebinned;
+		float maxSmallRadius = 0.0f;
+		float cellSize = 1.0f;
+		float invCellSize = 1.0f;
+		uint32_t tableSize = 0;
+		uint32_t num = 0;
+	};
+
+	// Cheap reject in front of the narrowphase that only touches position and radius.
+	// Both collision responses do nothing unless the spheres overlap, the small
+	// tolerance keeps this conservative against their own rounding. Planes are
+	// always passed on, there are only a handful of them.
+	inline bool mayCollide(const ParticleData& a, const ParticleData& b)
+	{
+		if (a.primitive != PARTICLE_PRIMITIVE_SPHERE || b.primitive != PARTICLE_PRIMITIVE_SPHERE) return true;
+		Float3 delta = a.position - b.position;
+		float radiusSum = a.radius + b.radius;
+		return delta.x * delta.x + delta.y * delta.y + delta.z * delta.z <= radiusSum * radiusSum * 1.0001f + 1e-6f;
+	}
+
+	struct BroadphaseStats
+	{
+		double buildSeconds = 0.0;
+		double stepSeconds = 0.0;
+		uint64_t pairTestNum = 0;
+	};
+
+	namespace shader {
+		namespace {
+
+		// One simulation step like simulateSerial, but simScene's loop over every
+		// particle is replaced by the grid candidates. Candidates are visited in index
+		// order, the same order the full loop uses, so the result matches simulateSerial.
+		inline BroadphaseStats simulateBroadphase(SpatialHash& grid, Array<uint32_t>& candidates, ParticleData* particleData, const SimulationData& simulationData, const ParticleSceneData& sceneData)
+		{
+			// Below this the grid costs more than it saves (-bench broadphase).
+			const uint32_t bruteForceMaxNum = 256;
+			BroadphaseStats stats = {};
+			double start = getSeconds();
+			if (simulationData.frame == 0 || sceneData.numParticles <= bruteForceMaxNum)
+			{
+				simulateSerial(particleData, simulationData, sceneData);
+				stats.stepSeconds = getSeconds() - start;
+				stats.pairTestNum = simulationData.frame == 0 ? 0 : (uint64_t)sceneData.numParticles * sceneData.numParticles;
+				return stats;
+			}
+
+			bindSimulation(particleData, simulationData, sceneData);
+			grid.build(particleData, sceneData.numParticles);
+			stats.buildSeconds = getSeconds() - start;
+
+			// Particles are updated in place. Each one is rebinned once it is done, so
+			// the grid always has every particle in the cell it is in now.
+			float slack = grid.getCellSize() * (1.0f - 1.0f / grid.cellMargin) * 0.5f;
+			for (uint32_t pid = 0; pid < sceneData.numParticles; ++pid)
+			{
+				seed = float3(1, 1, 1);
+				ParticleData particle = particles[pid];
+				uint sceneId = beginParticle(pid, particle);
+				integrateScene(sceneId, particle, simData.scene, simData.time);
+				if (particle.dynamic)
+				{
+					// The particle itself moves while it resolves its collisions. Once it is
+					// further than the slack from where the candidates were gathered, gather
+					// again and carry on after the last index tested.
+					float3 queryPosition = particle.position;
+					grid.gatherCandidates(queryPosition, particle.radius, candidates, slack);
+					stats.pairTestNum += candidates.getNum();
+					uint32_t index = 0;
+					while (index < candidates.getNum())
+					{
+						uint32_t other = candidates[index++];
+						if (other == pid || !mayCollide(particle, particles[other])) continue;
+						collideScene(particle, particles[other], simData.scene);
+						if (length(particle.position - queryPosition) > slack)
+						{
+							queryPosition = particle.position;
+							grid.gatherCandidates(queryPosition, particle.radius, candidates, slack);
+							stats.pairTestNum += candidates.getNum();
+							index = 0;
+							while (index < candidates.getNum() && candidates[index] <= other) index++;
+						}
+					}
+				}
+				particles[pid] = particle;
+				grid.rebin(pid, particle.position);
+			}
+			stats.stepSeconds = getSeconds() - start;
+			return stats;
+		}
+
+		}
+	}
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+// Sphere splatting for the camera rays (shaders/Splat.hlsli). Instead of every
+// pixel testing the spheres of its tile, every sphere is drawn over the pixel
+// rectangle ParticleTileBins projected it to, with the exact ray/sphere hit as its
+// per pixel depth, so primary visibility costs the covered pixels rather than
+// pixels times spheres. The tiles are the units of work: a worker takes one, keeps
+// its depth and particle index in a tile sized buffer and splats the tile's list
+// front to back, so a pixel skips a sphere that starts behind its closest hit.
+// The global list (planes and spheres around the camera) is tested at every pixel.
+// The result is the same particle per pixel as the traced camera ray, ties to the
+// lower index included.
+
+#include "shaderport.h"
+#include "tilebins.h"
+
+#include <float.h>
+
+namespace ni {
+
+	struct SplatStats
+	{
+		double seconds = 0.0;
+		// Ray/sphere tests, global list included.
+		uint64_t testNum = 0;
+	};
+
+	struct ParticleSplats
+	{
+		// bins must be built for the same particles and constantBufferData.
+		SplatStats rasterize(WorkerPool& pool, const ParticleData* particles, const ConstantBufferData& constantBufferData, const ParticleTileBins& bins)
+		{
+			double start = getSeconds();
+			width = (uint32_t)constantBufferData.resolution.x;
+			uint32_t height = (uint32_t)constantBufferData.resolution.y;
+			uint32_t columnNum = bins.getColumnNum();
+			uint32_t tileNum = columnNum * ((height + TILE_BIN_SIZE - 1) / TILE_BIN_SIZE);
+			Float4x4 invViewProjMtx = columnMajor(constantBufferData.invViewProjMtx);
+			Float3 cameraPos = constantBufferData.cameraPos;
+			Float2 resolution(constantBufferData.resolution.x, constantBufferData.resolution.y);
+			const uint32_t* offsets = bins.getOffsets();
+			const uint32_t* binParticles = bins.getParticles();
+			const uint32_t* globalParticles = bins.getGlobalParticles();
+			uint32_t globalNum = bins.getGlobalNum();
+
+			if (particleIndices.getNum() != width * height)
+			{
+				particleIndices.reset();
+				particleIndices.fill(width * height, SPLAT_MISS);
+			}
+			testNums.reset();
+			testNums.fill(pool.getWorkerNum(), 0);
+			pool.parallelFor(tileNum, [&](uint64_t tile, uint32_t workerIndex)
+			{
+				int32_t tileX = (int32_t)(tile % columnNum) * TILE_BIN_SIZE;
+				int32_t tileY = (int32_t)(tile / columnNum) * TILE_BIN_SIZE;
+				int32_t tileWidth = min(TILE_BIN_SIZE, (int32_t)width - tileX);
+				int32_t tileHeight = min(TILE_BIN_SIZE, (int32_t)height - tileY);
+				Float3 directions[TILE_BIN_SIZE * TILE_BIN_SIZE];
+				float depths[TILE_BIN_SIZE * TILE_BIN_SIZE];
+				uint32_t indices[TILE_BIN_SIZE * TILE_BIN_SIZE];
+				for (int32_t y = 0; y < tileHeight; ++y)
+				{
+					for (int32_t x = 0; x < tileWidth; ++x)
+					{
+						// As shadeBasePass() makes the camera ray.
+						Float3 rayOrigin;
+						Float2 uv = Float2((float)(tileX + x), (float)(tileY + y)) / resolution;
+						shader::createRayFromUV(uv, invViewProjMtx, cameraPos, rayOrigin, directions[y * TILE_BIN_SIZE + x]);
+						depths[y * TILE_BIN_SIZE + x] = FLT_MAX;
+						indices[y * TILE_BIN_SIZE + x] = SPLAT_MISS;
+					}
+				}
+
+				uint64_t testNum = 0;
+				for (uint32_t global = 0; global < globalNum; ++global)
+				{
+					uint32_t index = globalParticles[global];
+					for (int32_t y = 0; y < tileHeight; ++y)
+					{
+						for (int32_t x = 0; x < tileWidth; ++x)
+						{
+							splat(particles[index], index, cameraPos, directions, depths, indices, y * TILE_BIN_SIZE + x);
+						}
+					}
+					testNum += tileWidth * tileHeight;
+				}
+
+				for (uint32_t entry = offsets[tile]; entry < offsets[tile + 1]; ++entry)
+				{
+					uint32_t index = binParticles[entry];
+					Int2 pixelMin, pixelMax;
+					bins.getPixelRect(index, pixelMin, pixelMax);
+					int32_t x0 = max(pixelMin.x - tileX, 0);
+					int32_t y0 = max(pixelMin.y - tileY, 0);
+					int32_t x1 = min(pixelMax.x - tileX, tileWidth - 1);
+					int32_t y1 = min(pixelMax.y - tileY, tileHeight - 1);
+					// Same bound as traceTileBins() stops at.
+					float nearDepth = asfloat(shader::getTileBinDepthKey(particles[index], cameraPos) << 15) * TILE_BIN_DEPTH_SLACK;
+					for (int32_t y = y0; y <= y1; ++y)
+					{
+						for (int32_t x = x0; x <= x1; ++x)
+						{
+							uint32_t pixel = y * TILE_BIN_SIZE + x;
+							if (nearDepth > depths[pixel]) continue;
+							splat(particles[index], index, cameraPos, directions, depths, indices, pixel);
+							testNum++;
+						}
+					}
+				}
+
+				for (int32_t y = 0; y < tileHeight; ++y)
+				{
+					memcpy(&particleIndices[(tileY + y) * width + tileX], &indices[y * TILE_BIN_SIZE], tileWidth * sizeof(uint32_t));
+				}
+				testNums[workerIndex] += testNum;
+			});
+
+			SplatStats stats = {};
+			stats.seconds = getSeconds() - start;
+			for (uint32_t index = 0; index < testNums.getNum(); ++index) stats.testNum += testNums[index];
+			return stats;
+		}
+
+		// One particle index per pixel, SPLAT_MISS where the camera ray hits nothing.
+		const uint32_t* getParticleIndices() const { return particleIndices.getData(); }
+		uint32_t getWidth() const { return width; }
+
+	private:
+		static void splat(const ParticleData& particle, uint32_t index, const Float3& cameraPos, const Float3* directions, float* depths, uint32_t* indices, uint32_t pixel)
+		{
+			Float3 position, normal, exit;
+			float depth = 0.0f;
+			if (!particle.visible || !shader::intersectsParticle(cameraPos, directions[pixel], particle, position, normal, depth, exit)) return;
+			if (depth < depths[pixel] || (depth == depths[pixel] && index < indices[pixel]))
+			{
+				depths[pixel] = depth;
+				indices[pixel] = index;
+			}
+		}
+
+		uint32_t width = 0;
+		Array<uint32_t> particleIndices;
+		Array<uint64_t> testNums;
+	};
+
+}
@@ -0,0 +1,280 @@
+#pragma once
+
+// CPU version of TemporalAACS, the Playdead style resolve. resolveScalar() is
+// main() line by line, the reference. resolve() works on tileWidth x tileHeight
+// tiles spread over the worker pool: a tile and its one pixel halo of the current
+// frame go to YCoCg once, one plane per channel and clamped at the border like
+// GetCurrentFrame(), so the 3x3 box and the cross of 8 neighbouring pixels are
+// unaligned loads. The bilinear history fetch follows the velocity and stays per
+// pixel, the rest is 8 pixels at a time with the reference's operations in its
+// order, so the two match bit for bit (`-bench taa` checks it). Without SSE
+// resolve() runs the reference.
+//
+// The YCoCg matrices are applied the way mul(float3x3(...), v) reads them in
+// HLSL, by rows. They invert each other, and x, the luma the blend weighs, is
+// 0.25 r + 0.5 g - 0.25 b.
+//
+// Two reads differ from TemporalAACS as it stands. The shader divides the
+// velocity by Resolution and indexes HistoryBuffer with prevUv, which truncates
+// the uv to a texel. The port takes the velocity in uv, the way the base pass
+// writes it (getPrimaryVelocity()), and fetches the history bilinearly with
+// clamp, like SampleLevel with a linear clamp sampler.
+
+#include "shaderport.h"
+#include "cputexture.h"
+#include "raysimd.h"
+
+namespace ni {
+
+	struct TemporalAAStats
+	{
+		double seconds = 0.0;
+		uint64_t pixelNum = 0;
+
+		double getMegapixelsPerSecond() const { return seconds > 0.0 ? pixelNum / seconds / 1e6 : 0.0; }
+	};
+
+	struct TemporalAA
+	{
+		static constexpr uint32_t tileWidth = 32;
+		static constexpr uint32_t tileHeight = 16;
+		// FEEDBACK_FACTOR_MIN and GlobalBlendFactor of the shader.
+		static constexpr float feedbackMin = 0.88f;
+		static constexpr float globalBlendFactor = 1.0f;
+
+		static Float4 toYCoCg(const Float4& rgba)
+		{
+			return Float4(0.25f * rgba.x + 0.5f * rgba.y - 0.25f * rgba.z, 0.5f * rgba.x + 0.5f * rgba.z, 0.25f * rgba.x - 0.5f * rgba.y - 0.25f * rgba.z, rgba.w);
+		}
+
+		static Float4 toRgba(const Float4& yCoCg)
+		{
+			return Float4(yCoCg.x + yCoCg.y + yCoCg.z, yCoCg.x - yCoCg.z, -yCoCg.x + yCoCg.y - yCoCg.z, yCoCg.w);
+		}
+
+		static Float4 clipAABB(const Float3& aabbMin, const Float3& aabbMax, const Float4& current, const Float4& history)
+		{
+			Float3 pClip = 0.5f * (aabbMax + aabbMin);
+			Float3 eClip = 0.5f * (aabbMax - aabbMin);
+			Float4 vClip = history - Float4(pClip, current.w);
+			Float3 vUnit = vClip.xyz / eClip;
+			Float3 aUnit = abs(vUnit);
+			float maUnit = max(aUnit.x, max(aUnit.y, aUnit.z));
+			if (maUnit > 1.0f) return Float4(pClip, current.w) + vClip / maUnit;
+			return history;
+		}
+
+		// main() for every pixel of output, which must be as large as current.
+		// velocity holds the base pass' uv motion in xy. clip takes ClipAABB() over
+		// the clamp, the shader's USE_NEIGHBORHOOD_CLIPPING branch.
+		static TemporalAAStats resolveScalar(WorkerPool& pool, const CpuTexture2D<Float4>& current, const CpuTexture2D<Float4>& velocity, const CpuTexture2D<Float4>& history,
+			bool clip, CpuTexture2D<Float4>& output)
+		{
+			double start = getSeconds();
+			int32_t width = (int32_t)current.getWidth();
+			int32_t height = (int32_t)current.getHeight();
+			auto getCurrentFrame = [&](int32_t x, int32_t y) { return current[UInt2((uint32_t)clamp(x, 0, width - 1), (uint32_t)clamp(y, 0, height - 1))]; };
+			pool.parallelFor(height, [&](uint64_t row, uint32_t)
+			{
+				int32_t y = (int32_t)row;
+				for (int32_t x = 0; x < width; ++x)
+				{
+					UInt2 px((uint32_t)x, (uint32_t)y);
+					Float2 currUv = (Float2((float)x, (float)y) + 0.5f) / Float2((float)width, (float)height);
+					Float2 prevUv = currUv + velocity[px].xy;
+					Float4 currentColor = toYCoCg(current[px]);
+					Float4 historyColor = toYCoCg(history.SampleLevel(prevUv));
+
+					Float4 boxTL = toYCoCg(getCurrentFrame(x - 1, y - 1));
+					Float4 boxTC = toYCoCg(getCurrentFrame(x, y - 1));
+					Float4 boxTR = toYCoCg(getCurrentFrame(x + 1, y - 1));
+					Float4 boxCL = toYCoCg(getCurrentFrame(x - 1, y));
+					Float4 boxCR = toYCoCg(getCurrentFrame(x + 1, y));
+					Float4 boxBL = toYCoCg(getCurrentFrame(x - 1, y + 1));
+					Float4 boxBC = toYCoCg(getCurrentFrame(x, y + 1));
+					Float4 boxBR = toYCoCg(getCurrentFrame(x + 1, y + 1));
+
+					Float4 boxMin = min(currentColor, min(boxTL, min(boxTC, min(boxTR, min(boxCL, min(boxCR, min(boxBL, min(boxBC, boxBR))))))));
+					Float4 boxMax = max(currentColor, max(boxTL, max(boxTC, max(boxTR, max(boxCL, max(boxCR, max(boxBL, max(boxBC, boxBR))))))));
+					Float4 plusMin = min(currentColor, min(boxTC, min(boxCL, min(boxCR, boxBC))));
+					Float4 plusMax = max(currentColor, max(boxTC, max(boxCL, max(boxCR, boxBC))));
+					Float4 neighborMin = lerp(boxMin, plusMin, 0.5f);
+					Float4 neighborMax = lerp(boxMax, plusMax, 0.5f);
+
+					if (clip) historyColor = clipAABB(neighborMin.xyz, neighborMax.xyz, currentColor, historyColor);
+					else historyColor = clamp(historyColor, neighborMin, neighborMax);
+
+					float lumCurrent = currentColor.x;
+					float lumHistory = historyColor.x;
+					float unbiasedDiff = fabsf(lumCurrent - lumHistory) / max(lumCurrent, max(lumHistory, 1.2f));
+					float unbiasedWeight = 1.0f - unbiasedDiff;
+					float unbiasedWeightSqr = unbiasedWeight * unbiasedWeight;
+					float blendFactor = lerp(feedbackMin, 1.0f - globalBlendFactor, unbiasedWeightSqr);
+					output[px] = toRgba(lerp(currentColor, historyColor, blendFactor));
+				}
+			});
+			TemporalAAStats stats = {};
+			stats.seconds = getSeconds() - start;
+			stats.pixelNum = (uint64_t)width * height;
+			return stats;
+		}
+
+		// Same arguments as resolveScalar().
+		static TemporalAAStats resolve(WorkerPool& pool, const CpuTexture2D<Float4>& current, const CpuTexture2D<Float4>& velocity, const CpuTexture2D<Float4>& history,
+			bool clip, CpuTexture2D<Float4>& output)
+		{
+#if NI_SIMD_SSE
+			double start = getSeconds();
+			int32_t width = (int32_t)current.getWidth();
+			int32_t height = (int32_t)current.getHeight();
+			uint32_t columnNum = (width + tileWidth - 1) / tileWidth;
+			uint32_t tileNum = columnNum * ((height + tileHeight - 1) / tileHeight);
+
+			pool.parallelFor(tileNum, [&](uint64_t tile, uint32_t)
+			{
+				int32_t tileX = (int32_t)(tile % columnNum) * tileWidth;
+				int32_t tileY = (int32_t)(tile / columnNum) * tileHeight;
+				alignas(32) float planes[4][planeRowNum][planeWidth];
+				for (uint32_t by = 0; by < planeRowNum; ++by)
+				{
+					int32_t y = clamp(tileY - 1 + (int32_t)by, 0, height - 1);
+					for (uint32_t bx = 0; bx < planeWidth; ++bx)
+					{
+						Float4 texel = toYCoCg(current[UInt2((uint32_t)clamp(tileX - 1 + (int32_t)bx, 0, width - 1), (uint32_t)y)]);
+						planes[0][by][bx] = texel.x;
+						planes[1][by][bx] = texel.y;
+						planes[2][by][bx] = texel.z;
+						planes[3][by][bx] = texel.w;
+					}
+				}
+				resolveTile(planes, velocity, history, clip, tileX, tileY, output);
+			});
+			TemporalAAStats stats = {};
+			stats.seconds = getSeconds() - start;
+			stats.pixelNum = (uint64_t)width * height;
+			return stats;
+#else
+			return resolveScalar(pool, current, velocity, history, clip, output);
+#endif
+		}
+
+	private:
+		// A tile and its one pixel halo.
+		static constexpr uint32_t planeWidth = tileWidth + 2;
+		static constexpr uint32_t planeRowNum = tileHeight + 2;
+
+#if NI_SIMD_SSE
+		static void resolveTile(const float (*planes)[planeRowNum][planeWidth], const CpuTexture2D<Float4>& velocity, const CpuTexture2D<Float4>& history, bool clip,
+			int32_t tileX, int32_t tileY, CpuTexture2D<Float4>& output)
+		{
+			int32_t width = (int32_t)output.getWidth();
+			int32_t height = (int32_t)output.getHeight();
+			int32_t rowNum = min((int32_t)tileHeight, height - tileY);
+			int32_t pixelNum = min((int32_t)tileWidth, width - tileX);
+			simd::Float8 half = simd::set8(0.5f);
+			simd::Float8 one = simd::set8(1.0f);
+			simd::Float8 signBit = simd::set8(-0.0f);
+			simd::Float8 lumFloor = simd::set8(1.2f);
+			simd::Float8 feedback = simd::set8(feedbackMin);
+			simd::Float8 feedbackRange = simd::set8(1.0f - globalBlendFactor) - feedback;
+			for (int32_t y = 0; y < rowNum; ++y)
+			{
+				for (int32_t x = 0; x < pixelNum; x += 8)
+				{
+					// The history texels go where the velocity points, one fetch per pixel.
+					alignas(32) float historyLanes[4][8];
+					int32_t laneNum = min(8, pixelNum - x);
+					for (int32_t lane = 0; lane < 8; ++lane)
+					{
+						int32_t pixelX = tileX + x + min(lane, laneNum - 1);
+						UInt2 px((uint32_t)pixelX, (uint32_t)(tileY + y));
+						Float2 currUv = (Float2((float)pixelX, (float)(tileY + y)) + 0.5f) / Float2((float)width, (float)height);
+						Float4 texel = history.SampleLevel(currUv + velocity[px].xy);
+						historyLanes[0][lane] = texel.x;
+						historyLanes[1][lane] = texel.y;
+						historyLanes[2][lane] = texel.z;
+						historyLanes[3][lane] = texel.w;
+					}
+					simd::Float8 red = simd::load8(historyLanes[0]);
+					simd::Float8 green = simd::load8(historyLanes[1]);
+					simd::Float8 blue = simd::load8(historyLanes[2]);
+					simd::Float8 hist[4] = {
+						simd::set8(0.25f) * red + half * green - simd::set8(0.25f) * blue,
+						half * red + half * blue,
+						simd::set8(0.25f) * red - half * green - simd::set8(0.25f) * blue,
+						simd::load8(historyLanes[3]) };
+
+					simd::Float8 cur[4], neighborMin[4], neighborMax[4];
+					for (uint32_t channel = 0; channel < 4; ++channel)
+					{
+						const float* center = &planes[channel][y + 1][x + 1];
+						simd::Float8 c = simd::load8(center);
+						simd::Float8 tl = simd::load8(center - planeWidth - 1);
+						simd::Float8 tc = simd::load8(center - planeWidth);
+						simd::Float8 tr = simd::load8(center - planeWidth + 1);
+						simd::Float8 cl = simd::load8(center - 1);
+						simd::Float8 cr = simd::load8(center + 1);
+						simd::Float8 bl = simd::load8(center + planeWidth - 1);
+						simd::Float8 bc = simd::load8(center + planeWidth);
+						simd::Float8 br = simd::load8(center + planeWidth + 1);
+						using simd::min;
+						using simd::max;
+						simd::Float8 boxMin = min(c, min(tl, min(tc, min(tr, min(cl, min(cr, min(bl, min(bc, br))))))));
+						simd::Float8 boxMax = max(c, max(tl, max(tc, max(tr, max(cl, max(cr, max(bl, max(bc, br))))))));
+						simd::Float8 plusMin = min(c, min(tc, min(cl, min(cr, bc))));
+						simd::Float8 plusMax = max(c, max(tc, max(cl, max(cr, bc))));
+						cur[channel] = c;
+						neighborMin[channel] = boxMin + (plusMin - boxMin) * half;
+						neighborMax[channel] = boxMax + (plusMax - boxMax) * half;
+					}
+
+					if (clip)
+					{
+						simd::Float8 pClip[3], vClip[3], aUnit[3];
+						for (uint32_t channel = 0; channel < 3; ++channel)
+						{
+							pClip[channel] = half * (neighborMax[channel] + neighborMin[channel]);
+							simd::Float8 eClip = half * (neighborMax[channel] - neighborMin[channel]);
+							vClip[channel] = hist[channel] - pClip[channel];
+							aUnit[channel] = simd::andNot(signBit, vClip[channel] / eClip);
+						}
+						simd::Float8 maUnit = simd::max(aUnit[0], simd::max(aUnit[1], aUnit[2]));
+						simd::Float8 outside = simd::greater(maUnit, one);
+						for (uint32_t channel = 0; channel < 3; ++channel)
+						{
+							hist[channel] = simd::select(outside, pClip[channel] + vClip[channel] / maUnit, hist[channel]);
+						}
+						hist[3] = simd::select(outside, cur[3] + (hist[3] - cur[3]) / maUnit, hist[3]);
+					}
+					else
+					{
+						for (uint32_t channel = 0; channel < 4; ++channel)
+						{
+							hist[channel] = simd::min(simd::max(hist[channel], neighborMin[channel]), neighborMax[channel]);
+						}
+					}
+
+					simd::Float8 unbiasedDiff = simd::andNot(signBit, cur[0] - hist[0]) / simd::max(cur[0], simd::max(hist[0], lumFloor));
+					simd::Float8 unbiasedWeight = one - unbiasedDiff;
+					simd::Float8 blendFactor = feedback + feedbackRange * (unbiasedWeight * unbiasedWeight);
+					simd::Float8 blended[4];
+					for (uint32_t channel = 0; channel < 4; ++channel)
+					{
+						blended[channel] = cur[channel] + (hist[channel] - cur[channel]) * blendFactor;
+					}
+					alignas(32) float rgba[4][8];
+					simd::store8(rgba[0], blended[0] + blended[1] + blended[2]);
+					simd::store8(rgba[1], blended[0] - blended[2]);
+					simd::store8(rgba[2], blended[1] - blended[0] - blended[2]);
+					simd::store8(rgba[3], blended[3]);
+					for (int32_t lane = 0; lane < laneNum; ++lane)
+					{
+						output[UInt2((uint32_t)(tileX + x + lane), (uint32_t)(tileY + y))] = Float4(rgba[0][lane], rgba[1][lane], rgba[2][lane], rgba[3][lane]);
+					}
+				}
+			}
+		}
+#endif
+	};
+
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+// CPU version of TemporalReprojectionCS, and the same pass fused with the first
+// a-trous iteration. In fp2025.cpp the temporal pass writes its color to
+// resultTemporalReprojection and the first ATrousFilterCS iteration reads it back
+// right away, 25 taps a pixel. reprojectAndFilter() reprojects a tile and its
+// 2 pixel halo straight into ATrousFilter's planes and filters them there, so the
+// reprojected color never goes to memory; only HistoryM1/HistoryM2, which the
+// second iteration and the next frame read, are written. The planes are strips
+// 256 pixels wide that go down the image 16 rows at a time and hand their bottom
+// rows to the next band, so only the side halos are reprojected twice, about 1.02x
+// the pixels, and the inputs are still read along rows.
+
+#include "shaderport.h"
+#include "cputexture.h"
+#include "atrous.h"
+
+namespace ni {
+
+	// TemporalReprojectionCS's inputs, all the size of color.
+	struct TemporalInputs
+	{
+		const CpuTexture2D<Float4>* color = nullptr;
+		const CpuTexture2D<Float4>* velocity = nullptr;
+		const CpuTexture2D<Float4>* history = nullptr;
+		const CpuTexture2D<Float4>* position = nullptr;
+		const CpuTexture2D<Float4>* normal = nullptr;
+		const CpuTexture2D<Float4>* prevPosition = nullptr;
+		const CpuTexture2D<Float4>* prevNormal = nullptr;
+		const CpuTexture2D<float>* prevM1 = nullptr;
+		const CpuTexture2D<float>* prevM2 = nullptr;
+		const CpuTexture2D<float>* depth = nullptr;
+		const CpuTexture2D<float>* prevDepth = nullptr;
+	};
+
+	struct TemporalSample
+	{
+		Float3 color;
+		float m1 = 0.0f;
+		float m2 = 0.0f;
+	};
+
+	struct TemporalStats
+	{
+		double seconds = 0.0;
+		uint64_t pixelNum = 0;
+		// Pixels reprojected, halos included.
+		uint64_t reprojectedNum = 0;
+	};
+
+	// TemporalReprojectionCS's main() for one pixel.
+	inline TemporalSample reprojectPixel(const TemporalInputs& inputs, const UInt2& px)
+	{
+		int32_t width = (int32_t)inputs.color->getWidth();
+		int32_t height = (int32_t)inputs.color->getHeight();
+		const Float3 lumaWeights(0.299f, 0.587f, 0.114f);
+		Float4 positionAndId = (*inputs.position)[px];
+		Float2 uv = (Float2((float)px.x, (float)px.y) + 0.5f) / Float2((float)width, (float)height);
+		Float3 ccurr = (*inputs.color)[px].xyz;
+		Float3 ncurr = normalize((*inputs.normal)[px].xyz);
+		uint32_t idcurr = (uint32_t)positionAndId.w;
+		float zcurr = (*inputs.depth)[px];
+		Float2 vel = (*inputs.velocity)[px].xy;
+		Float2 uvPrev = uv + vel;
+
+		bool valid = uvPrev.x > 0.0f && uvPrev.y > 0.0f && uvPrev.x <= 1.0f && uvPrev.y <= 1.0f && idcurr > 0;
+
+		Float3 cprev = 0.0f;
+		float m1prev = 0.0f;
+		float m2prev = 0.0f;
+
+		if (valid)
+		{
+			cprev = inputs.history->SampleLevel(uvPrev).xyz;
+			m1prev = inputs.prevM1->SampleLevel(uvPrev);
+			m2prev = inputs.prevM2->SampleLevel(uvPrev);
+			Float3 nprev = normalize(inputs.prevNormal->SampleLevel(uvPrev).xyz);
+			uint32_t idprev = (uint32_t)inputs.prevPosition->SamplePoint(uvPrev).w;
+			float zprev = inputs.prevDepth->SampleLevel(uvPrev);
+			float ndot = dot(ncurr, nprev);
+			float dz = fabsf(zcurr - zprev);
+			const float zt = 0.1f;
+			float dzThr = max(zt * zcurr, zt * 0.5f);
+
+			const float nt = 0.9f;
+			valid = valid && (ndot > nt) && (dz < dzThr) && (idprev == idcurr);
+		}
+
+		float Ymin = +1e9f, Ymax = -1e9f, sum = 0.0f, sum2 = 0.0f;
+		for (int32_t oy = -1; oy <= 1; ++oy)
+		{
+			for (int32_t ox = -1; ox <= 1; ++ox)
+			{
+				UInt2 q((uint32_t)clamp((int32_t)px.x + ox, 0, width - 1), (uint32_t)clamp((int32_t)px.y + oy, 0, height - 1));
+				float y = dot((*inputs.color)[q].xyz, lumaWeights);
+				Ymin = min(Ymin, y);
+				Ymax = max(Ymax, y);
+				sum += y;
+				sum2 += y * y;
+			}
+		}
+
+		float mean = sum / 9.0f;
+		float var = max(sum2 / 9.0f - mean * mean, 0.0f);
+		float pad = 1.0f * sqrtf(var);
+		Ymin -= pad;
+		Ymax += pad;
+
+		// Clamp history luminance into current range
+		Float3 Chist = cprev;
+		if (valid)
+		{
+			float Yh = dot(Chist, lumaWeights);
+			float Yhc = clamp(Yh, Ymin, Ymax);
+			float s = (Yh > 1e-4f) ? (Yhc / Yh) : 1.0f;
+			Chist *= s;
+		}
+
+		float Ycurr = dot(ccurr, lumaWeights);
+		TemporalSample result;
+		if (!valid)
+		{
+			result.color = ccurr;
+			result.m1 = Ycurr;
+			result.m2 = Ycurr * Ycurr;
+		}
+		else
+		{
+			const float blend = 0.15f;
+			result.color = lerp(ccurr, Chist, 1.0f - blend);
+			result.m1 = lerp(Ycurr, m1prev, 1.0f - blend);
+			result.m2 = lerp(Ycurr * Ycurr, m2prev, 1.0f - blend);
+		}
+		return result;
+	}
+
+	struct TemporalReprojection
+	{
+		// TemporalReprojectionCS: ResultTexture, HistoryM1Out and HistoryM2Out.
+		static TemporalStats reproject(WorkerPool& pool, const TemporalInputs& inputs, CpuTexture2D<Float4>& output, CpuTexture2D<float>& m1, CpuTexture2D<float>& m2)
+		{
+			double start = getSeconds();
+			uint32_t width = inputs.color->getWidth();
+			uint32_t height = inputs.color->getHeight();
+			pool.parallelFor(height, [&](uint64_t y, uint32_t)
+			{
+				for (uint32_t x = 0; x < width; ++x)
+				{
+					UInt2 px(x, (uint32_t)y);
+					TemporalSample sample = reprojectPixel(inputs, px);
+					output[px] = Float4(sample.color, 1.0f);
+					m1[px] = sample.m1;
+					m2[px] = sample.m2;
+				}
+			});
+			TemporalStats stats = {};
+			stats.seconds = getSeconds() - start;
+			stats.pixelNum = (uint64_t)width * height;
+			stats.reprojectedNum = stats.pixelNum;
+			return stats;
+		}
+
+		// reproject() and then filter.filter() with step 1 into output, without the
+		// reprojected color in between. Gives what that filter() gives, bit for bit.
+		TemporalStats reprojectAndFilter(WorkerPool& pool, const TemporalInputs& inputs, ATrousFilter& filter, CpuTexture2D<Float4>& output, CpuTexture2D<float>& m1,
+			CpuTexture2D<float>& m2)
+		{
+#if NI_SIMD_SSE
+			double start = getSeconds();
+			const int32_t step = 1;
+			const int32_t halo = 2 * step;
+			int32_t width = (int32_t)inputs.color->getWidth();
+			int32_t height = (int32_t)inputs.color->getHeight();
+			uint32_t columnNum = (width + stripWidth - 1) / stripWidth;
+			uint32_t rowNum = (height + stripHeight - 1) / stripHeight;
+			uint32_t planeWidth = stripWidth + 2 * halo;
+			uint32_t planeRowNum = stripHeight + 2 * halo;
+			uint32_t planeSize = planeWidth * planeRowNum;
+			filter.reserve(pool, planeSize);
+			uint64_t lumaScaleNum = (uint64_t)planeRowNum * stripWidth;
+			if (lumaScales.getNum() < lumaScaleNum * pool.getWorkerNum())
+			{
+				lumaScales.reset();
+				lumaScales.fill(lumaScaleNum * pool.getWorkerNum(), 0.0f);
+			}
+
+			// A worker takes a strip and goes down it, moving the rows the last band
+			// shares with the next to the top of the planes.
+			pool.parallelFor(columnNum, [&](uint64_t column, uint32_t workerIndex)
+			{
+				int32_t stripX = (int32_t)column * stripWidth;
+				float* planes = filter.getPlanes(workerIndex, planeSize);
+				float* scales = &lumaScales[lumaScaleNum * workerIndex];
+				// Past the image only the halo is read.
+				uint32_t usedWidth = min(planeWidth, (uint32_t)(width - stripX + 2 * halo));
+				for (uint32_t row = 0; row < rowNum; ++row)
+				{
+					int32_t stripY = (int32_t)row * stripHeight;
+					uint32_t firstRow = 0;
+					if (row > 0)
+					{
+						firstRow = 2 * halo;
+						for (uint32_t channel = 0; channel < ATrousFilter::channelNum; ++channel)
+						{
+							float* plane = planes + channel * planeSize;
+							memmove(plane, plane + stripHeight * planeWidth, firstRow * planeWidth * sizeof(float));
+						}
+						memmove(scales, scales + stripHeight * stripWidth, firstRow * stripWidth * sizeof(float));
+					}
+					uint32_t usedRowNum = min(planeRowNum, (uint32_t)(height - stripY + 2 * halo));
+					for (uint32_t by = firstRow; by < usedRowNum; ++by)
+					{
+						int32_t y = stripY - halo + (int32_t)by;
+						for (uint32_t bx = 0; bx < usedWidth; ++bx)
+						{
+							int32_t x = stripX - halo + (int32_t)bx;
+							UInt2 q((uint32_t)clamp(x, 0, width - 1), (uint32_t)clamp(y, 0, height - 1));
+							TemporalSample sample = reprojectPixel(inputs, q);
+							uint32_t index = by * planeWidth + bx;
+							planes[ATrousFilter::redPlane * planeSize + index] = sample.color.x;
+							planes[ATrousFilter::greenPlane * planeSize + index] = sample.color.y;
+							planes[ATrousFilter::bluePlane * planeSize + index] = sample.color.z;
+							planes[ATrousFilter::lumaPlane * planeSize + index] = dot(sample.color, Float3(0.299f, 0.587f, 0.114f));
+							ATrousFilter::setGeometry(planes, planeSize, index, (*inputs.normal)[q], (*inputs.depth)[q]);
+
+							uint32_t stripColumn = bx - halo;
+							if (stripColumn >= stripWidth) continue;
+							scales[by * stripWidth + stripColumn] = ATrousFilter::getLumaScale(sample.m1, sample.m2);
+							if (x >= width || y < 0 || y >= height) continue;
+							m1[q] = sample.m1;
+							m2[q] = sample.m2;
+						}
+					}
+					ATrousFilter::filterTile(planes, planeWidth, planeSize, step, scales + halo * stripWidth, stripWidth, stripX, stripY, stripHeight, output);
+				}
+			});
+			TemporalStats stats = {};
+			stats.seconds = getSeconds() - start;
+			stats.pixelNum = (uint64_t)width * height;
+			stats.reprojectedNum = (uint64_t)(width + columnNum * 2 * halo) * (height + 2 * halo);
+			return stats;
+#else
+			reprojected.resize(inputs.color->getWidth(), inputs.color->getHeight());
+			TemporalStats stats = reproject(pool, inputs, reprojected, m1, m2);
+			stats.seconds += filter.filter(pool, reprojected, *inputs.normal, m1, m2, *inputs.depth, 1, output).seconds;
+			return stats;
+#endif
+		}
+
+		// reprojectAndFilter() goes down strips this wide, this many rows at a time.
+		static constexpr uint32_t stripWidth = 256;
+		static constexpr uint32_t stripHeight = 16;
+
+	private:
+#if NI_SIMD_SSE
+		Array<float> lumaScales;
+#else
+		CpuTexture2D<Float4> reprojected;
+#endif
+	};
+
+}
@@ -0,0 +1,172 @@
+#pragma once
+
+// Screen space tile bins for the camera rays (shaders/TileBins.hlsli). Every frame
+// the visible spheres are projected with viewProjMtx to the TILE_BIN_SIZE tiles
+// their bounding box covers, and the (tile, particle) pairs are compacted into one
+// index list per tile:
+//   1. per particle, its pixel rectangle and pair count, summed per block,
+//   2. an exclusive prefix sum over the block sums gives every block the offset it
+//      writes its pairs at, one particle after the other,
+//   3. the pairs are sorted by tile and then getTileBinDepthKey() with the
+//      RadixSorter, so every tile lists its particles front to back,
+//   4. each tile's start is a binary search in the sorted tiles.
+// Steps 1 to 4 run on the worker pool. Planes, spheres around the camera and
+// spheres covering more than hugeTileFraction of the screen go to the global list
+// that every tile tests.
+
+#include "shaderport.h"
+#include "mortonsort.h"
+
+#include <algorithm>
+
+namespace ni {
+
+	struct TileBinStats
+	{
+		double seconds = 0.0;
+		uint32_t tileNum = 0;
+		uint32_t pairNum = 0;
+		uint32_t globalNum = 0;
+	};
+
+	struct ParticleTileBins
+	{
+		static constexpr uint32_t blockSize = 1024;
+		static constexpr uint32_t depthBits = 16;
+
+		float hugeTileFraction = 0.25f;
+
+		// constantBufferData as fp2025.cpp fills it, for the camera and resolution.
+		TileBinStats build(WorkerPool& pool, const ParticleData* particles, uint32_t particleNum, const ConstantBufferData& constantBufferData)
+		{
+			double start = getSeconds();
+			uint32_t width = (uint32_t)constantBufferData.resolution.x;
+			uint32_t height = (uint32_t)constantBufferData.resolution.y;
+			columnNum = (width + TILE_BIN_SIZE - 1) / TILE_BIN_SIZE;
+			uint32_t tileNum = columnNum * ((height + TILE_BIN_SIZE - 1) / TILE_BIN_SIZE);
+			uint32_t hugeTileNum = max((uint32_t)(tileNum * hugeTileFraction), 1u);
+			Float4x4 viewProjMtx = columnMajor(constantBufferData.viewProjMtx);
+			Float3 resolution = constantBufferData.resolution;
+			Float3 cameraPos = constantBufferData.cameraPos;
+			float distancePerW = shader::getTileBinDistancePerW(viewProjMtx, columnMajor(constantBufferData.invViewProjMtx), cameraPos);
+
+			uint32_t blockNum = (particleNum + blockSize - 1) / blockSize;
+			ensureNum(rects, particleNum);
+			ensureNum(isGlobal, particleNum);
+			ensureNum(blockOffsets, blockNum);
+			pool.parallelFor(blockNum, [&](uint64_t block, uint32_t)
+			{
+				uint32_t sum = 0;
+				uint32_t end = min((uint32_t)block * blockSize + blockSize, particleNum);
+				for (uint32_t index = (uint32_t)block * blockSize; index < end; ++index)
+				{
+					Rect& rect = rects[index];
+					bool bounded = shader::getSpherePixelRect(particles[index], viewProjMtx, resolution, cameraPos, distancePerW, rect.pixelMin, rect.pixelMax);
+					uint32_t area = getTileArea(rect);
+					isGlobal[index] = particles[index].visible && (!bounded || area > hugeTileNum);
+					if (!particles[index].visible || isGlobal[index]) rect.pixelMax = Int2(-1, -1);
+					else sum += area;
+				}
+				blockOffsets[block] = sum;
+			});
+
+			uint32_t pairNum = 0;
+			for (uint32_t block = 0; block < blockNum; ++block)
+			{
+				uint32_t sum = blockOffsets[block];
+				blockOffsets[block] = pairNum;
+				pairNum += sum;
+			}
+
+			ensureNum(tiles, pairNum);
+			ensureNum(pairParticles, pairNum);
+			pool.parallelFor(blockNum, [&](uint64_t block, uint32_t)
+			{
+				uint32_t offset = blockOffsets[block];
+				uint32_t end = min((uint32_t)block * blockSize + blockSize, particleNum);
+				for (uint32_t index = (uint32_t)block * blockSize; index < end; ++index)
+				{
+					const Rect& rect = rects[index];
+					uint64_t depthKey = shader::getTileBinDepthKey(particles[index], cameraPos);
+					if (getTileArea(rect) == 0) continue;
+					for (int32_t y = rect.pixelMin.y / TILE_BIN_SIZE; y <= rect.pixelMax.y / TILE_BIN_SIZE; ++y)
+					{
+						for (int32_t x = rect.pixelMin.x / TILE_BIN_SIZE; x <= rect.pixelMax.x / TILE_BIN_SIZE; ++x)
+						{
+							tiles[offset] = (((uint64_t)y * columnNum + x) << depthBits) | depthKey;
+							pairParticles[offset] = index;
+							offset++;
+						}
+					}
+				}
+			});
+			uint32_t tileBits = 1;
+			while ((1u << tileBits) < tileNum) tileBits++;
+			sorter.sort(pool, tiles.getData(), pairParticles.getData(), pairNum, tileBits + depthBits);
+
+			ensureNum(offsets, tileNum + 1);
+			pool.parallelFor(tileNum + 1, [&](uint64_t tile, uint32_t)
+			{
+				offsets[(uint32_t)tile] = (uint32_t)(std::lower_bound(tiles.getData(), tiles.getData() + pairNum, tile << depthBits) - tiles.getData());
+			});
+
+			globalParticles.reset();
+			for (uint32_t index = 0; index < particleNum; ++index)
+			{
+				if (isGlobal[index]) globalParticles.add(index);
+			}
+
+			TileBinStats stats = {};
+			stats.seconds = getSeconds() - start;
+			stats.tileNum = tileNum;
+			stats.pairNum = pairNum;
+			stats.globalNum = globalParticles.getNum();
+			return stats;
+		}
+
+		const uint32_t* getOffsets() const { return offsets.getData(); }
+		const uint32_t* getParticles() const { return pairParticles.getData(); }
+		const uint32_t* getGlobalParticles() const { return globalParticles.getData(); }
+		uint32_t getGlobalNum() const { return globalParticles.getNum(); }
+		uint32_t getColumnNum() const { return columnNum; }
+		// Pixels the camera rays can hit a binned particle in, empty for the rest.
+		void getPixelRect(uint32_t index, Int2& pixelMin, Int2& pixelMax) const
+		{
+			pixelMin = rects[index].pixelMin;
+			pixelMax = rects[index].pixelMax;
+		}
+
+	private:
+		struct Rect
+		{
+			Int2 pixelMin;
+			Int2 pixelMax;
+		};
+
+		static uint32_t getTileArea(const Rect& rect)
+		{
+			if (rect.pixelMax.x < rect.pixelMin.x || rect.pixelMax.y < rect.pixelMin.y) return 0;
+			return (uint32_t)(rect.pixelMax.x / TILE_BIN_SIZE - rect.pixelMin.x / TILE_BIN_SIZE + 1) *
+				(uint32_t)(rect.pixelMax.y / TILE_BIN_SIZE - rect.pixelMin.y / TILE_BIN_SIZE + 1);
+		}
+
+		template<typename T>
+		static void ensureNum(Array<T>& array, uint32_t num)
+		{
+			if (array.getNum() >= num) return;
+			array.reset();
+			array.fill(num, T{});
+		}
+
+		uint32_t columnNum = 0;
+		Array<Rect> rects;
+		Array<uint8_t> isGlobal;
+		Array<uint32_t> blockOffsets;
+		Array<uint64_t> tiles;
+		Array<uint32_t> pairParticles;
+		Array<uint32_t> offsets;
+		Array<uint32_t> globalParticles;
+		RadixSorter sorter;
+	};
+
+}
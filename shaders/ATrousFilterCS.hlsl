@@ -1,5 +1,5 @@
 Texture2D<float4> currentFrame : register(t0);
-Texture2D<float4> normalBuffer : register(t1);
+Texture2D<float2> normalBuffer : register(t1);
 Texture2D<float> M1 : register(t2);
 Texture2D<float> M2 : register(t3);
 Texture2D<float> depthBuffer : register(t4);
@@ -9,6 +9,8 @@ RWTexture2D<float4> resultTexture : register(u0);
 const int iterStep;
 const float3 resolution;
 
+#include "GBuffer.hlsli"
+
 float3 AtrousIter(int2 px, int step)
 {
     static const int2 taps[25] =
@@ -20,7 +22,7 @@ float3 AtrousIter(int2 px, int step)
         int2(-2, 2), int2(-1, 2), int2(0, 2), int2(1, 2), int2(2, 2)
     };
     float3 Cc = currentFrame[px].rgb;
-    float3 Nc = normalBuffer[px].xyz;
+    float3 Nc = decodeOctahedral(normalBuffer[px]);
     float Zc = depthBuffer[px].r; // linear
     float Lc = dot(Cc, float3(0.299, 0.587, 0.114));
     float sigma = sqrt(max(M2[px] - M1[px] * M1[px], 0));
@@ -32,7 +34,7 @@ float3 AtrousIter(int2 px, int step)
     {
         int2 q = clamp(px + taps[i] * step, int2(0, 0), int2(resolution.xy) - 1);
         float3 Cq = currentFrame[q].rgb;
-        float3 Nq = normalBuffer[q].xyz;
+        float3 Nq = decodeOctahedral(normalBuffer[q]);
         float Zq = depthBuffer[q].r;
         float Lq = dot(Cq, float3(0.299, 0.587, 0.114));
 
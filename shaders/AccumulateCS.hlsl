@@ -0,0 +1,26 @@
+#include "ParticleConfig.h"
+
+// Running mean of the base pass output while the image stays still, see
+// code/accumulation.h. frameNum is the number of frames accumulationBuffer holds
+// already, 0 starts it over with this frame.
+
+Texture2D<float4> currentFrame : register(t0);
+RWTexture2D<float4> accumulationBuffer : register(u0);
+
+const uint frameNum;
+const float3 resolution;
+
+[numthreads(32, 32, 1)]
+void main(uint3 DTid : SV_DispatchThreadID)
+{
+    if (DTid.x >= resolution.x || DTid.y >= resolution.y)
+        return;
+
+    float4 color = currentFrame[DTid.xy];
+    if (frameNum > 0)
+    {
+        float4 mean = accumulationBuffer[DTid.xy];
+        color = mean + (color - mean) / float(frameNum + 1);
+    }
+    accumulationBuffer[DTid.xy] = color;
+}
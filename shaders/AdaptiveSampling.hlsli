@@ -0,0 +1,19 @@
+#include "ParticleConfig.h"
+
+// Per tile sample counts for the base pass, see code/adaptive.h. Included by
+// PathTrace.hlsli with `tileSampleCounts` (one count per ADAPTIVE_TILE_SIZE tile,
+// row by row) and `tileColumnNum` bound. Nothing is bound while tileColumnNum is 0.
+
+// Variance of one sample of a pixel, from the luminance moments the temporal pass
+// keeps (HistoryM1/HistoryM2) of frames that took sampleCount samples each.
+float getSampleVariance(float m1, float m2, uint sampleCount)
+{
+    return max(m2 - m1 * m1, 0.0) * float(sampleCount);
+}
+
+uint getTileSampleCount(uint2 pixel)
+{
+    uint tileX = pixel.x / ADAPTIVE_TILE_SIZE;
+    uint tileY = pixel.y / ADAPTIVE_TILE_SIZE;
+    return tileSampleCounts[tileY * tileColumnNum + tileX];
+}
@@ -0,0 +1,52 @@
+#ifndef _BLUE_NOISE_HLSLI_
+#define _BLUE_NOISE_HLSLI_
+
+// 32x32 tileable blue noise ranks, a permutation of 0..1023 from the void and cluster
+// generator in code/bluenoise.h (sigma 1.5). The pixels with rank below n are spread
+// evenly over the tile for every n. Regenerate with BlueNoiseGenerator, `-bench
+// sampler` fails when this table and the generator disagree.
+
+#define BLUE_NOISE_TILE 32
+
+static const uint blueNoiseRanks[BLUE_NOISE_TILE * BLUE_NOISE_TILE] =
+{
+    1003, 103, 686, 959, 485, 575, 265, 168, 589, 297, 646, 530, 700, 80, 497, 329, 445, 651, 515, 12, 466, 330, 777, 993, 609, 396, 5, 234, 624, 943, 463, 200,
+    725, 514, 822, 335, 197, 914, 794, 683, 997, 441, 214, 847, 402, 911, 204, 731, 925, 143, 223, 711, 814, 131, 541, 215, 100, 918, 521, 842, 427, 124, 573, 327,
+    880, 244, 424, 79, 658, 414, 18, 492, 347, 105, 930, 6, 292, 781, 629, 31, 288, 774, 555, 1021, 278, 409, 936, 648, 746, 280, 159, 696, 315, 764, 902, 22,
+    154, 633, 980, 544, 750, 283, 962, 153, 863, 742, 558, 657, 471, 134, 533, 994, 431, 868, 355, 68, 631, 874, 30, 348, 473, 805, 579, 990, 73, 227, 659, 475,
+    771, 301, 38, 888, 176, 840, 593, 704, 526, 309, 184, 798, 971, 372, 836, 226, 587, 109, 673, 454, 195, 511, 723, 166, 969, 49, 359, 447, 827, 537, 961, 394,
+    846, 577, 708, 356, 494, 108, 385, 237, 53, 1013, 408, 74, 252, 701, 43, 341, 754, 182, 965, 789, 922, 270, 832, 585, 251, 671, 893, 128, 636, 339, 54, 201,
+    1000, 114, 452, 210, 988, 653, 775, 909, 467, 816, 613, 894, 568, 480, 952, 641, 887, 508, 326, 14, 595, 377, 98, 435, 871, 524, 209, 749, 269, 933, 732, 509,
+    373, 276, 917, 806, 552, 33, 273, 578, 160, 675, 219, 331, 120, 770, 173, 417, 85, 259, 738, 434, 155, 703, 1011, 776, 71, 392, 995, 26, 569, 415, 139, 672,
+    2, 616, 734, 81, 322, 876, 438, 977, 369, 15, 741, 443, 931, 599, 284, 839, 545, 935, 627, 981, 849, 531, 307, 183, 612, 279, 684, 457, 780, 884, 241, 821,
+    945, 194, 390, 489, 680, 196, 727, 101, 830, 944, 523, 811, 65, 393, 989, 40, 690, 205, 117, 363, 232, 51, 661, 476, 912, 810, 141, 940, 318, 72, 491, 565,
+    433, 795, 900, 136, 1020, 581, 342, 501, 211, 604, 300, 180, 647, 225, 724, 450, 328, 826, 490, 583, 790, 891, 410, 735, 9, 538, 370, 591, 186, 643, 1012, 286,
+    695, 48, 527, 262, 765, 24, 926, 788, 669, 413, 107, 1015, 882, 517, 801, 144, 634, 908, 19, 702, 282, 110, 976, 333, 224, 956, 94, 716, 862, 391, 748, 119,
+    607, 344, 854, 656, 388, 465, 171, 277, 55, 856, 744, 470, 362, 1, 306, 964, 554, 249, 381, 1006, 446, 632, 165, 580, 762, 444, 833, 261, 478, 28, 913, 216,
+    784, 987, 199, 66, 960, 619, 878, 548, 979, 323, 566, 236, 713, 608, 860, 77, 423, 757, 92, 843, 206, 778, 502, 859, 69, 299, 649, 152, 972, 570, 324, 505,
+    142, 406, 586, 311, 747, 118, 357, 692, 449, 145, 904, 90, 953, 162, 481, 693, 190, 920, 652, 561, 337, 34, 937, 368, 694, 1022, 551, 380, 792, 88, 730, 889,
+    11, 488, 714, 867, 510, 245, 797, 17, 222, 825, 617, 421, 796, 264, 358, 985, 529, 289, 137, 472, 963, 642, 258, 138, 477, 208, 41, 916, 247, 600, 425, 272,
+    820, 932, 185, 84, 395, 905, 594, 991, 518, 737, 351, 29, 512, 667, 850, 47, 785, 405, 831, 709, 78, 422, 729, 910, 603, 751, 864, 442, 691, 175, 1007, 663,
+    352, 601, 298, 1002, 676, 164, 429, 302, 91, 942, 271, 699, 1004, 123, 562, 235, 621, 104, 1014, 217, 317, 855, 540, 4, 403, 290, 127, 525, 325, 845, 106, 542,
+    767, 42, 451, 786, 534, 57, 722, 865, 639, 178, 458, 895, 212, 340, 426, 934, 739, 334, 507, 588, 923, 146, 773, 231, 998, 819, 660, 939, 20, 740, 398, 229,
+    148, 968, 645, 207, 343, 954, 242, 495, 366, 787, 576, 64, 817, 628, 877, 10, 479, 167, 800, 37, 668, 461, 353, 638, 499, 70, 383, 202, 614, 978, 496, 897,
+    550, 255, 824, 76, 869, 620, 755, 7, 1009, 126, 687, 399, 528, 116, 707, 293, 970, 650, 892, 397, 250, 975, 95, 899, 172, 728, 582, 808, 453, 274, 67, 670,
+    428, 720, 375, 584, 468, 158, 401, 556, 295, 829, 238, 958, 305, 779, 198, 572, 416, 243, 75, 539, 733, 812, 574, 303, 837, 257, 986, 338, 96, 718, 835, 320,
+    3, 879, 122, 1023, 266, 921, 813, 111, 896, 625, 504, 23, 885, 456, 1016, 83, 768, 851, 354, 948, 187, 16, 400, 678, 474, 44, 535, 151, 927, 567, 189, 947,
+    602, 228, 493, 760, 32, 662, 336, 710, 448, 179, 371, 705, 156, 615, 360, 677, 484, 157, 597, 698, 287, 498, 1019, 121, 919, 378, 758, 848, 654, 387, 503, 772,
+    361, 938, 679, 316, 553, 437, 218, 974, 52, 769, 992, 564, 844, 256, 56, 870, 310, 929, 99, 420, 793, 622, 853, 240, 721, 610, 191, 440, 267, 35, 983, 130,
+    462, 82, 841, 174, 957, 802, 135, 536, 640, 239, 314, 97, 418, 736, 951, 522, 221, 717, 547, 973, 58, 161, 345, 557, 27, 308, 999, 86, 901, 745, 304, 688,
+    563, 263, 626, 389, 60, 606, 890, 346, 858, 469, 803, 928, 513, 193, 376, 611, 0, 818, 367, 253, 873, 689, 460, 941, 763, 506, 804, 644, 560, 486, 170, 866,
+    45, 756, 903, 487, 712, 246, 419, 13, 706, 129, 596, 50, 681, 828, 132, 759, 996, 455, 181, 637, 516, 291, 807, 112, 213, 411, 133, 350, 230, 823, 374, 1010,
+    432, 203, 332, 93, 1001, 783, 520, 915, 281, 1017, 404, 220, 321, 967, 483, 285, 102, 682, 898, 36, 1008, 89, 384, 618, 984, 685, 857, 955, 21, 697, 113, 635,
+    782, 950, 664, 543, 188, 319, 115, 655, 192, 546, 726, 886, 630, 25, 571, 906, 412, 549, 313, 761, 430, 719, 907, 260, 519, 62, 294, 590, 436, 924, 532, 296,
+    500, 8, 881, 407, 838, 623, 966, 459, 753, 349, 87, 464, 791, 379, 169, 715, 233, 799, 125, 592, 248, 177, 559, 834, 150, 766, 482, 163, 752, 254, 872, 147,
+    382, 598, 275, 140, 743, 59, 386, 875, 39, 815, 949, 149, 268, 1005, 605, 852, 61, 982, 364, 861, 946, 665, 46, 439, 312, 883, 674, 1018, 365, 63, 666, 809
+};
+
+uint getBlueNoiseRank(uint2 pixel)
+{
+    return blueNoiseRanks[(pixel.y % BLUE_NOISE_TILE) * BLUE_NOISE_TILE + (pixel.x % BLUE_NOISE_TILE)];
+}
+
+#endif
@@ -0,0 +1,213 @@
+#include "ParticleConfig.h"
+
+// Ray queries against the particle BVH built by code/bvh.h. Included by
+// PathTrace.hlsli after intersectsParticle(), with `bvhNodes`, `bvhPrimitives`,
+// `bvhNodeNum` and `bvhPlaneNum` bound next to `particles`. Hits are exactly the ones
+// the linear loop in trace() finds: closest intersectsParticle() distance, lowest
+// index on a tie. The planes in front of the primitive buffer are tested first.
+
+#define BVH_STACK_SIZE 64
+
+// The zero components of a direction are nudged so the slab test never does 0 * inf.
+float3 getInverseDirection(float3 rayDirection)
+{
+    float3 direction = rayDirection;
+    direction.x = abs(direction.x) < 1e-20 ? (direction.x < 0.0 ? -1e-20 : 1e-20) : direction.x;
+    direction.y = abs(direction.y) < 1e-20 ? (direction.y < 0.0 ? -1e-20 : 1e-20) : direction.y;
+    direction.z = abs(direction.z) < 1e-20 ? (direction.z < 0.0 ? -1e-20 : 1e-20) : direction.z;
+    return 1.0 / direction;
+}
+
+// Slab test. entryDist is where the ray enters the box, negative when it starts inside.
+bool intersectsBounds(float3 rayOrigin, float3 invDirection, float3 boundsMin, float3 boundsMax, float maxDist, OUT(float) entryDist)
+{
+    float3 t0 = (boundsMin - rayOrigin) * invDirection;
+    float3 t1 = (boundsMax - rayOrigin) * invDirection;
+    float3 tMin = min(t0, t1);
+    float3 tMax = max(t0, t1);
+    entryDist = max(max(tMin.x, tMin.y), tMin.z);
+    float exitDist = min(min(tMax.x, tMax.y), tMax.z);
+    return exitDist >= max(entryDist, 0.0) && entryDist <= maxDist;
+}
+
+// Closest hit, same outputs as trace().
+bool traceClosestBvh(float3 rayOrigin, float3 rayDirection, OUT(ParticleData) outParticle, OUT(float3) outPosition, OUT(float3) outNormal, OUT(float3) outExit)
+{
+    // A NaN ray (refract() past the critical angle) makes intersectsParticle() report
+    // a hit at a NaN distance for every sphere. trace() then returns true without
+    // writing any output, and pathtrace() depends on that.
+    if (isnan(dot(rayOrigin, rayOrigin) + dot(rayDirection, rayDirection)))
+    {
+        for (uint i = 0; i < particleScene.numParticles; i++)
+        {
+            if (particles[i].visible && particles[i].primitive == PARTICLE_PRIMITIVE_SPHERE)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    float3 invDirection = getInverseDirection(rayDirection);
+    float lastDepth = 3.402823466e+38F;
+    uint lastIndex = 0xffffffff;
+    bool hit = false;
+
+    for (uint plane = 0; plane < bvhPlaneNum; plane++)
+    {
+        uint index = bvhPrimitives[plane];
+        float3 hitPosition;
+        float3 hitNormal;
+        float3 hitExit;
+        float dist = 0.0;
+        if (particles[index].visible && intersectsParticle(rayOrigin, rayDirection, particles[index], hitPosition, hitNormal, dist, hitExit))
+        {
+            if (dist < lastDepth || (dist == lastDepth && index < lastIndex))
+            {
+                outParticle = particles[index];
+                outPosition = hitPosition;
+                outNormal = hitNormal;
+                outExit = hitExit;
+                lastDepth = dist;
+                lastIndex = index;
+            }
+            hit = true;
+        }
+    }
+
+    uint stack[BVH_STACK_SIZE];
+    float stackDist[BVH_STACK_SIZE];
+    uint stackSize = 0;
+    float entryDist = 0.0;
+    if (!intersectsBounds(rayOrigin, invDirection, bvhNodes[0].boundsMin, bvhNodes[0].boundsMax, lastDepth, entryDist))
+    {
+        return hit;
+    }
+    uint nodeIndex = 0;
+    LOOP
+    while (true)
+    {
+        BvhNode node = bvhNodes[nodeIndex];
+        if (node.primitiveNum > 0)
+        {
+            for (uint i = 0; i < node.primitiveNum; i++)
+            {
+                uint index = bvhPrimitives[node.leftFirst + i];
+                if (!particles[index].visible)
+                {
+                    continue;
+                }
+
+                float3 hitPosition;
+                float3 hitNormal;
+                float3 hitExit;
+                float dist = 0.0;
+                if (intersectsParticle(rayOrigin, rayDirection, particles[index], hitPosition, hitNormal, dist, hitExit))
+                {
+                    if (dist < lastDepth || (dist == lastDepth && index < lastIndex))
+                    {
+                        outParticle = particles[index];
+                        outPosition = hitPosition;
+                        outNormal = hitNormal;
+                        outExit = hitExit;
+                        lastDepth = dist;
+                        lastIndex = index;
+                    }
+                    hit = true;
+                }
+            }
+        }
+        else
+        {
+            uint left = node.leftFirst;
+            uint right = node.leftFirst + 1;
+            float leftDist = 0.0;
+            float rightDist = 0.0;
+            bool hitLeft = intersectsBounds(rayOrigin, invDirection, bvhNodes[left].boundsMin, bvhNodes[left].boundsMax, lastDepth, leftDist);
+            bool hitRight = intersectsBounds(rayOrigin, invDirection, bvhNodes[right].boundsMin, bvhNodes[right].boundsMax, lastDepth, rightDist);
+            if (hitLeft && hitRight)
+            {
+                // Nearer child first, the other one waits with its entry distance.
+                bool leftFirst = leftDist <= rightDist;
+                stack[stackSize] = leftFirst ? right : left;
+                stackDist[stackSize] = leftFirst ? rightDist : leftDist;
+                stackSize++;
+                nodeIndex = leftFirst ? left : right;
+                continue;
+            }
+            if (hitLeft || hitRight)
+            {
+                nodeIndex = hitLeft ? left : right;
+                continue;
+            }
+        }
+
+        // Pop, skipping nodes that start behind the closest hit so far.
+        bool found = false;
+        while (stackSize > 0 && !found)
+        {
+            stackSize--;
+            nodeIndex = stack[stackSize];
+            found = stackDist[stackSize] <= lastDepth;
+        }
+        if (!found)
+        {
+            break;
+        }
+    }
+    return hit;
+}
+
+// Any hit: true as soon as one visible particle is hit closer than maxDist.
+bool traceAnyBvh(float3 rayOrigin, float3 rayDirection, float maxDist)
+{
+    for (uint plane = 0; plane < bvhPlaneNum; plane++)
+    {
+        uint index = bvhPrimitives[plane];
+        float3 hitPosition;
+        float3 hitNormal;
+        float3 hitExit;
+        float dist = 0.0;
+        if (particles[index].visible && intersectsParticle(rayOrigin, rayDirection, particles[index], hitPosition, hitNormal, dist, hitExit) && dist < maxDist)
+        {
+            return true;
+        }
+    }
+
+    float3 invDirection = getInverseDirection(rayDirection);
+    uint stack[BVH_STACK_SIZE];
+    uint stackSize = 0;
+    stack[stackSize++] = 0;
+    LOOP
+    while (stackSize > 0)
+    {
+        stackSize--;
+        BvhNode node = bvhNodes[stack[stackSize]];
+        float entryDist = 0.0;
+        if (!intersectsBounds(rayOrigin, invDirection, node.boundsMin, node.boundsMax, maxDist, entryDist))
+        {
+            continue;
+        }
+        if (node.primitiveNum > 0)
+        {
+            for (uint i = 0; i < node.primitiveNum; i++)
+            {
+                uint index = bvhPrimitives[node.leftFirst + i];
+                float3 hitPosition;
+                float3 hitNormal;
+                float3 hitExit;
+                float dist = 0.0;
+                if (particles[index].visible && intersectsParticle(rayOrigin, rayDirection, particles[index], hitPosition, hitNormal, dist, hitExit) && dist < maxDist)
+                {
+                    return true;
+                }
+            }
+        }
+        else
+        {
+            stack[stackSize++] = node.leftFirst;
+            stack[stackSize++] = node.leftFirst + 1;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,69 @@
+// Packed G-buffer of the base pass. ParticleBasePassCS writes the normal as two
+// octahedral R16G16_SNORM components, the velocity as R16G16_FLOAT and the
+// particle id as R32_UINT. The position isn't stored: reconstructPosition() gets it
+// back from depthBuffer. The pack/unpack functions give the texels those formats
+// hold, for the CPU side (code/shaderport.h) and bench::gbuffer.
+
+// Sign that is +1 for 0, so the folded hemisphere keeps its quadrant.
+float2 octahedralSign(float2 v)
+{
+    return float2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// Unit vector to [-1, 1]^2: projected on the octahedron, lower half folded out.
+float2 encodeOctahedral(float3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    float2 e = n.xy;
+    if (n.z < 0.0)
+    {
+        e = (1.0 - abs(float2(n.y, n.x))) * octahedralSign(e);
+    }
+    return e;
+}
+
+float3 decodeOctahedral(float2 e)
+{
+    float3 n = float3(e.x, e.y, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+    {
+        float2 folded = (1.0 - abs(float2(n.y, n.x))) * octahedralSign(float2(n.x, n.y));
+        n.x = folded.x;
+        n.y = folded.y;
+    }
+    return normalize(n);
+}
+
+// One R16G16_SNORM texel, x in the low half.
+uint packSnorm2x16(float2 v)
+{
+    uint x = uint(int(round(clamp(v.x, -1.0, 1.0) * 32767.0))) & 0xffff;
+    uint y = uint(int(round(clamp(v.y, -1.0, 1.0) * 32767.0))) & 0xffff;
+    return x | (y << 16);
+}
+
+float2 unpackSnorm2x16(uint p)
+{
+    float x = float(int(p << 16) >> 16) / 32767.0;
+    float y = float(int(p) >> 16) / 32767.0;
+    return float2(max(x, -1.0), max(y, -1.0));
+}
+
+// One R16G16_FLOAT texel, x in the low half.
+uint packHalf2x16(float2 v)
+{
+    return f32tof16(v.x) | (f32tof16(v.y) << 16);
+}
+
+float2 unpackHalf2x16(uint p)
+{
+    return float2(f16tof32(p & 0xffff), f16tof32(p >> 16));
+}
+
+// The hit the base pass wrote depth for. uv is the pixel over the resolution, as
+// tracePrimary() gets it, and depth its clip z / w; a miss gives the far plane.
+float3 reconstructPosition(float2 uv, float depth, float4x4 invViewProj)
+{
+    float4 worldPos = mul(float4(uv * 2.0 - 1.0, depth, 1.0), invViewProj);
+    return worldPos.xyz / worldPos.w;
+}
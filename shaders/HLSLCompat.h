@@ -0,0 +1,24 @@
+#ifndef _HLSL_COMPAT_H_
+#define _HLSL_COMPAT_H_
+
+// Spellings that differ between HLSL and the C++ emulation in code/hlsl.h.
+// Files that are shared with the CPU (.hlsli includes) use these instead of the
+// HLSL keywords so they compile on both sides.
+
+#ifdef IS_CPU
+#define INOUT(type) type&
+#define OUT(type) type&
+#define UNROLL
+#define LOOP
+#define THREAD_STATIC static thread_local
+#define ZERO_INIT(type) type{}
+#else
+#define INOUT(type) inout type
+#define OUT(type) out type
+#define UNROLL [unroll]
+#define LOOP [loop]
+#define THREAD_STATIC static
+#define ZERO_INIT(type) (type)0
+#endif
+
+#endif
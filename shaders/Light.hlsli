@@ -0,0 +1,120 @@
+#include "ParticleConfig.h"
+
+// Next event estimation against the emissive particles. Included by PathTrace.hlsli
+// after traceAny(), with `lights`, `lightNum` and `lightPowerSum` bound next to
+// `particles`. The light list comes from code/lights.h, which weighs every emissive
+// sphere by getLightPower().
+//
+// Emission is read off ParticleData like the list builder does it, not through
+// getMaterial(). Scene 0 doesn't change albedo or emissive there.
+
+// What pathtrace() adds when a bounce hits the particle: the throughput, which the
+// hit already multiplied by albedo, times albedo * emissive.
+float3 getLightEmission(ParticleData particle)
+{
+    return particle.material.albedo * particle.material.albedo * particle.material.emissive;
+}
+
+// Emission over the whole sphere, up to a constant.
+float getLightPower(ParticleData particle)
+{
+    float3 emission = getLightEmission(particle);
+    return dot(emission, float3(0.2126, 0.7152, 0.0722)) * particle.radius * particle.radius;
+}
+
+float getLightSelectionPdf(ParticleData particle)
+{
+    return getLightPower(particle) / lightPowerSum;
+}
+
+// First light whose cdf is above u.
+uint selectLight(float u, OUT(float) selectionPdf)
+{
+    uint low = 0;
+    uint high = lightNum - 1;
+    while (low < high)
+    {
+        uint middle = (low + high) / 2;
+        if (lights[middle].cdf <= u)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    selectionPdf = lights[low].pdf;
+    return lights[low].particle;
+}
+
+// 1 - cos of the half angle the sphere covers seen from position, 0 from inside it.
+// Written so it doesn't cancel out for small, far away spheres.
+float getSphereConeSize(float3 position, ParticleData light)
+{
+    float3 toCenter = light.position - position;
+    float ratio = light.radius * light.radius / dot(toCenter, toCenter);
+    if (ratio >= 1.0)
+    {
+        return 0.0;
+    }
+    return ratio / (1.0 + sqrt(1.0 - ratio));
+}
+
+// Solid angle pdf of sampleSphereCone().
+float getSphereConePdf(float3 position, ParticleData light)
+{
+    float coneSize = getSphereConeSize(position, light);
+    return coneSize > 0.0 ? 1.0 / (2.0 * PI * coneSize) : 0.0;
+}
+
+// Uniform direction inside the cone the sphere covers seen from position.
+float3 sampleSphereCone(float3 position, ParticleData light, float2 u)
+{
+    float3 axis = normalize(light.position - position);
+    float3 o1 = normalize(ortho(axis));
+    float3 o2 = cross(axis, o1);
+    float cosTheta = 1.0 - u.x * getSphereConeSize(position, light);
+    float sinTheta = sqrt(max(0.0, 1.0 - cosTheta * cosTheta));
+    float phi = u.y * 2.0 * PI;
+    return cos(phi) * sinTheta * o1 + sin(phi) * sinTheta * o2 + cosTheta * axis;
+}
+
+float getPowerHeuristic(float pdf, float otherPdf)
+{
+    return (pdf * pdf) / (pdf * pdf + otherPdf * otherPdf);
+}
+
+// Light reaching a diffuse hit from one light picked by power, with a shadow ray,
+// weighted against the cosine sampled bounce that could have found it as well. The
+// result still has to be multiplied by the throughput and the hit's albedo.
+// u.x picks the light, u.yz the direction.
+float3 sampleDirectLight(float3 position, float3 normal, float3 u)
+{
+    float selectionPdf = 0.0;
+    ParticleData light = particles[selectLight(u.x, selectionPdf)];
+    float conePdf = getSphereConePdf(position, light);
+    if (conePdf <= 0.0)
+    {
+        return 0;
+    }
+
+    float3 direction = sampleSphereCone(position, light, u.yz);
+    float cosine = dot(normal, direction);
+    float3 lightPosition;
+    float3 lightNormal;
+    float3 lightExit;
+    float lightDist = 0.0;
+    if (cosine <= 0.0 || !intersectsParticle(position, direction, light, lightPosition, lightNormal, lightDist, lightExit))
+    {
+        return 0;
+    }
+    if (traceAny(position + direction * 1e-3, direction, lightDist - 2e-3))
+    {
+        return 0;
+    }
+
+    float lightPdf = selectionPdf * conePdf;
+    float bsdfPdf = cosine / PI;
+    return getLightEmission(light) * (bsdfPdf / lightPdf * getPowerHeuristic(lightPdf, bsdfPdf));
+}
@@ -0,0 +1,82 @@
+#include "ParticleConfig.h"
+
+// Value noise with analytic derivatives, shared by the materials and the CPU port.
+// With PARTICLE_NOISE_VOLUME defined and a lattice from code/noisevolume.h bound
+// (`noiseLattice`, `noiseLatticeExtent`), noised() reads the corner hashes inside
+// the lattice instead of evaluating sin() for them, with the same result.
+
+float hash(float n)
+{
+    return frac(sin(n) * 753.5);
+}
+
+float4 noised(float3 x)
+{
+    float3 p = floor(x);
+    float3 w = frac(x);
+    float3 u = w * w * (3 - 2 * w);
+    float3 du = 6 * w * (1 - w);
+
+    float n = p.x + p.y * 157 + 113 * p.z;
+
+    float a, b, c, d, e, f, g, h;
+#if PARTICLE_NOISE_VOLUME
+    float extent = float(noiseLatticeExtent);
+    if (p.x >= -extent && p.y >= -extent && p.z >= -extent && p.x < extent && p.y < extent && p.z < extent)
+    {
+        // Corner (x, y, z) of the cell holds hash(n + x + 157 * y + 113 * z).
+        uint size = 2 * noiseLatticeExtent + 1;
+        uint index = ((uint(p.z + extent) * size) + uint(p.y + extent)) * size + uint(p.x + extent);
+        a = noiseLattice[index];
+        b = noiseLattice[index + 1];
+        c = noiseLattice[index + size];
+        d = noiseLattice[index + size + 1];
+        e = noiseLattice[index + size * size];
+        f = noiseLattice[index + size * size + 1];
+        g = noiseLattice[index + size * size + size];
+        h = noiseLattice[index + size * size + size + 1];
+    }
+    else
+#endif
+    {
+        a = hash(n);
+        b = hash(n + 1);
+        c = hash(n + 157);
+        d = hash(n + 158);
+        e = hash(n + 113);
+        f = hash(n + 114);
+        g = hash(n + 270);
+        h = hash(n + 271);
+    }
+
+    float k0 = a;
+    float k1 = b - a;
+    float k2 = c - a;
+    float k3 = e - a;
+    float k4 = a - b - c + d;
+    float k5 = a - c - e + g;
+    float k6 = a - b - e + f;
+    float k7 = -a + b + c - d + e - f - g + h;
+
+    return float4(k0 + k1 * u.x + k2 * u.y + k3 * u.z + k4 * u.x * u.y + k5 * u.y * u.z + k6 * u.z * u.x + k7 * u.x * u.y * u.z,
+		du * (float3(k1, k2, k3) + u.yzx * float3(k4, k5, k6) + u.zxy * float3(k6, k4, k5) + k7 * u.yzx * u.zxy));
+}
+
+float4 fbmd(float3 x)
+{
+    float a = 0,
+		b = 0.5,
+		f = 1;
+    float3 d = float3(0, 0, 0);
+    UNROLL
+    for (int i = 0; i < 3; i++)
+    {
+        float4 n = noised(f * x);
+        a += b * n.x; // accumulate values      
+        d += b * n.yzw * f; // accumulate derivatives
+        b *= 0.5; // amplitude decrease
+        f *= 1.8; // frequency increase
+    }
+
+    return float4(a, d);
+}
@@ -1,8 +1,13 @@
 #ifndef _PARTICLE_CONFIG_H_
 #define _PARTICLE_CONFIG_H_
 
+#include "HLSLCompat.h"
+
 //#define NUM_PARTICLES (32*1)
 
+#define RENDER_WIDTH 1920
+#define RENDER_HEIGHT 1080
+
 #ifdef IS_CPU
 typedef ni::Float3 float3;
 typedef ni::Float4x4 float4x4;
@@ -19,6 +24,11 @@ struct Material
 	float indexOfRefraction;
 };
 
+// ParticleData::primitive. A plane keeps the position and radius of the sphere it
+// stands in for, see shaders/Primitive.hlsli.
+#define PARTICLE_PRIMITIVE_SPHERE 0
+#define PARTICLE_PRIMITIVE_PLANE 1
+
 struct ParticleData
 {
 	float3 position;
@@ -31,14 +41,102 @@ struct ParticleData
 	uint id; // don't use this. It's for the temporal reprojection rejection
 	uint dynamic;
 	uint visible;
+	uint primitive; // PARTICLE_PRIMITIVE_*
 	Material material;
 };
 
+// Flattened BVH node (code/bvh.h), 32 bytes so the node array can be uploaded as a
+// StructuredBuffer as is. Interior nodes have primitiveNum == 0 and their children
+// at leftFirst and leftFirst + 1. Leaves reference primitiveNum particle indices
+// starting at leftFirst in the primitive index buffer.
+struct BvhNode
+{
+	float3 boundsMin;
+	uint leftFirst;
+	float3 boundsMax;
+	uint primitiveNum;
+};
+
 struct ParticleSceneData
 {
 	uint numParticles;
 };
 
+// Entry of the emissive particle list (code/lights.h) that next event estimation
+// picks lights from, in particle order. cdf is inclusive, the last light's is 1.
+struct LightData
+{
+	uint particle;
+	float cdf;
+	float pdf;
+	float _padding;
+};
+
+// Light sample reservoir of one pixel (shaders/Restir.hlsli). The sample is a point
+// on the emissive particle `light`, kept as its offset from the center.
+struct LightReservoir
+{
+	float3 lightOffset;
+	uint light; // RESTIR_NO_LIGHT when empty
+	float weightSum;
+	float M;
+	float W;
+	float targetPdf; // of the sample, at the surface that holds the reservoir
+};
+
+// The camera hit a reservoir belongs to. depth is 0 where there is none.
+struct RestirSurface
+{
+	float3 position;
+	float depth;
+	float3 normal;
+	uint id;
+	float3 albedo;
+	float _padding;
+};
+
+// ConstantBufferData::samplerType, where the path tracer's random numbers come from.
+// SAMPLER_HASH is the old sin hash, kept to compare against (`-bench sampler`).
+#define SAMPLER_SOBOL 0
+#define SAMPLER_HASH 1
+
+// Adaptive sampling (code/adaptive.h) gives every ADAPTIVE_TILE_SIZE tile of the base
+// pass its own sample count, at most ADAPTIVE_MAX_SAMPLE_COUNT, with sampleCount as
+// the average.
+#define ADAPTIVE_TILE_SIZE 32
+#define ADAPTIVE_MAX_SAMPLE_COUNT 16
+
+// Camera rays test the spheres binned to their TILE_BIN_SIZE screen tile
+// (code/tilebins.h) rather than every particle.
+#define TILE_BIN_SIZE 16
+
+// The noise lattice (code/noisevolume.h) holds the value noise hashes of the
+// integer points in [-NOISE_VOLUME_EXTENT, NOISE_VOLUME_EXTENT]^3, noised() inputs
+// outside it fall back to evaluating them.
+#define NOISE_VOLUME_EXTENT 64
+
+// Reservoir resampling of the camera hit's direct light (shaders/Restir.hlsli):
+// candidates per pixel and frame, the cap on the history's M as a multiple of the
+// candidates, and the neighbours merged within a radius in pixels when their
+// normal and camera distance are close enough.
+#define RESTIR_NO_LIGHT 0xffffffffu
+#define RESTIR_CANDIDATE_NUM 8
+#define RESTIR_HISTORY_LIMIT 20
+#define RESTIR_SPATIAL_NUM 4
+#define RESTIR_SPATIAL_RADIUS 16.0
+#define RESTIR_NORMAL_THRESHOLD 0.9
+#define RESTIR_DEPTH_THRESHOLD 0.1
+
+// Progressive accumulation of a still image (code/accumulation.h). The running mean
+// replaces the temporal and a-trous passes once it holds ACCUMULATION_DENOISE_FRAME_NUM
+// frames, and the base pass stops at ACCUMULATION_MAX_FRAME_NUM.
+#define ACCUMULATION_DENOISE_FRAME_NUM 32
+#define ACCUMULATION_MAX_FRAME_NUM 4096
+
+// ConstantBufferData::bounceNum, clamped to PATH_MAX_BOUNCE_NUM. 0 picks the default.
+#define PATH_DEFAULT_BOUNCE_NUM 5
+#define PATH_MAX_BOUNCE_NUM 16
+
 struct ConstantBufferData
 {
 	float3 cameraPos;
@@ -54,6 +152,9 @@ struct ConstantBufferData
 	float time;
 	float frame;
 	uint sampleCount;
+	uint samplerType; // SAMPLER_*
+	uint bounceNum; // surface hits a path can have
+	uint rouletteBounce; // first bounce Russian roulette may end a path after, 0 = never
 };
 
 struct DepthOfFieldData
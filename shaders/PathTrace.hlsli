@@ -0,0 +1,561 @@
+#include "ParticleConfig.h"
+#include "Primitive.hlsli"
+#include "Sampler.hlsli"
+
+// Path tracer shared between ParticleBasePassCS.hlsl and the CPU (code/cpurender.h).
+// Expects `particles`, `constantData`, `particleScene` and `simData` to be bound and
+// Noise.hlsli plus the scene material files to be included by the includer. With
+// PARTICLE_BVH defined trace() goes through Bvh.hlsli whenever a BVH is bound. With
+// PARTICLE_LIGHTS defined diffuse hits sample the bound light list (Light.hlsli).
+// With PARTICLE_TILE_BINS defined camera rays test bound tile bins (TileBins.hlsli)
+// instead of the BVH, with PARTICLE_SPLATS defined they read a bound splat buffer
+// (Splat.hlsli) before either. With PARTICLE_RESTIR defined and reservoirs bound the
+// camera hit's direct light is left to Restir.hlsli. With PARTICLE_ADAPTIVE_SAMPLING
+// defined a bound sample count map overrides constantData.sampleCount per tile
+// (AdaptiveSampling.hlsli).
+// constantData.samplerType picks the random numbers, see Sampler.hlsli.
+
+struct PathtraceOutput
+{
+    float3 color;
+};
+
+// First hit of a pixel's camera ray. The camera ray is the same for every sample of
+// the pixel, so shadeBasePass() traces it once and every path starts from here.
+struct PrimaryHit
+{
+    ParticleData particle;
+    float3 direction;
+    float3 position;
+    float3 normal;
+    float3 exit;
+    bool hit;
+};
+
+// Everything the base pass writes for one pixel.
+struct BasePassOutput
+{
+    float4 color;
+    float4 velocity;
+    float4 position;
+    float4 normal;
+    float depth;
+};
+
+Material getMaterial(ParticleData particle, uint pid, INOUT(float3) position, INOUT(float3) normal, uint scene, float time)
+{
+    Material material = ZERO_INIT(Material);
+    if (scene == 0) material = getMaterialScene0(particle, pid, position, normal, time);
+    return material;
+}
+
+
+void createRayFromUV(float2 uv, float4x4 invViewProj, float3 cameraPosition, OUT(float3) rayOrigin, OUT(float3) rayDirection)
+{
+    float4 clipSpacePos = float4(uv * 2.0 - 1.0, 1.0, 1.0);
+    float4 worldPos = mul(clipSpacePos, invViewProj);
+    worldPos /= worldPos.w;
+    rayOrigin = cameraPosition;
+    rayDirection = normalize(worldPos.xyz - cameraPosition);
+}
+
+bool intersectsParticle(float3 rayOrigin, float3 rayDirection, ParticleData particle, OUT(float3) outPosition, OUT(float3) outNormal, OUT(float) outDist, OUT(float3) exitPosition)
+{
+    if (particle.primitive == PARTICLE_PRIMITIVE_PLANE)
+    {
+        return intersectsPlane(rayOrigin, rayDirection, particle, outPosition, outNormal, outDist, exitPosition);
+    }
+
+    float3 oc = rayOrigin - particle.position;
+    float a = dot(rayDirection, rayDirection);
+    float b = 2.0f * dot(oc, rayDirection);
+    float c = dot(oc, oc) - particle.radius * particle.radius;
+    float discriminant = b * b - 4.0f * a * c;
+
+    if (discriminant < 0.0)
+    {
+        outPosition = float3(0.0, 0.0, 0.0);
+        outNormal = float3(0.0, 0.0, 0.0);
+        outDist = 0;
+        exitPosition = float3(0.0, 0.0, 0.0);
+        return false;
+    }
+    else
+    {
+        float sqrtDiscriminant = sqrt(discriminant);
+        float t1 = (-b - sqrtDiscriminant) / (2.0f * a);
+        float t2 = (-b + sqrtDiscriminant) / (2.0f * a);
+
+        float t = (t1 > 0.0) ? t1 : t2;
+        if (t < 0.0)
+        {
+            outPosition = float3(0.0, 0.0, 0.0);
+            outNormal = float3(0.0, 0.0, 0.0);
+            outDist = 0;
+            exitPosition = float3(0.0, 0.0, 0.0);
+            return false;
+        }
+
+        outPosition = rayOrigin + t * rayDirection;
+        outNormal = normalize(outPosition - particle.position);
+        outDist = t;
+
+        // exit point always corresponds to the farther root
+        float tExit = max(t1, t2);
+        exitPosition = rayOrigin + tExit * rayDirection;
+
+        return true;
+    }
+}
+
+#if PARTICLE_BVH
+#include "Bvh.hlsli"
+#endif
+
+bool trace(float3 rayOrigin, float3 rayDirection, OUT(ParticleData) outParticle, OUT(float3) outPosition, OUT(float3) outNormal, OUT(float3) outExit)
+{
+#ifdef IS_CPU
+    rayNum++;
+#endif
+#if PARTICLE_BVH
+    if (bvhNodeNum > 0)
+    {
+        return traceClosestBvh(rayOrigin, rayDirection, outParticle, outPosition, outNormal, outExit);
+    }
+#endif
+    bool hit = false;
+    float lastDepth = 3.402823466e+38F;
+    for (uint i = 0; i < particleScene.numParticles; i++)
+    {
+        if (!particles[i].visible)
+        {
+            continue;
+        }
+
+        float3 hitPosition;
+        float3 hitNormal;
+        float3 hitExit;
+        float dist = 0.0;
+        if (intersectsParticle(rayOrigin, rayDirection, particles[i], hitPosition, hitNormal, dist, hitExit))
+        {
+            if (dist < lastDepth)
+            {
+                outParticle = particles[i];
+                outPosition = hitPosition;
+                outNormal = hitNormal;
+                outExit = hitExit;
+                lastDepth = dist;
+            }
+            hit = true;
+        }
+    }
+    return hit;
+}
+
+// True when a visible particle is hit closer than maxDist, for shadow rays.
+bool traceAny(float3 rayOrigin, float3 rayDirection, float maxDist)
+{
+#ifdef IS_CPU
+    rayNum++;
+#endif
+#if PARTICLE_BVH
+    if (bvhNodeNum > 0)
+    {
+        return traceAnyBvh(rayOrigin, rayDirection, maxDist);
+    }
+#endif
+    for (uint i = 0; i < particleScene.numParticles; i++)
+    {
+        float3 hitPosition;
+        float3 hitNormal;
+        float3 hitExit;
+        float dist = 0.0;
+        if (particles[i].visible && intersectsParticle(rayOrigin, rayDirection, particles[i], hitPosition, hitNormal, dist, hitExit) && dist < maxDist)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+#if PARTICLE_TILE_BINS
+#include "TileBins.hlsli"
+#endif
+#if PARTICLE_SPLATS
+#include "Splat.hlsli"
+#endif
+
+THREAD_STATIC float2 seed2 = float2(1.0f, 1.0f);
+float2 rand2n()
+{
+    seed2 += float2(-1.0f, 1.0f);
+    float x = frac(sin(dot(seed2.xy, float2(12.9898f, 78.233f))) * 43758.5453f);
+    float y = frac(cos(dot(seed2.xy, float2(4.898f, 7.23f))) * 23421.631f);
+    return float2(x, y);
+}
+
+// The path shadeBasePass() is tracing, for SAMPLER_SOBOL.
+THREAD_STATIC uint2 samplePixel = uint2(0, 0);
+THREAD_STATIC uint sampleIndex = 0;
+THREAD_STATIC float4 bouncePairSample = float4(0.0, 0.0, 0.0, 0.0);
+// What is left of the path's choice number, negative until the first choice.
+THREAD_STATIC float pathChoice = -1.0;
+
+#define SAMPLER_CHOICE_SEED 0x80000000u
+
+// Direction sample of a bounce. Two bounces in a row share a 4D Sobol point, so their
+// directions are stratified together, and every pair has its own scrambled sequence.
+float2 getBounceSample(uint bounce)
+{
+    if ((bounce & 1) == 0)
+    {
+        bouncePairSample = getPixelSample4D(samplePixel, sampleIndex, bounce >> 1);
+        return bouncePairSample.xy;
+    }
+    return bouncePairSample.zw;
+}
+
+// SAMPLER_HASH draws from rand2n() at the same points, in the same order as before.
+float2 getDirectionSample(float2 bounceSample)
+{
+    if (constantData.samplerType == SAMPLER_HASH)
+    {
+        return rand2n();
+    }
+    return bounceSample;
+}
+
+// True with probability 1 - threshold. Sobol paths make all their choices from one
+// number, rescaled to [0, 1) again after each choice, so the combinations of choices
+// along a path are stratified too and not just every choice on its own.
+bool sampleChoice(float threshold)
+{
+    if (constantData.samplerType == SAMPLER_HASH)
+    {
+        return rand2n().x > threshold;
+    }
+    if (pathChoice < 0.0)
+    {
+        pathChoice = getPixelSample4D(samplePixel, sampleIndex, SAMPLER_CHOICE_SEED).x;
+    }
+    bool above = pathChoice > threshold;
+    pathChoice = above ? (pathChoice - threshold) / (1.0 - threshold) : pathChoice / max(threshold, 1e-6);
+    pathChoice = min(pathChoice, 0.99999994);
+    return above;
+}
+
+#define SAMPLER_ROULETTE_SEED 0x20000000u
+
+float getRouletteSample(uint bounce)
+{
+    if (constantData.samplerType == SAMPLER_HASH)
+    {
+        return rand2n().x;
+    }
+    return getPixelSample1D(samplePixel, sampleIndex, SAMPLER_ROULETTE_SEED + bounce);
+}
+
+float3 ortho(float3 v)
+{
+    // http://lolengine.net/blog/2013/09/21/picking-orthogonal-vector-combing-coconuts
+    return (abs(v.x) > abs(v.z)) ? float3(-v.y, v.x, 0.0f)
+                                 : float3(0.0f, -v.z, v.y);
+}
+static const float PI = 3.14159265358979323846f;
+float3 getSampleBiased(float3 dir, float power, float2 r)
+{
+    dir = normalize(dir);
+    float3 o1 = normalize(ortho(dir));
+    float3 o2 = normalize(cross(dir, o1));
+
+    r.x = r.x * 2.0f * PI;
+    r.y = pow(r.y, 1.0f / (power + 1.0f));
+
+    float oneminus = sqrt(max(0.0f, 1.0f - r.y * r.y));
+
+    return cos(r.x) * oneminus * o1
+         + sin(r.x) * oneminus * o2
+         + r.y * dir;
+}
+
+float3 getCosineWeightedSample(float3 dir, float2 r)
+{
+    return getSampleBiased(dir, 1.0f, r);
+}
+
+#if PARTICLE_ADAPTIVE_SAMPLING
+#include "AdaptiveSampling.hlsli"
+#endif
+
+#if PARTICLE_LIGHTS
+#include "Light.hlsli"
+
+#define SAMPLER_LIGHT_SEED 0x40000000u
+
+// Light pick in x, direction toward the light in yz.
+float3 getLightSample(uint bounce)
+{
+    if (constantData.samplerType == SAMPLER_HASH)
+    {
+        float pick = rand2n().x;
+        float2 direction = rand2n();
+        return float3(pick, direction.x, direction.y);
+    }
+    return getPixelSample4D(samplePixel, sampleIndex, SAMPLER_LIGHT_SEED + bounce).xyz;
+}
+#endif
+
+float3 getBackground(float3 dir)
+{
+    return (float3(0.11, 0.11, 0.18) * pow(((1.0 - dir.y)), 2.0)) * 0;
+}
+
+uint getBounceNum()
+{
+    return constantData.bounceNum == 0 ? PATH_DEFAULT_BOUNCE_NUM : min(constantData.bounceNum, PATH_MAX_BOUNCE_NUM);
+}
+
+PathtraceOutput pathtrace(float3 rayOrigin, PrimaryHit primary)
+{
+    float3 rayDirection = primary.direction;
+    ParticleData particle;
+    float3 luminance = 1;
+    float3 hitNormal = 0;
+    float3 hitPosition = 0;
+    float3 hitExit = 0;
+    PathtraceOutput output;
+    output.color = 0;
+    // Where the path left the last diffuse hit and the pdf of that bounce direction,
+    // 0 when light sampling didn't see that bounce and a light hit counts in full.
+    float3 lastPosition = 0;
+    float lastBsdfPdf = 0.0;
+#if PARTICLE_RESTIR
+    // The camera hit's direct light comes from Restir.hlsli, so light found by its
+    // bounce counts nothing.
+    bool reservoirLit = false;
+#endif
+    uint bounceNum = getBounceNum();
+    uint hitNum = 0;
+
+    for (uint bounce = 0; bounce < bounceNum; ++bounce)
+    {
+        bool hit = primary.hit;
+        if (bounce == 0)
+        {
+            particle = primary.particle;
+            hitPosition = primary.position;
+            hitNormal = primary.normal;
+            hitExit = primary.exit;
+        }
+        else
+        {
+            hit = trace(rayOrigin, rayDirection, particle, hitPosition, hitNormal, hitExit);
+        }
+        if (hit)
+        {
+            hitNum++;
+            float2 bounceSample = 0;
+            if (constantData.samplerType == SAMPLER_SOBOL)
+            {
+                bounceSample = getBounceSample(bounce);
+            }
+
+            Material hitMaterial = getMaterial(particle, particle.id - 1, hitPosition, hitNormal, simData.scene, simData.time);
+            float emissionWeight = 1.0;
+#if PARTICLE_LIGHTS
+            if (lastBsdfPdf > 0.0 && hitMaterial.emissive > 0)
+            {
+                emissionWeight = getPowerHeuristic(lastBsdfPdf, getLightSelectionPdf(particle) * getSphereConePdf(lastPosition, particle));
+            }
+            lastBsdfPdf = 0.0;
+            bool isDiffuse = hitMaterial.reflection == 0.0 && hitMaterial.transparency == 0.0;
+            // A light found from the last hit would be one bounce past what the loop traces.
+            isDiffuse = isDiffuse && bounce + 1 < bounceNum;
+#if PARTICLE_RESTIR
+            if (reservoirLit && hitMaterial.emissive > 0)
+            {
+                emissionWeight = 0.0;
+            }
+            reservoirLit = bounce == 0 && restirWidth > 0 && isDiffuse && lightNum > 0;
+            isDiffuse = isDiffuse && !reservoirLit;
+#endif
+            if (isDiffuse && lightNum > 0)
+            {
+                output.color += luminance * hitMaterial.albedo * sampleDirectLight(hitPosition, hitNormal, getLightSample(bounce));
+            }
+#endif
+            if (hitMaterial.transparency > 0.0)
+            {
+                bool refracts = hitMaterial.reflection == 0.0;
+                if (!refracts)
+                {
+                    refracts = sampleChoice(abs(hitMaterial.transparency * hitMaterial.reflection) * 0.5);
+                }
+                if (refracts)
+                {
+                    rayDirection = (normalize(refract(rayDirection, normalize(particle.position - hitExit), hitMaterial.indexOfRefraction)));
+                    rayOrigin = hitExit + rayDirection * 1e-3;
+                    float3 color = lerp(hitMaterial.albedo, 1, hitMaterial.transparency);
+                    luminance *= (color * 2);
+
+                }
+                else
+                {
+                    rayDirection = lerp(getCosineWeightedSample(hitNormal, getDirectionSample(bounceSample)), normalize(reflect(rayDirection, hitNormal)), hitMaterial.reflection);
+                    rayOrigin = hitPosition + rayDirection * 1e-3;
+                    luminance *= hitMaterial.albedo;
+                }
+            }
+            else
+            {
+                rayDirection = lerp(getCosineWeightedSample(hitNormal, getDirectionSample(bounceSample)), normalize(reflect(rayDirection, hitNormal)), hitMaterial.reflection);
+                rayOrigin = hitPosition + rayDirection * 1e-3;
+                luminance *= hitMaterial.albedo;
+#if PARTICLE_LIGHTS
+                if (isDiffuse && lightNum > 0)
+                {
+                    lastPosition = hitPosition;
+                    lastBsdfPdf = max(dot(hitNormal, rayDirection), 0.0) / PI;
+                }
+#endif
+            }
+
+            if (hitMaterial.emissive > 0)
+            {
+                output.color += luminance * hitMaterial.albedo * hitMaterial.emissive * emissionWeight;
+            }
+
+            // Russian roulette: from rouletteBounce hits on, the path goes on with the
+            // probability of its largest throughput component and is divided by it, so
+            // dark paths end early without changing the expected color.
+            if (constantData.rouletteBounce > 0 && hitNum >= constantData.rouletteBounce && bounce + 1 < bounceNum)
+            {
+                float survival = min(max(max(luminance.x, luminance.y), luminance.z), 1.0);
+                if (!(getRouletteSample(bounce) < survival))
+                {
+                    break;
+                }
+                luminance /= survival;
+            }
+        }
+        else
+        {
+            output.color += luminance * getBackground(rayDirection);
+            break;
+        }
+    }
+
+#ifdef IS_CPU
+    pathLengthNums[hitNum]++;
+#endif
+    return output;
+}
+
+#if PARTICLE_RESTIR
+#include "Restir.hlsli"
+#endif
+
+PrimaryHit tracePrimary(float2 uv, uint2 pixel, OUT(float3) rayOrigin)
+{
+#ifdef IS_CPU
+    cameraRayNum++;
+#endif
+    PrimaryHit primary;
+    createRayFromUV(uv, constantData.invViewProjMtx, constantData.cameraPos, rayOrigin, primary.direction);
+    primary.particle = ZERO_INIT(ParticleData);
+    primary.normal = -primary.direction;
+    primary.position = rayOrigin + primary.direction * 3.402823466e+38F;
+    primary.exit = 0;
+#if PARTICLE_SPLATS
+    if (splatWidth > 0)
+    {
+        primary.hit = getSplatHit(rayOrigin, primary.direction, pixel, primary.particle, primary.position, primary.normal, primary.exit);
+        return primary;
+    }
+#endif
+#if PARTICLE_TILE_BINS
+    if (binColumnNum > 0)
+    {
+        primary.hit = traceTileBins(rayOrigin, primary.direction, pixel, primary.particle, primary.position, primary.normal, primary.exit);
+        return primary;
+    }
+#endif
+    primary.hit = trace(rayOrigin, primary.direction, primary.particle, primary.position, primary.normal, primary.exit);
+    return primary;
+}
+
+// Screen space motion from last frame to this one: the hit point carried back with
+// its particle (prevPosition) and seen through last frame's camera. A miss moves
+// like the direction at infinity, so only the camera rotation shows.
+float2 getPrimaryVelocity(PrimaryHit primary)
+{
+    float4 prevPos = mul(constantData.prevViewProjMtx, float4(primary.direction, 0));
+    float4 currPos = mul(constantData.viewProjMtx, float4(primary.direction, 0));
+    if (primary.hit)
+    {
+        prevPos = mul(constantData.prevViewProjMtx, float4(primary.position + primary.particle.prevPosition - primary.particle.position, 1));
+        currPos = mul(constantData.viewProjMtx, float4(primary.position, 1));
+    }
+
+    float2 prevUv = (prevPos.xy / prevPos.w) * 0.5 + 0.5;
+    float2 currUv = (currPos.xy / currPos.w) * 0.5 + 0.5;
+    return prevUv - currUv;
+}
+
+// Body of ParticleBasePassCS main() for one pixel.
+BasePassOutput shadeBasePass(uint2 pixel)
+{
+    float2 uv = float2(pixel) / constantData.resolution.xy;
+    float3 rayOrigin = 0;
+    PathtraceOutput output;
+    output.color = 0;
+
+    float offsetTime = constantData.time;
+#if 0
+    if ((pixel.x % 4) == 0 || (pixel.y % 4) == 0)
+    {
+        offsetTime = fmod(offsetTime, 1);
+    }
+#endif
+    seed2 = uv + cos(offsetTime);
+
+    PrimaryHit primary = tracePrimary(uv, pixel, rayOrigin);
+    float2 velocity = getPrimaryVelocity(primary);
+#if PARTICLE_RESTIR
+    if (restirWidth > 0)
+    {
+        restirInitial(pixel, primary, velocity);
+    }
+#endif
+    float4 clipSpacePos = mul(constantData.viewProjMtx, float4(primary.position, 1.0));
+    float depth = primary.hit ? clipSpacePos.z / clipSpacePos.w : 1;
+
+    int samples = constantData.sampleCount;
+    uint sampleStride = constantData.sampleCount;
+#if PARTICLE_ADAPTIVE_SAMPLING
+    if (tileColumnNum > 0)
+    {
+        // Every frame gets a full block of indices, so tiles that change their count
+        // from frame to frame don't reuse samples.
+        samples = getTileSampleCount(pixel);
+        sampleStride = ADAPTIVE_MAX_SAMPLE_COUNT;
+    }
+#endif
+    for (int i = 0; i < samples; i++)
+    {
+        samplePixel = pixel;
+        sampleIndex = uint(constantData.frame) * sampleStride + uint(i);
+        pathChoice = -1.0;
+        PathtraceOutput ptResult = pathtrace(rayOrigin, primary);
+        output.color += ptResult.color;
+    }
+    output.color /= float(samples);
+
+    BasePassOutput pixelOutput;
+    pixelOutput.color = float4(output.color, 1);
+    pixelOutput.velocity = float4(velocity, 0, 1);
+    pixelOutput.position = float4(primary.position, float(primary.particle.id));
+    pixelOutput.normal = float4(primary.normal, 1);
+    pixelOutput.depth = depth;
+    return pixelOutput;
+}
@@ -0,0 +1,44 @@
+#ifndef _PRIMITIVE_HLSLI_
+#define _PRIMITIVE_HLSLI_
+
+#include "ParticleConfig.h"
+
+// A PARTICLE_PRIMITIVE_PLANE particle is the tangent plane of its sphere that faces
+// the world origin. Scene 0 builds its room out of radius 999 spheres; as planes
+// they cost a dot product per ray, and spatial structures no longer see a
+// 2000 unit wide primitive. The normal points away from the sphere center, into the
+// room, like the sphere's own normal there.
+float3 getPlaneNormal(ParticleData particle)
+{
+    return -normalize(particle.position);
+}
+
+// Signed distance from the plane, positive on the side the normal faces.
+float getPlaneDistance(ParticleData particle, float3 position)
+{
+    return dot(position - particle.position, getPlaneNormal(particle)) - particle.radius;
+}
+
+// Same outputs as the sphere test. A plane has no thickness, so the exit point is
+// the hit point. Both sides are hit, rays parallel to the plane are not.
+bool intersectsPlane(float3 rayOrigin, float3 rayDirection, ParticleData particle, OUT(float3) outPosition, OUT(float3) outNormal, OUT(float) outDist, OUT(float3) exitPosition)
+{
+    float3 normal = getPlaneNormal(particle);
+    float denominator = dot(rayDirection, normal);
+    float t = -getPlaneDistance(particle, rayOrigin) / denominator;
+    if (denominator == 0.0 || !(t >= 0.0))
+    {
+        outPosition = float3(0.0, 0.0, 0.0);
+        outNormal = float3(0.0, 0.0, 0.0);
+        outDist = 0;
+        exitPosition = float3(0.0, 0.0, 0.0);
+        return false;
+    }
+    outPosition = rayOrigin + t * rayDirection;
+    outNormal = normal;
+    outDist = t;
+    exitPosition = outPosition;
+    return true;
+}
+
+#endif
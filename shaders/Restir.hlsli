@@ -0,0 +1,312 @@
+#include "ParticleConfig.h"
+
+// Reservoir resampling of the direct light at the camera hit (ReSTIR DI, Bitterli
+// et al. 2020). Included by PathTrace.hlsli after Light.hlsli, with
+// `restirReservoirs`, `restirSurfaces` (this frame), `restirHistory`,
+// `restirHistorySurfaces` (last frame's, read while restirHistoryValid is not 0),
+// `restirOutput` and `restirWidth` bound. Nothing runs while restirWidth is 0.
+//
+// A sample is a point on an emissive sphere and the target is the unshadowed
+// luminance it sends to the surface, so samples can move between pixels:
+//   1. restirInitial() resamples RESTIR_CANDIDATE_NUM candidates, picked the way
+//      sampleDirectLight() picks them, down to one and drops it if its shadow ray
+//      is blocked. Last frame's reservoir of the same surface, found through the
+//      velocity and checked by particle id and normal, is merged in with its M
+//      capped at RESTIR_HISTORY_LIMIT times the candidates and normalized by the M
+//      of the two surfaces that see the merged sample.
+//   2. restirSpatial() resamples the pixel's reservoir and RESTIR_SPATIAL_NUM
+//      neighbours that see a similar surface with pairwise MIS weights, and shades
+//      the pixel with all of their samples at two shadow rays per neighbour.
+// A reservoir keeps no sample its own surface doesn't see and no combination gives
+// a share of a sample to a surface that doesn't see it, so the result doesn't
+// darken next to shadows the way plain 1/M does and a still scene converges to the
+// same image as without this. Particles that moved since last frame still bias the
+// history, and the reuse correlates neighbouring pixels and frames. While this
+// runs pathtrace() leaves the camera hit's direct light out: no light sampling
+// there, and a bounce from it that hits a light adds nothing.
+
+LightReservoir getEmptyReservoir()
+{
+    LightReservoir reservoir;
+    reservoir.lightOffset = 0;
+    reservoir.light = RESTIR_NO_LIGHT;
+    reservoir.weightSum = 0.0;
+    reservoir.M = 0.0;
+    reservoir.W = 0.0;
+    reservoir.targetPdf = 0.0;
+    return reservoir;
+}
+
+RestirSurface getEmptySurface()
+{
+    RestirSurface surface;
+    surface.position = 0;
+    surface.depth = 0.0;
+    surface.normal = 0;
+    surface.id = 0;
+    surface.albedo = 0;
+    surface._padding = 0.0;
+    return surface;
+}
+
+// A hit pathtrace() would sample lights at.
+bool isRestirSurface(Material material)
+{
+    return material.reflection == 0.0 && material.transparency == 0.0 && getBounceNum() > 1 && lightNum > 0;
+}
+
+float getRestirRandom(uint2 pixel, uint dimension)
+{
+    return toUnitFloat(hashUint(hashCombine(hashCombine(pixel.x + pixel.y * 65536u, uint(constantData.frame)), dimension)));
+}
+
+// Luminance of `contribution`, the light the sample sends to the surface without
+// the albedo and the shadow: emission * cos * cos / (PI * distance^2) in area measure.
+float getRestirTarget(float3 position, float3 normal, uint light, float3 lightOffset, OUT(float3) contribution)
+{
+    contribution = 0;
+    if (light == RESTIR_NO_LIGHT || !particles[light].visible || particles[light].material.emissive <= 0.0)
+    {
+        return 0.0;
+    }
+    float3 toLight = particles[light].position + lightOffset - position;
+    float distanceSquared = dot(toLight, toLight);
+    float3 direction = toLight * rsqrt(distanceSquared);
+    float surfaceCosine = dot(normal, direction);
+    float lightCosine = -dot(normalize(lightOffset), direction);
+    if (surfaceCosine <= 0.0 || lightCosine <= 0.0)
+    {
+        return 0.0;
+    }
+    contribution = getLightEmission(particles[light]) * (surfaceCosine * lightCosine / (PI * distanceSquared));
+    return dot(contribution, float3(0.2126, 0.7152, 0.0722));
+}
+
+// The shadow ray sampleDirectLight() traces.
+bool isLightPointVisible(float3 position, float3 lightPoint)
+{
+    float3 toLight = lightPoint - position;
+    float dist = length(toLight);
+    float3 direction = toLight / dist;
+    return !traceAny(position + direction * 1e-3, direction, dist - 2e-3);
+}
+
+// getRestirTarget() of a reservoir's sample, 0 when its shadow ray is blocked.
+float getVisibleRestirTarget(float3 position, float3 normal, LightReservoir reservoir, OUT(float3) contribution)
+{
+    float targetPdf = getRestirTarget(position, normal, reservoir.light, reservoir.lightOffset, contribution);
+    if (targetPdf > 0.0 && !isLightPointVisible(position, particles[reservoir.light].position + reservoir.lightOffset))
+    {
+        contribution = 0;
+        targetPdf = 0.0;
+    }
+    return targetPdf;
+}
+
+void updateReservoir(INOUT(LightReservoir) reservoir, uint light, float3 lightOffset, float weight, float targetPdf, float M, float u)
+{
+    reservoir.weightSum += weight;
+    reservoir.M += M;
+    if (weight > 0.0 && u * reservoir.weightSum < weight)
+    {
+        reservoir.light = light;
+        reservoir.lightOffset = lightOffset;
+        reservoir.targetPdf = targetPdf;
+    }
+}
+
+void finalizeReservoir(INOUT(LightReservoir) reservoir)
+{
+    reservoir.W = reservoir.targetPdf > 0.0 ? reservoir.weightSum / (reservoir.M * reservoir.targetPdf) : 0.0;
+}
+
+// Merges `other`, resampled for another surface, into a reservoir of this one.
+void mergeReservoir(INOUT(LightReservoir) reservoir, LightReservoir other, float3 position, float3 normal, float u)
+{
+    float3 contribution;
+    float targetPdf = getRestirTarget(position, normal, other.light, other.lightOffset, contribution);
+    updateReservoir(reservoir, other.light, other.lightOffset, targetPdf * other.W * other.M, targetPdf, other.M, u);
+}
+
+bool isRestirNeighbour(RestirSurface surface, RestirSurface neighbour)
+{
+    return neighbour.depth > 0.0 && dot(surface.normal, neighbour.normal) > RESTIR_NORMAL_THRESHOLD &&
+           abs(neighbour.depth - surface.depth) <= RESTIR_DEPTH_THRESHOLD * surface.depth;
+}
+
+// Step 1 for the camera hit of `pixel`, with its getPrimaryVelocity().
+void restirInitial(uint2 pixel, PrimaryHit primary, float2 velocity)
+{
+    uint index = pixel.y * restirWidth + pixel.x;
+    LightReservoir reservoir = getEmptyReservoir();
+    RestirSurface surface = getEmptySurface();
+    float3 position = primary.position;
+    float3 normal = primary.normal;
+    Material material = ZERO_INIT(Material);
+    if (primary.hit)
+    {
+        material = getMaterial(primary.particle, primary.particle.id - 1, position, normal, simData.scene, simData.time);
+    }
+    if (!primary.hit || !isRestirSurface(material))
+    {
+        restirReservoirs[index] = reservoir;
+        restirSurfaces[index] = surface;
+        return;
+    }
+    surface.position = position;
+    surface.depth = length(position - constantData.cameraPos);
+    surface.normal = normal;
+    surface.id = primary.particle.id;
+    surface.albedo = material.albedo;
+
+    for (uint candidate = 0; candidate < RESTIR_CANDIDATE_NUM; ++candidate)
+    {
+        float selectionPdf = 0.0;
+        uint light = selectLight(getRestirRandom(pixel, candidate * 4), selectionPdf);
+        float conePdf = getSphereConePdf(position, particles[light]);
+        float3 direction = sampleSphereCone(position, particles[light], float2(getRestirRandom(pixel, candidate * 4 + 1), getRestirRandom(pixel, candidate * 4 + 2)));
+        float3 lightPosition;
+        float3 lightNormal;
+        float3 lightExit;
+        float lightDist = 0.0;
+        float weight = 0.0;
+        float targetPdf = 0.0;
+        float3 lightOffset = 0;
+        if (conePdf > 0.0 && intersectsParticle(position, direction, particles[light], lightPosition, lightNormal, lightDist, lightExit))
+        {
+            // The cone pdf moved from solid angle to the light's area.
+            lightOffset = lightPosition - particles[light].position;
+            float3 contribution;
+            targetPdf = getRestirTarget(position, normal, light, lightOffset, contribution);
+            float sourcePdf = selectionPdf * conePdf * max(-dot(lightNormal, direction), 0.0) / (lightDist * lightDist);
+            weight = sourcePdf > 0.0 ? targetPdf / sourcePdf : 0.0;
+        }
+        updateReservoir(reservoir, light, lightOffset, weight, targetPdf, 1.0, getRestirRandom(pixel, candidate * 4 + 3));
+    }
+    finalizeReservoir(reservoir);
+    if (reservoir.W > 0.0 && !isLightPointVisible(position, particles[reservoir.light].position + reservoir.lightOffset))
+    {
+        reservoir.W = 0.0;
+    }
+
+    if (restirHistoryValid != 0)
+    {
+        float2 previous = float2(pixel) + velocity * constantData.resolution.xy;
+        int2 previousPixel = int2(int(floor(previous.x + 0.5)), int(floor(previous.y + 0.5)));
+        if (previousPixel.x >= 0 && previousPixel.y >= 0 && previousPixel.x < int(restirWidth) && previousPixel.y < int(constantData.resolution.y))
+        {
+            uint previousIndex = uint(previousPixel.y) * restirWidth + uint(previousPixel.x);
+            RestirSurface previousSurface = restirHistorySurfaces[previousIndex];
+            if (previousSurface.depth > 0.0 && previousSurface.id == surface.id && dot(previousSurface.normal, normal) > RESTIR_NORMAL_THRESHOLD)
+            {
+                // The cap only shifts the history's share: its M enters the weight and
+                // the normalization below alike.
+                LightReservoir history = restirHistory[previousIndex];
+                history.M = min(history.M, RESTIR_HISTORY_LIMIT * reservoir.M);
+                LightReservoir merged = getEmptyReservoir();
+                mergeReservoir(merged, reservoir, position, normal, getRestirRandom(pixel, RESTIR_CANDIDATE_NUM * 4));
+                mergeReservoir(merged, history, position, normal, getRestirRandom(pixel, RESTIR_CANDIDATE_NUM * 4 + 1));
+                // Normalized by the M of the two reservoirs whose surface sees the
+                // sample. Each holds only samples its surface sees, so the one the
+                // sample came from needs no shadow ray. Both are the same surface a
+                // frame apart, whose targets agree, so this is cheaper than the pairwise
+                // weights of restirSpatial() without their fireflies.
+                if (merged.targetPdf > 0.0)
+                {
+                    bool isCurrentSample = merged.light == reservoir.light && merged.lightOffset.x == reservoir.lightOffset.x &&
+                        merged.lightOffset.y == reservoir.lightOffset.y && merged.lightOffset.z == reservoir.lightOffset.z;
+                    bool isCurrentVisible = isCurrentSample || isLightPointVisible(position, particles[merged.light].position + merged.lightOffset);
+                    float3 contribution;
+                    bool isHistoryVisible = !isCurrentSample || getVisibleRestirTarget(previousSurface.position, previousSurface.normal, merged, contribution) > 0.0;
+                    float M = (isCurrentVisible ? reservoir.M : 0.0) + (isHistoryVisible ? history.M : 0.0);
+                    merged.W = isCurrentVisible ? merged.weightSum / (M * merged.targetPdf) : 0.0;
+                }
+                reservoir = merged;
+            }
+        }
+    }
+
+    restirReservoirs[index] = reservoir;
+    restirSurfaces[index] = surface;
+}
+
+// Step 2, once restirInitial() ran for every pixel. Returns the direct light to add
+// to the pixel's color.
+float3 restirSpatial(uint2 pixel)
+{
+    uint index = pixel.y * restirWidth + pixel.x;
+    RestirSurface surface = restirSurfaces[index];
+    LightReservoir canonical = restirReservoirs[index];
+    if (surface.depth <= 0.0)
+    {
+        restirOutput[index] = canonical;
+        return 0;
+    }
+
+    uint neighbours[RESTIR_SPATIAL_NUM];
+    uint neighbourNum = 0;
+    float neighbourM = 0.0;
+    for (uint neighbour = 0; neighbour < RESTIR_SPATIAL_NUM; ++neighbour)
+    {
+        float radius = RESTIR_SPATIAL_RADIUS * sqrt(getRestirRandom(pixel, 65 + neighbour * 3));
+        float angle = 2.0 * PI * getRestirRandom(pixel, 66 + neighbour * 3);
+        int2 neighbourPixel = int2(int(pixel.x) + int(floor(cos(angle) * radius + 0.5)), int(pixel.y) + int(floor(sin(angle) * radius + 0.5)));
+        if (neighbourPixel.x < 0 || neighbourPixel.y < 0 || neighbourPixel.x >= int(restirWidth) || neighbourPixel.y >= int(constantData.resolution.y))
+        {
+            continue;
+        }
+        uint neighbourIndex = uint(neighbourPixel.y) * restirWidth + uint(neighbourPixel.x);
+        if (neighbourIndex == index || !isRestirNeighbour(surface, restirSurfaces[neighbourIndex]))
+        {
+            continue;
+        }
+        neighbours[neighbourNum++] = neighbourIndex;
+        neighbourM += restirReservoirs[neighbourIndex].M;
+    }
+
+    // Pairwise MIS between this pixel's reservoir and each neighbour, weighed by M,
+    // with shadowed targets so only the surfaces that see a sample get a share of
+    // it. Unlike counting the M of those surfaces, the weights stay bounded when a
+    // neighbour's target is far below this one's, which made its samples fireflies.
+    float3 canonicalContribution;
+    float canonicalTarget = getRestirTarget(surface.position, surface.normal, canonical.light, canonical.lightOffset, canonicalContribution);
+    float canonicalWeight = neighbourNum == 0 ? 1.0 : 0.0;
+    // The pixel is shaded with what the picked sample brings on average over all
+    // candidates, which needs no more rays than shading the picked one.
+    float3 color = 0;
+    LightReservoir reservoir = getEmptyReservoir();
+    for (uint entry = 0; entry < neighbourNum; ++entry)
+    {
+        RestirSurface neighbourSurface = restirSurfaces[neighbours[entry]];
+        LightReservoir other = restirReservoirs[neighbours[entry]];
+        float3 contribution;
+        if (canonical.W > 0.0)
+        {
+            float canonicalThere = getVisibleRestirTarget(neighbourSurface.position, neighbourSurface.normal, canonical, contribution);
+            canonicalWeight += other.M / neighbourM * canonical.M * canonicalTarget / (neighbourM * canonicalThere + canonical.M * canonicalTarget);
+        }
+        float targetPdf = 0.0;
+        float weight = 0.0;
+        if (other.W > 0.0)
+        {
+            // Seen from the neighbour, as the neighbour's reservoir only holds such samples.
+            float otherTarget = getRestirTarget(neighbourSurface.position, neighbourSurface.normal, other.light, other.lightOffset, contribution);
+            targetPdf = getVisibleRestirTarget(surface.position, surface.normal, other, contribution);
+            if (targetPdf > 0.0)
+            {
+                weight = other.M * otherTarget / (neighbourM * otherTarget + canonical.M * targetPdf) * targetPdf * other.W;
+                color += contribution * (weight / targetPdf);
+            }
+        }
+        updateReservoir(reservoir, other.light, other.lightOffset, weight, targetPdf, other.M, getRestirRandom(pixel, 67 + entry * 3));
+    }
+    float canonicalWeightSum = canonicalWeight * canonicalTarget * canonical.W;
+    updateReservoir(reservoir, canonical.light, canonical.lightOffset, canonicalWeightSum, canonicalTarget, canonical.M, getRestirRandom(pixel, 64));
+    color += canonicalContribution * (canonicalWeight * canonical.W);
+    // The weights sum to one, so there is no 1/M. Every candidate with a weight is
+    // seen from this surface, so the reservoir only holds samples its surface sees.
+    reservoir.W = reservoir.targetPdf > 0.0 ? reservoir.weightSum / reservoir.targetPdf : 0.0;
+    restirOutput[index] = reservoir;
+
+    return surface.albedo * color;
+}
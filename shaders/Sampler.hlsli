@@ -0,0 +1,133 @@
+#ifndef _SAMPLER_HLSLI_
+#define _SAMPLER_HLSLI_
+
+#include "BlueNoise.hlsli"
+
+// Owen scrambled Sobol samples (Burley 2020, "Practical Hash-based Owen Scrambling"),
+// dithered per pixel with the blue noise ranks. Every pixel walks the same scrambled
+// sequence, shifted (Cranley-Patterson) by its blue noise value, so one pixel's
+// samples stay stratified and the error left between neighbours is blue noise.
+// Shared between the shaders and the CPU (code/shaderport.h).
+
+#define SOBOL_DIMENSIONS 4
+
+// Generator matrices, one 32 bit column per index bit: van der Corput, then the
+// Joe-Kuo new-joe-kuo-6.21201 directions for dimensions 2 to 4.
+static const uint sobolMatrices[SOBOL_DIMENSIONS * 32] =
+{
+    0x80000000u, 0x40000000u, 0x20000000u, 0x10000000u, 0x08000000u, 0x04000000u, 0x02000000u, 0x01000000u,
+    0x00800000u, 0x00400000u, 0x00200000u, 0x00100000u, 0x00080000u, 0x00040000u, 0x00020000u, 0x00010000u,
+    0x00008000u, 0x00004000u, 0x00002000u, 0x00001000u, 0x00000800u, 0x00000400u, 0x00000200u, 0x00000100u,
+    0x00000080u, 0x00000040u, 0x00000020u, 0x00000010u, 0x00000008u, 0x00000004u, 0x00000002u, 0x00000001u,
+
+    0x80000000u, 0xc0000000u, 0xa0000000u, 0xf0000000u, 0x88000000u, 0xcc000000u, 0xaa000000u, 0xff000000u,
+    0x80800000u, 0xc0c00000u, 0xa0a00000u, 0xf0f00000u, 0x88880000u, 0xcccc0000u, 0xaaaa0000u, 0xffff0000u,
+    0x80008000u, 0xc000c000u, 0xa000a000u, 0xf000f000u, 0x88008800u, 0xcc00cc00u, 0xaa00aa00u, 0xff00ff00u,
+    0x80808080u, 0xc0c0c0c0u, 0xa0a0a0a0u, 0xf0f0f0f0u, 0x88888888u, 0xccccccccu, 0xaaaaaaaau, 0xffffffffu,
+
+    0x80000000u, 0xc0000000u, 0x60000000u, 0x90000000u, 0xe8000000u, 0x5c000000u, 0x8e000000u, 0xc5000000u,
+    0x68800000u, 0x9cc00000u, 0xee600000u, 0x55900000u, 0x80680000u, 0xc09c0000u, 0x60ee0000u, 0x90550000u,
+    0xe8808000u, 0x5cc0c000u, 0x8e606000u, 0xc5909000u, 0x6868e800u, 0x9c9c5c00u, 0xeeee8e00u, 0x5555c500u,
+    0x8000e880u, 0xc0005cc0u, 0x60008e60u, 0x9000c590u, 0xe8006868u, 0x5c009c9cu, 0x8e00eeeeu, 0xc5005555u,
+
+    0x80000000u, 0xc0000000u, 0x20000000u, 0x50000000u, 0xf8000000u, 0x74000000u, 0xa2000000u, 0x93000000u,
+    0xd8800000u, 0x25400000u, 0x59e00000u, 0xe6d00000u, 0x78080000u, 0xb40c0000u, 0x82020000u, 0xc3050000u,
+    0x208f8000u, 0x51474000u, 0xfbea2000u, 0x75d93000u, 0xa0858800u, 0x914e5400u, 0xdbe79e00u, 0x25db6d00u,
+    0x58800080u, 0xe54000c0u, 0x79e00020u, 0xb6d00050u, 0x800800f8u, 0xc00c0074u, 0x200200a2u, 0x50050093u
+};
+
+uint sobol(uint index, uint dimension)
+{
+    uint result = 0;
+    uint bit = dimension * 32;
+    while (index != 0)
+    {
+        if ((index & 1u) != 0)
+        {
+            result ^= sobolMatrices[bit];
+        }
+        index >>= 1;
+        bit++;
+    }
+    return result;
+}
+
+// lowbias32 (Chris Wellons).
+uint hashUint(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+uint hashCombine(uint seed, uint value)
+{
+    return seed ^ (hashUint(value) + 0x9e3779b9u + (seed << 6) + (seed >> 2));
+}
+
+// Scrambles the low bits from the high ones, which is an Owen scramble when the
+// bits are reversed around it.
+uint laineKarrasPermutation(uint x, uint seed)
+{
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return x;
+}
+
+uint owenScramble(uint x, uint seed)
+{
+    return reversebits(laineKarrasPermutation(reversebits(x), seed));
+}
+
+// Top 24 bits, the most a float in [0, 1) holds.
+float toUnitFloat(uint x)
+{
+    return float(x >> 8) * 5.96046448e-8;
+}
+
+// Shuffled and scrambled Sobol point `index` in [0, 1)^4. Different seeds give
+// independent sequences, which pads more dimensions out of the four.
+float4 getSobol4D(uint index, uint seed)
+{
+    uint shuffled = owenScramble(index, hashUint(seed));
+    return float4(toUnitFloat(owenScramble(sobol(shuffled, 0), hashCombine(seed, 1))),
+                  toUnitFloat(owenScramble(sobol(shuffled, 1), hashCombine(seed, 2))),
+                  toUnitFloat(owenScramble(sobol(shuffled, 2), hashCombine(seed, 3))),
+                  toUnitFloat(owenScramble(sobol(shuffled, 3), hashCombine(seed, 4))));
+}
+
+// Blue noise value of the pixel for one dimension. Each dimension reads the tile
+// at its own offset, so the dimensions do not share a pattern.
+float getBlueNoise(uint2 pixel, uint dimensionSeed)
+{
+    uint offset = hashUint(dimensionSeed);
+    uint2 shifted = uint2(pixel.x + (offset & (BLUE_NOISE_TILE - 1)), pixel.y + ((offset >> 8) & (BLUE_NOISE_TILE - 1)));
+    return (float(getBlueNoiseRank(shifted)) + 0.5) / float(BLUE_NOISE_TILE * BLUE_NOISE_TILE);
+}
+
+// Sample `index` of the pixel's sequence for `seed`. Every pixel uses the same
+// scrambled points, the blue noise shift decorrelates them.
+float4 getPixelSample4D(uint2 pixel, uint index, uint seed)
+{
+    float4 value = getSobol4D(index, seed);
+    value.x = frac(value.x + getBlueNoise(pixel, hashCombine(seed, 5)));
+    value.y = frac(value.y + getBlueNoise(pixel, hashCombine(seed, 6)));
+    value.z = frac(value.z + getBlueNoise(pixel, hashCombine(seed, 7)));
+    value.w = frac(value.w + getBlueNoise(pixel, hashCombine(seed, 8)));
+    return value;
+}
+
+// First dimension of getPixelSample4D() alone.
+float getPixelSample1D(uint2 pixel, uint index, uint seed)
+{
+    uint shuffled = owenScramble(index, hashUint(seed));
+    return frac(toUnitFloat(owenScramble(sobol(shuffled, 0), hashCombine(seed, 1))) + getBlueNoise(pixel, hashCombine(seed, 5)));
+}
+
+#endif
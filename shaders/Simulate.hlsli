@@ -0,0 +1,160 @@
+#include "ParticleConfig.h"
+#include "Primitive.hlsli"
+
+// Simulation code shared between SimulateCS.hlsl and the CPU (code/shaderport.h).
+// Expects `particles`, `simData` and `particleScene` to be bound by the includer.
+
+THREAD_STATIC float3 seed = float3(1, 1, 1);
+
+float3 palette(float t, float3 a, float3 b, float3 c, float3 d)
+{
+    return a + b * cos(6.283185 * (c * t + d));
+}
+
+float3 getRandomColor(float t)
+{
+#define vec3 float3
+    float3 color = palette(t, vec3(0.5, 0.5, 0.5), vec3(0.5, 0.5, 0.5), vec3(1.0, 1.0, 1.0), vec3(0.0, 0.10, 0.20));
+#undef vec3
+    return color;
+}
+
+float rand()
+{
+    seed = frac(seed * 1.6180339887 + 0.123456789);
+    float3 s = seed;
+    float n = dot(s, float3(12.9898, 78.233, 37.719));
+    return frac(sin(n) * 43758.5453);
+}
+
+// Function to handle response for a dynamic particle colliding with a static particle
+void handleStaticParticleResponse(INOUT(ParticleData) dynamicParticle, ParticleData staticParticle)
+{
+    float3 n = float3(0, 1, 0);
+    float penetration = 0.0f;
+    if (staticParticle.primitive == PARTICLE_PRIMITIVE_PLANE)
+    {
+        n = getPlaneNormal(staticParticle);
+        penetration = dynamicParticle.radius - getPlaneDistance(staticParticle, dynamicParticle.position);
+    }
+    else
+    {
+        float3 delta = dynamicParticle.position - staticParticle.position;
+        float dist = length(delta);
+        n = (dist > 1e-6) ? (delta / dist) : float3(0, 1, 0);
+        penetration = dynamicParticle.radius + staticParticle.radius - dist;
+    }
+
+    if (penetration > 0.0f)
+    {
+        const float percent = 0.8f;
+        const float slop = 1e-3f;
+        float corr = percent * max(penetration - slop, 0.0f);
+        dynamicParticle.position += n * corr;
+
+        float vN = dot(dynamicParticle.velocity, n);
+        if (vN < 0.0f)
+        {
+            float e = saturate(dynamicParticle.elasticity);
+            float mu = saturate(dynamicParticle.friction * staticParticle.friction);
+
+            float3 vNvec = vN * n;
+            float3 vT = dynamicParticle.velocity - vNvec;
+            float3 vN_post = -e * vNvec;
+            float3 vT_post = vT * (1.0f - mu);
+
+            dynamicParticle.velocity = vN_post + vT_post;
+        }
+    }
+}
+
+// Function to handle dynamic particle collision response
+void handleDynamicParticleResponse(INOUT(ParticleData) dynamicparticle1, INOUT(ParticleData) dynamicparticle2)
+{
+    float3 delta = dynamicparticle2.position - dynamicparticle1.position;
+    float distance = length(delta);
+    float radiiSum = dynamicparticle1.radius + dynamicparticle2.radius;
+    if (distance < radiiSum)
+    {
+        // Coincident particles (the scene RNG repeats itself at large counts) would
+        // give a NaN normal that then spreads through every neighbour.
+        float3 normal = (distance > 1e-6) ? normalize(delta) : float3(0, 1, 0);
+        float interDepth = radiiSum - distance;
+        float3 relativeVelocity = dynamicparticle1.velocity - dynamicparticle2.velocity;
+        float velocityAlongNormal = dot(relativeVelocity, normal);
+        float restitution = min(dynamicparticle1.elasticity, dynamicparticle2.elasticity);
+        float impulseScalar = -(1.0 + restitution) * velocityAlongNormal;
+        float3 impulse = normal * impulseScalar;
+        float3 correction = normal * (interDepth / (dynamicparticle1.radius + dynamicparticle2.radius));
+
+        if (dynamicparticle1.dynamic)
+        {
+            dynamicparticle1.velocity += impulse * dynamicparticle2.friction;
+            dynamicparticle1.position -= correction * dynamicparticle2.radius;
+        }
+
+        if (dynamicparticle2.dynamic)
+        {
+            dynamicparticle2.velocity -= impulse * dynamicparticle2.friction;
+            dynamicparticle2.position += correction * dynamicparticle1.radius;
+        }
+
+    }
+}
+
+#include "scenes/scene0/Sim0.hlsli"
+
+void initScene(uint pid, INOUT(ParticleData) particle, uint scene)
+{
+    if (scene == 0) initScene0(pid, particle);
+}
+
+void simulateScene(uint pid, uint sceneId, INOUT(ParticleData) particle, uint scene, float time)
+{
+    if (scene == 0) simScene0(pid, sceneId, particle, time);
+}
+
+// Split version of simulateScene for callers that provide their own collision
+// candidates (the CPU broadphase and simulator). integrateScene then collideScene
+// per candidate.
+void integrateScene(uint sceneId, INOUT(ParticleData) particle, uint scene, float time)
+{
+    if (scene == 0) integrateScene0(sceneId, particle, time);
+}
+
+void collideScene(INOUT(ParticleData) particle, ParticleData other, uint scene)
+{
+    if (scene == 0) collideScene0(particle, other);
+}
+
+// ParticleData::id is pid + 1 of the particle when the scene was initialized. The
+// CPU reorders particles for locality (code/mortonsort.h), so after init the scene
+// code identifies a particle by this id and not by its buffer index. Returns id - 1.
+uint beginParticle(uint pid, INOUT(ParticleData) particle)
+{
+    if (simData.frame == 0 || particle.id == 0)
+    {
+        particle.id = pid + 1;
+    }
+    uint sceneId = particle.id - 1;
+    seed += sceneId + simData.time;
+    // Always run this...
+    particle.prevPosition = particle.position;
+    return sceneId;
+}
+
+void simulateParticle(uint pid)
+{
+    ParticleData particle = particles[pid];
+    uint sceneId = beginParticle(pid, particle);
+
+    if (simData.frame > 0)
+    {
+        simulateScene(pid, sceneId, particle, simData.scene, simData.time);
+    }
+    else
+    {
+        initScene(pid, particle, simData.scene);
+    }
+    particles[pid] = particle;
+}
@@ -0,0 +1,24 @@
+#include "ParticleConfig.h"
+
+// Primary visibility from splatted spheres (code/splat.h). Each sphere is drawn over
+// the pixel rectangle it projects to, and every covered pixel keeps the particle
+// whose ray/sphere hit is closest, so the camera ray needs no trace: the particle
+// is read back here and the hit recomputed with the same intersectsParticle() the
+// rasterizer ran. Included by PathTrace.hlsli after TileBins.hlsli, with
+// `splatParticles` (one particle index per pixel, 0xffffffff for a miss) and
+// `splatWidth` bound. Nothing is bound while splatWidth is 0.
+
+#define SPLAT_MISS 0xffffffffu
+
+// trace() for the camera ray of `pixel`, out of the splat buffer.
+bool getSplatHit(float3 rayOrigin, float3 rayDirection, uint2 pixel, OUT(ParticleData) outParticle, OUT(float3) outPosition, OUT(float3) outNormal, OUT(float3) outExit)
+{
+    uint index = splatParticles[pixel.y * splatWidth + pixel.x];
+    if (index == SPLAT_MISS)
+    {
+        return false;
+    }
+    float dist = 0.0;
+    outParticle = particles[index];
+    return intersectsParticle(rayOrigin, rayDirection, particles[index], outPosition, outNormal, dist, outExit);
+}
@@ -1,12 +1,12 @@
 #include "ParticleConfig.h"
 
 Texture2D<float4> CurrentFrame : register(t0);
-Texture2D<float4> velocityBuffer : register(t1);
+Texture2D<float2> velocityBuffer : register(t1);
 Texture2D<float4> HistoryBuffer : register(t2);
-Texture2D<float4> positionBuffer : register(t3);
-Texture2D<float4> normalBuffer : register(t4);
-Texture2D<float4> PrevPositionBuffer : register(t5);
-Texture2D<float4> PrevNormalBuffer : register(t6);
+Texture2D<uint> idBuffer : register(t3);
+Texture2D<float2> normalBuffer : register(t4);
+Texture2D<uint> PrevIdBuffer : register(t5);
+Texture2D<float2> PrevNormalBuffer : register(t6);
 Texture2D<float> HistoryM1Prev : register(t7);
 Texture2D<float> HistoryM2Prev : register(t8);
 Texture2D<float> depthBuffer : register(t9);
@@ -21,11 +21,28 @@ ConstantBuffer<ConstantBufferData> constantData : register(b0);
 SamplerState linearClamp : register(s0);
 SamplerState pointClamp : register(s1);
 
+#include "GBuffer.hlsli"
+
 float luma(float3 c)
 {
     return dot(c, float3(0.299, 0.587, 0.114));
 }
 
+// Octahedral normals don't filter, so the four texels linearClamp would blend
+// are decoded first and blended after.
+float3 sampleNormal(Texture2D<float2> normals, float2 uv)
+{
+    float2 texel = uv * constantData.resolution.xy - 0.5;
+    int2 base = int2(floor(texel));
+    float2 f = texel - float2(base);
+    int2 last = int2(constantData.resolution.xy) - 1;
+    float3 n00 = decodeOctahedral(normals[clamp(base, int2(0, 0), last)]);
+    float3 n10 = decodeOctahedral(normals[clamp(base + int2(1, 0), int2(0, 0), last)]);
+    float3 n01 = decodeOctahedral(normals[clamp(base + int2(0, 1), int2(0, 0), last)]);
+    float3 n11 = decodeOctahedral(normals[clamp(base + int2(1, 1), int2(0, 0), last)]);
+    return lerp(lerp(n00, n10, f.x), lerp(n01, n11, f.x), f.y);
+}
+
 [numthreads(32, 32, 1)]
 void main( uint3 DTid : SV_DispatchThreadID )
 {
@@ -33,16 +50,14 @@ void main( uint3 DTid : SV_DispatchThreadID )
     if (px.x >= uint(constantData.resolution.x) || px.y >= uint(constantData.resolution.y))
         return;
     
-    float4 positionAndId = positionBuffer[px];
     float4 currentFrameAndDepth = CurrentFrame[px];
     
     float2 uv = (float2(px) + 0.5) / constantData.resolution.xy;
     float3 ccurr = currentFrameAndDepth.rgb;
-    float3 ncurr = normalize(normalBuffer[px].rgb);
-    float3 pcurr = positionAndId.xyz;
-    uint idcurr = uint(positionAndId.w);
+    float3 ncurr = decodeOctahedral(normalBuffer[px]);
+    uint idcurr = idBuffer[px];
     float zcurr = depthBuffer[px].r;
-    float2 vel = velocityBuffer[px].xy;
+    float2 vel = velocityBuffer[px];
     float2 uvPrev = uv + vel;
     
     bool valid = all(uvPrev > 0.0) && all(uvPrev <= 1.0) && all(idcurr > 0);
@@ -57,9 +72,9 @@ void main( uint3 DTid : SV_DispatchThreadID )
         cprev = prevFrameAndDepth.rgb;
         m1prev = HistoryM1Prev.SampleLevel(linearClamp, uvPrev, 0).r;
         m2prev = HistoryM2Prev.SampleLevel(linearClamp, uvPrev, 0).r;
-        float3 nprev = normalize(PrevNormalBuffer.SampleLevel(linearClamp, uvPrev, 0).rgb);
-        float3 pprev = PrevPositionBuffer.SampleLevel(linearClamp, uvPrev, 0).rgb;
-        uint idprev = uint(PrevPositionBuffer.SampleLevel(pointClamp, uvPrev, 0).w);
+        float3 nprev = normalize(sampleNormal(PrevNormalBuffer, uvPrev));
+        // Integer textures can't be sampled, this loads the texel pointClamp would.
+        uint idprev = PrevIdBuffer[clamp(int2(floor(uvPrev * constantData.resolution.xy)), int2(0, 0), int2(constantData.resolution.xy) - 1)];
         float zprev = PrevDepthBuffer.SampleLevel(linearClamp, uvPrev, 0).r;
         float ndot = dot(ncurr, nprev);
         float dz = abs(zcurr - zprev);
@@ -0,0 +1,162 @@
+#include "ParticleConfig.h"
+
+// Screen space tile bins for the camera rays (code/tilebins.h). Every sphere is
+// projected to a conservative pixel rectangle and listed in each TILE_BIN_SIZE
+// tile it touches, so a camera ray only tests the spheres of its pixel's tile.
+// Each tile lists its spheres front to back by getTileBinDepthKey(), and the ray
+// stops at the first sphere that starts behind its closest hit. Planes, spheres
+// around the camera and spheres covering a large part of the screen go to one
+// global list that every tile tests. Included by
+// PathTrace.hlsli after trace(), with `binOffsets` (tileNum + 1 entries),
+// `binParticles`, `binGlobalParticles`, `binGlobalNum` and `binColumnNum` bound.
+// Nothing is bound while binColumnNum is 0.
+
+// Closer than this in clip w the projection of a sphere is not worth bounding.
+#define TILE_BIN_MIN_W 1e-3
+// Relative slack on the early out, well above the rounding of intersectsParticle().
+#define TILE_BIN_DEPTH_SLACK 0.999
+
+// Top 16 bits of the distance from the camera to the front of the sphere, rounded
+// down. Sorting on it keeps every later sphere of a tile at least this far away.
+uint getTileBinDepthKey(ParticleData particle, float3 cameraPos)
+{
+    return asuint(max(length(particle.position - cameraPos) - particle.radius, 0.0)) >> 15;
+}
+
+// Distance from the camera per unit of clip w at the farthest screen corner, the
+// most any camera ray travels for its w.
+float getTileBinDistancePerW(float4x4 viewProjMtx, float4x4 invViewProjMtx, float3 cameraPos)
+{
+    float cameraW = mul(viewProjMtx, float4(cameraPos, 1)).w;
+    float distancePerW = 1.0;
+    for (uint corner = 0; corner < 4; ++corner)
+    {
+        float3 rayOrigin;
+        float3 rayDirection;
+        createRayFromUV(float2(float(corner & 1), float(corner >> 1)), invViewProjMtx, cameraPos, rayOrigin, rayDirection);
+        distancePerW = max(distancePerW, 1.0 / (mul(viewProjMtx, float4(cameraPos + rayDirection, 1)).w - cameraW));
+    }
+    return distancePerW;
+}
+
+// Pixels whose camera ray, through uv = pixel / resolution, can hit the sphere. A
+// ray only reaches the sphere past the clip w where it has gone the sphere's
+// distance from the camera, so the bounding box is clipped there before its corners
+// and edge crossings are projected. False when the sphere belongs on the global
+// list. A sphere that is off screen or behind the camera gets pixelMin > pixelMax.
+bool getSpherePixelRect(ParticleData particle, float4x4 viewProjMtx, float3 resolution, float3 cameraPos, float distancePerW,
+                        OUT(int2) pixelMin, OUT(int2) pixelMax)
+{
+    pixelMin = int2(0, 0);
+    pixelMax = int2(-1, -1);
+    if (particle.primitive != PARTICLE_PRIMITIVE_SPHERE)
+    {
+        return false;
+    }
+    // Kept short of the exact value for rounding.
+    float clipW = (length(particle.position - cameraPos) - particle.radius) / distancePerW * TILE_BIN_DEPTH_SLACK;
+    if (clipW < TILE_BIN_MIN_W)
+    {
+        return false;
+    }
+
+    float4 corners[8];
+    uint frontNum = 0;
+    for (uint corner = 0; corner < 8; ++corner)
+    {
+        float3 offset = float3((corner & 1) != 0 ? 1.0 : -1.0, (corner & 2) != 0 ? 1.0 : -1.0, (corner & 4) != 0 ? 1.0 : -1.0);
+        corners[corner] = mul(viewProjMtx, float4(particle.position + offset * particle.radius, 1));
+        frontNum += corners[corner].w >= clipW ? 1 : 0;
+    }
+    if (frontNum == 0)
+    {
+        return true;
+    }
+
+    float2 low = float2(3.402823466e+38F, 3.402823466e+38F);
+    float2 high = float2(-3.402823466e+38F, -3.402823466e+38F);
+    for (uint a = 0; a < 8; ++a)
+    {
+        float4 points[4];
+        uint pointNum = 0;
+        if (corners[a].w >= clipW)
+        {
+            points[pointNum++] = corners[a];
+        }
+        // The edges to the corners one bit up, each edge once.
+        for (uint axis = 0; axis < 3; ++axis)
+        {
+            uint b = a | (1u << axis);
+            if (b != a && (corners[a].w >= clipW) != (corners[b].w >= clipW))
+            {
+                float t = (clipW - corners[a].w) / (corners[b].w - corners[a].w);
+                points[pointNum] = corners[a] + (corners[b] - corners[a]) * t;
+                points[pointNum].w = clipW;
+                pointNum++;
+            }
+        }
+        for (uint i = 0; i < pointNum; ++i)
+        {
+            float2 pixel = (float2(points[i].x, points[i].y) / points[i].w * 0.5 + 0.5) * float2(resolution.x, resolution.y);
+            low = min(low, pixel);
+            high = max(high, pixel);
+        }
+    }
+
+    // A pixel of slack for the rounding between this and createRayFromUV().
+    float2 limit = float2(resolution.x, resolution.y);
+    low = clamp(low - 1.0, float2(-1.0, -1.0), limit);
+    high = clamp(high + 1.0, float2(-1.0, -1.0), limit);
+    pixelMin = int2(max(int(ceil(low.x)), 0), max(int(ceil(low.y)), 0));
+    pixelMax = int2(min(int(floor(high.x)), int(resolution.x) - 1), min(int(floor(high.y)), int(resolution.y) - 1));
+    return true;
+}
+
+void testBinnedParticle(float3 rayOrigin, float3 rayDirection, uint index, INOUT(uint) closestIndex, INOUT(float) closestDist,
+                        INOUT(ParticleData) outParticle, INOUT(float3) outPosition, INOUT(float3) outNormal, INOUT(float3) outExit)
+{
+    float3 hitPosition;
+    float3 hitNormal;
+    float3 hitExit;
+    float dist = 0.0;
+    if (particles[index].visible && intersectsParticle(rayOrigin, rayDirection, particles[index], hitPosition, hitNormal, dist, hitExit))
+    {
+        // The lower index wins a tie, as in trace()'s loop over every particle.
+        if (dist < closestDist || (dist == closestDist && index < closestIndex))
+        {
+            outParticle = particles[index];
+            outPosition = hitPosition;
+            outNormal = hitNormal;
+            outExit = hitExit;
+            closestDist = dist;
+            closestIndex = index;
+        }
+    }
+}
+
+// trace() for the camera ray of `pixel`.
+bool traceTileBins(float3 rayOrigin, float3 rayDirection, uint2 pixel, OUT(ParticleData) outParticle, OUT(float3) outPosition, OUT(float3) outNormal, OUT(float3) outExit)
+{
+#ifdef IS_CPU
+    rayNum++;
+#endif
+    uint closestIndex = 0xffffffffu;
+    float closestDist = 3.402823466e+38F;
+    for (uint i = 0; i < binGlobalNum; i++)
+    {
+        testBinnedParticle(rayOrigin, rayDirection, binGlobalParticles[i], closestIndex, closestDist, outParticle, outPosition, outNormal, outExit);
+    }
+    uint tile = (pixel.y / TILE_BIN_SIZE) * binColumnNum + pixel.x / TILE_BIN_SIZE;
+    for (uint j = binOffsets[tile]; j < binOffsets[tile + 1]; j++)
+    {
+        // The tile is front to back, nothing after a sphere that starts behind the
+        // closest hit can be closer.
+        uint index = binParticles[j];
+        if (asfloat(getTileBinDepthKey(particles[index], rayOrigin) << 15) * TILE_BIN_DEPTH_SLACK > closestDist)
+        {
+            break;
+        }
+        testBinnedParticle(rayOrigin, rayDirection, index, closestIndex, closestDist, outParticle, outPosition, outNormal, outExit);
+    }
+    return closestIndex != 0xffffffffu;
+}
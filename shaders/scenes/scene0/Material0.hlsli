@@ -1,6 +1,6 @@
 #include "../../ParticleConfig.h"
 
-Material getMaterialScene0(in ParticleData particle, uint pid, inout float3 position, inout float3 normal, float time)
+Material getMaterialScene0(ParticleData particle, uint pid, INOUT(float3) position, INOUT(float3) normal, float time)
 {
     Material material = particle.material;
     
@@ -1,8 +1,7 @@
 #include "../../ParticleConfig.h"
 
-void initScene0(uint pid)
+void initScene0(uint pid, INOUT(ParticleData) particle)
 {
-    ParticleData particle = particles[pid];
     const float bigRadius = 999.0;
     const float offset = 25.0;
     if (pid == 0)
@@ -118,43 +117,54 @@ void initScene0(uint pid)
         particle.material.reflection = 1;
         particle.visible = 1;
     }
+    // The walls are only ever seen from the inside, so they can be planes.
+    particle.primitive = pid < 6 ? PARTICLE_PRIMITIVE_PLANE : PARTICLE_PRIMITIVE_SPHERE;
     particle.prevPosition = 0;
-    particles[pid] = particle;
 }
 
-void simScene0(uint pid, float time)
+// Particles are passed by value so the in-place update below and the double
+// buffered CPU simulator (code/cpusim.h) share the same code.
+void integrateScene0(uint sceneId, INOUT(ParticleData) particle, float time)
 {
-    ParticleData particle = particles[pid];
     if (particle.dynamic)
     {
-        particles[pid].acceleration = 0.00001 * (float3(0, 0, 0) - particle.position);
-        //particles[pid].emissive = abs(sin((sin(pid + time * .5) * 0.5))) * 1.0;
-        particles[pid].velocity += particle.acceleration;
-        //particles[pid].position += particle.velocity;
-        //particles[pid].albedo = getRandomColor(fmod(float(pid) / particleScene.numParticles + time * 0.1, 1.0));
+        // Velocity picks up the acceleration of the previous step.
+        float3 acceleration = particle.acceleration;
+        particle.acceleration = 0.00001 * (float3(0, 0, 0) - particle.position);
+        //particle.emissive = abs(sin((sin(sceneId + time * .5) * 0.5))) * 1.0;
+        particle.velocity += acceleration;
+        //particle.position += particle.velocity;
+        //particle.albedo = getRandomColor(fmod(float(sceneId) / particleScene.numParticles + time * 0.1, 1.0));
     }
     
-    if (pid == 6)
+    if (sceneId == 6)
     {
-        particles[pid].position = simData.cameraPos;
+        particle.position = simData.cameraPos;
     }
+}
 
-    for (int i = 0; i < particleScene.numParticles; ++i)
+// Narrowphase for one pair. Only particle is written, other is read only.
+void collideScene0(INOUT(ParticleData) particle, ParticleData other)
+{
+    if (particle.dynamic && other.dynamic)
+    {
+        handleDynamicParticleResponse(particle, other);
+    }
+    else if (particle.dynamic && !other.dynamic)
+    {
+        handleStaticParticleResponse(particle, other);
+    }
+}
+
+void simScene0(uint pid, uint sceneId, INOUT(ParticleData) particle, float time)
+{
+    integrateScene0(sceneId, particle, time);
+
+    for (uint i = 0; i < particleScene.numParticles; ++i)
     {
-        particle = particles[pid];
         if (i != pid)
         {
-            ParticleData particle2 = particles[i];
-
-            if (particle.dynamic && particle2.dynamic)
-            {
-                handleDynamicParticleResponse(particle, particle2);
-            }
-            else if (particle.dynamic && !particle2.dynamic)
-            {
-                handleStaticParticleResponse(particle, particle2);
-            }
-            particles[pid] = particle;
+            collideScene0(particle, particles[i]);
         }
     }
-}
\ No newline at end of file
+}